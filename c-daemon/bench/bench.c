@@ -0,0 +1,126 @@
+// Benchmark Support Implementation
+// Latency histograms and report lines shared by the benchmark programs
+//
+// Each power of two of nanoseconds is split into BENCH_SUB_BUCKETS linear
+// steps, so a histogram is a fixed array that records in constant time and
+// resolves p999 to within a few percent from nanoseconds to minutes.
+// Quantiles report the upper edge of their bucket, which never flatters.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "platform.h"
+
+static int highest_bit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1) {
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+// Values below BENCH_SUB_BUCKETS get a bucket each; above, the bits after
+// the leading one pick the step within its power of two
+static int bucket_index(uint64_t ns) {
+    if (ns < BENCH_SUB_BUCKETS) {
+        return (int)ns;
+    }
+    int bit = highest_bit(ns);
+    if (bit >= BENCH_MAX_EXPONENT) {
+        return BENCH_BUCKETS - 1;
+    }
+    return BENCH_SUB_BUCKETS * (bit - BENCH_SUB_BITS + 1) +
+           (int)((ns >> (bit - BENCH_SUB_BITS)) & (BENCH_SUB_BUCKETS - 1));
+}
+
+// Smallest value that lands in a bucket
+static uint64_t bucket_lower(int index) {
+    if (index < BENCH_SUB_BUCKETS) {
+        return (uint64_t)index;
+    }
+    int shift = index / BENCH_SUB_BUCKETS - 1;
+    return (uint64_t)(BENCH_SUB_BUCKETS + index % BENCH_SUB_BUCKETS) << shift;
+}
+
+void bench_histogram_record(bench_histogram_t *h, uint64_t ns) {
+    h->buckets[bucket_index(ns)]++;
+    h->count++;
+    h->sum += ns;
+    if (ns > h->max) {
+        h->max = ns;
+    }
+}
+
+void bench_histogram_merge(bench_histogram_t *into, const bench_histogram_t *from) {
+    for (int i = 0; i < BENCH_BUCKETS; i++) {
+        into->buckets[i] += from->buckets[i];
+    }
+    into->count += from->count;
+    into->sum += from->sum;
+    if (from->max > into->max) {
+        into->max = from->max;
+    }
+}
+
+// Upper edge of the bucket holding quantile q (0..1), capped at the largest
+// value seen; 0 when empty
+uint64_t bench_histogram_quantile(const bench_histogram_t *h, double q) {
+    if (h->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * (double)h->count);
+    if (rank >= h->count) {
+        rank = h->count - 1;
+    }
+
+    uint64_t seen = 0;
+    for (int i = 0; i < BENCH_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen > rank) {
+            uint64_t upper = i + 1 < BENCH_BUCKETS ? bucket_lower(i + 1) - 1 : h->max;
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
+
+void bench_report_header(void) {
+    printf("%-16s %10s %8s %12s %10s %10s %10s %10s %10s\n",
+           "operation", "count", "errors", "ops/s", "mean_us", "p50_us", "p99_us", "p999_us", "max_us");
+}
+
+// One line per operation; seconds is the measured wall time
+void bench_report(const char *name, const bench_histogram_t *h, uint64_t errors, double seconds) {
+    double mean = h->count > 0 ? (double)h->sum / (double)h->count : 0.0;
+    printf("%-16s %10llu %8llu %12.1f %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+           name, (unsigned long long)h->count, (unsigned long long)errors,
+           seconds > 0.0 ? (double)h->count / seconds : 0.0,
+           mean / 1000.0,
+           (double)bench_histogram_quantile(h, 0.50) / 1000.0,
+           (double)bench_histogram_quantile(h, 0.99) / 1000.0,
+           (double)bench_histogram_quantile(h, 0.999) / 1000.0,
+           (double)h->max / 1000.0);
+}
+
+// Portable sleep on a private condition variable nobody signals
+void bench_sleep_ms(int ms) {
+    mutex_t mutex;
+    cond_t cond;
+    mutex_init(&mutex);
+    cond_init(&cond);
+
+    long long deadline = monotonic_ms() + ms;
+    mutex_lock(&mutex);
+    for (long long left = ms; left > 0; left = deadline - monotonic_ms()) {
+        cond_timedwait_ms(&cond, &mutex, (int)left);
+    }
+    mutex_unlock(&mutex);
+
+    cond_destroy(&cond);
+    mutex_destroy(&mutex);
+}
\ No newline at end of file
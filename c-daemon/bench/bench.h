@@ -0,0 +1,33 @@
+// Benchmark Support Header
+// Latency histograms and report lines shared by the benchmark programs
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+#define BENCH_SUB_BUCKETS 16                 // Linear steps per power of two: <= 6.25% error
+#define BENCH_SUB_BITS 4                     // log2(BENCH_SUB_BUCKETS)
+#define BENCH_MAX_EXPONENT 40                // 2^40 ns (~18 minutes) and up share a bucket
+#define BENCH_BUCKETS (BENCH_SUB_BUCKETS * BENCH_MAX_EXPONENT)
+
+// Log-linear latency histogram in nanoseconds, like the daemon's metrics
+// but finer. One per thread and operation, merged for the report. All-zero
+// is a valid, empty histogram.
+typedef struct {
+    uint64_t buckets[BENCH_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+} bench_histogram_t;
+
+// Function declarations
+void bench_histogram_record(bench_histogram_t *h, uint64_t ns);
+void bench_histogram_merge(bench_histogram_t *into, const bench_histogram_t *from);
+uint64_t bench_histogram_quantile(const bench_histogram_t *h, double q);
+
+void bench_report_header(void);
+void bench_report(const char *name, const bench_histogram_t *h, uint64_t errors, double seconds);
+void bench_sleep_ms(int ms);
+
+#endif // BENCH_H
\ No newline at end of file
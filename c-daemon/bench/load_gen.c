@@ -0,0 +1,672 @@
+// Load Generator
+// Closed-loop multi-threaded client measuring daemon throughput and latency
+//
+// Every thread keeps one connection to the daemon, over HTTP/1.1 keep-alive
+// or the binary command socket, and issues one request at a time, picking
+// each from the weighted mix:
+//   acquire  TRY_ACQUIRE on one of --contention shared rooms, then RELEASE
+//            if granted; conflicts count as busy, not as errors
+//   create   CREATE_MESSAGE into the thread's own room, whose writer
+//            semaphore it takes before the run
+//   list     LIST_MESSAGES page 1 of the thread's own room, --limit rows on
+//            either transport
+// Requests issued during --warmup are not recorded. Latency is measured
+// from the first byte sent to the last byte of the reply.
+
+#ifndef _WIN32
+    #define _POSIX_C_SOURCE 200809L  // inet_pton
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "bench.h"
+#include "platform.h"
+#include "handlers.h"
+#include "command_socket.h"
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #include <afunix.h>
+    typedef SOCKET bench_socket_t;
+    #define BENCH_INVALID_SOCKET INVALID_SOCKET
+    #define close_socket closesocket
+#else
+    #include <unistd.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <arpa/inet.h>
+    typedef int bench_socket_t;
+    #define BENCH_INVALID_SOCKET (-1)
+    #define close_socket close
+#endif
+
+#define LOAD_DEFAULT_THREADS 4
+#define LOAD_DEFAULT_DURATION_S 10
+#define LOAD_DEFAULT_WARMUP_S 1
+#define LOAD_MAX_THREADS 256
+#define LOAD_RECV_BUFFER (256 * 1024)        // Largest reply accepted (a full page of long messages)
+#define LOAD_REQUEST_MAX (4 * 1024 + MAX_MESSAGE_LEN)
+#define LOAD_ERROR_TEXT 160                  // Reply bytes kept from the first failure of each operation
+
+typedef enum {
+    OP_TRY_ACQUIRE,
+    OP_RELEASE,
+    OP_CREATE,
+    OP_LIST,
+    OP_COUNT
+} load_op_t;
+
+static const char *const g_op_names[OP_COUNT] = { "try_acquire", "release", "create", "list" };
+
+typedef enum {
+    REPLY_OK,
+    REPLY_BUSY,                              // Semaphore held by another writer
+    REPLY_DENIED,                            // Writer semaphore not held
+    REPLY_ERROR
+} reply_kind_t;
+
+typedef struct {
+    bool use_socket;
+    const char *host;
+    int port;
+    const char *socket_path;
+    int threads;
+    int duration_s;
+    int warmup_s;
+    int weight_acquire;
+    int weight_create;
+    int weight_list;
+    int contention_rooms;
+    int message_size;
+    int limit;
+} load_config_t;
+
+typedef struct {
+    bench_socket_t fd;
+    bool use_socket;
+    uint32_t next_id;
+    char *buf;                               // Received bytes not yet consumed
+    size_t len;
+    bool closing;                            // Server said Connection: close; reconnect before the next request
+    char error[LOAD_ERROR_TEXT];             // Payload of the last failed reply
+} load_conn_t;
+
+typedef struct {
+    int index;
+    thread_t thread;
+    bench_histogram_t latency[OP_COUNT];
+    uint64_t errors[OP_COUNT];
+    char first_error[OP_COUNT][LOAD_ERROR_TEXT];
+    uint64_t busy;
+    uint64_t reconnects;
+    bool failed;                             // Connection lost; the thread stopped early
+} load_worker_t;
+
+static load_config_t g_config;
+static char g_message[MAX_MESSAGE_LEN];
+static atomic_u32_t g_measuring;
+static atomic_u32_t g_stop;
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --transport http|socket   Daemon interface to drive (default http)\n"
+            "  --host HOST               HTTP address (default 127.0.0.1)\n"
+            "  --port N                  HTTP port (default 8081)\n"
+            "  --socket PATH             Command socket (default " COMMAND_SOCKET_DEFAULT_PATH ")\n"
+            "  --threads N               Concurrent connections, one per thread (default %d)\n"
+            "  --duration S              Measured seconds (default %d)\n"
+            "  --warmup S                Unmeasured seconds first (default %d)\n"
+            "  --mix A,C,L               Weights of acquire, create and list (default 2,1,7)\n"
+            "  --contention N            Rooms the acquire mix contends on (default 1)\n"
+            "  --message-size BYTES      Created message length (default 64)\n"
+            "  --limit N                 List page size (default 50)\n",
+            program, LOAD_DEFAULT_THREADS, LOAD_DEFAULT_DURATION_S, LOAD_DEFAULT_WARMUP_S);
+}
+
+// Non-negative integer option; -1 if malformed
+static int parse_count(const char *text) {
+    if (text == NULL || *text == '\0') {
+        return -1;
+    }
+    char *end = NULL;
+    long value = strtol(text, &end, 10);
+    if (*end != '\0' || value < 0 || value > 1000000) {
+        return -1;
+    }
+    return (int)value;
+}
+
+static int parse_args(int argc, char *argv[]) {
+    g_config.host = "127.0.0.1";
+    g_config.port = 8081;
+    g_config.socket_path = COMMAND_SOCKET_DEFAULT_PATH;
+    g_config.threads = LOAD_DEFAULT_THREADS;
+    g_config.duration_s = LOAD_DEFAULT_DURATION_S;
+    g_config.warmup_s = LOAD_DEFAULT_WARMUP_S;
+    g_config.weight_acquire = 2;
+    g_config.weight_create = 1;
+    g_config.weight_list = 7;
+    g_config.contention_rooms = 1;
+    g_config.message_size = 64;
+    g_config.limit = 50;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        int *count = NULL;
+        if (strcmp(arg, "--transport") == 0 && value != NULL) {
+            if (strcmp(value, "socket") != 0 && strcmp(value, "http") != 0) {
+                return -1;
+            }
+            g_config.use_socket = strcmp(value, "socket") == 0;
+        } else if (strcmp(arg, "--host") == 0 && value != NULL) {
+            g_config.host = value;
+        } else if (strcmp(arg, "--socket") == 0 && value != NULL) {
+            g_config.socket_path = value;
+        } else if (strcmp(arg, "--mix") == 0 && value != NULL) {
+            if (sscanf(value, "%d,%d,%d", &g_config.weight_acquire, &g_config.weight_create,
+                       &g_config.weight_list) != 3) {
+                return -1;
+            }
+        } else if (strcmp(arg, "--port") == 0) {
+            count = &g_config.port;
+        } else if (strcmp(arg, "--threads") == 0) {
+            count = &g_config.threads;
+        } else if (strcmp(arg, "--duration") == 0) {
+            count = &g_config.duration_s;
+        } else if (strcmp(arg, "--warmup") == 0) {
+            count = &g_config.warmup_s;
+        } else if (strcmp(arg, "--contention") == 0) {
+            count = &g_config.contention_rooms;
+        } else if (strcmp(arg, "--message-size") == 0) {
+            count = &g_config.message_size;
+        } else if (strcmp(arg, "--limit") == 0) {
+            count = &g_config.limit;
+        } else {
+            return -1;
+        }
+        if (count != NULL && (*count = parse_count(value)) < 0) {
+            return -1;
+        }
+        i++;
+    }
+
+    if (g_config.threads < 1 || g_config.threads > LOAD_MAX_THREADS || g_config.duration_s < 1 ||
+        g_config.contention_rooms < 1 || g_config.message_size < 1 ||
+        g_config.message_size >= MAX_MESSAGE_LEN || g_config.limit < 1 ||
+        g_config.weight_acquire < 0 || g_config.weight_create < 0 || g_config.weight_list < 0 ||
+        g_config.weight_acquire + g_config.weight_create + g_config.weight_list == 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int conn_connect(load_conn_t *conn) {
+    conn->len = 0;
+    conn->closing = false;
+    if (conn->use_socket) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(g_config.socket_path) >= sizeof(addr.sun_path)) {
+            return -1;
+        }
+        strcpy(addr.sun_path, g_config.socket_path);
+        conn->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (conn->fd == BENCH_INVALID_SOCKET) {
+            return -1;
+        }
+        return connect(conn->fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 ? 0 : -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)g_config.port);
+    if (inet_pton(AF_INET, g_config.host, &addr.sin_addr) != 1) {
+        return -1;
+    }
+    conn->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (conn->fd == BENCH_INVALID_SOCKET) {
+        return -1;
+    }
+    int nodelay = 1;
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, (char *)&nodelay, sizeof(nodelay));
+    return connect(conn->fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 ? 0 : -1;
+}
+
+static int conn_open(load_conn_t *conn) {
+    conn->fd = BENCH_INVALID_SOCKET;
+    conn->use_socket = g_config.use_socket;
+    conn->next_id = 1;
+    conn->error[0] = '\0';
+    conn->buf = malloc(LOAD_RECV_BUFFER);
+    return conn->buf != NULL ? conn_connect(conn) : -1;
+}
+
+static void conn_disconnect(load_conn_t *conn) {
+    if (conn->fd != BENCH_INVALID_SOCKET) {
+        close_socket(conn->fd);
+        conn->fd = BENCH_INVALID_SOCKET;
+    }
+}
+
+static void conn_close(load_conn_t *conn) {
+    conn_disconnect(conn);
+    free(conn->buf);
+    conn->buf = NULL;
+}
+
+// Keep the first bytes of a failed reply's payload, one line
+static void keep_error(load_conn_t *conn, const char *payload, size_t len) {
+    if (len >= sizeof(conn->error)) {
+        len = sizeof(conn->error) - 1;
+    }
+    for (size_t i = 0; i < len; i++) {
+        conn->error[i] = payload[i] == '\r' || payload[i] == '\n' ? ' ' : payload[i];
+    }
+    conn->error[len] = '\0';
+}
+
+static int send_all(load_conn_t *conn, const char *data, size_t len) {
+    while (len > 0) {
+        int sent = (int)send(conn->fd, data, (int)len, 0);
+        if (sent <= 0) {
+            return -1;
+        }
+        data += sent;
+        len -= (size_t)sent;
+    }
+    return 0;
+}
+
+// Read until at least want bytes are buffered
+static int recv_until(load_conn_t *conn, size_t want) {
+    if (want > LOAD_RECV_BUFFER) {
+        return -1;
+    }
+    while (conn->len < want) {
+        int got = (int)recv(conn->fd, conn->buf + conn->len, (int)(LOAD_RECV_BUFFER - conn->len), 0);
+        if (got <= 0) {
+            return -1;
+        }
+        conn->len += (size_t)got;
+    }
+    return 0;
+}
+
+static void consume(load_conn_t *conn, size_t len) {
+    memmove(conn->buf, conn->buf + len, conn->len - len);
+    conn->len -= len;
+}
+
+static const char *find_bytes(const char *haystack, size_t len, const char *needle) {
+    size_t needle_len = strlen(needle);
+    for (size_t i = 0; i + needle_len <= len; i++) {
+        if (memcmp(haystack + i, needle, needle_len) == 0) {
+            return haystack + i;
+        }
+    }
+    return NULL;
+}
+
+// One HTTP exchange; returns the status code or -1 if the connection failed
+static int http_exchange(load_conn_t *conn, const char *request, size_t len) {
+    if (send_all(conn, request, len) != 0) {
+        return -1;
+    }
+
+    const char *end = NULL;
+    while ((end = find_bytes(conn->buf, conn->len, "\r\n\r\n")) == NULL) {
+        if (recv_until(conn, conn->len + 1) != 0) {
+            return -1;
+        }
+    }
+    size_t header_len = (size_t)(end - conn->buf) + 4;
+
+    int status = 0;
+    if (sscanf(conn->buf, "HTTP/1.%*d %d", &status) != 1) {
+        return -1;
+    }
+    size_t body_len = 0;
+    const char *length = find_bytes(conn->buf, header_len, "Content-Length:");
+    if (length != NULL) {
+        body_len = (size_t)strtoul(length + strlen("Content-Length:"), NULL, 10);
+    }
+
+    if (recv_until(conn, header_len + body_len) != 0) {
+        return -1;
+    }
+    if (status != 200) {
+        keep_error(conn, conn->buf + header_len, body_len);
+    }
+    conn->closing = find_bytes(conn->buf, header_len, "Connection: close") != NULL;
+    consume(conn, header_len + body_len);
+    return status;
+}
+
+static void put_u32(unsigned char *p, uint32_t value) {
+    p[0] = (unsigned char)(value >> 24);
+    p[1] = (unsigned char)(value >> 16);
+    p[2] = (unsigned char)(value >> 8);
+    p[3] = (unsigned char)value;
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static size_t put_field(unsigned char *p, command_field_t tag, const void *value, size_t len) {
+    p[0] = (unsigned char)tag;
+    p[1] = (unsigned char)(len >> 8);
+    p[2] = (unsigned char)len;
+    memcpy(p + 3, value, len);
+    return 3 + len;
+}
+
+static size_t put_string_field(unsigned char *p, command_field_t tag, const char *value) {
+    return put_field(p, tag, value, strlen(value));
+}
+
+static size_t put_number_field(unsigned char *p, command_field_t tag, uint32_t value) {
+    unsigned char number[4];
+    put_u32(number, value);
+    return put_field(p, tag, number, sizeof(number));
+}
+
+// One command frame exchange; returns the reply status (handlers.h codes)
+// or 1 if the connection failed
+static int socket_exchange(load_conn_t *conn, command_type_t type, unsigned char *frame, size_t len) {
+    uint32_t request_id = conn->next_id++;
+    put_u32(frame, (uint32_t)(len - 4));
+    put_u32(frame + 4, request_id);
+    frame[8] = (unsigned char)type;
+    if (send_all(conn, (const char *)frame, len) != 0 || recv_until(conn, COMMAND_REPLY_HEADER) != 0) {
+        return 1;
+    }
+
+    const unsigned char *reply = (const unsigned char *)conn->buf;
+    size_t reply_len = 4 + (size_t)get_u32(reply);
+    if (reply_len < COMMAND_REPLY_HEADER || get_u32(reply + 4) != request_id ||
+        recv_until(conn, reply_len) != 0) {
+        return 1;
+    }
+    int status = (int)get_u32((const unsigned char *)conn->buf + 8);
+    if (status != 0) {
+        keep_error(conn, conn->buf + COMMAND_REPLY_HEADER, reply_len - COMMAND_REPLY_HEADER);
+    }
+    consume(conn, reply_len);
+    return status;
+}
+
+// Issue one operation and classify its reply; -1 if the connection failed
+static int run_op(load_conn_t *conn, load_op_t op, const char *user, const char *room) {
+    if (conn->use_socket) {
+        unsigned char frame[LOAD_REQUEST_MAX];
+        size_t len = COMMAND_FRAME_HEADER;
+        command_type_t type = CMD_LIST_MESSAGES;
+        len += put_string_field(frame + len, FIELD_ROOM, room);
+        if (op == OP_LIST) {
+            len += put_number_field(frame + len, FIELD_PAGE, 1);
+            len += put_number_field(frame + len, FIELD_LIMIT, (uint32_t)g_config.limit);
+        } else {
+            type = op == OP_TRY_ACQUIRE ? CMD_TRY_ACQUIRE : op == OP_RELEASE ? CMD_RELEASE : CMD_CREATE_MESSAGE;
+            len += put_string_field(frame + len, FIELD_USER, user);
+            if (op == OP_CREATE) {
+                len += put_string_field(frame + len, FIELD_MESSAGE, g_message);
+            }
+        }
+
+        int status = socket_exchange(conn, type, frame, len);
+        return status == 1 ? -1
+               : status == 0 ? REPLY_OK
+               : status == -3 && op == OP_TRY_ACQUIRE ? REPLY_BUSY
+               : status == -2 && op == OP_CREATE ? REPLY_DENIED : REPLY_ERROR;
+    }
+
+    char body[LOAD_REQUEST_MAX / 2];
+    char request[LOAD_REQUEST_MAX];
+    int len;
+    if (op == OP_LIST) {
+        len = snprintf(request, sizeof(request),
+                       "GET /api/messages?room=%s&page=1&limit=%d HTTP/1.1\r\nHost: %s\r\n\r\n",
+                       room, g_config.limit, g_config.host);
+    } else {
+        const char *path = op == OP_TRY_ACQUIRE ? "/api/semaphore/acquire"
+                           : op == OP_RELEASE ? "/api/semaphore/release" : "/api/messages";
+        int body_len = op == OP_CREATE
+            ? snprintf(body, sizeof(body), "{\"username\":\"%s\",\"room\":\"%s\",\"message\":\"%s\"}",
+                       user, room, g_message)
+            : snprintf(body, sizeof(body), "{\"username\":\"%s\",\"room\":\"%s\"}", user, room);
+        len = snprintf(request, sizeof(request),
+                       "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\n"
+                       "Content-Length: %d\r\n\r\n%s",
+                       path, g_config.host, body_len, body);
+    }
+    if (len < 0 || (size_t)len >= sizeof(request)) {
+        return REPLY_ERROR;
+    }
+
+    int status = http_exchange(conn, request, (size_t)len);
+    return status < 0 ? -1
+           : status == 200 ? REPLY_OK
+           : status == 409 && op == OP_TRY_ACQUIRE ? REPLY_BUSY
+           : status == 403 && op == OP_CREATE ? REPLY_DENIED : REPLY_ERROR;
+}
+
+// xorshift32: cheap per-thread choice of the next operation and room
+static uint32_t next_random(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// The daemon closes kept-alive connections after a number of requests;
+// reconnect, outside any timing, if the last reply said so
+static int reconnect_if_closing(load_worker_t *worker, load_conn_t *conn) {
+    if (!conn->closing) {
+        return 0;
+    }
+    conn_disconnect(conn);
+    if (conn_connect(conn) != 0) {
+        return -1;
+    }
+    worker->reconnects++;
+    return 0;
+}
+
+static int untimed_op(load_worker_t *worker, load_conn_t *conn, load_op_t op, const char *user,
+                      const char *room) {
+    return reconnect_if_closing(worker, conn) == 0 ? run_op(conn, op, user, room) : -1;
+}
+
+// Time one operation, recording it once measuring has begun
+static int timed_op(load_worker_t *worker, load_conn_t *conn, load_op_t op, const char *user,
+                    const char *room) {
+    if (reconnect_if_closing(worker, conn) != 0) {
+        return -1;
+    }
+    uint64_t started = monotonic_ns();
+    int kind = run_op(conn, op, user, room);
+    uint64_t elapsed = monotonic_ns() - started;
+    if (kind >= 0 && atomic_u32_load(&g_measuring)) {
+        bench_histogram_record(&worker->latency[op], elapsed);
+        if (kind == REPLY_BUSY) {
+            worker->busy++;
+        } else if (kind != REPLY_OK) {
+            if (worker->errors[op]++ == 0) {
+                strcpy(worker->first_error[op], conn->error);
+            }
+        }
+    }
+    return kind;
+}
+
+static void *worker_main(void *arg) {
+    load_worker_t *worker = (load_worker_t *)arg;
+    char user[MAX_USERNAME_LEN];
+    char own_room[MAX_ROOM_NAME_LEN];
+    snprintf(user, sizeof(user), "bench-%d", worker->index);
+    snprintf(own_room, sizeof(own_room), "bench-own-%d", worker->index);
+    uint32_t random_state = 2463534242u + (uint32_t)worker->index * 2654435761u;
+    int total_weight = g_config.weight_acquire + g_config.weight_create + g_config.weight_list;
+
+    load_conn_t conn;
+    if (conn_open(&conn) != 0) {
+        fprintf(stderr, "Thread %d: cannot connect to the daemon\n", worker->index);
+        worker->failed = true;
+        conn_close(&conn);
+        return NULL;
+    }
+
+    // The thread's own room is where it creates; holding it outlasts the run
+    bool holds_own_room = g_config.weight_create == 0 ||
+                          untimed_op(worker, &conn, OP_TRY_ACQUIRE, user, own_room) == REPLY_OK;
+
+    while (!atomic_u32_load(&g_stop)) {
+        int pick = (int)(next_random(&random_state) % (uint32_t)total_weight);
+        int kind;
+        if (pick < g_config.weight_acquire) {
+            char room[MAX_ROOM_NAME_LEN];
+            snprintf(room, sizeof(room), "bench-shared-%u",
+                     next_random(&random_state) % (uint32_t)g_config.contention_rooms);
+            kind = timed_op(worker, &conn, OP_TRY_ACQUIRE, user, room);
+            if (kind == REPLY_OK) {
+                kind = timed_op(worker, &conn, OP_RELEASE, user, room);
+            }
+        } else if (pick < g_config.weight_acquire + g_config.weight_create) {
+            kind = timed_op(worker, &conn, OP_CREATE, user, own_room);
+            if (kind == REPLY_DENIED || !holds_own_room) {
+                // Lease expired or never granted: take the room back, untimed
+                holds_own_room = untimed_op(worker, &conn, OP_TRY_ACQUIRE, user, own_room) == REPLY_OK;
+            }
+        } else {
+            kind = timed_op(worker, &conn, OP_LIST, user, own_room);
+        }
+        if (kind < 0) {
+            fprintf(stderr, "Thread %d: connection lost\n", worker->index);
+            worker->failed = true;
+            break;
+        }
+    }
+
+    if (!worker->failed && g_config.weight_create > 0) {
+        untimed_op(worker, &conn, OP_RELEASE, user, own_room);
+    }
+    conn_close(&conn);
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    if (parse_args(argc, argv) != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+#ifdef _WIN32
+    WSADATA wsa_data;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+        fprintf(stderr, "WSAStartup failed\n");
+        return 1;
+    }
+#endif
+
+    memset(g_message, 'x', (size_t)g_config.message_size);
+    g_message[g_config.message_size] = '\0';
+
+    load_worker_t *workers = calloc((size_t)g_config.threads, sizeof(load_worker_t));
+    if (workers == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    printf("Driving %s with %d threads for %d s (+%d s warmup), mix acquire:create:list = %d:%d:%d, "
+           "%d contended room(s)\n",
+           g_config.use_socket ? g_config.socket_path : "HTTP", g_config.threads, g_config.duration_s,
+           g_config.warmup_s, g_config.weight_acquire, g_config.weight_create, g_config.weight_list,
+           g_config.contention_rooms);
+
+    int started = 0;
+    for (int i = 0; i < g_config.threads; i++) {
+        workers[i].index = i;
+        if (thread_create(&workers[i].thread, worker_main, &workers[i]) != 0) {
+            fprintf(stderr, "Cannot start thread %d\n", i);
+            break;
+        }
+        started++;
+    }
+
+    bench_sleep_ms(g_config.warmup_s * 1000);
+    uint64_t measure_start = monotonic_ns();
+    atomic_u32_store(&g_measuring, 1);
+    bench_sleep_ms(g_config.duration_s * 1000);
+    atomic_u32_store(&g_measuring, 0);
+    uint64_t measure_end = monotonic_ns();
+    atomic_u32_store(&g_stop, 1);
+
+    bench_histogram_t *totals = calloc(OP_COUNT + 1, sizeof(bench_histogram_t));
+    uint64_t errors[OP_COUNT + 1] = {0};
+    uint64_t busy = 0;
+    uint64_t reconnects = 0;
+    const char *first_error[OP_COUNT] = {0};
+    int failed = 0;
+    for (int i = 0; i < started; i++) {
+        thread_join(workers[i].thread);
+        failed += workers[i].failed ? 1 : 0;
+        busy += workers[i].busy;
+        reconnects += workers[i].reconnects;
+        for (int op = 0; op < OP_COUNT; op++) {
+            if (first_error[op] == NULL && workers[i].errors[op] > 0) {
+                first_error[op] = workers[i].first_error[op];
+            }
+            if (totals != NULL) {
+                bench_histogram_merge(&totals[op], &workers[i].latency[op]);
+                bench_histogram_merge(&totals[OP_COUNT], &workers[i].latency[op]);
+            }
+            errors[op] += workers[i].errors[op];
+            errors[OP_COUNT] += workers[i].errors[op];
+        }
+    }
+    if (totals == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        free(workers);
+        return 1;
+    }
+
+    double seconds = (double)(measure_end - measure_start) / 1e9;
+    bench_report_header();
+    for (int op = 0; op < OP_COUNT; op++) {
+        if (totals[op].count > 0) {
+            bench_report(g_op_names[op], &totals[op], errors[op], seconds);
+        }
+    }
+    bench_report("all", &totals[OP_COUNT], errors[OP_COUNT], seconds);
+    printf("try_acquire busy (held by another writer): %llu, reconnects: %llu\n",
+           (unsigned long long)busy, (unsigned long long)reconnects);
+    for (int op = 0; op < OP_COUNT; op++) {
+        if (first_error[op] != NULL) {
+            printf("first %s error: %s\n", g_op_names[op], first_error[op]);
+        }
+    }
+
+    free(totals);
+    free(workers);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    if (failed > 0 || started < g_config.threads) {
+        fprintf(stderr, "%d of %d threads did not finish the run\n",
+                failed + g_config.threads - started, g_config.threads);
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -38,6 +38,60 @@ echo Compiling with MSVC...
 cl /nologo /W3 /Iinclude /c src/main.c /Fo:obj/main.obj
 if %errorlevel% neq 0 goto :compile_error
 
+cl /nologo /W3 /Iinclude /c src/search_index.c /Fo:obj/search_index.obj
+if %errorlevel% neq 0 goto :compile_error
+
+cl /nologo /W3 /Iinclude /c src/arena.c /Fo:obj/arena.obj
+if %errorlevel% neq 0 goto :compile_error
+
+cl /nologo /W3 /Iinclude /c src/json_reader.c /Fo:obj/json_reader.obj
+if %errorlevel% neq 0 goto :compile_error
+
+cl /nologo /W3 /Iinclude /c src/http_parser.c /Fo:obj/http_parser.obj
+if %errorlevel% neq 0 goto :compile_error
+
+cl /nologo /W3 /Iinclude /c src/command_socket.c /Fo:obj/command_socket.obj
+if %errorlevel% neq 0 goto :compile_error
+
+cl /nologo /W3 /Iinclude /c src/events.c /Fo:obj/events.obj
+if %errorlevel% neq 0 goto :compile_error
+
+cl /nologo /W3 /Iinclude /c src/diag.c /Fo:obj/diag.obj
+if %errorlevel% neq 0 goto :compile_error
+
+cl /nologo /W3 /Iinclude /c src/metrics.c /Fo:obj/metrics.obj
+if %errorlevel% neq 0 goto :compile_error
+
+cl /nologo /W3 /Iinclude /c src/storage.c /Fo:obj/storage.obj
+if %errorlevel% neq 0 goto :compile_error
+
+cl /nologo /W3 /Iinclude /c src/db_simple.c /Fo:obj/db_simple.obj
+if %errorlevel% neq 0 goto :compile_error
+
+cl /nologo /W3 /Iinclude /c src/segment_store.c /Fo:obj/segment_store.obj
+if %errorlevel% neq 0 goto :compile_error
+
+cl /nologo /W3 /Iinclude /c src/message_cache.c /Fo:obj/message_cache.obj
+if %errorlevel% neq 0 goto :compile_error
+
+cl /nologo /W3 /Iinclude /c src/json_writer.c /Fo:obj/json_writer.obj
+if %errorlevel% neq 0 goto :compile_error
+
+cl /nologo /W3 /Iinclude /c src/strbuf.c /Fo:obj/strbuf.obj
+if %errorlevel% neq 0 goto :compile_error
+
+cl /nologo /W3 /Iinclude /c src/timer_wheel.c /Fo:obj/timer_wheel.obj
+if %errorlevel% neq 0 goto :compile_error
+
+cl /nologo /W3 /Iinclude /c src/platform.c /Fo:obj/platform.obj
+if %errorlevel% neq 0 goto :compile_error
+
+cl /nologo /W3 /Iinclude /c src/thread_pool.c /Fo:obj/thread_pool.obj
+if %errorlevel% neq 0 goto :compile_error
+
+cl /nologo /W3 /Iinclude /c src/event_loop.c /Fo:obj/event_loop.obj
+if %errorlevel% neq 0 goto :compile_error
+
 cl /nologo /W3 /Iinclude /c src/semaphore.c /Fo:obj/semaphore.obj
 if %errorlevel% neq 0 goto :compile_error
 
@@ -51,30 +105,84 @@ cl /nologo /W3 /Iinclude /c src/handlers.c /Fo:obj/handlers.obj
 if %errorlevel% neq 0 goto :compile_error
 
 echo Linking with MSVC...
-link /nologo obj/main.obj obj/semaphore.obj obj/db.obj obj/logger.obj obj/handlers.obj /out:bin/chat_daemon.exe ws2_32.lib
+link /nologo obj/main.obj obj/search_index.obj obj/arena.obj obj/json_reader.obj obj/http_parser.obj obj/command_socket.obj obj/events.obj obj/diag.obj obj/metrics.obj obj/storage.obj obj/db_simple.obj obj/segment_store.obj obj/message_cache.obj obj/json_writer.obj obj/strbuf.obj obj/timer_wheel.obj obj/platform.obj obj/thread_pool.obj obj/event_loop.obj obj/semaphore.obj obj/db.obj obj/logger.obj obj/handlers.obj /out:bin/chat_daemon.exe ws2_32.lib
 if %errorlevel% neq 0 goto :link_error
 
 goto :success
 
 :use_gcc
 echo Compiling with GCC...
-gcc -Wall -Wextra -std=c99 -Iinclude -c src/main.c -o obj/main.o
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/main.c -o obj/main.o
+if %errorlevel% neq 0 goto :compile_error
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/search_index.c -o obj/search_index.o
+if %errorlevel% neq 0 goto :compile_error
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/arena.c -o obj/arena.o
+if %errorlevel% neq 0 goto :compile_error
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/json_reader.c -o obj/json_reader.o
+if %errorlevel% neq 0 goto :compile_error
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/http_parser.c -o obj/http_parser.o
+if %errorlevel% neq 0 goto :compile_error
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/command_socket.c -o obj/command_socket.o
+if %errorlevel% neq 0 goto :compile_error
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/events.c -o obj/events.o
+if %errorlevel% neq 0 goto :compile_error
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/diag.c -o obj/diag.o
+if %errorlevel% neq 0 goto :compile_error
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/metrics.c -o obj/metrics.o
+if %errorlevel% neq 0 goto :compile_error
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/storage.c -o obj/storage.o
+if %errorlevel% neq 0 goto :compile_error
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/db_simple.c -o obj/db_simple.o
+if %errorlevel% neq 0 goto :compile_error
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/segment_store.c -o obj/segment_store.o
+if %errorlevel% neq 0 goto :compile_error
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/message_cache.c -o obj/message_cache.o
+if %errorlevel% neq 0 goto :compile_error
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/json_writer.c -o obj/json_writer.o
+if %errorlevel% neq 0 goto :compile_error
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/strbuf.c -o obj/strbuf.o
+if %errorlevel% neq 0 goto :compile_error
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/timer_wheel.c -o obj/timer_wheel.o
+if %errorlevel% neq 0 goto :compile_error
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/platform.c -o obj/platform.o
+if %errorlevel% neq 0 goto :compile_error
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/thread_pool.c -o obj/thread_pool.o
+if %errorlevel% neq 0 goto :compile_error
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/event_loop.c -o obj/event_loop.o
 if %errorlevel% neq 0 goto :compile_error
 
-gcc -Wall -Wextra -std=c99 -Iinclude -c src/semaphore.c -o obj/semaphore.o
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/semaphore.c -o obj/semaphore.o
 if %errorlevel% neq 0 goto :compile_error
 
-gcc -Wall -Wextra -std=c99 -Iinclude -c src/db.c -o obj/db.o
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/db.c -o obj/db.o
 if %errorlevel% neq 0 goto :compile_error
 
-gcc -Wall -Wextra -std=c99 -Iinclude -c src/logger.c -o obj/logger.o
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/logger.c -o obj/logger.o
 if %errorlevel% neq 0 goto :compile_error
 
-gcc -Wall -Wextra -std=c99 -Iinclude -c src/handlers.c -o obj/handlers.o
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/handlers.c -o obj/handlers.o
 if %errorlevel% neq 0 goto :compile_error
 
 echo Linking with GCC...
-gcc obj/main.o obj/semaphore.o obj/db.o obj/logger.o obj/handlers.o -o bin/chat_daemon.exe -lws2_32
+gcc obj/main.o obj/search_index.o obj/arena.o obj/json_reader.o obj/http_parser.o obj/command_socket.o obj/events.o obj/diag.o obj/metrics.o obj/storage.o obj/db_simple.o obj/segment_store.o obj/message_cache.o obj/json_writer.o obj/strbuf.o obj/timer_wheel.o obj/platform.o obj/thread_pool.o obj/event_loop.o obj/semaphore.o obj/db.o obj/logger.o obj/handlers.o -o bin/chat_daemon.exe -lws2_32
 if %errorlevel% neq 0 goto :link_error
 
 goto :success
@@ -16,35 +16,161 @@ echo Consider using vcpkg: vcpkg install sqlite3 cjson
 
 REM Compile source files
 echo Compiling source files...
-gcc -Wall -Wextra -std=c99 -Iinclude -c src/main.c -o obj/main.o
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/main.c -o obj/main.o
 if %errorlevel% neq 0 (
     echo Compilation of main.c failed!
     pause
     exit /b 1
 )
 
-gcc -Wall -Wextra -std=c99 -Iinclude -c src/semaphore.c -o obj/semaphore.o
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/search_index.c -o obj/search_index.o
+if %errorlevel% neq 0 (
+    echo Compilation of search_index.c failed!
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/arena.c -o obj/arena.o
+if %errorlevel% neq 0 (
+    echo Compilation of arena.c failed!
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/json_reader.c -o obj/json_reader.o
+if %errorlevel% neq 0 (
+    echo Compilation of json_reader.c failed!
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/http_parser.c -o obj/http_parser.o
+if %errorlevel% neq 0 (
+    echo Compilation of http_parser.c failed!
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/command_socket.c -o obj/command_socket.o
+if %errorlevel% neq 0 (
+    echo Compilation of command_socket.c failed!
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/events.c -o obj/events.o
+if %errorlevel% neq 0 (
+    echo Compilation of events.c failed!
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/diag.c -o obj/diag.o
+if %errorlevel% neq 0 (
+    echo Compilation of diag.c failed!
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/metrics.c -o obj/metrics.o
+if %errorlevel% neq 0 (
+    echo Compilation of metrics.c failed!
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/storage.c -o obj/storage.o
+if %errorlevel% neq 0 (
+    echo Compilation of storage.c failed!
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/db_simple.c -o obj/db_simple.o
+if %errorlevel% neq 0 (
+    echo Compilation of db_simple.c failed!
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/segment_store.c -o obj/segment_store.o
+if %errorlevel% neq 0 (
+    echo Compilation of segment_store.c failed!
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/message_cache.c -o obj/message_cache.o
+if %errorlevel% neq 0 (
+    echo Compilation of message_cache.c failed!
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/json_writer.c -o obj/json_writer.o
+if %errorlevel% neq 0 (
+    echo Compilation of json_writer.c failed!
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/strbuf.c -o obj/strbuf.o
+if %errorlevel% neq 0 (
+    echo Compilation of strbuf.c failed!
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/timer_wheel.c -o obj/timer_wheel.o
+if %errorlevel% neq 0 (
+    echo Compilation of timer_wheel.c failed!
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/platform.c -o obj/platform.o
+if %errorlevel% neq 0 (
+    echo Compilation of platform.c failed!
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/thread_pool.c -o obj/thread_pool.o
+if %errorlevel% neq 0 (
+    echo Compilation of thread_pool.c failed!
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/event_loop.c -o obj/event_loop.o
+if %errorlevel% neq 0 (
+    echo Compilation of event_loop.c failed!
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/semaphore.c -o obj/semaphore.o
 if %errorlevel% neq 0 (
     echo Compilation of semaphore.c failed!
     pause
     exit /b 1
 )
 
-gcc -Wall -Wextra -std=c99 -Iinclude -c src/db.c -o obj/db.o
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/db.c -o obj/db.o
 if %errorlevel% neq 0 (
     echo Compilation of db.c failed!
     pause
     exit /b 1
 )
 
-gcc -Wall -Wextra -std=c99 -Iinclude -c src/logger.c -o obj/logger.o
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/logger.c -o obj/logger.o
 if %errorlevel% neq 0 (
     echo Compilation of logger.c failed!
     pause
     exit /b 1
 )
 
-gcc -Wall -Wextra -std=c99 -Iinclude -c src/handlers.c -o obj/handlers.o
+gcc -Wall -Wextra -std=c11 -Iinclude -c src/handlers.c -o obj/handlers.o
 if %errorlevel% neq 0 (
     echo Compilation of handlers.c failed!
     pause
@@ -53,7 +179,7 @@ if %errorlevel% neq 0 (
 
 REM Link the executable
 echo Linking executable...
-gcc obj/main.o obj/semaphore.o obj/db.o obj/logger.o obj/handlers.o -o bin/chat_daemon.exe -lws2_32 -lsqlite3 -lcjson
+gcc obj/main.o obj/search_index.o obj/arena.o obj/json_reader.o obj/http_parser.o obj/command_socket.o obj/events.o obj/diag.o obj/metrics.o obj/storage.o obj/db_simple.o obj/segment_store.o obj/message_cache.o obj/json_writer.o obj/strbuf.o obj/timer_wheel.o obj/platform.o obj/thread_pool.o obj/event_loop.o obj/semaphore.o obj/db.o obj/logger.o obj/handlers.o -o bin/chat_daemon.exe -lws2_32 -lsqlite3 -lcjson
 if %errorlevel% neq 0 (
     echo Linking failed! Make sure SQLite3 and cJSON libraries are installed.
     echo Try: vcpkg install sqlite3 cjson
@@ -0,0 +1,28 @@
+// Request Arena Header
+// Per-thread bump allocator for memory that only lives as long as one request
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)         // Kept across resets; larger requests chain more
+
+typedef struct arena_block arena_block_t;
+
+// Blocks newest first. All-zero is a valid, empty arena.
+typedef struct {
+    arena_block_t *blocks;
+} arena_t;
+
+// Function declarations
+void *arena_alloc(arena_t *arena, size_t size);
+void *arena_grow(arena_t *arena, void *ptr, size_t old_size, size_t new_size);
+void arena_reset(arena_t *arena);
+void arena_free(arena_t *arena);
+
+arena_t *request_arena(void);
+void request_arena_reset(void);
+void request_arena_release(void);
+
+#endif // ARENA_H
\ No newline at end of file
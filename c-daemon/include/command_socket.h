@@ -0,0 +1,15 @@
+// Command Socket Header
+// Unix domain socket listener speaking the binary command frames of handlers.h
+
+#ifndef COMMAND_SOCKET_H
+#define COMMAND_SOCKET_H
+
+#define COMMAND_SOCKET_DEFAULT_PATH "../data/chat_daemon.sock"
+#define COMMAND_SOCKET_PATH_MAX 104          // sun_path capacity on the smallest platforms
+
+// Function declarations
+int command_socket_open(const char *path);
+const char *command_socket_path(void);
+void command_socket_close(void);
+
+#endif // COMMAND_SOCKET_H
\ No newline at end of file
@@ -1,15 +1,43 @@
 // Database Manager Header
-// Handles SQLite operations for chat and logs databases
+// SQLite storage backend ("sqlite"): chat and logs databases
 
 #ifndef DB_H
 #define DB_H
 
 #include <sqlite3.h>
 
-#define MAX_MESSAGE_LEN 2000
-#define MAX_USERNAME_LEN 64
-#define MAX_TIMESTAMP_LEN 32
-#define MAX_JSON_LEN 8192
+#include "storage.h"
+
+#define DB_LOG_STMT_SLOTS 16                       // Per-connection cache of day partition statements
+#define DB_SEARCH_BACKFILL_BATCH 500               // Ids indexed per write by the search backfill
+
+// A log query prepared against one day's partition of the audit log
+typedef struct {
+    int day;                                       // YYYYMMDD
+    int kind;                                      // Which query, see log_statement()
+    sqlite3_stmt *stmt;
+} db_log_stmt_t;
+
+// Read statements on one pair of connections. The writer has a set for
+// cache warming and for reads when no reader pool is configured; every
+// pooled reader has its own read-only connections and its own set.
+typedef struct db_reader {
+    sqlite3 *chat_db;
+    sqlite3 *logs_db;
+    
+    sqlite3_stmt *stmt_list_messages;
+    sqlite3_stmt *stmt_list_room_messages;
+    sqlite3_stmt *stmt_list_messages_before;       // Keyset paging, see list_messages()
+    sqlite3_stmt *stmt_list_messages_after;
+    sqlite3_stmt *stmt_list_room_messages_before;
+    sqlite3_stmt *stmt_list_room_messages_after;
+    sqlite3_stmt *stmt_search_messages;            // Full-text search, see search_messages()
+    sqlite3_stmt *stmt_count_search_messages;
+    sqlite3_stmt *stmt_list_changes;               // Change feed, see get_changes()
+    db_log_stmt_t log_stmts[DB_LOG_STMT_SLOTS];    // Log pages, see get_logs()
+    
+    struct db_reader *next_free;                   // Pool free list
+} db_reader_t;
 
 // Database connection structure
 typedef struct {
@@ -20,21 +48,15 @@ typedef struct {
     sqlite3_stmt *stmt_create_message;
     sqlite3_stmt *stmt_update_message;
     sqlite3_stmt *stmt_delete_message;
-    sqlite3_stmt *stmt_list_messages;
+    sqlite3_stmt *stmt_insert_tombstone;           // Change feed entry of a delete
+    sqlite3_stmt *stmt_search_backfill;            // Indexes the next batch of older rows
+    sqlite3_stmt *stmt_search_backfill_advance;
     
     // Prepared statements for log operations
-    sqlite3_stmt *stmt_insert_log;
-    sqlite3_stmt *stmt_get_logs;
+    sqlite3_stmt *stmt_insert_log;                 // Into the partition of the current day
+    
+    // Read statements on the writer connections
+    db_reader_t reads;
 } db_context_t;
 
-// Function declarations
-int init_databases(const char *chat_db_path, const char *log_db_path);
-int create_message(const char *username, const char *message, char *out_timestamp);
-int update_message(int id, const char *username, const char *message);
-int delete_message(int id, const char *username);
-int list_messages(int page, int limit, char *out_json);
-int get_logs(int page, int limit, char *out_json);
-int insert_log_entry(const char *action, const char *user, const char *content, int semaphore_value);
-void cleanup_databases(void);
-
 #endif // DB_H
\ No newline at end of file
@@ -0,0 +1,62 @@
+// Diagnostics Header
+// Leveled operator messages, gated at compile time and buffered per thread
+
+#ifndef DIAG_H
+#define DIAG_H
+
+#include <stdbool.h>
+
+#include "platform.h"
+
+#define LOG_LEVEL_ERROR 0              // To stderr, at once
+#define LOG_LEVEL_WARN 1               // To stderr, at once
+#define LOG_LEVEL_INFO 2               // To stdout, buffered: startup, shutdown, rare events
+#define LOG_LEVEL_DEBUG 3              // To stdout, buffered: per request and per connection
+
+// Most verbose level compiled in; statements above it generate no code.
+// Build with -DLOG_COMPILE_LEVEL=LOG_LEVEL_DEBUG to trace every request.
+#ifndef LOG_COMPILE_LEVEL
+    #define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define DIAG_BUFFER_SIZE 4096          // Buffered stdout bytes per thread
+#define DIAG_LINE_MAX 1024             // Longer messages are truncated
+#define DIAG_FLUSH_MS 100              // Longest a buffered line waits for diag_flush()
+#define DIAG_RATE_LIMIT 100            // Lines per second from one call site
+
+// Per call site rate limiter, one static instance per LOG_ statement
+typedef struct {
+    atomic_u32_t window;               // Second the counts below belong to
+    atomic_u32_t emitted;
+    atomic_u32_t suppressed;
+} diag_site_t;
+
+// printf-style, newline included in fmt as with printf. Arguments are not
+// evaluated when the level is compiled out or below the runtime level.
+#define LOG_AT(level, ...)                                                  \
+    do {                                                                    \
+        if ((level) <= LOG_COMPILE_LEVEL && (level) <= diag_level()) {      \
+            static diag_site_t diag_site_;                                  \
+            diag_write(&diag_site_, (level), __VA_ARGS__);                  \
+        }                                                                   \
+    } while (0)
+
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+// Function declarations
+int diag_init(void);
+int diag_parse_level(const char *name);
+void diag_set_level(int level);
+int diag_level(void);
+void diag_write(diag_site_t *site, int level, const char *fmt, ...)
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((format(printf, 3, 4)))
+#endif
+    ;
+void diag_flush(void);
+void diag_cleanup(void);
+
+#endif // DIAG_H
\ No newline at end of file
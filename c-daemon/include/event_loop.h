@@ -0,0 +1,106 @@
+// Event Loop Header
+// Non-blocking, single-threaded connection multiplexer (epoll / kqueue / select)
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <signal.h>
+#include <time.h>
+
+#include "http_parser.h"
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    typedef SOCKET socket_t;
+    #define INVALID_SOCKET_FD INVALID_SOCKET
+#else
+    typedef int socket_t;
+    #define INVALID_SOCKET_FD (-1)
+#endif
+
+#define MAX_CONNECTIONS 1024         // Concurrent client connections per loop
+#define MAX_REQUEST_BUFFER 65536     // Upper bound for buffered, unparsed input
+#define CONN_READ_CHUNK 4096         // Bytes requested per recv() call
+#define CONN_MAX_IOV_PER_SEND 64     // Output pieces handed to one sendmsg()/WSASend()
+#define EVENT_LOOP_MAX_POST_IOV 4    // Pieces one posted response may carry
+#define CONN_MAX_STREAM_BACKLOG (4 << 20)  // Unsent bytes a streaming reader may fall behind by
+#define EVENT_LOOP_MAX_LISTENERS 4   // Listening sockets (HTTP, command socket, ...)
+
+// One malloc'd piece of output; ownership passes to the loop, which frees
+// base once every byte has been sent (or the connection closes)
+typedef struct {
+    char *base;
+    size_t len;
+} conn_iov_t;
+
+// Stable handle for a connection that may be closed while work is in flight
+typedef uint64_t conn_id_t;
+
+// Per-connection state owned by the event loop
+typedef struct connection {
+    socket_t fd;
+    int slot;                        // Index in the connection table
+    int listener;                    // Listening socket it came from, picks its handler
+    conn_id_t id;                    // Slot plus generation, see event_loop_post()
+
+    char *in_buf;                    // Received, not yet consumed bytes (NUL-terminated)
+    size_t in_len;
+    size_t in_cap;
+
+    conn_iov_t *out_iov;             // Pending output pieces, sent in order without copying
+    int out_count;
+    int out_cap;
+    size_t out_offset;               // Bytes of out_iov[0] already sent
+    size_t out_pending;              // Unsent bytes across every piece
+
+    bool write_armed;                // Poller is watching for writability
+    bool close_after_write;          // Close once all output has been flushed
+    bool peer_closed;                // Peer shut down its write side
+    time_t last_active;              // Last read or write, for idle timeouts
+
+    // Protocol handler state
+    http_parser_t http;              // Progress through the request at the front of in_buf
+    bool keep_alive;                 // Current request allows connection reuse
+    unsigned int requests_served;    // Requests answered on this connection
+    bool awaiting_reply;             // A worker is producing the next response
+    bool streaming;                  // Open-ended response: posted output never completes it
+} connection_t;
+
+// Called whenever new bytes have been appended to conn->in_buf
+typedef void (*conn_data_handler_t)(connection_t *conn);
+
+// Called once a posted response has been written (delivered) or dropped
+// because its connection closed first
+typedef void (*post_done_t)(void *arg, bool delivered);
+
+// Periodic work run on the loop thread; returns ms until it is next due, or -1
+typedef int (*loop_timer_handler_t)(void);
+
+// Event loop lifecycle
+int event_loop_init(socket_t listen_fd, conn_data_handler_t on_data);
+int event_loop_add_listener(socket_t listen_fd, conn_data_handler_t on_data, bool idle_timeout);
+void event_loop_run(volatile sig_atomic_t *running);
+void event_loop_cleanup(void);
+void event_loop_set_idle_timeout(int seconds);
+void event_loop_set_timer_handler(loop_timer_handler_t handler);
+const char *event_loop_backend(void);
+bool event_loop_conn_open(conn_id_t id);
+
+// Thread-safe: hand a finished response (malloc'd, ownership transfers)
+// back to the loop thread, which writes it and resumes reading the connection
+int event_loop_post(conn_id_t id, char *data, size_t len, bool close_after_write);
+int event_loop_post_ex(conn_id_t id, char *data, size_t len, bool close_after_write,
+                       post_done_t done, void *done_arg);
+int event_loop_post_iov(conn_id_t id, const conn_iov_t *iov, int count, bool close_after_write,
+                        post_done_t done, void *done_arg);
+
+// Connection helpers for protocol handlers (loop thread only)
+int conn_write(connection_t *conn, const void *data, size_t len);
+int conn_write_iov(connection_t *conn, const conn_iov_t *iov, int count);
+void conn_consume_input(connection_t *conn, size_t len);
+void conn_close_after_write(connection_t *conn);
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,37 @@
+// Events Header
+// Server-Sent Events stream of semaphore and message changes (GET /api/events)
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "event_loop.h"
+
+#define EVENTS_MAX_SUBSCRIBERS 64      // Concurrent event-stream connections
+#define EVENTS_HISTORY 1024            // Recent events kept for Last-Event-ID resume
+#define EVENTS_HEARTBEAT_MS 15000      // Comment frame that keeps idle streams (and proxies) alive
+#define EVENTS_RETRY_MS 2000           // Reconnect delay suggested to clients
+
+// Event names on the wire, indexed by event_type_t
+typedef enum {
+    EVENT_ACQUIRE,                     // {"room","holder","generation"}
+    EVENT_RELEASE,                     // {"room","holder","generation","reason"}
+    EVENT_TOGGLE,                      // {"writer_enabled","admin"}
+    EVENT_MESSAGE_CREATED,             // {"id","room","username","message","created_at"}
+    EVENT_MESSAGE_UPDATED,             // {"id","room","username","message"}
+    EVENT_MESSAGE_DELETED,             // {"id","room","username"}
+    EVENT_TYPE_COUNT
+} event_type_t;
+
+// Function declarations
+void events_init(void);
+bool events_enabled(void);
+void events_publish(event_type_t type, const char *json, size_t len);
+int events_subscribe(conn_id_t id, unsigned long long last_event_id);
+int events_subscriber_count(void);
+void events_heartbeat(void);
+void events_cleanup(void);
+
+#endif // EVENTS_H
\ No newline at end of file
@@ -4,21 +4,99 @@
 #ifndef HANDLERS_H
 #define HANDLERS_H
 
-#include "db.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "storage.h"
+#include "semaphore.h"
+#include "search_index.h"
 
 // Command types enumeration
 typedef enum {
     CMD_TRY_ACQUIRE,
+    CMD_ACQUIRE_WAIT,
     CMD_RELEASE,
+    CMD_HEARTBEAT,
     CMD_CREATE_MESSAGE,
+    CMD_CREATE_BATCH,
     CMD_UPDATE_MESSAGE,
     CMD_DELETE_MESSAGE,
     CMD_LIST_MESSAGES,
     CMD_GET_STATUS,
     CMD_GET_LOGS,
-    CMD_TOGGLE_WRITER
+    CMD_TOGGLE_WRITER,
+    CMD_SEARCH_MESSAGES,
+    CMD_GET_CHANGES
 } command_type_t;
 
+#define CMD_TYPE_COUNT (CMD_GET_CHANGES + 1)
+
+// Binary command frames (command socket). Integers are big-endian.
+//   request:  u32 length | u32 request_id | u8 command_type_t | fields...
+//   field:    u8 tag | u16 length | value (strings unterminated, numbers u32)
+//   response: u32 length | u32 request_id | i32 status | payload
+// length counts the bytes after itself. The payload is the command's JSON
+// data when status is 0 and the error text otherwise. MESSAGE repeats once
+// per entry of a CREATE_BATCH.
+#define COMMAND_FRAME_HEADER 9               // length, request_id, command
+#define COMMAND_REPLY_HEADER 12              // length, request_id, status
+#define COMMAND_FRAME_MAX (32 * 1024)        // Largest request length accepted
+
+typedef enum {
+    FIELD_USER = 1,
+    FIELD_ROOM,
+    FIELD_MESSAGE,
+    FIELD_ID,
+    FIELD_PAGE,
+    FIELD_LIMIT,
+    FIELD_WAIT_MS,
+    FIELD_BEFORE,
+    FIELD_AFTER,
+    FIELD_ENABLED,                           // u8: 0 or 1
+    FIELD_QUERY,
+    FIELD_SINCE                              // u64 (u32 also accepted)
+} command_field_t;
+
+// Command structure for parsed JSON commands
+typedef struct {
+    command_type_t type;
+    char user[MAX_USERNAME_LEN];
+    char room[MAX_ROOM_NAME_LEN];  // Empty selects the default room
+    char message[MAX_MESSAGE_LEN];
+    int id;
+    int page;
+    int limit;
+    char before[MAX_CURSOR_LEN];   // Keyset paging cursors; empty when unused
+    char after[MAX_CURSOR_LEN];
+    char query[SEARCH_MAX_QUERY_LEN + 1];  // SEARCH words
+    long long since;               // CHANGES: last change sequence number seen
+    int wait_ms;
+    bool enabled;
+    char **messages;               // CREATE_BATCH texts (heap copies), see free_command()
+    int message_count;
+} command_t;
+
+// Response structure for command results. Storage pages are not copied
+// into data: page points at the page built in the request arena, valid
+// until the arena is reset once the reply is sent.
+typedef struct {
+    int status;                    // 0 = success, negative = error
+    char error[256];              // Error message if status != 0
+    char data[MAX_JSON_LEN];      // JSON response data
+    const char *page;             // Storage page sent instead of data, or NULL
+    size_t page_len;
+} response_t;
+
+// Function declarations
+int parse_json_command(const char *input, command_t *cmd);
+int parse_binary_command(const unsigned char *fields, size_t len, command_type_t type, command_t *cmd);
+int execute_command(const command_t *cmd, response_t *resp);
+void init_command(command_t *cmd);
+void init_response(response_t *resp);
+const char *response_data(const response_t *resp, size_t *len);
+void describe_acquire(const command_t *cmd, response_t *resp);
+void free_command(command_t *cmd);
+
 // Main command handler function - parses JSON input and generates JSON output
 int handle_command(const char *json_input, char *json_output);
 
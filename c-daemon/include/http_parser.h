@@ -0,0 +1,77 @@
+// HTTP Parser Header
+// Incremental HTTP/1.x request parser working in place on a connection's input
+
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define HTTP_MAX_HEADERS 32                  // Header lines kept per request
+#define HTTP_MAX_HEAD_LENGTH 8192            // Request line plus headers
+
+// A byte range of the input buffer. Offsets rather than pointers, so they
+// stay valid when the buffer is reallocated between reads.
+typedef struct {
+    size_t offset;
+    size_t length;
+} http_span_t;
+
+// What a span points at once the request is complete
+typedef struct {
+    const char *data;
+    size_t length;
+} http_slice_t;
+
+typedef struct {
+    http_span_t name;
+    http_span_t value;                       // Blanks around the value trimmed
+} http_header_t;
+
+typedef enum {
+    HTTP_PARSE_INCOMPLETE = 0,               // Call again when more bytes arrive
+    HTTP_PARSE_COMPLETE = 1,
+    HTTP_PARSE_INVALID = -4,                 // 400
+    HTTP_PARSE_TOO_LARGE = -3,               // 413: head, header count or body over its limit
+    HTTP_PARSE_UNSUPPORTED = -1              // 501: unknown Transfer-Encoding
+} http_parse_status_t;
+
+typedef enum {
+    HTTP_PHASE_HEAD,
+    HTTP_PHASE_BODY,
+    HTTP_PHASE_CHUNK_SIZE,
+    HTTP_PHASE_CHUNK_DATA,
+    HTTP_PHASE_CHUNK_END,
+    HTTP_PHASE_TRAILER,
+    HTTP_PHASE_DONE
+} http_phase_t;
+
+// Parse state of the request at the front of a buffer. Zeroed (or reset)
+// before each request; every byte is examined once however the request is
+// split across reads.
+typedef struct {
+    http_phase_t phase;
+    size_t scanned;                          // Raw bytes examined so far
+    http_span_t method;
+    http_span_t path;                        // Request target without the query
+    http_span_t query;                       // After '?'; has_query tells "" from absent
+    bool has_query;
+    http_span_t version;
+    http_header_t headers[HTTP_MAX_HEADERS];
+    int header_count;
+    size_t head_length;                      // Through the blank line
+    size_t content_length;
+    bool chunked;
+    size_t chunk_left;                       // Unread bytes of the current chunk
+    size_t body_length;                      // Body bytes so far, stored at head_length
+    size_t request_length;                   // Raw bytes to consume once complete
+} http_parser_t;
+
+// Function declarations
+void http_parser_reset(http_parser_t *parser);
+http_parse_status_t http_parser_execute(http_parser_t *parser, char *buf, size_t len, size_t max_request);
+http_slice_t http_parser_slice(const char *buf, http_span_t span);
+bool http_parser_header(const http_parser_t *parser, const char *buf, const char *name, http_slice_t *value);
+bool http_slice_equals(http_slice_t slice, const char *text);
+
+#endif // HTTP_PARSER_H
\ No newline at end of file
@@ -0,0 +1,52 @@
+// JSON Reader Header
+// Single-pass reader for the members of a JSON object, without building a tree
+
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+    JSON_VALUE_STRING,
+    JSON_VALUE_NUMBER,
+    JSON_VALUE_TRUE,
+    JSON_VALUE_FALSE,
+    JSON_VALUE_NULL,
+    JSON_VALUE_ARRAY,
+    JSON_VALUE_OBJECT
+} json_value_type_t;
+
+// A view into the input. Strings exclude their quotes and are still
+// escaped when escaped is set; arrays and objects include their brackets.
+typedef struct {
+    const char *data;
+    size_t len;
+    bool escaped;
+} json_view_t;
+
+typedef struct {
+    json_view_t key;                         // Empty for array elements
+    json_value_type_t type;
+    json_view_t value;
+} json_member_t;
+
+// Cursor over one object or array; nested values are skipped, not decoded
+typedef struct {
+    const char *pos;
+    const char *end;
+    char close;                              // '}' or ']'
+    bool started;                            // A member has been read
+} json_reader_t;
+
+// Function declarations
+int json_reader_init(json_reader_t *reader, const char *json, size_t len);
+int json_reader_init_array(json_reader_t *reader, const json_view_t *array);
+int json_reader_next(json_reader_t *reader, json_member_t *member);
+bool json_view_equals(const json_view_t *view, const char *text);
+bool json_view_equals_nocase(const json_view_t *view, const char *text);
+long long json_view_copy_string(const json_view_t *view, char *out, size_t out_size);
+int json_view_int(const json_view_t *view, int *out);
+int json_view_int64(const json_view_t *view, long long *out);
+
+#endif // JSON_READER_H
\ No newline at end of file
@@ -0,0 +1,45 @@
+// JSON Writer Header
+// Streaming JSON output into a strbuf, with strings escaped in a single pass
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "strbuf.h"
+
+#define JSON_WRITER_MAX_DEPTH 16
+
+// Appends to out as values are written; commas are placed automatically.
+// Misuse (unbalanced nesting, too deep) and allocation failure are both
+// reported once, by json_writer_finish().
+typedef struct {
+    strbuf_t *out;
+    int depth;
+    bool need_comma[JSON_WRITER_MAX_DEPTH];
+    bool after_key;                // A key was written; the next value follows it
+    bool misuse;
+} json_writer_t;
+
+// Function declarations
+void json_writer_init(json_writer_t *w, strbuf_t *out);
+void json_begin_object(json_writer_t *w);
+void json_end_object(json_writer_t *w);
+void json_begin_array(json_writer_t *w);
+void json_end_array(json_writer_t *w);
+void json_key(json_writer_t *w, const char *key);
+void json_string(json_writer_t *w, const char *value);
+void json_int(json_writer_t *w, long long value);
+void json_double(json_writer_t *w, double value);
+void json_bool(json_writer_t *w, bool value);
+void json_raw(json_writer_t *w, const char *json, size_t len);
+void json_field_string(json_writer_t *w, const char *key, const char *value);
+void json_field_int(json_writer_t *w, const char *key, long long value);
+void json_field_double(json_writer_t *w, const char *key, double value);
+void json_field_bool(json_writer_t *w, const char *key, bool value);
+int json_writer_finish(json_writer_t *w);
+int json_escape_append(strbuf_t *out, const char *str, size_t len);
+size_t json_plain_run(const char *str, size_t len);
+
+#endif // JSON_WRITER_H
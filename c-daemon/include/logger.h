@@ -5,12 +5,38 @@
 #define LOGGER_H
 
 #include <stdbool.h>
+#include <time.h>
+
+#define LOGGER_RING_CAPACITY 1024     // Records queued ahead of the writer (power of two)
+#define LOGGER_DEFAULT_FLUSH_MS 50    // Longest a record waits before it is written
+#define LOGGER_DEFAULT_BATCH 256      // Records that trigger an early write
+#define LOGGER_MAX_ACTION_LEN 32
+#define LOGGER_MAX_USER_LEN 64
+#define LOGGER_MAX_CONTENT_LEN 2000   // Matches the transactions.content CHECK
+#define LOGGER_DEFAULT_ROTATE_BYTES (64LL * 1024 * 1024)  // File log size that starts a new file
+#define LOGGER_DEFAULT_KEEP_FILES 7   // Rotated files kept as <path>.1 (newest) .. <path>.N
+#define LOGGER_MAX_KEEP_FILES 100
+
+// One audit record as handed to the storage layer in a batch
+typedef struct {
+    time_t when;
+    const char *action;
+    const char *user;                 // NULL for system actions
+    const char *content;              // May be NULL
+    int semaphore_value;
+} log_entry_t;
 
 // Function declarations
+void logger_configure(int flush_interval_ms, int batch_size);
+void logger_configure_rotation(long long rotate_bytes, int keep_files);
 int init_logger(const char *log_file_path);
-void log_transaction(const char *action, const char *user, 
+void log_transaction(const char *action, const char *user,
                     const char *content, int semaphore_value);
+int log_transaction_durable(const char *action, const char *user,
+                            const char *content, int semaphore_value);
 void log_semaphore_event(const char *action, const char *user, int value);
+void logger_flush(void);
+int logger_queue_depth(void);
 void cleanup_logger(void);
 
-#endif // LOGGER_H
\ No newline at end of file
+#endif // LOGGER_H
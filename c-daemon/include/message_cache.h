@@ -0,0 +1,32 @@
+// Message Cache Header
+// Most recent messages kept in memory as ready-to-send JSON rows
+
+#ifndef MESSAGE_CACHE_H
+#define MESSAGE_CACHE_H
+
+#include <stdbool.h>
+
+#include "strbuf.h"
+
+#define MESSAGE_CACHE_DEFAULT_CAPACITY 1024  // Rows kept; 0 turns the cache off
+#define MESSAGE_CACHE_MAX_CAPACITY 65536
+
+// Function declarations. The storage layer owns the cache: it warms it in
+// init_databases() and reports every committed write; list requests it can
+// answer are served by message_cache_page() without a query. A backend
+// that can name its state (a change sequence) saves the cache on shutdown
+// and loads it back at the next start.
+void message_cache_configure(int capacity);
+int message_cache_capacity(void);
+int message_cache_init(void);
+void message_cache_insert(int id, const char *room, const char *username, const char *message,
+                          const char *created_at);
+void message_cache_update(int id, const char *message);
+void message_cache_remove(int id);
+void message_cache_set_complete(bool complete);
+int message_cache_page(const char *room, int page, int limit, strbuf_t *out);
+int message_cache_save(const char *path, long long version);
+int message_cache_load(const char *path, long long version);
+void message_cache_cleanup(void);
+
+#endif // MESSAGE_CACHE_H
@@ -0,0 +1,44 @@
+// Metrics Header
+// Sharded counters and latency histograms exposed on GET /metrics
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+#include "handlers.h"
+#include "strbuf.h"
+
+#define METRICS_SHARDS 16              // Threads beyond this share shards (power of two)
+#define METRICS_SUB_BUCKETS 4          // Linear steps per power of two: <= 25% error
+#define METRICS_MAX_EXPONENT 40        // Observations of 2^40 ns (~18 minutes) and up share a bucket
+#define METRICS_BUCKETS (METRICS_SUB_BUCKETS * METRICS_MAX_EXPONENT)
+
+// Monotonic event counters
+typedef enum {
+    METRIC_REQUESTS,                   // HTTP requests routed
+    METRIC_BYTES_SENT,                 // Response bytes written to sockets
+    METRIC_ACQUIRE_GRANTED,
+    METRIC_ACQUIRE_CONFLICT,           // -3: another writer holds the room
+    METRIC_ACQUIRE_DENIED,             // -2: writer access disabled
+    METRIC_ACQUIRE_FAILED,             // Any other error
+    METRIC_LEASE_EXPIRED,              // Holders dropped by the lease timer
+    METRIC_COUNTER_COUNT
+} metric_counter_t;
+
+// Latency histograms, all observed in nanoseconds; one per command type
+// follows the fixed ones
+typedef enum {
+    METRIC_SEMAPHORE_HOLD,             // Grant to release or lease expiry
+    METRIC_SEMAPHORE_WAIT,             // Queueing to grant, expiry or cancel
+    METRIC_SQLITE_STEP,                // One sqlite3_step() on a runtime path
+    METRIC_COMMAND_BASE,
+    METRIC_HISTOGRAM_COUNT = METRIC_COMMAND_BASE + CMD_TYPE_COUNT
+} metric_histogram_t;
+
+// Function declarations
+void metrics_count(metric_counter_t counter, uint64_t delta);
+void metrics_observe(metric_histogram_t histogram, uint64_t ns);
+int metrics_render(strbuf_t *out);
+
+#endif // METRICS_H
\ No newline at end of file
@@ -0,0 +1,154 @@
+// Platform Compatibility Header
+// Cross-platform threading primitives shared by the daemon modules
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#ifdef _WIN32
+    #include <windows.h>
+    typedef CRITICAL_SECTION mutex_t;
+    typedef CONDITION_VARIABLE cond_t;
+    typedef HANDLE thread_t;
+    #define mutex_init(m) InitializeCriticalSection(m)
+    #define mutex_destroy(m) DeleteCriticalSection(m)
+    #define mutex_lock(m) EnterCriticalSection(m)
+    #define mutex_unlock(m) LeaveCriticalSection(m)
+    #define mutex_trylock(m) (TryEnterCriticalSection(m) ? 0 : 1)
+    #define cond_init(c) InitializeConditionVariable(c)
+    #define cond_destroy(c) ((void)(c))
+    #define cond_wait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+    #define cond_signal(c) WakeConditionVariable(c)
+    #define cond_broadcast(c) WakeAllConditionVariable(c)
+#else
+    #include <pthread.h>
+    typedef pthread_mutex_t mutex_t;
+    typedef pthread_cond_t cond_t;
+    typedef pthread_t thread_t;
+    #define mutex_init(m) pthread_mutex_init(m, NULL)
+    #define mutex_destroy(m) pthread_mutex_destroy(m)
+    #define mutex_lock(m) pthread_mutex_lock(m)
+    #define mutex_unlock(m) pthread_mutex_unlock(m)
+    #define mutex_trylock(m) pthread_mutex_trylock(m)
+    #define cond_init(c) pthread_cond_init(c, NULL)
+    #define cond_destroy(c) pthread_cond_destroy(c)
+    #define cond_wait(c, m) pthread_cond_wait(c, m)
+    #define cond_signal(c) pthread_cond_signal(c)
+    #define cond_broadcast(c) pthread_cond_broadcast(c)
+#endif
+
+#include <time.h>
+
+// Lock-free primitives for small shared words. C11 <stdatomic.h> on GCC and
+// Clang (including MinGW); Interlocked intrinsics on MSVC.
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    typedef volatile LONG64 atomic_u64_t;
+    typedef volatile LONG atomic_u32_t;
+
+    static __inline uint64_t atomic_u64_load(atomic_u64_t *p) {
+        return (uint64_t)InterlockedCompareExchange64(p, 0, 0);
+    }
+    static __inline void atomic_u64_store(atomic_u64_t *p, uint64_t v) {
+        InterlockedExchange64(p, (LONG64)v);
+    }
+    static __inline uint64_t atomic_u64_exchange(atomic_u64_t *p, uint64_t v) {
+        return (uint64_t)InterlockedExchange64(p, (LONG64)v);
+    }
+    static __inline uint64_t atomic_u64_add(atomic_u64_t *p, uint64_t delta) {
+        return (uint64_t)InterlockedExchangeAdd64(p, (LONG64)delta);
+    }
+    static __inline bool atomic_u64_cas(atomic_u64_t *p, uint64_t *expected, uint64_t desired) {
+        LONG64 seen = InterlockedCompareExchange64(p, (LONG64)desired, (LONG64)*expected);
+        if ((uint64_t)seen == *expected) {
+            return true;
+        }
+        *expected = (uint64_t)seen;
+        return false;
+    }
+    static __inline uint32_t atomic_u32_load(atomic_u32_t *p) {
+        return (uint32_t)InterlockedCompareExchange(p, 0, 0);
+    }
+    static __inline void atomic_u32_store(atomic_u32_t *p, uint32_t v) {
+        InterlockedExchange(p, (LONG)v);
+    }
+    static __inline uint32_t atomic_u32_exchange(atomic_u32_t *p, uint32_t v) {
+        return (uint32_t)InterlockedExchange(p, (LONG)v);
+    }
+    static __inline uint32_t atomic_u32_add(atomic_u32_t *p, uint32_t delta) {
+        return (uint32_t)InterlockedExchangeAdd(p, (LONG)delta);
+    }
+    #define atomic_fence() MemoryBarrier()
+#else
+    #include <stdatomic.h>
+    typedef _Atomic uint64_t atomic_u64_t;
+    typedef _Atomic uint32_t atomic_u32_t;
+
+    // Loads acquire and stores/exchanges release, so data published before a
+    // store is visible to any thread that observes the new value
+    #define atomic_u64_load(p) atomic_load_explicit(p, memory_order_acquire)
+    #define atomic_u64_store(p, v) atomic_store_explicit(p, v, memory_order_release)
+    #define atomic_u64_exchange(p, v) atomic_exchange_explicit(p, v, memory_order_acq_rel)
+    #define atomic_u64_add(p, delta) atomic_fetch_add_explicit(p, delta, memory_order_acq_rel)
+    #define atomic_u64_cas(p, expected, desired) \
+        atomic_compare_exchange_strong_explicit(p, expected, desired, \
+                                                memory_order_acq_rel, memory_order_acquire)
+    #define atomic_u32_load(p) atomic_load_explicit(p, memory_order_acquire)
+    #define atomic_u32_store(p, v) atomic_store_explicit(p, v, memory_order_release)
+    #define atomic_u32_exchange(p, v) atomic_exchange_explicit(p, v, memory_order_acq_rel)
+    #define atomic_u32_add(p, delta) atomic_fetch_add_explicit(p, delta, memory_order_acq_rel)
+    // Full barrier, for store-then-load handshakes between two threads
+    #define atomic_fence() atomic_thread_fence(memory_order_seq_cst)
+#endif
+
+// Per-object cache line alignment, so independently updated hot words (one
+// room's semaphore vs. its neighbour's) never share a line
+#define CACHE_LINE_SIZE 64
+#if defined(_MSC_VER) && !defined(__clang__)
+    #define CACHE_ALIGNED __declspec(align(CACHE_LINE_SIZE))
+#else
+    #define CACHE_ALIGNED _Alignas(CACHE_LINE_SIZE)
+#endif
+
+// One instance of a static variable per thread
+#if defined(_MSC_VER) && !defined(__clang__)
+    #define THREAD_LOCAL __declspec(thread)
+#else
+    #define THREAD_LOCAL _Thread_local
+#endif
+
+// Thread entry point signature (same on every platform)
+typedef void *(*thread_fn_t)(void *arg);
+
+// A file mapped read/write into memory; base and size change on resize.
+// Opened without a path it is plain zeroed heap memory that nothing backs.
+#include <stddef.h>
+typedef struct {
+    char *base;
+    size_t size;
+    bool anonymous;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+} mapped_file_t;
+
+// Function declarations
+int thread_create(thread_t *thread, thread_fn_t fn, void *arg);
+int thread_join(thread_t thread);
+int cond_timedwait_ms(cond_t *cond, mutex_t *mutex, int timeout_ms);
+long long monotonic_ms(void);
+uint64_t monotonic_ns(void);
+int platform_cpu_count(void);
+int platform_gmtime(time_t when, struct tm *out);
+int mapped_file_open(mapped_file_t *mf, const char *path, size_t min_size);
+int mapped_file_resize(mapped_file_t *mf, size_t size);
+int mapped_file_sync(mapped_file_t *mf, size_t offset, size_t length);
+void mapped_file_close(mapped_file_t *mf);
+int platform_replace_file(const char *from, const char *to);
+long long platform_prefetch_file(const char *path, size_t max_bytes);
+
+#endif // PLATFORM_H
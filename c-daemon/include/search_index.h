@@ -0,0 +1,37 @@
+// Search Index Header
+// Word tokenizer and in-memory inverted index over message text
+
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SEARCH_MAX_TERM_LEN 32               // Longer words are indexed by their first bytes
+#define SEARCH_MAX_QUERY_TERMS 8             // Further query words are ignored
+#define SEARCH_MAX_QUERY_LEN 256
+
+// A word of a text: a run of ASCII letters and digits (lowercased) or of
+// non-ASCII bytes, so UTF-8 words stay whole. Return false to stop.
+typedef bool (*search_term_fn)(const char *term, size_t len, void *ctx);
+
+// One ranked match; higher scores are better
+typedef struct {
+    int id;
+    double score;
+} search_hit_t;
+
+// Function declarations
+int search_tokenize(const char *text, size_t len, search_term_fn fn, void *ctx);
+int search_query_terms(const char *query, char terms[][SEARCH_MAX_TERM_LEN + 1]);
+
+int search_index_init(void);
+int search_index_put(int id, const char *room, size_t room_len, const char *text, size_t len, bool replace);
+void search_index_remove(int id);
+int search_index_query(const char *room, const char *query, int offset, int limit,
+                       search_hit_t *hits, int *out_count, int *out_total);
+void search_index_set_complete(bool complete);
+bool search_index_complete(void);
+void search_index_cleanup(void);
+
+#endif // SEARCH_INDEX_H
\ No newline at end of file
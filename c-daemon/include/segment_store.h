@@ -0,0 +1,53 @@
+// Segment Store Header
+// Append-only, memory-mapped message log with an id index and compaction
+
+#ifndef SEGMENT_STORE_H
+#define SEGMENT_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SEGMENT_CREATED_AT_LEN 24          // "YYYY-MM-DDTHH:MM:SS" plus padding
+#define SEGMENT_INITIAL_SIZE (1 << 20)     // First mapping of a new segment file
+#define SEGMENT_INITIAL_IDS 4096           // First mapping of a new index file, in ids
+#define SEGMENT_COMPACT_CHECK_MS 5000      // How often the compactor looks at dead space
+#define SEGMENT_COMPACT_MIN_DEAD (256 * 1024)  // Dead bytes worth a rewrite (if also >= live)
+
+// Scan orders: the listing order (created_at descending, ties by ascending
+// id) and its exact reverse, matching the SQL paging queries
+typedef enum {
+    SEGMENT_SCAN_NEWEST_FIRST,
+    SEGMENT_SCAN_OLDEST_FIRST
+} segment_scan_order_t;
+
+// One live message. Strings point into the mapping and are not
+// NUL-terminated; they are valid only inside the scan callback.
+typedef struct {
+    int id;
+    const char *created_at;                // NUL-terminated
+    const char *room;
+    size_t room_len;
+    const char *username;
+    size_t username_len;
+    const char *message;
+    size_t message_len;
+} segment_row_t;
+
+// Return false to stop the scan. Runs with the store locked: it must not
+// call back into the store.
+typedef bool (*segment_row_fn)(const segment_row_t *row, void *ctx);
+
+// Function declarations
+int segment_store_open(const char *segment_path, const char *index_path, bool sync_writes);
+int segment_store_append(const char *room, const char *username, const char *message,
+                         const char *created_at, int *out_id, char *out_created_at);
+int segment_store_commit(void);
+void segment_store_rollback(void);
+int segment_store_update(int id, const char *room, const char *username, const char *message);
+int segment_store_delete(int id, const char *room, const char *username);
+int segment_store_scan(segment_scan_order_t order, const char *cursor_created_at, int cursor_id,
+                       segment_row_fn fn, void *ctx);
+int segment_store_fetch(const int *ids, int count, segment_row_fn fn, void *ctx);
+void segment_store_close(void);
+
+#endif // SEGMENT_STORE_H
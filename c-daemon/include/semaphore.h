@@ -1,35 +1,74 @@
 // Binary Semaphore Manager Header
-// Cross-platform mutex implementation for write operations
+// Lock-free binary semaphores (C11 atomics) guarding write operations, one per room
 
 #ifndef SEMAPHORE_H
 #define SEMAPHORE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
-#ifdef _WIN32
-    #include <windows.h>
-    typedef CRITICAL_SECTION mutex_t;
-#else
-    #include <pthread.h>
-    typedef pthread_mutex_t mutex_t;
-#endif
+#include "platform.h"
+#include "timer_wheel.h"
 
 #define MAX_USERNAME_LEN 64
+#define MAX_ROOM_NAME_LEN 64
+#define MAX_HOLDER_NAMES 8192                 // Distinct usernames that can ever hold a semaphore
+#define SEMAPHORE_MAX_ROOMS 1024              // Rooms that can ever exist (power of two)
+#define SEMAPHORE_DEFAULT_ROOM "general"      // Used when a request names no room
+#define SEMAPHORE_MAX_WAIT_MS 30000           // Longest a queued acquire may wait
+#define SEMAPHORE_DEFAULT_LEASE_SEC 30        // Holder TTL unless renewed (0 disables leases)
+#define SEMAPHORE_STATE_DEFAULT_PATH "../data/semaphore.state"  // Holders kept across a restart
 
-// Semaphore state structure
+// Holder word layout: generation in the high 32 bits, holder id in the low
+// 32 bits (0 = free). Every acquire and release bumps the generation so a
+// stale compare-and-swap can never succeed (no ABA).
+#define HOLDER_ID(word) ((uint32_t)((word) & 0xFFFFFFFFu))
+#define HOLDER_GENERATION(word) ((uint32_t)((word) >> 32))
+#define HOLDER_WORD(generation, id) (((uint64_t)(generation) << 32) | (uint64_t)(id))
+
+struct waiter;
+
+// One room's semaphore. Slots live in an open-addressed table and are
+// cache-line aligned, so writers in different rooms never contend on a line.
 typedef struct {
-    mutex_t write_mutex;                      // Binary semaphore implementation
-    mutex_t admin_mutex;                      // Protects admin operations
-    char current_holder[MAX_USERNAME_LEN];    // Current semaphore holder
-    bool writer_enabled;                      // Global writer toggle (admin control)
+    CACHE_ALIGNED atomic_u64_t holder;        // Packed generation + holder id
+    atomic_u64_t lease;                       // Holder generation + lease deadline, see semaphore.c
+    atomic_u32_t waiters;                     // Queued acquirers; nonzero stops barging
+    atomic_u32_t published;                   // Set once the slot below is fully initialized
+    char name[MAX_ROOM_NAME_LEN];
+    mutex_t wait_mutex;                       // Protects the FIFO waiter queue
+    struct waiter *wait_head;
+    struct waiter *wait_tail;
+    uint64_t next_ticket;
+    timer_entry_t lease_timer;
+    atomic_u64_t granted_ns;                  // monotonic_ns() of the current grant, for metrics
+    atomic_u32_t granted_generation;          // Holder generation granted_ns belongs to
 } semaphore_state_t;
 
-// Function declarations
+// Outcome of a queued acquire: 0 granted, -3 timed out, -1 shutting down.
+// Runs exactly once, on whichever thread released, expired or cleaned up.
+typedef void (*acquire_callback_t)(void *ctx, int status);
+
+// Function declarations. A NULL or empty room means SEMAPHORE_DEFAULT_ROOM.
 int init_semaphore(void);
-int try_acquire_writer(const char *username);
-int release_writer(const char *username);
-int get_semaphore_status(char *holder, int *value);
+bool semaphore_valid_room(const char *room);
+int try_acquire_writer(const char *room, const char *username);
+int acquire_writer_queued(const char *room, const char *username, int wait_ms,
+                          acquire_callback_t callback, void *ctx);
+int acquire_writer_wait(const char *room, const char *username, int wait_ms);
+int semaphore_expire_waiters(void);
+int semaphore_queue_length(const char *room);
+int release_writer(const char *room, const char *username);
+int semaphore_renew_lease(const char *room, const char *username);
+int semaphore_lease_remaining_ms(const char *room);
+void semaphore_set_lease_ttl(int seconds);
+int get_semaphore_status(const char *room, char *holder, int *value);
+bool semaphore_is_holder(const char *room, const char *username);
+int semaphore_room_count(void);
+int semaphore_rooms_json(char *out_json, size_t size);
 int admin_toggle_writer(bool enabled, const char *admin_user);
+int semaphore_save_state(const char *path);
+int semaphore_load_state(const char *path);
 void cleanup_semaphore(void);
 
-#endif // SEMAPHORE_H
\ No newline at end of file
+#endif // SEMAPHORE_H
@@ -0,0 +1,115 @@
+// Storage Header
+// Message and audit-log storage API, served by a backend chosen at startup
+
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "strbuf.h"
+#include "logger.h"
+
+#define MAX_MESSAGE_LEN 2000
+#define MAX_USERNAME_LEN 64
+#define MAX_TIMESTAMP_LEN 32
+#define MAX_JSON_LEN 8192
+#define MAX_CURSOR_LEN 64            // "<created_at>,<id>" paging cursor
+#define DB_DEFAULT_COMMIT_WINDOW_MS 2  // How long a group commit waits for more writers
+#define DB_MAX_COMMIT_WINDOW_MS 1000
+#define DB_MAX_COMMIT_GROUP 64         // Writers that close a group early
+#define DB_DEFAULT_SYNCHRONOUS "FULL"
+#define DB_MAX_BATCH_MESSAGES 1000     // Messages one create_message_batch() call accepts
+#define DB_DEFAULT_READERS 4           // Read-only connections serving LIST and LOGS
+#define DB_MAX_READERS 64
+#define DB_DEFAULT_LOG_RETENTION_DAYS 0  // Days of audit log kept; 0 keeps every day
+#define DB_MAX_LOG_RETENTION_DAYS 3650
+#define DB_DEFAULT_CACHE_MB 16         // SQLite page cache per connection (PRAGMA cache_size)
+#define DB_MAX_CACHE_MB 4096
+#define DB_DEFAULT_MMAP_MB 256         // Bytes of the database SQLite reads through mmap (PRAGMA mmap_size)
+#define DB_MAX_MMAP_MB 2047            // SQLite's own mmap ceiling on 64-bit builds
+#define SEARCH_MAX_PAGE 1000           // Ranked results are paged by offset; deeper pages are refused
+#define DB_MAX_CHANGES_LIMIT 100       // Changes one get_changes() page returns
+
+// Builds without SQLite (build-minimal.bat) define STORAGE_NO_SQLITE
+#ifdef STORAGE_NO_SQLITE
+    #define STORAGE_DEFAULT_BACKEND "file"
+#else
+    #define STORAGE_DEFAULT_BACKEND "sqlite"
+#endif
+
+// Id and timestamp assigned to one message of a batch
+typedef struct {
+    long long id;
+    char timestamp[MAX_TIMESTAMP_LEN];
+} message_ref_t;
+
+// One storage engine. Each entry has the contract of the function of the
+// same name below; the configure_ entries receive options already
+// validated, and so do search_messages and get_changes. configure_readers,
+// configure_log_retention, configure_cache and get_changes are NULL for
+// backends without a reader pool, log partitions, files to warm or a change
+// sequence.
+typedef struct {
+    const char *name;
+    void (*configure_commit)(int window_ms, const char *synchronous);
+    void (*configure_readers)(int readers);
+    void (*configure_log_retention)(int days);
+    void (*configure_cache)(int cache_mb, int mmap_mb);
+    int (*init)(const char *chat_db_path, const char *log_db_path);
+    int (*create_message)(const char *room, const char *username, const char *message, char *out_timestamp);
+    int (*create_message_batch)(const char *room, const char *username, const char *const *messages,
+                                int count, message_ref_t *out_refs);
+    int (*update_message)(const char *room, int id, const char *username, const char *message);
+    int (*delete_message)(const char *room, int id, const char *username);
+    int (*list_messages)(const char *room, int page, int limit, const char *before, const char *after,
+                         strbuf_t *out);
+    int (*search_messages)(const char *room, const char *query, int page, int limit, strbuf_t *out);
+    int (*get_changes)(const char *room, long long since, int limit, strbuf_t *out);
+    int (*get_logs)(int page, int limit, const char *before, const char *after, strbuf_t *out);
+    int (*insert_log_entry)(const char *action, const char *user, const char *content, int semaphore_value);
+    int (*insert_log_entries)(const log_entry_t *entries, int count);
+    void (*cleanup)(void);
+} storage_backend_t;
+
+#ifndef STORAGE_NO_SQLITE
+extern const storage_backend_t storage_sqlite_backend;   // db.c: chat.db and logs.db
+#endif
+extern const storage_backend_t storage_file_backend;     // db_simple.c: segment log in ../data
+extern const storage_backend_t storage_memory_backend;   // db_simple.c: nothing outlives the process
+
+// Backend selection, before init_databases()
+int storage_select(const char *name);
+const char *storage_backend_name(void);
+
+// Function declarations; each is answered by the selected backend
+int db_configure_commit(int window_ms, const char *synchronous);
+int db_configure_readers(int readers);
+int db_configure_log_retention(int days);
+int db_configure_cache(int cache_mb, int mmap_mb);
+int init_databases(const char *chat_db_path, const char *log_db_path);
+int create_message(const char *room, const char *username, const char *message, char *out_timestamp);
+int create_message_batch(const char *room, const char *username, const char *const *messages,
+                         int count, message_ref_t *out_refs);
+int update_message(const char *room, int id, const char *username, const char *message);
+int delete_message(const char *room, int id, const char *username);
+int list_messages(const char *room, int page, int limit, const char *before, const char *after,
+                  strbuf_t *out);
+int search_messages(const char *room, const char *query, int page, int limit, strbuf_t *out);
+int get_changes(const char *room, long long since, int limit, strbuf_t *out);
+int get_logs(int page, int limit, const char *before, const char *after, strbuf_t *out);
+int insert_log_entry(const char *action, const char *user, const char *content, int semaphore_value);
+int insert_log_entries(const log_entry_t *entries, int count);
+void cleanup_databases(void);
+
+// Shared by the backends
+void get_current_timestamp(char *timestamp, size_t size);
+const char *storage_room_or_default(const char *room);
+int validate_semaphore_ownership(const char *room, const char *username);
+int storage_parse_page_cursor(const char *cursor, char *ts, size_t ts_size, int *id);
+void storage_publish_created(long long id, const char *room, const char *username, const char *message,
+                             const char *created_at);
+void storage_publish_updated(int id, const char *room, const char *username, const char *message);
+void storage_publish_deleted(int id, const char *room, const char *username);
+
+#endif // STORAGE_H
@@ -0,0 +1,38 @@
+// String Buffer Header
+// Growable byte buffer for building responses without fixed-size caps
+
+#ifndef STRBUF_H
+#define STRBUF_H
+
+#include <stddef.h>
+
+#include "arena.h"
+
+#define STRBUF_MIN_CAPACITY 256
+
+// Heap buffer that doubles as it fills; data is NUL-terminated whenever it is
+// non-NULL, so it can be handed to string functions directly
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    int failed;                    // Set once an allocation fails; appends become no-ops
+    arena_t *arena;                // Grows inside this arena instead of the heap, if set
+} strbuf_t;
+
+// Function declarations
+void strbuf_init(strbuf_t *sb);
+void strbuf_init_arena(strbuf_t *sb, arena_t *arena);
+int strbuf_reserve(strbuf_t *sb, size_t extra);
+int strbuf_append(strbuf_t *sb, const void *data, size_t len);
+int strbuf_append_str(strbuf_t *sb, const char *str);
+int strbuf_printf(strbuf_t *sb, const char *fmt, ...)
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+void strbuf_truncate(strbuf_t *sb, size_t len);
+char *strbuf_detach(strbuf_t *sb, size_t *out_len);
+void strbuf_free(strbuf_t *sb);
+
+#endif // STRBUF_H
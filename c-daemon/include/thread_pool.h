@@ -0,0 +1,33 @@
+// Worker Thread Pool Header
+// Fixed-size worker pool with per-worker deques and work stealing
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define THREAD_POOL_MAX_WORKERS 64
+#define THREAD_POOL_DEFAULT_QUEUE_DEPTH 256
+
+// Unit of work executed on a worker thread
+typedef void (*task_fn_t)(void *arg);
+
+// Per-worker counters, for sizing the pool
+typedef struct {
+    int queue_depth;               // Tasks currently waiting in this worker's deque
+    int queue_capacity;            // Maximum tasks the deque can hold
+    unsigned long executed;        // Tasks run by this worker
+    unsigned long stolen;          // Of those, tasks taken from another worker's deque
+} worker_stats_t;
+
+// Function declarations
+int thread_pool_init(int num_workers, int queue_capacity);
+int thread_pool_submit(task_fn_t fn, void *arg);
+int thread_pool_size(void);
+int thread_pool_queue_depth(int worker);
+int thread_pool_get_stats(int worker, worker_stats_t *out);
+int thread_pool_stats_json(char *out_json, size_t size);
+void thread_pool_shutdown(void);
+
+#endif // THREAD_POOL_H
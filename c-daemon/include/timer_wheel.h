@@ -0,0 +1,38 @@
+// Timer Wheel Header
+// Hierarchical timing wheel: O(1) schedule, cancel and per-tick expiry
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TIMER_TICK_MS 10             // Resolution of every timer
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4         // 64^4 ticks: roughly 46 hours of range
+
+typedef void (*timer_callback_t)(void *arg);
+
+// Caller-owned timer, embedded in whatever it times out. Callbacks run on the
+// thread that calls timer_wheel_advance(), after the wheel lock is dropped,
+// so a callback may race with a timer_cancel() issued just before it ran.
+typedef struct timer_entry {
+    struct timer_entry *next;
+    struct timer_entry *prev;
+    uint64_t expires;                // Absolute tick
+    timer_callback_t callback;
+    void *arg;
+    bool pending;
+} timer_entry_t;
+
+// Function declarations
+int timer_wheel_init(void);
+void timer_init(timer_entry_t *timer, timer_callback_t callback, void *arg);
+void timer_schedule(timer_entry_t *timer, long long delay_ms);
+void timer_cancel(timer_entry_t *timer);
+bool timer_pending(timer_entry_t *timer);
+int timer_wheel_advance(void);
+void timer_wheel_cleanup(void);
+
+#endif // TIMER_WHEEL_H
@@ -7,9 +7,10 @@
 #include <time.h>
 
 #include "admin.h"
-#include "db.h"
+#include "storage.h"
 #include "semaphore.h"
 #include "logger.h"
+#include "platform.h"
 
 // Simple admin user validation (in production, this would use proper authentication)
 // For now, we'll use a simple hardcoded list
@@ -37,8 +38,8 @@ bool is_admin_user(const char *username) {
 }
 
 // Admin function to retrieve transaction logs with pagination
-int admin_get_logs(const char *admin_user, int page, int limit, char *out_json) {
-    if (admin_user == NULL || out_json == NULL) {
+int admin_get_logs(const char *admin_user, int page, int limit, strbuf_t *out) {
+    if (admin_user == NULL || out == NULL) {
         fprintf(stderr, "Invalid parameters for admin_get_logs\n");
         return -4;  // Invalid input
     }
@@ -61,7 +62,7 @@ int admin_get_logs(const char *admin_user, int page, int limit, char *out_json)
     }
     
     // Call the database function to get logs
-    int result = get_logs(page, limit, out_json);
+    int result = get_logs(page, limit, NULL, NULL, out);
     if (result != 0) {
         fprintf(stderr, "Failed to retrieve logs from database\n");
         return result;
@@ -70,12 +71,15 @@ int admin_get_logs(const char *admin_user, int page, int limit, char *out_json)
     // Log the admin action
     char current_holder[MAX_USERNAME_LEN];
     int semaphore_value;
-    get_semaphore_status(current_holder, &semaphore_value);
+    get_semaphore_status(NULL, current_holder, &semaphore_value);
     
     char log_content[256];
     snprintf(log_content, sizeof(log_content), 
              "Admin accessed logs (page %d, limit %d)", page, limit);
-    log_transaction("ADMIN_ACTION", admin_user, log_content, semaphore_value);
+    if (log_transaction_durable("ADMIN_ACTION", admin_user, log_content, semaphore_value) != 0) {
+        fprintf(stderr, "Failed to record admin log access\n");
+        return -5;  // Storage error: the access must not go unrecorded
+    }
     
     printf("Admin '%s' retrieved logs (page %d, limit %d)\n", admin_user, page, limit);
     return 0;
@@ -99,21 +103,27 @@ int admin_get_system_status(const char *admin_user, char *out_json) {
         return -2;  // Permission denied
     }
     
-    // Get semaphore status
+    // Get the default room's semaphore status, plus every room's summary
     char current_holder[MAX_USERNAME_LEN];
     int semaphore_value;
-    int status_result = get_semaphore_status(current_holder, &semaphore_value);
+    int status_result = get_semaphore_status(NULL, current_holder, &semaphore_value);
     
     if (status_result != 0) {
         fprintf(stderr, "Failed to get semaphore status\n");
         return -1;  // General error
     }
     
+    char rooms_json[MAX_JSON_LEN / 2];
+    if (semaphore_rooms_json(rooms_json, sizeof(rooms_json)) != 0) {
+        strcpy(rooms_json, "null");  // Too many rooms to list here
+    }
+    
     // Get current timestamp
     time_t now = time(NULL);
-    struct tm *utc_tm = gmtime(&now);
+    struct tm utc_tm;
+    platform_gmtime(now, &utc_tm);
     char timestamp[64];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", utc_tm);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &utc_tm);
     
     // Build JSON response
     snprintf(out_json, MAX_JSON_LEN,
@@ -124,6 +134,7 @@ int admin_get_system_status(const char *admin_user, char *out_json) {
              "\"holder\":\"%s\","
              "\"available\":%s"
              "},"
+             "\"rooms\":%s,"
              "\"system\":{"
              "\"status\":\"running\","
              "\"admin_user\":\"%s\""
@@ -133,17 +144,21 @@ int admin_get_system_status(const char *admin_user, char *out_json) {
              semaphore_value,
              current_holder,
              semaphore_value == 1 ? "true" : "false",
+             rooms_json,
              admin_user);
     
     // Log the admin action
-    log_transaction("ADMIN_ACTION", admin_user, "Retrieved system status", semaphore_value);
+    if (log_transaction_durable("ADMIN_ACTION", admin_user, "Retrieved system status", semaphore_value) != 0) {
+        fprintf(stderr, "Failed to record admin status access\n");
+        return -5;  // Storage error
+    }
     
     printf("Admin '%s' retrieved system status\n", admin_user);
     return 0;
 }
 
-// Admin function to force release semaphore (emergency use)
-int admin_force_release_semaphore(const char *admin_user) {
+// Admin function to force release a room's semaphore (emergency use)
+int admin_force_release_semaphore(const char *room, const char *admin_user) {
     if (admin_user == NULL) {
         fprintf(stderr, "Invalid admin user for force release\n");
         return -4;  // Invalid input
@@ -163,7 +178,7 @@ int admin_force_release_semaphore(const char *admin_user) {
     // Get current semaphore status
     char current_holder[MAX_USERNAME_LEN];
     int semaphore_value;
-    int status_result = get_semaphore_status(current_holder, &semaphore_value);
+    int status_result = get_semaphore_status(room, current_holder, &semaphore_value);
     
     if (status_result != 0) {
         fprintf(stderr, "Failed to get semaphore status\n");
@@ -176,18 +191,22 @@ int admin_force_release_semaphore(const char *admin_user) {
         return 0;  // Success (no-op)
     }
     
-    printf("Admin '%s' forcing release of semaphore held by '%s'\n", 
-           admin_user, current_holder);
+    printf("Admin '%s' forcing release of room '%s' semaphore held by '%s'\n", 
+           admin_user, room && room[0] ? room : SEMAPHORE_DEFAULT_ROOM, current_holder);
     
     // Log the forced release action
     char log_content[256];
     snprintf(log_content, sizeof(log_content), 
-             "Admin forced release of semaphore from user '%s'", current_holder);
-    log_transaction("ADMIN_ACTION", admin_user, log_content, 0);
+             "Admin forced release of room '%s' semaphore from user '%s'",
+             room && room[0] ? room : SEMAPHORE_DEFAULT_ROOM, current_holder);
+    if (log_transaction_durable("ADMIN_ACTION", admin_user, log_content, 0) != 0) {
+        fprintf(stderr, "Failed to record forced release; semaphore left held\n");
+        return -5;  // Storage error: don't release without an audit record
+    }
     
     // Force release by calling the release function with the current holder's name
     // This is a bit of a hack, but it ensures proper cleanup
-    int release_result = release_writer(current_holder);
+    int release_result = release_writer(room, current_holder);
     
     if (release_result != 0) {
         fprintf(stderr, "Failed to force release semaphore\n");
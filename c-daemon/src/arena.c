@@ -0,0 +1,130 @@
+// Request Arena Implementation
+// Per-thread bump allocator for memory that only lives as long as one request
+//
+// A request's scratch memory (command and response structures, batch id
+// lists, pages built before they are copied into a reply) is carved off a
+// block by bumping an offset, and all of it is let go at once when the
+// request ends, so there is no per-object free and no trip through the
+// shared malloc heap. Each thread has its own arena: the worker pool
+// resets it after every task and the event loop after every request it
+// answers inline. The first block is kept for the next request; blocks a
+// large request chained on are returned to the heap.
+//
+// Anything handed to another thread or to the event loop (queued jobs,
+// response buffers) must stay on the heap.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "arena.h"
+#include "platform.h"
+
+#define ARENA_ALIGN (sizeof(max_align_t))
+
+struct arena_block {
+    arena_block_t *next;                     // Older block
+    size_t size;                             // Usable bytes in data
+    size_t used;
+    max_align_t data[];
+};
+
+static THREAD_LOCAL arena_t t_arena;
+
+static size_t align_up(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+// Memory for size bytes, suitably aligned for any type and not zeroed;
+// NULL if the heap is exhausted. Valid until the next reset.
+void *arena_alloc(arena_t *arena, size_t size) {
+    size_t needed = align_up(size > 0 ? size : 1);
+    if (needed < size) {
+        return NULL;                         // Overflowed
+    }
+
+    arena_block_t *block = arena->blocks;
+    if (block == NULL || block->size - block->used < needed) {
+        size_t block_size = needed > ARENA_BLOCK_SIZE ? needed : ARENA_BLOCK_SIZE;
+        if (block_size > SIZE_MAX - sizeof(arena_block_t)) {
+            return NULL;
+        }
+        block = malloc(sizeof(arena_block_t) + block_size);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->next = arena->blocks;
+        block->size = block_size;
+        block->used = 0;
+        arena->blocks = block;
+    }
+
+    void *ptr = (char *)block->data + block->used;
+    block->used += needed;
+    return ptr;
+}
+
+// Resize an allocation, in place when it is the newest one and its block
+// has room, otherwise by copying; ptr may be NULL. The old memory is not
+// reclaimed until the next reset.
+void *arena_grow(arena_t *arena, void *ptr, size_t old_size, size_t new_size) {
+    arena_block_t *block = arena->blocks;
+    if (ptr != NULL && block != NULL && (char *)ptr >= (char *)block->data &&
+        (char *)ptr < (char *)block->data + block->used) {
+        size_t offset = (size_t)((char *)ptr - (char *)block->data);
+        size_t needed = align_up(new_size > 0 ? new_size : 1);
+        if (offset + align_up(old_size > 0 ? old_size : 1) == block->used &&
+            needed >= new_size && offset + needed <= block->size) {
+            block->used = offset + needed;
+            return ptr;
+        }
+    }
+
+    void *grown = arena_alloc(arena, new_size);
+    if (grown != NULL && ptr != NULL) {
+        memcpy(grown, ptr, old_size < new_size ? old_size : new_size);
+    }
+    return grown;
+}
+
+// Release everything allocated so far, keeping one standard block
+void arena_reset(arena_t *arena) {
+    arena_block_t *keep = NULL;
+    arena_block_t *block = arena->blocks;
+    while (block != NULL) {
+        arena_block_t *next = block->next;
+        if (keep == NULL && block->size == ARENA_BLOCK_SIZE) {
+            keep = block;
+        } else {
+            free(block);
+        }
+        block = next;
+    }
+    if (keep != NULL) {
+        keep->next = NULL;
+        keep->used = 0;
+    }
+    arena->blocks = keep;
+}
+
+void arena_free(arena_t *arena) {
+    arena_reset(arena);
+    free(arena->blocks);
+    arena->blocks = NULL;
+}
+
+// The calling thread's request arena
+arena_t *request_arena(void) {
+    return &t_arena;
+}
+
+// End of a request: everything allocated for it is dropped
+void request_arena_reset(void) {
+    arena_reset(&t_arena);
+}
+
+// Give the thread's memory back before the thread exits
+void request_arena_release(void) {
+    arena_free(&t_arena);
+}
\ No newline at end of file
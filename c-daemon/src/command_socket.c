@@ -0,0 +1,307 @@
+// Command Socket Implementation
+// Unix domain socket listener speaking the binary command frames of handlers.h
+//
+// The bridge keeps one connection open and multiplexes commands over it:
+// every frame carries a request id that its reply echoes, so replies may
+// come back in any order. Semaphore commands are answered on the loop
+// thread and storage commands on the worker pool, as their HTTP routes
+// are; ACQUIRE_WAIT parks in the room's FIFO queue without holding a
+// thread. Windows 10 and later have AF_UNIX as well, so one implementation
+// serves every platform.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "command_socket.h"
+#include "handlers.h"
+#include "event_loop.h"
+#include "thread_pool.h"
+#include "arena.h"
+#include "metrics.h"
+#include "platform.h"
+#include "diag.h"
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <afunix.h>
+    #define close_socket closesocket
+#else
+    #include <unistd.h>
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/un.h>
+    #define close_socket close
+#endif
+
+static socket_t g_socket_fd = INVALID_SOCKET_FD;
+static char g_socket_path[COMMAND_SOCKET_PATH_MAX] = "";
+
+// A decoded command on its way to a worker or a semaphore queue
+typedef struct {
+    conn_id_t conn_id;
+    uint32_t request_id;
+    command_t cmd;
+} command_job_t;
+
+static uint32_t read_u32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static void write_u32(unsigned char *p, uint32_t value) {
+    p[0] = (unsigned char)(value >> 24);
+    p[1] = (unsigned char)(value >> 16);
+    p[2] = (unsigned char)(value >> 8);
+    p[3] = (unsigned char)value;
+}
+
+// Encode a reply frame; malloc'd, so it can be handed to the event loop.
+// Storage pages are written straight from the request arena, any size.
+static char *encode_reply(uint32_t request_id, const response_t *resp, size_t *out_len) {
+    size_t payload_len = 0;
+    const char *payload;
+    if (resp->status == 0) {
+        payload = response_data(resp, &payload_len);
+    } else {
+        payload = resp->error[0] != '\0' ? resp->error : "Unknown error";
+        payload_len = strlen(payload);
+    }
+    if (payload_len > UINT32_MAX - COMMAND_REPLY_HEADER) {
+        return NULL;
+    }
+    size_t len = COMMAND_REPLY_HEADER + payload_len;
+
+    unsigned char *frame = malloc(len);
+    if (frame == NULL) {
+        return NULL;
+    }
+    write_u32(frame, (uint32_t)(len - 4));
+    write_u32(frame + 4, request_id);
+    write_u32(frame + 8, (uint32_t)resp->status);
+    memcpy(frame + COMMAND_REPLY_HEADER, payload, payload_len);
+    *out_len = len;
+    return (char *)frame;
+}
+
+// Answer on the loop thread
+static void reply_inline(connection_t *conn, uint32_t request_id, const response_t *resp) {
+    conn_iov_t piece;
+    piece.base = encode_reply(request_id, resp, &piece.len);
+    if (piece.base != NULL) {
+        conn_write_iov(conn, &piece, 1);
+    }
+}
+
+// Answer from any thread; done (optional) learns whether it was delivered
+static void post_reply(conn_id_t conn_id, uint32_t request_id, const response_t *resp,
+                       post_done_t done, void *done_arg) {
+    size_t len = 0;
+    char *frame = encode_reply(request_id, resp, &len);
+    if (frame == NULL) {
+        if (done != NULL) {
+            done(done_arg, false);
+        }
+        return;
+    }
+    event_loop_post_ex(conn_id, frame, len, false, done, done_arg);
+}
+
+static void free_job(command_job_t *job) {
+    free_command(&job->cmd);
+    free(job);
+}
+
+// Run a command and time it like handle_command()
+static void run_command(const command_t *cmd, response_t *resp) {
+    uint64_t started = monotonic_ns();
+    execute_command(cmd, resp);
+    metrics_observe((metric_histogram_t)(METRIC_COMMAND_BASE + cmd->type), monotonic_ns() - started);
+}
+
+// Worker thread entry for storage commands
+static void command_worker_task(void *arg) {
+    command_job_t *job = (command_job_t *)arg;
+    response_t resp;
+
+    run_command(&job->cmd, &resp);
+    post_reply(job->conn_id, job->request_id, &resp, NULL, NULL);
+    free_job(job);
+}
+
+// A granted acquire whose client left before hearing about it must not
+// keep the semaphore
+static void finish_queued_grant(void *arg, bool delivered) {
+    command_job_t *job = (command_job_t *)arg;
+    if (!delivered) {
+        LOG_INFO("Command client of '%s' left before its queued acquire completed, releasing\n",
+                 job->cmd.user);
+        release_writer(job->cmd.room, job->cmd.user);
+    }
+    free_job(job);
+}
+
+// Outcome of a parked ACQUIRE_WAIT (may run on any thread)
+static void on_queued_acquire(void *ctx, int status) {
+    command_job_t *job = (command_job_t *)ctx;
+    response_t resp;
+
+    init_response(&resp);
+    resp.status = status;
+    describe_acquire(&job->cmd, &resp);
+    if (status == 0) {
+        post_reply(job->conn_id, job->request_id, &resp, finish_queued_grant, job);
+        return;
+    }
+    post_reply(job->conn_id, job->request_id, &resp, NULL, NULL);
+    free_job(job);
+}
+
+// Commands that touch storage run on the worker pool
+static bool runs_on_worker(command_type_t type) {
+    switch (type) {
+        case CMD_CREATE_MESSAGE:
+        case CMD_CREATE_BATCH:
+        case CMD_UPDATE_MESSAGE:
+        case CMD_DELETE_MESSAGE:
+        case CMD_LIST_MESSAGES:
+        case CMD_SEARCH_MESSAGES:
+        case CMD_GET_CHANGES:
+        case CMD_GET_LOGS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Decode and start one frame; frame points just past its length field
+static void handle_frame(connection_t *conn, const unsigned char *frame, size_t len) {
+    uint32_t request_id = read_u32(frame);
+    response_t resp;
+    init_response(&resp);
+
+    command_job_t *job = malloc(sizeof(command_job_t));
+    if (job == NULL) {
+        resp.status = -1;
+        strcpy(resp.error, "Out of memory");
+        reply_inline(conn, request_id, &resp);
+        return;
+    }
+    job->conn_id = conn->id;
+    job->request_id = request_id;
+
+    int parsed = parse_binary_command(frame + COMMAND_FRAME_HEADER - 4, len - (COMMAND_FRAME_HEADER - 4),
+                                      (command_type_t)frame[4], &job->cmd);
+    if (parsed != 0) {
+        free(job);
+        resp.status = parsed;
+        strcpy(resp.error, "Invalid command frame");
+        reply_inline(conn, request_id, &resp);
+        return;
+    }
+
+    // Park in the room's queue; the callback answers and owns the job
+    if (job->cmd.type == CMD_ACQUIRE_WAIT && job->cmd.user[0] != '\0') {
+        uint64_t started = monotonic_ns();
+        int result = acquire_writer_queued(job->cmd.room, job->cmd.user, job->cmd.wait_ms,
+                                           on_queued_acquire, job);
+        metrics_observe((metric_histogram_t)(METRIC_COMMAND_BASE + CMD_ACQUIRE_WAIT),
+                        monotonic_ns() - started);
+        if (result == 1) {
+            return;
+        }
+        resp.status = result;
+        describe_acquire(&job->cmd, &resp);
+        reply_inline(conn, request_id, &resp);
+        free_job(job);
+        return;
+    }
+
+    if (thread_pool_size() > 0 && runs_on_worker(job->cmd.type) &&
+        thread_pool_submit(command_worker_task, job) == 0) {
+        return;
+    }
+
+    run_command(&job->cmd, &resp);
+    reply_inline(conn, request_id, &resp);
+    free_job(job);
+}
+
+// Event loop data handler: start every complete frame in the input
+static void handle_command_frames(connection_t *conn) {
+    while (conn->in_len >= 4 && !conn->close_after_write) {
+        const unsigned char *buffer = (const unsigned char *)conn->in_buf;
+        uint32_t length = read_u32(buffer);
+        if (length < COMMAND_FRAME_HEADER - 4 || length > COMMAND_FRAME_MAX) {
+            // Framing is lost; nothing after this can be trusted
+            LOG_WARN("Malformed command frame (length %u), closing connection\n", (unsigned)length);
+            conn_close_after_write(conn);
+            return;
+        }
+        if (conn->in_len - 4 < length) {
+            return;  // Wait for the rest of the frame
+        }
+
+        handle_frame(conn, buffer + 4, length);
+        conn_consume_input(conn, 4 + (size_t)length);
+        request_arena_reset();  // Scratch of a command answered inline
+    }
+}
+
+// Listen for bridge connections on path. Call after event_loop_init(); the
+// HTTP port is bound first, so a second daemon fails before it gets here
+// and removing a stale socket file cannot steal a live one.
+int command_socket_open(const char *path) {
+    if (path == NULL || path[0] == '\0' || strlen(path) >= COMMAND_SOCKET_PATH_MAX) {
+        LOG_ERROR("Invalid command socket path\n");
+        return -4;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    socket_t fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == INVALID_SOCKET_FD) {
+        LOG_ERROR("Command socket creation failed\n");
+        return -1;
+    }
+
+    remove(path);  // Left behind by a daemon that did not shut down cleanly
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        LOG_ERROR("Failed to bind command socket %s\n", path);
+        close_socket(fd);
+        return -1;
+    }
+#ifndef _WIN32
+    chmod(path, S_IRUSR | S_IWUSR);  // Only the daemon's user may send commands
+#endif
+
+    // The bridge holds its connection for the daemon's lifetime
+    if (event_loop_add_listener(fd, handle_command_frames, false) != 0) {
+        close_socket(fd);
+        remove(path);
+        return -1;
+    }
+
+    g_socket_fd = fd;
+    strcpy(g_socket_path, path);
+    LOG_INFO("Command socket listening on %s\n", path);
+    return 0;
+}
+
+const char *command_socket_path(void) {
+    return g_socket_path;
+}
+
+// Close the listener and remove its file; call after event_loop_cleanup()
+void command_socket_close(void) {
+    if (g_socket_fd == INVALID_SOCKET_FD) {
+        return;
+    }
+    close_socket(g_socket_fd);
+    remove(g_socket_path);
+    g_socket_fd = INVALID_SOCKET_FD;
+    g_socket_path[0] = '\0';
+}
\ No newline at end of file
@@ -8,55 +8,161 @@
 #include <sqlite3.h>
 
 #include "db.h"
+#include "json_writer.h"
+#include "message_cache.h"
+#include "arena.h"
+#include "search_index.h"
 #include "semaphore.h"
 #include "logger.h"
+#include "platform.h"
+#include "metrics.h"
+#include "diag.h"
 
-// Helper function to validate semaphore ownership for write operations
-int validate_semaphore_ownership(const char *username) {
-    char current_holder[MAX_USERNAME_LEN];
-    int semaphore_value;
-    
-    int status = get_semaphore_status(current_holder, &semaphore_value);
-    if (status != 0) {
-        fprintf(stderr, "Failed to get semaphore status\n");
-        return -1;  // General error
-    }
-    
-    // Check if semaphore is available (value = 1 means no one holds it)
-    if (semaphore_value == 1) {
-        fprintf(stderr, "No writer currently holds the semaphore\n");
-        return -2;  // Permission denied
-    }
-    
-    // Check if the requesting user is the current holder
-    if (strcmp(current_holder, username) != 0) {
-        fprintf(stderr, "User '%s' does not hold the semaphore (held by '%s')\n", 
-                username, current_holder);
-        return -2;  // Permission denied
-    }
-    
-    return 0;  // Ownership validated
+// sqlite3_step() on the request paths, timed for /metrics
+static int timed_step(sqlite3_stmt *stmt) {
+    uint64_t start = monotonic_ns();
+    int result = sqlite3_step(stmt);
+    metrics_observe(METRIC_SQLITE_STEP, monotonic_ns() - start);
+    return result;
 }
 
 // Global database context
 static db_context_t g_db_ctx;
 static bool g_db_initialized = false;
 
-// Generate ISO 8601 timestamp
-void get_current_timestamp(char *timestamp, size_t size) {
-    time_t now = time(NULL);
-    struct tm *utc_tm = gmtime(&now);
-    strftime(timestamp, size, "%Y-%m-%dT%H:%M:%S", utc_tm);
+// Prepared statements are shared, so each connection is used by one
+// worker thread at a time
+static mutex_t g_chat_lock;                // chat_db and its statements
+static mutex_t g_logs_lock;                // logs_db and its statements
+
+// Group commit. The first writer to finish a statement becomes the group
+// leader: it holds the BEGIN IMMEDIATE transaction open for the commit
+// window (with g_chat_lock released) so closely spaced writers can add
+// their rows, then issues one COMMIT for all of them. Every writer returns
+// only after the COMMIT covering its row, so callers keep the usual
+// "returned 0 means stored" guarantee at one fsync per group.
+typedef struct commit_waiter {
+    struct commit_waiter *next;
+    int result;
+    bool done;
+} commit_waiter_t;
+
+static int g_commit_window_ms = DB_DEFAULT_COMMIT_WINDOW_MS;
+static char g_synchronous[8] = DB_DEFAULT_SYNCHRONOUS;
+static bool g_chat_txn_open = false;       // BEGIN IMMEDIATE issued, COMMIT pending
+static bool g_group_has_leader = false;
+static atomic_u32_t g_writers_inbound;     // Writers between entry and joining a group
+static int g_group_size = 0;
+static commit_waiter_t *g_group_waiters = NULL;
+static cond_t g_group_leader_cond;         // Wakes the leader early when a group fills
+static cond_t g_group_done_cond;           // Broadcast after every COMMIT
+static unsigned long g_groups_committed = 0;
+static unsigned long g_writes_committed = 0;
+
+// Read-only connection pool. In WAL mode readers neither block the writer
+// nor each other, so LIST and LOGS queries run in parallel on their own
+// connections (seeing only committed rows) while the writer connections
+// take the writes. A request checks out a whole reader and returns it when
+// its page is built. With no pool, reads share the writer connections
+// under g_chat_lock / g_logs_lock as before.
+static int g_reader_count = DB_DEFAULT_READERS;
+static db_reader_t *g_readers = NULL;
+static db_reader_t *g_free_readers = NULL;
+static mutex_t g_reader_lock;
+static cond_t g_reader_cond;               // Signalled when a reader is returned
+
+// Day-partitioned audit log. Records live in one table per UTC day,
+// transactions_YYYYMMDD, so retention drops whole tables instead of
+// deleting rows, and a cursor page only opens the days it can reach. Ids
+// are assigned here rather than by each table, so they stay unique across
+// days and "<ts>,<id>" cursors work as before.
+#define DB_LOG_PRUNE_CHECK_MS (10 * 60 * 1000)   // How often retention is enforced
+
+typedef enum {
+    LOG_QUERY_PAGE,                        // Newest first, LIMIT/OFFSET
+    LOG_QUERY_BEFORE,                      // Keyset, continuing newest first
+    LOG_QUERY_AFTER,                       // Keyset, oldest first
+    LOG_QUERY_COUNT
+} log_query_t;
+
+static int *g_log_days = NULL;             // Ascending YYYYMMDD of every partition
+static int g_log_day_count = 0;
+static int g_log_day_capacity = 0;
+static mutex_t g_log_days_lock;            // g_log_days, read by every reader
+static long long g_next_log_id = 1;        // Under g_logs_lock
+static int g_insert_day = 0;               // Partition stmt_insert_log writes to
+static int g_log_retention_days = DB_DEFAULT_LOG_RETENTION_DAYS;
+static bool g_log_pruner_running = false;
+static thread_t g_log_pruner;
+static mutex_t g_log_pruner_lock;
+static cond_t g_log_pruner_cond;           // Wakes the pruner to stop
+static unsigned long g_log_days_dropped = 0;
+
+// Change sequence. Every create, update and delete takes the next number
+// (under g_chat_lock, so numbers are committed in order) and stores it with
+// the row, or with the tombstone a delete leaves in message_tombstones.
+// Numbers of a write group that fails to commit are simply never seen.
+static long long g_change_seq = 0;
+
+// Full-text search. messages_fts is an FTS5 index over messages.message
+// that triggers keep in step with every write. Rows stored before it
+// existed, ids next_id..end_id of search_backfill, are indexed a batch at a
+// time in the background; until a row is reached its update and delete
+// triggers stay quiet, since FTS5 must never be told to remove text it was
+// not given.
+static bool g_search_available = false;    // SQLite was built with FTS5
+static atomic_u32_t g_search_complete;     // The backfill has reached end_id
+static atomic_u32_t g_search_backfill_stop;
+static bool g_search_backfill_running = false;
+static thread_t g_search_backfill;
+
+// Page cache and mmap of every connection, and the warm start. On a clean
+// shutdown the message cache is saved beside chat.db tagged with the change
+// sequence; a start that finds the sequence unchanged loads it instead of
+// querying. The first pages of chat.db are read into the OS cache before
+// the first request, so it is not served by random reads from a cold disk.
+static int g_cache_mb = DB_DEFAULT_CACHE_MB;
+static int g_mmap_mb = DB_DEFAULT_MMAP_MB;
+static char g_cache_snapshot_path[512];
+
+static void sqlite_cleanup(void);
+
+// Format an ISO 8601 timestamp the way every stored row carries it
+static void format_timestamp(time_t when, char *timestamp, size_t size) {
+    struct tm utc_tm;
+    platform_gmtime(when, &utc_tm);
+    strftime(timestamp, size, "%Y-%m-%dT%H:%M:%S", &utc_tm);
+}
+
+// Whether an existing table already has a column (for schema migrations)
+static bool table_has_column(sqlite3 *db, const char *table, const char *column) {
+    char sql[128];
+    snprintf(sql, sizeof(sql), "PRAGMA table_info(%s);", table);
+    
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        return false;
+    }
+    
+    bool found = false;
+    while (!found && sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *name = (const char *)sqlite3_column_text(stmt, 1);
+        found = name != NULL && strcmp(name, column) == 0;
+    }
+    sqlite3_finalize(stmt);
+    return found;
 }
 
 // Create chat database schema
-int create_chat_schema(sqlite3 *db) {
+static int create_chat_schema(sqlite3 *db) {
     const char *create_messages_table = 
         "CREATE TABLE IF NOT EXISTS messages ("
         "id INTEGER PRIMARY KEY AUTOINCREMENT,"
         "username TEXT NOT NULL CHECK(length(username) > 0 AND length(username) <= 64),"
         "message TEXT NOT NULL CHECK(length(message) > 0 AND length(message) <= 2000),"
-        "created_at TEXT NOT NULL"
+        "created_at TEXT NOT NULL,"
+        "room TEXT NOT NULL DEFAULT '" SEMAPHORE_DEFAULT_ROOM "',"
+        "change_seq INTEGER NOT NULL DEFAULT 0"
         ");";
     
     const char *create_messages_index1 = 
@@ -65,145 +171,995 @@ int create_chat_schema(sqlite3 *db) {
     const char *create_messages_index2 = 
         "CREATE INDEX IF NOT EXISTS idx_messages_username ON messages(username);";
     
+    const char *create_messages_index3 = 
+        "CREATE INDEX IF NOT EXISTS idx_messages_room ON messages(room, created_at DESC);";
+    
+    const char *create_messages_index4 = 
+        "CREATE INDEX IF NOT EXISTS idx_messages_change_seq ON messages(change_seq);";
+    
+    const char *create_tombstones_table = 
+        "CREATE TABLE IF NOT EXISTS message_tombstones ("
+        "change_seq INTEGER PRIMARY KEY,"
+        "id INTEGER NOT NULL,"
+        "room TEXT NOT NULL,"
+        "deleted_at TEXT NOT NULL"
+        ");";
+    
     if (sqlite3_exec(db, create_messages_table, NULL, NULL, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to create messages table: %s\n", sqlite3_errmsg(db));
+        LOG_ERROR("Failed to create messages table: %s\n", sqlite3_errmsg(db));
         return -1;
     }
     
+    // Databases from before rooms existed: every old message joins the default room
+    if (!table_has_column(db, "messages", "room")) {
+        if (sqlite3_exec(db, "ALTER TABLE messages ADD COLUMN room TEXT NOT NULL "
+                             "DEFAULT '" SEMAPHORE_DEFAULT_ROOM "';",
+                         NULL, NULL, NULL) != SQLITE_OK) {
+            LOG_ERROR("Failed to add room column to messages: %s\n", sqlite3_errmsg(db));
+            return -1;
+        }
+        LOG_INFO("Migrated messages table: existing messages moved to room '%s'\n",
+                 SEMAPHORE_DEFAULT_ROOM);
+    }
+    
+    // Databases from before the change feed: existing messages are numbered
+    // by id, which already orders them, and new writes continue from there
+    if (!table_has_column(db, "messages", "change_seq")) {
+        if (sqlite3_exec(db, "BEGIN;"
+                             "ALTER TABLE messages ADD COLUMN change_seq INTEGER NOT NULL DEFAULT 0;"
+                             "UPDATE messages SET change_seq = id;"
+                             "COMMIT;",
+                         NULL, NULL, NULL) != SQLITE_OK) {
+            LOG_ERROR("Failed to add change_seq column to messages: %s\n", sqlite3_errmsg(db));
+            sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+            return -1;
+        }
+        LOG_INFO("Migrated messages table: existing messages numbered for the change feed\n");
+    }
+    
     if (sqlite3_exec(db, create_messages_index1, NULL, NULL, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to create messages index 1: %s\n", sqlite3_errmsg(db));
+        LOG_ERROR("Failed to create messages index 1: %s\n", sqlite3_errmsg(db));
         return -1;
     }
     
     if (sqlite3_exec(db, create_messages_index2, NULL, NULL, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to create messages index 2: %s\n", sqlite3_errmsg(db));
+        LOG_ERROR("Failed to create messages index 2: %s\n", sqlite3_errmsg(db));
         return -1;
     }
     
-    return 0;
-}
-
-// Create logs database schema
-int create_logs_schema(sqlite3 *db) {
-    const char *create_transactions_table = 
-        "CREATE TABLE IF NOT EXISTS transactions ("
-        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "ts TEXT NOT NULL,"
-        "action TEXT NOT NULL CHECK(action IN ("
-        "'CREATE', 'UPDATE', 'DELETE', 'READ',"
-        "'ACQUIRE_MUTEX', 'RELEASE_MUTEX', 'ADMIN_ACTION'"
-        ")),"
-        "user TEXT,"
-        "content TEXT CHECK(content IS NULL OR length(content) <= 2000),"
-        "semaphore_value INTEGER NOT NULL CHECK(semaphore_value IN (0, 1))"
-        ");";
+    if (sqlite3_exec(db, create_messages_index3, NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_ERROR("Failed to create messages index 3: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
     
-    const char *create_transactions_index1 = 
-        "CREATE INDEX IF NOT EXISTS idx_transactions_ts ON transactions(ts DESC);";
+    if (sqlite3_exec(db, create_messages_index4, NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_ERROR("Failed to create messages index 4: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
     
-    const char *create_transactions_index2 = 
-        "CREATE INDEX IF NOT EXISTS idx_transactions_action ON transactions(action);";
+    if (sqlite3_exec(db, create_tombstones_table, NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_ERROR("Failed to create message_tombstones table: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
     
-    const char *create_transactions_index3 = 
-        "CREATE INDEX IF NOT EXISTS idx_transactions_user ON transactions(user);";
+    return 0;
+}
+
+// Highest change sequence number stored, where g_change_seq resumes
+static long long stored_change_seq(sqlite3 *db) {
+    sqlite3_stmt *stmt = NULL;
+    long long seq = 0;
+    if (sqlite3_prepare_v2(db, "SELECT MAX((SELECT COALESCE(MAX(change_seq), 0) FROM messages), "
+                               "(SELECT COALESCE(MAX(change_seq), 0) FROM message_tombstones))",
+                           -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        seq = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return seq;
+}
+
+// Create the full-text index and its triggers. When the index is new,
+// every existing row is left to the backfill. false if this SQLite has no
+// FTS5, which leaves search unavailable rather than failing startup.
+static bool create_search_schema(sqlite3 *db) {
+    const char *create_search =
+        "BEGIN;"
+        "CREATE VIRTUAL TABLE IF NOT EXISTS messages_fts USING fts5("
+        "message, content='messages', content_rowid='id');"
+        "CREATE TABLE IF NOT EXISTS search_backfill ("
+        "next_id INTEGER NOT NULL,"
+        "end_id INTEGER NOT NULL"
+        ");"
+        "INSERT INTO search_backfill (next_id, end_id) "
+        "SELECT 1, COALESCE(MAX(id), 0) FROM messages WHERE NOT EXISTS (SELECT 1 FROM search_backfill);"
+        "CREATE TRIGGER IF NOT EXISTS messages_fts_insert AFTER INSERT ON messages BEGIN "
+        "INSERT INTO messages_fts (rowid, message) VALUES (new.id, new.message); "
+        "END;"
+        "CREATE TRIGGER IF NOT EXISTS messages_fts_delete AFTER DELETE ON messages "
+        "WHEN old.id < (SELECT next_id FROM search_backfill) OR old.id > (SELECT end_id FROM search_backfill) "
+        "BEGIN "
+        "INSERT INTO messages_fts (messages_fts, rowid, message) VALUES ('delete', old.id, old.message); "
+        "END;"
+        "CREATE TRIGGER IF NOT EXISTS messages_fts_update AFTER UPDATE OF message ON messages "
+        "WHEN old.id < (SELECT next_id FROM search_backfill) OR old.id > (SELECT end_id FROM search_backfill) "
+        "BEGIN "
+        "INSERT INTO messages_fts (messages_fts, rowid, message) VALUES ('delete', old.id, old.message); "
+        "INSERT INTO messages_fts (rowid, message) VALUES (new.id, new.message); "
+        "END;"
+        "COMMIT;";
+    
+    if (sqlite3_exec(db, create_search, NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_WARN("Full-text search unavailable: %s\n", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        return false;
+    }
     
-    if (sqlite3_exec(db, create_transactions_table, NULL, NULL, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to create transactions table: %s\n", sqlite3_errmsg(db));
+    sqlite3_stmt *stmt = NULL;
+    bool complete = false;
+    if (sqlite3_prepare_v2(db, "SELECT next_id > end_id FROM search_backfill", -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        complete = sqlite3_column_int(stmt, 0) != 0;
+    }
+    sqlite3_finalize(stmt);
+    atomic_u32_store(&g_search_complete, complete ? 1 : 0);
+    return true;
+}
+
+// Day key (YYYYMMDD) of a stored "YYYY-MM-DDTHH:MM:SS" timestamp; 0 if malformed
+static int timestamp_day(const char *ts) {
+    int year, month, day;
+    if (ts == NULL || strlen(ts) < 10 || ts[4] != '-' || ts[7] != '-' ||
+        sscanf(ts, "%4d-%2d-%2d", &year, &month, &day) != 3 ||
+        month < 1 || month > 12 || day < 1 || day > 31) {
+        return 0;
+    }
+    return year * 10000 + month * 100 + day;
+}
+
+static int utc_day(time_t when) {
+    char timestamp[MAX_TIMESTAMP_LEN];
+    format_timestamp(when, timestamp, sizeof(timestamp));
+    return timestamp_day(timestamp);
+}
+
+// Create one day's partition of the audit log
+static int create_log_partition(sqlite3 *db, int day) {
+    char sql[1024];
+    snprintf(sql, sizeof(sql),
+             "CREATE TABLE IF NOT EXISTS transactions_%08d ("
+             "id INTEGER PRIMARY KEY,"
+             "ts TEXT NOT NULL,"
+             "action TEXT NOT NULL CHECK(action IN ("
+             "'CREATE', 'UPDATE', 'DELETE', 'READ',"
+             "'ACQUIRE_MUTEX', 'RELEASE_MUTEX', 'ADMIN_ACTION'"
+             ")),"
+             "user TEXT,"
+             "content TEXT CHECK(content IS NULL OR length(content) <= 2000),"
+             "semaphore_value INTEGER NOT NULL CHECK(semaphore_value IN (0, 1))"
+             ");"
+             "CREATE INDEX IF NOT EXISTS idx_transactions_%08d_ts ON transactions_%08d(ts DESC);"
+             "CREATE INDEX IF NOT EXISTS idx_transactions_%08d_action ON transactions_%08d(action);"
+             "CREATE INDEX IF NOT EXISTS idx_transactions_%08d_user ON transactions_%08d(user);",
+             day, day, day, day, day, day, day);
+    
+    if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_ERROR("Failed to create log partition %08d: %s\n", day, sqlite3_errmsg(db));
+        return -1;
+    }
+    return 0;
+}
+
+// Record a partition in g_log_days (kept sorted); idempotent
+static int log_days_add(int day) {
+    mutex_lock(&g_log_days_lock);
+    int at = g_log_day_count;
+    while (at > 0 && g_log_days[at - 1] > day) {
+        at--;
+    }
+    if (at > 0 && g_log_days[at - 1] == day) {
+        mutex_unlock(&g_log_days_lock);
+        return 0;
+    }
+    if (g_log_day_count == g_log_day_capacity) {
+        int capacity = g_log_day_capacity > 0 ? g_log_day_capacity * 2 : 64;
+        int *days = realloc(g_log_days, (size_t)capacity * sizeof(int));
+        if (days == NULL) {
+            mutex_unlock(&g_log_days_lock);
+            return -1;
+        }
+        g_log_days = days;
+        g_log_day_capacity = capacity;
+    }
+    memmove(&g_log_days[at + 1], &g_log_days[at], (size_t)(g_log_day_count - at) * sizeof(int));
+    g_log_days[at] = day;
+    g_log_day_count++;
+    mutex_unlock(&g_log_days_lock);
+    return 0;
+}
+
+static void log_days_remove(int day) {
+    mutex_lock(&g_log_days_lock);
+    for (int i = 0; i < g_log_day_count; i++) {
+        if (g_log_days[i] == day) {
+            memmove(&g_log_days[i], &g_log_days[i + 1], (size_t)(g_log_day_count - i - 1) * sizeof(int));
+            g_log_day_count--;
+            break;
+        }
+    }
+    mutex_unlock(&g_log_days_lock);
+}
+
+// Copy of g_log_days for a query to walk without the lock. Returns 0 (with
+// *out NULL when there are no partitions) or -1 if out of memory.
+static int log_days_snapshot(int **out, int *count) {
+    mutex_lock(&g_log_days_lock);
+    *out = NULL;
+    *count = g_log_day_count;
+    if (g_log_day_count > 0) {
+        *out = malloc((size_t)g_log_day_count * sizeof(int));
+        if (*out != NULL) {
+            memcpy(*out, g_log_days, (size_t)g_log_day_count * sizeof(int));
+        }
+    }
+    mutex_unlock(&g_log_days_lock);
+    return *count > 0 && *out == NULL ? -1 : 0;
+}
+
+// Move the rows of a pre-partition transactions table into day partitions,
+// one day at a time along its ts index. The table is dropped only when
+// every row found a day.
+static int migrate_unpartitioned_logs(sqlite3 *db) {
+    if (!table_has_column(db, "transactions", "ts")) {
+        return 0;
+    }
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_ERROR("Failed to begin log migration: %s\n", sqlite3_errmsg(db));
         return -1;
     }
     
-    if (sqlite3_exec(db, create_transactions_index1, NULL, NULL, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to create transactions index 1: %s\n", sqlite3_errmsg(db));
+    sqlite3_stmt *next_day = NULL;
+    sqlite3_stmt *total = NULL;
+    if (sqlite3_prepare_v2(db, "SELECT MIN(ts) FROM transactions WHERE ts >= ?1", -1, &next_day, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM transactions", -1, &total, NULL) != SQLITE_OK) {
+        LOG_ERROR("Failed to prepare log migration: %s\n", sqlite3_errmsg(db));
+        sqlite3_finalize(next_day);
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
         return -1;
     }
     
-    if (sqlite3_exec(db, create_transactions_index2, NULL, NULL, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to create transactions index 2: %s\n", sqlite3_errmsg(db));
+    // Every ts of day D sorts between "D" and "D~" ('T' < '~')
+    char lower[16] = "";
+    long long moved = 0;
+    int days = 0;
+    int result = 0;
+    for (;;) {
+        sqlite3_reset(next_day);
+        sqlite3_bind_text(next_day, 1, lower, -1, SQLITE_STATIC);
+        if (sqlite3_step(next_day) != SQLITE_ROW || sqlite3_column_type(next_day, 0) == SQLITE_NULL) {
+            break;
+        }
+        const char *first = (const char *)sqlite3_column_text(next_day, 0);
+        int day = timestamp_day(first);
+        if (day == 0) {
+            break;
+        }
+        char day_start[16];
+        snprintf(day_start, sizeof(day_start), "%.10s", first);
+        snprintf(lower, sizeof(lower), "%.10s~", first);
+        sqlite3_reset(next_day);
+        
+        char sql[256];
+        snprintf(sql, sizeof(sql),
+                 "INSERT INTO transactions_%08d (id, ts, action, user, content, semaphore_value) "
+                 "SELECT id, ts, action, user, content, semaphore_value FROM transactions "
+                 "WHERE ts >= '%s' AND ts < '%s'", day, day_start, lower);
+        if (create_log_partition(db, day) != 0 || sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+            LOG_ERROR("Failed to migrate logs of %s: %s\n", day_start, sqlite3_errmsg(db));
+            result = -1;
+            break;
+        }
+        moved += sqlite3_changes(db);
+        days++;
+    }
+    sqlite3_finalize(next_day);
+    
+    long long rows = sqlite3_step(total) == SQLITE_ROW ? sqlite3_column_int64(total, 0) : -1;
+    sqlite3_finalize(total);
+    if (result == 0 && rows != moved) {
+        LOG_WARN("Keeping unpartitioned transactions table: %lld of %lld rows have no day\n",
+                rows - moved, rows);
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        return 0;
+    }
+    if (result != 0 || sqlite3_exec(db, "DROP TABLE transactions", NULL, NULL, NULL) != SQLITE_OK ||
+        sqlite3_exec(db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_ERROR("Log migration failed: %s\n", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        return -1;
+    }
+    LOG_INFO("Migrated %lld log rows into %d day partitions\n", moved, days);
+    return 0;
+}
+
+// Create logs database schema: find the day partitions (migrating an
+// unpartitioned table first) and the next free log id
+static int create_logs_schema(sqlite3 *db) {
+    if (migrate_unpartitioned_logs(db) != 0) {
         return -1;
     }
     
-    if (sqlite3_exec(db, create_transactions_index3, NULL, NULL, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to create transactions index 3: %s\n", sqlite3_errmsg(db));
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db, "SELECT name FROM sqlite_master WHERE type = 'table' "
+                               "AND name GLOB 'transactions_[0-9][0-9][0-9][0-9][0-9][0-9][0-9][0-9]'",
+                           -1, &stmt, NULL) != SQLITE_OK) {
+        LOG_ERROR("Failed to list log partitions: %s\n", sqlite3_errmsg(db));
         return -1;
     }
     
+    g_next_log_id = 1;
+    int result = 0;
+    while (result == 0 && sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *name = (const char *)sqlite3_column_text(stmt, 0);
+        int day = atoi(name + strlen("transactions_"));
+        
+        char sql[64];
+        sqlite3_stmt *max_id = NULL;
+        snprintf(sql, sizeof(sql), "SELECT MAX(id) FROM transactions_%08d", day);
+        if (sqlite3_prepare_v2(db, sql, -1, &max_id, NULL) != SQLITE_OK || log_days_add(day) != 0) {
+            LOG_ERROR("Failed to load log partition %08d\n", day);
+            result = -1;
+        } else if (sqlite3_step(max_id) == SQLITE_ROW && sqlite3_column_int64(max_id, 0) >= g_next_log_id) {
+            g_next_log_id = sqlite3_column_int64(max_id, 0) + 1;
+        }
+        sqlite3_finalize(max_id);
+    }
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+// Point stmt_insert_log at the partition of day, creating the partition
+// with the first record of a new day (caller holds g_logs_lock)
+static sqlite3_stmt *log_insert_statement(int day) {
+    if (g_insert_day == day && g_db_ctx.stmt_insert_log != NULL) {
+        return g_db_ctx.stmt_insert_log;
+    }
+    if (g_db_ctx.stmt_insert_log != NULL) {
+        sqlite3_finalize(g_db_ctx.stmt_insert_log);
+        g_db_ctx.stmt_insert_log = NULL;
+    }
+    g_insert_day = 0;
+    if (create_log_partition(g_db_ctx.logs_db, day) != 0 || log_days_add(day) != 0) {
+        return NULL;
+    }
+    
+    char sql[160];
+    snprintf(sql, sizeof(sql),
+             "INSERT INTO transactions_%08d (id, ts, action, user, content, semaphore_value) "
+             "VALUES (?, ?, ?, ?, ?, ?)", day);
+    if (sqlite3_prepare_v2(g_db_ctx.logs_db, sql, -1, &g_db_ctx.stmt_insert_log, NULL) != SQLITE_OK) {
+        LOG_ERROR("Failed to prepare insert_log statement: %s\n", sqlite3_errmsg(g_db_ctx.logs_db));
+        return NULL;
+    }
+    g_insert_day = day;
+    return g_db_ctx.stmt_insert_log;
+}
+
+// Insert one record into its day's partition (caller holds g_logs_lock)
+static int insert_log_row(time_t when, const char *action, const char *user, const char *content,
+                          int semaphore_value) {
+    char timestamp[MAX_TIMESTAMP_LEN];
+    format_timestamp(when, timestamp, sizeof(timestamp));
+    sqlite3_stmt *stmt = log_insert_statement(timestamp_day(timestamp));
+    if (stmt == NULL) {
+        return -5;
+    }
+    
+    sqlite3_reset(stmt);
+    sqlite3_bind_int64(stmt, 1, g_next_log_id);
+    sqlite3_bind_text(stmt, 2, timestamp, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, action, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, user, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 5, content, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 6, semaphore_value);
+    int result = timed_step(stmt);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);  // The caller's strings are about to be reused
+    if (result != SQLITE_DONE) {
+        LOG_ERROR("Failed to insert log entry: %s\n", sqlite3_errmsg(g_db_ctx.logs_db));
+        return -5;
+    }
+    g_next_log_id++;
+    return 0;
+}
+
+// This connection's statement of one kind for one day's partition,
+// prepared on first use and cached by (day, kind). NULL if the partition
+// has been dropped.
+static sqlite3_stmt *log_statement(db_reader_t *reader, int day, log_query_t kind) {
+    static const char *const sql_templates[] = {
+        [LOG_QUERY_PAGE] =
+            "SELECT id, ts, action, user, content, semaphore_value FROM transactions_%08d "
+            "ORDER BY ts DESC, id ASC LIMIT ?1 OFFSET ?2",
+        [LOG_QUERY_BEFORE] =
+            "SELECT id, ts, action, user, content, semaphore_value FROM transactions_%08d "
+            "WHERE ts <= ?1 AND (ts < ?1 OR id > ?2) "
+            "ORDER BY ts DESC, id ASC LIMIT ?3",
+        [LOG_QUERY_AFTER] =
+            "SELECT id, ts, action, user, content, semaphore_value FROM transactions_%08d "
+            "WHERE ts >= ?1 AND (ts > ?1 OR id < ?2) "
+            "ORDER BY ts ASC, id DESC LIMIT ?3",
+        [LOG_QUERY_COUNT] =
+            "SELECT COUNT(*) FROM transactions_%08d",
+    };
+    
+    db_log_stmt_t *slot = &reader->log_stmts[(unsigned)(day * 4 + (int)kind) % DB_LOG_STMT_SLOTS];
+    if (slot->stmt != NULL && slot->day == day && slot->kind == (int)kind) {
+        return slot->stmt;
+    }
+    if (slot->stmt != NULL) {
+        sqlite3_finalize(slot->stmt);
+        slot->stmt = NULL;
+    }
+    
+    char sql[256];
+    snprintf(sql, sizeof(sql), sql_templates[kind], day);
+    if (sqlite3_prepare_v2(reader->logs_db, sql, -1, &slot->stmt, NULL) != SQLITE_OK) {
+        slot->stmt = NULL;
+        return NULL;
+    }
+    slot->day = day;
+    slot->kind = (int)kind;
+    return slot->stmt;
+}
+
+// Drop every partition older than the retention window (today is one of
+// its days). Freed pages are reused by later days, so the file stops growing.
+static void prune_log_partitions(void) {
+    int cutoff = utc_day(time(NULL) - (time_t)(g_log_retention_days - 1) * 86400);
+    int *days;
+    int count;
+    if (log_days_snapshot(&days, &count) != 0) {
+        return;
+    }
+    
+    for (int i = 0; i < count && days[i] < cutoff; i++) {
+        char sql[64];
+        snprintf(sql, sizeof(sql), "DROP TABLE IF EXISTS transactions_%08d;", days[i]);
+        mutex_lock(&g_logs_lock);
+        if (days[i] == g_insert_day) {
+            sqlite3_finalize(g_db_ctx.stmt_insert_log);
+            g_db_ctx.stmt_insert_log = NULL;
+            g_insert_day = 0;
+        }
+        int result = sqlite3_exec(g_db_ctx.logs_db, sql, NULL, NULL, NULL);
+        if (result == SQLITE_OK) {
+            log_days_remove(days[i]);
+        } else {
+            LOG_ERROR("Failed to drop log partition %08d: %s\n", days[i],
+                    sqlite3_errmsg(g_db_ctx.logs_db));
+        }
+        mutex_unlock(&g_logs_lock);
+        if (result != SQLITE_OK) {
+            break;
+        }
+        g_log_days_dropped++;
+        LOG_INFO("Dropped log partition %08d (retention %d days)\n", days[i], g_log_retention_days);
+    }
+    free(days);
+}
+
+static void *log_pruner_main(void *arg) {
+    (void)arg;
+    mutex_lock(&g_log_pruner_lock);
+    while (g_log_pruner_running) {
+        mutex_unlock(&g_log_pruner_lock);
+        prune_log_partitions();
+        mutex_lock(&g_log_pruner_lock);
+        if (g_log_pruner_running) {
+            cond_timedwait_ms(&g_log_pruner_cond, &g_log_pruner_lock, DB_LOG_PRUNE_CHECK_MS);
+        }
+    }
+    mutex_unlock(&g_log_pruner_lock);
+    return NULL;
+}
+
+// Prepare the message read statements of one connection pair (log
+// statements are prepared per day partition, see log_statement())
+static int prepare_read_statements(db_reader_t *reader) {
+    // Pages run newest first. Ties on created_at are broken by ascending id,
+    // which is exactly the order of the created_at DESC indexes (rowid is
+    // their implicit last column), so no query below needs a sort step.
+    //
+    // Keyset paging (the _before/_after variants): seek straight to the
+    // cursor row's position in the index, so every page costs the same as
+    // the first. "before" continues the newest-first order; "after" returns
+    // newer rows oldest first.
+    const struct {
+        sqlite3 *db;
+        sqlite3_stmt **stmt;
+        const char *sql;
+    } read_statements[] = {
+        { reader->chat_db, &reader->stmt_list_messages,
+          "SELECT id, username, message, created_at, room FROM messages "
+          "ORDER BY created_at DESC, id ASC LIMIT ? OFFSET ?" },
+        { reader->chat_db, &reader->stmt_list_room_messages,
+          "SELECT id, username, message, created_at, room FROM messages WHERE room = ? "
+          "ORDER BY created_at DESC, id ASC LIMIT ? OFFSET ?" },
+        { reader->chat_db, &reader->stmt_list_messages_before,
+          "SELECT id, username, message, created_at, room FROM messages "
+          "WHERE created_at <= ?1 AND (created_at < ?1 OR id > ?2) "
+          "ORDER BY created_at DESC, id ASC LIMIT ?3" },
+        { reader->chat_db, &reader->stmt_list_messages_after,
+          "SELECT id, username, message, created_at, room FROM messages "
+          "WHERE created_at >= ?1 AND (created_at > ?1 OR id < ?2) "
+          "ORDER BY created_at ASC, id DESC LIMIT ?3" },
+        { reader->chat_db, &reader->stmt_list_room_messages_before,
+          "SELECT id, username, message, created_at, room FROM messages "
+          "WHERE room = ?1 AND created_at <= ?2 AND (created_at < ?2 OR id > ?3) "
+          "ORDER BY created_at DESC, id ASC LIMIT ?4" },
+        { reader->chat_db, &reader->stmt_list_room_messages_after,
+          "SELECT id, username, message, created_at, room FROM messages "
+          "WHERE room = ?1 AND created_at >= ?2 AND (created_at > ?2 OR id < ?3) "
+          "ORDER BY created_at ASC, id DESC LIMIT ?4" },
+        // Change feed: live rows and tombstones past ?1 merged in sequence
+        // order, both read off their change_seq keys; ?2 NULL is every room.
+        // A tombstone is the row with no username (its time is deleted_at).
+        { reader->chat_db, &reader->stmt_list_changes,
+          "SELECT change_seq, id, room, username, message, created_at FROM messages "
+          "WHERE change_seq > ?1 AND (?2 IS NULL OR room = ?2) "
+          "UNION ALL "
+          "SELECT change_seq, id, room, NULL, NULL, deleted_at FROM message_tombstones "
+          "WHERE change_seq > ?1 AND (?2 IS NULL OR room = ?2) "
+          "ORDER BY 1 LIMIT ?3" },
+    };
+    
+    for (size_t i = 0; i < sizeof(read_statements) / sizeof(read_statements[0]); i++) {
+        if (sqlite3_prepare_v2(read_statements[i].db, read_statements[i].sql, -1,
+                              read_statements[i].stmt, NULL) != SQLITE_OK) {
+            LOG_ERROR("Failed to prepare read statement: %s\n",
+                    sqlite3_errmsg(read_statements[i].db));
+            return -1;
+        }
+    }
+    
+    // Search ranks by BM25 (FTS5's default rank, smaller is better),
+    // newest first on ties; ?2 NULL searches every room. The total rides
+    // along as a window count, with a separate count for pages past the
+    // last hit.
+    if (g_search_available) {
+        const struct {
+            sqlite3_stmt **stmt;
+            const char *sql;
+        } search_statements[] = {
+            { &reader->stmt_search_messages,
+              "SELECT m.id, m.username, m.message, m.created_at, m.room, -f.rank, count(*) OVER () "
+              "FROM (SELECT rowid, rank FROM messages_fts WHERE messages_fts MATCH ?1) f "
+              "JOIN messages m ON m.id = f.rowid WHERE ?2 IS NULL OR m.room = ?2 "
+              "ORDER BY f.rank, m.id DESC LIMIT ?3 OFFSET ?4" },
+            { &reader->stmt_count_search_messages,
+              "SELECT count(*) FROM messages_fts JOIN messages m ON m.id = messages_fts.rowid "
+              "WHERE messages_fts MATCH ?1 AND (?2 IS NULL OR m.room = ?2)" },
+        };
+        for (size_t i = 0; i < sizeof(search_statements) / sizeof(search_statements[0]); i++) {
+            if (sqlite3_prepare_v2(reader->chat_db, search_statements[i].sql, -1,
+                                  search_statements[i].stmt, NULL) != SQLITE_OK) {
+                LOG_ERROR("Failed to prepare search statement: %s\n", sqlite3_errmsg(reader->chat_db));
+                return -1;
+            }
+        }
+    }
+    
     return 0;
 }
 
-// Prepare all SQL statements
-int prepare_statements() {
+// Finalize the read statements of one connection pair
+static void finalize_read_statements(db_reader_t *reader) {
+    sqlite3_stmt *stmts[] = {
+        reader->stmt_list_messages, reader->stmt_list_room_messages,
+        reader->stmt_list_messages_before, reader->stmt_list_messages_after,
+        reader->stmt_list_room_messages_before, reader->stmt_list_room_messages_after,
+        reader->stmt_search_messages, reader->stmt_count_search_messages, reader->stmt_list_changes
+    };
+    
+    for (size_t i = 0; i < sizeof(stmts) / sizeof(stmts[0]); i++) {
+        if (stmts[i]) sqlite3_finalize(stmts[i]);
+    }
+    for (int i = 0; i < DB_LOG_STMT_SLOTS; i++) {
+        if (reader->log_stmts[i].stmt) sqlite3_finalize(reader->log_stmts[i].stmt);
+    }
+}
+
+// Prepare all SQL statements on the writer connections
+static int prepare_statements() {
     // Chat database statements
     const char *sql_create_message = 
-        "INSERT INTO messages (username, message, created_at) VALUES (?, ?, ?)";
+        "INSERT INTO messages (username, message, created_at, room, change_seq) VALUES (?, ?, ?, ?, ?)";
     
     const char *sql_update_message = 
-        "UPDATE messages SET message = ? WHERE id = ? AND username = ?";
+        "UPDATE messages SET message = ?1, change_seq = ?5 WHERE id = ?2 AND username = ?3 AND room = ?4";
     
     const char *sql_delete_message = 
-        "DELETE FROM messages WHERE id = ? AND username = ?";
-    
-    const char *sql_list_messages = 
-        "SELECT id, username, message, created_at FROM messages "
-        "ORDER BY created_at DESC LIMIT ? OFFSET ?";
-    
-    // Logs database statements
-    const char *sql_insert_log = 
-        "INSERT INTO transactions (ts, action, user, content, semaphore_value) "
-        "VALUES (?, ?, ?, ?, ?)";
+        "DELETE FROM messages WHERE id = ? AND username = ? AND room = ?";
     
-    const char *sql_get_logs = 
-        "SELECT id, ts, action, user, content, semaphore_value FROM transactions "
-        "ORDER BY ts DESC LIMIT ? OFFSET ?";
+    const char *sql_insert_tombstone = 
+        "INSERT INTO message_tombstones (change_seq, id, room, deleted_at) VALUES (?, ?, ?, ?)";
     
     // Prepare chat statements
     if (sqlite3_prepare_v2(g_db_ctx.chat_db, sql_create_message, -1, 
                           &g_db_ctx.stmt_create_message, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare create_message statement: %s\n", 
+        LOG_ERROR("Failed to prepare create_message statement: %s\n", 
                 sqlite3_errmsg(g_db_ctx.chat_db));
         return -1;
     }
     
     if (sqlite3_prepare_v2(g_db_ctx.chat_db, sql_update_message, -1, 
                           &g_db_ctx.stmt_update_message, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare update_message statement: %s\n", 
+        LOG_ERROR("Failed to prepare update_message statement: %s\n", 
                 sqlite3_errmsg(g_db_ctx.chat_db));
         return -1;
     }
     
     if (sqlite3_prepare_v2(g_db_ctx.chat_db, sql_delete_message, -1, 
                           &g_db_ctx.stmt_delete_message, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare delete_message statement: %s\n", 
+        LOG_ERROR("Failed to prepare delete_message statement: %s\n", 
                 sqlite3_errmsg(g_db_ctx.chat_db));
         return -1;
     }
     
-    if (sqlite3_prepare_v2(g_db_ctx.chat_db, sql_list_messages, -1, 
-                          &g_db_ctx.stmt_list_messages, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare list_messages statement: %s\n", 
+    if (sqlite3_prepare_v2(g_db_ctx.chat_db, sql_insert_tombstone, -1, 
+                          &g_db_ctx.stmt_insert_tombstone, NULL) != SQLITE_OK) {
+        LOG_ERROR("Failed to prepare insert_tombstone statement: %s\n", 
                 sqlite3_errmsg(g_db_ctx.chat_db));
         return -1;
     }
     
-    // Prepare log statements
-    if (sqlite3_prepare_v2(g_db_ctx.logs_db, sql_insert_log, -1, 
-                          &g_db_ctx.stmt_insert_log, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare insert_log statement: %s\n", 
-                sqlite3_errmsg(g_db_ctx.logs_db));
+    // The backfill indexes ids next_id .. next_id + ?1 - 1 (capped at end_id)
+    // and then moves next_id past them; the advance reports whether it is done
+    if (g_search_available) {
+        const char *sql_search_backfill =
+            "INSERT INTO messages_fts (rowid, message) SELECT id, message FROM messages "
+            "WHERE id >= (SELECT next_id FROM search_backfill) "
+            "AND id <= (SELECT MIN(end_id, next_id + ?1 - 1) FROM search_backfill)";
+        const char *sql_search_backfill_advance =
+            "UPDATE search_backfill SET next_id = MIN(end_id, next_id + ?1 - 1) + 1 "
+            "RETURNING next_id > end_id";
+        if (sqlite3_prepare_v2(g_db_ctx.chat_db, sql_search_backfill, -1,
+                              &g_db_ctx.stmt_search_backfill, NULL) != SQLITE_OK ||
+            sqlite3_prepare_v2(g_db_ctx.chat_db, sql_search_backfill_advance, -1,
+                              &g_db_ctx.stmt_search_backfill_advance, NULL) != SQLITE_OK) {
+            LOG_ERROR("Failed to prepare search backfill statements: %s\n",
+                    sqlite3_errmsg(g_db_ctx.chat_db));
+            return -1;
+        }
+    }
+    
+    // The log insert statement follows the current day, see log_insert_statement()
+    g_db_ctx.reads.chat_db = g_db_ctx.chat_db;
+    g_db_ctx.reads.logs_db = g_db_ctx.logs_db;
+    return prepare_read_statements(&g_db_ctx.reads);
+}
+
+// Group commit options (validated by db_configure_commit()). A window of 0
+// commits every write on its own.
+static void sqlite_configure_commit(int window_ms, const char *synchronous) {
+    g_commit_window_ms = window_ms;
+    if (synchronous != NULL) {
+        strcpy(g_synchronous, synchronous);
+    }
+}
+
+// Read pool size (validated by db_configure_readers()); 0 disables it
+static void sqlite_configure_readers(int readers) {
+    g_reader_count = readers;
+}
+
+// Days of audit log kept (validated by db_configure_log_retention()); 0 keeps all
+static void sqlite_configure_log_retention(int days) {
+    g_log_retention_days = days;
+}
+
+// Page cache and mmap sizes (validated by db_configure_cache())
+static void sqlite_configure_cache(int cache_mb, int mmap_mb) {
+    g_cache_mb = cache_mb;
+    g_mmap_mb = mmap_mb;
+}
+
+// Apply the cache options to one connection; 0 MB keeps SQLite's default cache
+static void apply_cache_pragmas(sqlite3 *db) {
+    char pragma[96];
+    if (g_cache_mb > 0) {
+        snprintf(pragma, sizeof(pragma), "PRAGMA cache_size=-%d;", g_cache_mb * 1024);
+        if (sqlite3_exec(db, pragma, NULL, NULL, NULL) != SQLITE_OK) {
+            LOG_WARN("Failed to set %s\n", pragma);
+        }
+    }
+    snprintf(pragma, sizeof(pragma), "PRAGMA mmap_size=%lld;", (long long)g_mmap_mb * 1024 * 1024);
+    if (sqlite3_exec(db, pragma, NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_WARN("Failed to set %s\n", pragma);
+    }
+}
+
+// Switch a database to WAL; readers on other connections need it
+static bool enable_wal(sqlite3 *db) {
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db, "PRAGMA journal_mode=WAL;", -1, &stmt, NULL) != SQLITE_OK) {
+        return false;
+    }
+    
+    bool wal = false;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *mode = (const char *)sqlite3_column_text(stmt, 0);
+        wal = mode != NULL && strcmp(mode, "wal") == 0;
+    }
+    sqlite3_finalize(stmt);
+    return wal;
+}
+
+// Open one read-only connection with its own read statements
+static int open_reader(db_reader_t *reader, const char *chat_db_path, const char *log_db_path) {
+    memset(reader, 0, sizeof(*reader));
+    if (sqlite3_open_v2(chat_db_path, &reader->chat_db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK ||
+        sqlite3_open_v2(log_db_path, &reader->logs_db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+        LOG_ERROR("Failed to open read-only connection: %s\n",
+                sqlite3_errmsg(reader->logs_db != NULL ? reader->logs_db : reader->chat_db));
         return -1;
     }
     
-    if (sqlite3_prepare_v2(g_db_ctx.logs_db, sql_get_logs, -1, 
-                          &g_db_ctx.stmt_get_logs, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare get_logs statement: %s\n", 
-                sqlite3_errmsg(g_db_ctx.logs_db));
+    // A reader only waits while the writer checkpoints or recovers the WAL
+    sqlite3_busy_timeout(reader->chat_db, 1000);
+    sqlite3_busy_timeout(reader->logs_db, 1000);
+    apply_cache_pragmas(reader->chat_db);
+    apply_cache_pragmas(reader->logs_db);
+    return prepare_read_statements(reader);
+}
+
+static void close_reader(db_reader_t *reader) {
+    finalize_read_statements(reader);
+    if (reader->chat_db) sqlite3_close(reader->chat_db);
+    if (reader->logs_db) sqlite3_close(reader->logs_db);
+}
+
+// Open g_reader_count readers. A pool that cannot be opened is not fatal:
+// reads then fall back to the writer connections.
+static void open_reader_pool(const char *chat_db_path, const char *log_db_path, bool wal) {
+    if (g_reader_count == 0) {
+        return;
+    }
+    if (!wal) {
+        LOG_WARN("Databases are not in WAL mode, serving reads from the writer connection\n");
+        return;
+    }
+    
+    g_readers = calloc((size_t)g_reader_count, sizeof(db_reader_t));
+    if (g_readers == NULL) {
+        LOG_ERROR("Out of memory allocating %d readers\n", g_reader_count);
+        return;
+    }
+    for (int i = 0; i < g_reader_count; i++) {
+        if (open_reader(&g_readers[i], chat_db_path, log_db_path) != 0) {
+            for (int j = 0; j <= i; j++) {
+                close_reader(&g_readers[j]);
+            }
+            free(g_readers);
+            g_readers = NULL;
+            LOG_WARN("Serving reads from the writer connection\n");
+            return;
+        }
+        g_readers[i].next_free = g_free_readers;
+        g_free_readers = &g_readers[i];
+    }
+    
+    mutex_init(&g_reader_lock);
+    cond_init(&g_reader_cond);
+}
+
+static void close_reader_pool(void) {
+    if (g_readers == NULL) {
+        return;
+    }
+    for (int i = 0; i < g_reader_count; i++) {
+        close_reader(&g_readers[i]);
+    }
+    free(g_readers);
+    g_readers = NULL;
+    g_free_readers = NULL;
+    cond_destroy(&g_reader_cond);
+    mutex_destroy(&g_reader_lock);
+}
+
+// Check out a reader, waiting while all are in use. Without a pool this
+// is the writer's read set, returned with writer_lock held.
+static db_reader_t *reader_checkout(mutex_t *writer_lock) {
+    if (g_readers == NULL) {
+        mutex_lock(writer_lock);
+        return &g_db_ctx.reads;
+    }
+    
+    mutex_lock(&g_reader_lock);
+    while (g_free_readers == NULL) {
+        cond_wait(&g_reader_cond, &g_reader_lock);
+    }
+    db_reader_t *reader = g_free_readers;
+    g_free_readers = reader->next_free;
+    mutex_unlock(&g_reader_lock);
+    return reader;
+}
+
+static void reader_checkin(db_reader_t *reader, mutex_t *writer_lock) {
+    if (reader == &g_db_ctx.reads) {
+        mutex_unlock(writer_lock);
+        return;
+    }
+    
+    mutex_lock(&g_reader_lock);
+    reader->next_free = g_free_readers;
+    g_free_readers = reader;
+    cond_signal(&g_reader_cond);
+    mutex_unlock(&g_reader_lock);
+}
+
+// Take g_chat_lock and open (or join) the current write group. Returns
+// with the lock held on success; on failure the lock is not held.
+static int chat_write_enter(void) {
+    atomic_u32_add(&g_writers_inbound, 1);
+    mutex_lock(&g_chat_lock);
+    if (g_chat_txn_open) {
+        return 0;
+    }
+    if (sqlite3_exec(g_db_ctx.chat_db, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_ERROR("Failed to begin write transaction: %s\n", sqlite3_errmsg(g_db_ctx.chat_db));
+        atomic_u32_add(&g_writers_inbound, (uint32_t)-1);
+        mutex_unlock(&g_chat_lock);
+        return -5;
+    }
+    g_chat_txn_open = true;
+    return 0;
+}
+
+// Wait for the COMMIT that covers this writer's statement (caller holds
+// g_chat_lock, which is released while waiting). Every writer that entered
+// must come here, even if its own statement failed, so the transaction
+// always has a leader to close it. Returns 0 once committed, -5 if the
+// group's COMMIT failed and was rolled back.
+static int chat_write_commit(void) {
+    commit_waiter_t self = { g_group_waiters, 0, false };
+    g_group_waiters = &self;
+    g_group_size++;
+    bool more_inbound = atomic_u32_add(&g_writers_inbound, (uint32_t)-1) > 1;
+    
+    if (g_group_has_leader) {
+        if (!more_inbound || g_group_size >= DB_MAX_COMMIT_GROUP) {
+            cond_signal(&g_group_leader_cond);  // Nobody else is coming: commit now
+        }
+        while (!self.done) {
+            cond_wait(&g_group_done_cond, &g_chat_lock);
+        }
+        return self.result;
+    }
+    
+    // Leader: let writers already on their way join before paying for the
+    // fsync. A lone writer commits at once rather than sitting out the window.
+    g_group_has_leader = true;
+    if (g_commit_window_ms > 0 && more_inbound) {
+        long long deadline = monotonic_ms() + g_commit_window_ms;
+        long long remaining;
+        while (g_group_size < DB_MAX_COMMIT_GROUP && atomic_u32_load(&g_writers_inbound) > 0 &&
+               (remaining = deadline - monotonic_ms()) > 0) {
+            cond_timedwait_ms(&g_group_leader_cond, &g_chat_lock, (int)remaining);
+        }
+    }
+    
+    int result = 0;
+    if (sqlite3_exec(g_db_ctx.chat_db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_ERROR("Failed to commit write group of %d: %s\n", g_group_size,
+                sqlite3_errmsg(g_db_ctx.chat_db));
+        sqlite3_exec(g_db_ctx.chat_db, "ROLLBACK", NULL, NULL, NULL);
+        result = -5;
+    } else {
+        g_groups_committed++;
+        g_writes_committed += (unsigned long)g_group_size;
+    }
+    
+    for (commit_waiter_t *waiter = g_group_waiters; waiter != NULL; waiter = waiter->next) {
+        waiter->result = result;
+        waiter->done = true;
+    }
+    g_group_waiters = NULL;
+    g_group_size = 0;
+    g_group_has_leader = false;
+    g_chat_txn_open = false;
+    cond_broadcast(&g_group_done_cond);
+    return result;
+}
+
+// Index one batch of the rows stored before the full-text index, as a
+// write of its own so it joins the group commit like any other. The insert
+// and the advance of next_id land together or not at all.
+static int search_backfill_batch(bool *done) {
+    if (chat_write_enter() != 0) {
+        return -5;
+    }
+    int result = sqlite3_exec(g_db_ctx.chat_db, "SAVEPOINT search_backfill", NULL, NULL, NULL);
+    if (result == SQLITE_OK) {
+        sqlite3_stmt *stmts[] = { g_db_ctx.stmt_search_backfill, g_db_ctx.stmt_search_backfill_advance };
+        for (size_t i = 0; i < sizeof(stmts) / sizeof(stmts[0]) && result == SQLITE_OK; i++) {
+            sqlite3_reset(stmts[i]);
+            sqlite3_bind_int(stmts[i], 1, DB_SEARCH_BACKFILL_BATCH);
+            int step = sqlite3_step(stmts[i]);
+            if (step == SQLITE_ROW) {
+                *done = sqlite3_column_int(stmts[i], 0) != 0;
+                step = sqlite3_step(stmts[i]);
+            }
+            result = step == SQLITE_DONE ? SQLITE_OK : step;
+            sqlite3_reset(stmts[i]);
+        }
+        if (result != SQLITE_OK) {
+            LOG_ERROR("Failed to index older messages: %s\n", sqlite3_errmsg(g_db_ctx.chat_db));
+            sqlite3_exec(g_db_ctx.chat_db, "ROLLBACK TO search_backfill", NULL, NULL, NULL);
+        }
+        sqlite3_exec(g_db_ctx.chat_db, "RELEASE search_backfill", NULL, NULL, NULL);
+    }
+    int committed = chat_write_commit();
+    mutex_unlock(&g_chat_lock);
+    return result == SQLITE_OK && committed == 0 ? 0 : -5;
+}
+
+static void *search_backfill_main(void *arg) {
+    (void)arg;
+    unsigned long batches = 0;
+    bool done = false;
+    while (!done && atomic_u32_load(&g_search_backfill_stop) == 0) {
+        if (search_backfill_batch(&done) != 0) {
+            LOG_WARN("Search backfill stopped; older messages stay unsearchable until restart\n");
+            return NULL;
+        }
+        batches++;
+    }
+    if (done) {
+        atomic_u32_store(&g_search_complete, 1);
+        LOG_INFO("Search backfill complete (%lu batches)\n", batches);
+    }
+    return NULL;
+}
+
+// Fill the message cache with the newest rows, in listing order
+static int warm_message_cache(void) {
+    if (message_cache_init() != 0) {
         return -1;
     }
+    int capacity = message_cache_capacity();
+    if (capacity == 0) {
+        return 0;
+    }
+    
+    // Rows saved by the last clean shutdown, if nothing has been written since
+    if (message_cache_load(g_cache_snapshot_path, g_change_seq) >= 0) {
+        return 0;
+    }
     
+    sqlite3_stmt *stmt = g_db_ctx.reads.stmt_list_messages;
+    int rows = 0;
+    sqlite3_reset(stmt);
+    sqlite3_bind_int(stmt, 1, capacity);
+    sqlite3_bind_int(stmt, 2, 0);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        message_cache_insert(sqlite3_column_int(stmt, 0), (const char *)sqlite3_column_text(stmt, 4),
+                             (const char *)sqlite3_column_text(stmt, 1),
+                             (const char *)sqlite3_column_text(stmt, 2),
+                             (const char *)sqlite3_column_text(stmt, 3));
+        rows++;
+    }
+    sqlite3_reset(stmt);
+    
+    // A short read means the table holds nothing the cache lacks
+    message_cache_set_complete(rows < capacity);
+    LOG_INFO("Message cache warmed with %d of up to %d rows\n", rows, capacity);
     return 0;
 }
 
 // Initialize databases
-int init_databases(const char *chat_db_path, const char *log_db_path) {
+static int sqlite_init(const char *chat_db_path, const char *log_db_path) {
     if (g_db_initialized) {
         return 0;  // Already initialized
     }
@@ -213,42 +1169,69 @@ int init_databases(const char *chat_db_path, const char *log_db_path) {
     
     // Open chat database
     if (sqlite3_open(chat_db_path, &g_db_ctx.chat_db) != SQLITE_OK) {
-        fprintf(stderr, "Failed to open chat database: %s\n", sqlite3_errmsg(g_db_ctx.chat_db));
+        LOG_ERROR("Failed to open chat database: %s\n", sqlite3_errmsg(g_db_ctx.chat_db));
         return -1;
     }
     
     // Open logs database
     if (sqlite3_open(log_db_path, &g_db_ctx.logs_db) != SQLITE_OK) {
-        fprintf(stderr, "Failed to open logs database: %s\n", sqlite3_errmsg(g_db_ctx.logs_db));
+        LOG_ERROR("Failed to open logs database: %s\n", sqlite3_errmsg(g_db_ctx.logs_db));
         sqlite3_close(g_db_ctx.chat_db);
         return -1;
     }
     
     // Enable WAL mode for concurrent read access
-    if (sqlite3_exec(g_db_ctx.chat_db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to enable WAL mode for chat database: %s\n", 
+    bool chat_wal = enable_wal(g_db_ctx.chat_db);
+    if (!chat_wal) {
+        LOG_ERROR("Failed to enable WAL mode for chat database: %s\n", 
                 sqlite3_errmsg(g_db_ctx.chat_db));
     }
     
-    if (sqlite3_exec(g_db_ctx.logs_db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to enable WAL mode for logs database: %s\n", 
+    bool logs_wal = enable_wal(g_db_ctx.logs_db);
+    if (!logs_wal) {
+        LOG_ERROR("Failed to enable WAL mode for logs database: %s\n", 
                 sqlite3_errmsg(g_db_ctx.logs_db));
     }
     
     // Enable foreign keys
     sqlite3_exec(g_db_ctx.chat_db, "PRAGMA foreign_keys=ON;", NULL, NULL, NULL);
     sqlite3_exec(g_db_ctx.logs_db, "PRAGMA foreign_keys=ON;", NULL, NULL, NULL);
+    apply_cache_pragmas(g_db_ctx.chat_db);
+    apply_cache_pragmas(g_db_ctx.logs_db);
+    
+    // Pull chat.db into the OS page cache while nothing is served yet
+    size_t prefetch_mb = (size_t)(g_mmap_mb > g_cache_mb ? g_mmap_mb : g_cache_mb);
+    long long start_ms = monotonic_ms();
+    long long prefetched = platform_prefetch_file(chat_db_path, prefetch_mb * 1024 * 1024);
+    if (prefetched > 0) {
+        LOG_INFO("Prefetched %lld KB of %s in %lld ms\n", prefetched / 1024, chat_db_path,
+                 monotonic_ms() - start_ms);
+    }
+    snprintf(g_cache_snapshot_path, sizeof(g_cache_snapshot_path), "%s.cache", chat_db_path);
+    
+    // Durability of each commit (group commit makes FULL affordable)
+    char synchronous_pragma[48];
+    snprintf(synchronous_pragma, sizeof(synchronous_pragma), "PRAGMA synchronous=%s;", g_synchronous);
+    if (sqlite3_exec(g_db_ctx.chat_db, synchronous_pragma, NULL, NULL, NULL) != SQLITE_OK ||
+        sqlite3_exec(g_db_ctx.logs_db, synchronous_pragma, NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_ERROR("Failed to set %s\n", synchronous_pragma);
+    }
     
     // Create schemas
     if (create_chat_schema(g_db_ctx.chat_db) != 0) {
-        fprintf(stderr, "Failed to create chat database schema\n");
+        LOG_ERROR("Failed to create chat database schema\n");
         sqlite3_close(g_db_ctx.chat_db);
         sqlite3_close(g_db_ctx.logs_db);
         return -1;
     }
     
+    g_search_available = create_search_schema(g_db_ctx.chat_db);
+    g_change_seq = stored_change_seq(g_db_ctx.chat_db);
+    
+    mutex_init(&g_log_days_lock);
+    g_insert_day = 0;
     if (create_logs_schema(g_db_ctx.logs_db) != 0) {
-        fprintf(stderr, "Failed to create logs database schema\n");
+        LOG_ERROR("Failed to create logs database schema\n");
         sqlite3_close(g_db_ctx.chat_db);
         sqlite3_close(g_db_ctx.logs_db);
         return -1;
@@ -256,36 +1239,84 @@ int init_databases(const char *chat_db_path, const char *log_db_path) {
     
     // Prepare statements
     if (prepare_statements() != 0) {
-        fprintf(stderr, "Failed to prepare SQL statements\n");
-        cleanup_databases();
+        LOG_ERROR("Failed to prepare SQL statements\n");
+        sqlite_cleanup();
+        return -1;
+    }
+    
+    if (warm_message_cache() != 0) {
+        LOG_ERROR("Failed to initialize message cache\n");
+        sqlite_cleanup();
         return -1;
     }
     
+    // Readers open after the schema exists, so they never see an empty file
+    open_reader_pool(chat_db_path, log_db_path, chat_wal && logs_wal);
+    
+    mutex_init(&g_chat_lock);
+    mutex_init(&g_logs_lock);
+    cond_init(&g_group_leader_cond);
+    cond_init(&g_group_done_cond);
+    g_chat_txn_open = false;
+    g_group_has_leader = false;
+    g_group_size = 0;
+    g_group_waiters = NULL;
+    atomic_u32_store(&g_writers_inbound, 0);
     g_db_initialized = true;
-    printf("Database manager initialized successfully\n");
+    
+    // Retention runs now and then every DB_LOG_PRUNE_CHECK_MS
+    if (g_log_retention_days > 0) {
+        mutex_init(&g_log_pruner_lock);
+        cond_init(&g_log_pruner_cond);
+        g_log_pruner_running = true;
+        if (thread_create(&g_log_pruner, log_pruner_main, NULL) != 0) {
+            g_log_pruner_running = false;
+            LOG_WARN("Failed to start log pruner; old log partitions will not be dropped\n");
+        }
+    }
+    
+    // Messages stored before the full-text index are indexed in the background
+    if (g_search_available && atomic_u32_load(&g_search_complete) == 0) {
+        atomic_u32_store(&g_search_backfill_stop, 0);
+        g_search_backfill_running = thread_create(&g_search_backfill, search_backfill_main, NULL) == 0;
+        if (!g_search_backfill_running) {
+            LOG_WARN("Failed to start search backfill; older messages will not be searchable\n");
+        }
+    }
+    LOG_INFO("Database manager initialized successfully (commit window %d ms, synchronous=%s, "
+             "%d readers, cache %d MB, mmap %d MB)\n", g_commit_window_ms, g_synchronous,
+             g_readers != NULL ? g_reader_count : 0, g_cache_mb, g_mmap_mb);
+    LOG_INFO("Audit log: %d day partitions, %s\n", g_log_day_count,
+             g_log_retention_days > 0 ? "retention enforced" : "kept forever");
     return 0;
 }
 
-// Create a new message
-int create_message(const char *username, const char *message, char *out_timestamp) {
+// Create a new message in a room
+static int sqlite_create_message(const char *room, const char *username, const char *message, char *out_timestamp) {
     if (!g_db_initialized) {
-        fprintf(stderr, "Database not initialized\n");
+        LOG_ERROR("Database not initialized\n");
         return -1;
     }
     
     if (username == NULL || message == NULL || out_timestamp == NULL) {
-        fprintf(stderr, "Invalid parameters for create_message\n");
+        LOG_ERROR("Invalid parameters for create_message\n");
         return -4;
     }
     
     if (strlen(username) == 0 || strlen(username) > MAX_USERNAME_LEN ||
         strlen(message) == 0 || strlen(message) > MAX_MESSAGE_LEN) {
-        fprintf(stderr, "Invalid username or message length\n");
+        LOG_DEBUG("Invalid username or message length\n");
         return -4;
     }
     
+    if (!semaphore_valid_room(room)) {
+        LOG_DEBUG("Invalid room name for create_message\n");
+        return -4;
+    }
+    room = storage_room_or_default(room);
+    
     // Validate semaphore ownership for write operation
-    int ownership_status = validate_semaphore_ownership(username);
+    int ownership_status = validate_semaphore_ownership(room, username);
     if (ownership_status != 0) {
         return ownership_status;  // Return the specific error code
     }
@@ -295,18 +1326,32 @@ int create_message(const char *username, const char *message, char *out_timestam
     get_current_timestamp(timestamp, sizeof(timestamp));
     
     // Bind parameters
+    if (chat_write_enter() != 0) {
+        return -5;  // Database error
+    }
     sqlite3_reset(g_db_ctx.stmt_create_message);
     sqlite3_bind_text(g_db_ctx.stmt_create_message, 1, username, -1, SQLITE_STATIC);
     sqlite3_bind_text(g_db_ctx.stmt_create_message, 2, message, -1, SQLITE_STATIC);
     sqlite3_bind_text(g_db_ctx.stmt_create_message, 3, timestamp, -1, SQLITE_STATIC);
+    sqlite3_bind_text(g_db_ctx.stmt_create_message, 4, room, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(g_db_ctx.stmt_create_message, 5, ++g_change_seq);
     
     // Execute statement
-    int result = sqlite3_step(g_db_ctx.stmt_create_message);
+    int result = timed_step(g_db_ctx.stmt_create_message);
     if (result != SQLITE_DONE) {
-        fprintf(stderr, "Failed to create message: %s\n", sqlite3_errmsg(g_db_ctx.chat_db));
+        LOG_ERROR("Failed to create message: %s\n", sqlite3_errmsg(g_db_ctx.chat_db));
+    }
+    int id = (int)sqlite3_last_insert_rowid(g_db_ctx.chat_db);
+    sqlite3_reset(g_db_ctx.stmt_create_message);
+    int committed = chat_write_commit();
+    mutex_unlock(&g_chat_lock);
+    if (result != SQLITE_DONE || committed != 0) {
         return -5;  // Database error
     }
     
+    message_cache_insert(id, room, username, message, timestamp);
+    storage_publish_created(id, room, username, message, timestamp);
+    
     // Copy timestamp to output
     strncpy(out_timestamp, timestamp, MAX_TIMESTAMP_LEN - 1);
     out_timestamp[MAX_TIMESTAMP_LEN - 1] = '\0';
@@ -314,295 +1359,908 @@ int create_message(const char *username, const char *message, char *out_timestam
     // Log the transaction
     char current_holder[MAX_USERNAME_LEN];
     int semaphore_value;
-    get_semaphore_status(current_holder, &semaphore_value);
+    get_semaphore_status(room, current_holder, &semaphore_value);
     log_transaction("CREATE", username, message, semaphore_value);
     
-    printf("Created message by '%s' at %s\n", username, timestamp);
+    LOG_DEBUG("Created message by '%s' in room '%s' at %s\n", username, room, timestamp);
+    return 0;
+}
+
+// Create count messages in a room as one unit: a single ownership check,
+// one prepared statement stepped per row, and one savepoint inside the
+// current write group, so either every row is stored or none is. The id
+// and timestamp assigned to messages[i] are written to out_refs[i].
+static int sqlite_create_message_batch(const char *room, const char *username, const char *const *messages,
+                                       int count, message_ref_t *out_refs) {
+    if (!g_db_initialized) {
+        LOG_ERROR("Database not initialized\n");
+        return -1;
+    }
+    
+    if (username == NULL || messages == NULL || out_refs == NULL ||
+        count < 1 || count > DB_MAX_BATCH_MESSAGES) {
+        LOG_ERROR("Invalid parameters for create_message_batch\n");
+        return -4;
+    }
+    
+    if (strlen(username) == 0 || strlen(username) > MAX_USERNAME_LEN) {
+        LOG_DEBUG("Invalid username length\n");
+        return -4;
+    }
+    for (int i = 0; i < count; i++) {
+        if (messages[i] == NULL || strlen(messages[i]) == 0 || strlen(messages[i]) > MAX_MESSAGE_LEN) {
+            LOG_DEBUG("Invalid length for message %d of batch\n", i);
+            return -4;
+        }
+    }
+    
+    if (!semaphore_valid_room(room)) {
+        LOG_DEBUG("Invalid room name for create_message_batch\n");
+        return -4;
+    }
+    room = storage_room_or_default(room);
+    
+    // One ownership check covers the whole batch
+    int ownership_status = validate_semaphore_ownership(room, username);
+    if (ownership_status != 0) {
+        return ownership_status;
+    }
+    
+    char timestamp[MAX_TIMESTAMP_LEN];
+    get_current_timestamp(timestamp, sizeof(timestamp));
+    
+    if (chat_write_enter() != 0) {
+        return -5;  // Database error
+    }
+    
+    // The savepoint lets a failed row undo this batch without touching the
+    // other writers sharing the group's transaction
+    bool stored = sqlite3_exec(g_db_ctx.chat_db, "SAVEPOINT create_batch", NULL, NULL, NULL) == SQLITE_OK;
+    if (stored) {
+        sqlite3_stmt *stmt = g_db_ctx.stmt_create_message;
+        for (int i = 0; i < count && stored; i++) {
+            sqlite3_reset(stmt);
+            sqlite3_bind_text(stmt, 1, username, -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 2, messages[i], -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 3, timestamp, -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 4, room, -1, SQLITE_STATIC);
+            sqlite3_bind_int64(stmt, 5, ++g_change_seq);
+            if (timed_step(stmt) == SQLITE_DONE) {
+                out_refs[i].id = sqlite3_last_insert_rowid(g_db_ctx.chat_db);
+                strcpy(out_refs[i].timestamp, timestamp);
+            } else {
+                LOG_ERROR("Failed to create message %d of batch: %s\n", i,
+                        sqlite3_errmsg(g_db_ctx.chat_db));
+                stored = false;
+            }
+        }
+        sqlite3_reset(stmt);
+        if (!stored) {
+            sqlite3_exec(g_db_ctx.chat_db, "ROLLBACK TO create_batch", NULL, NULL, NULL);
+        }
+        sqlite3_exec(g_db_ctx.chat_db, "RELEASE create_batch", NULL, NULL, NULL);
+    } else {
+        LOG_ERROR("Failed to open batch savepoint: %s\n", sqlite3_errmsg(g_db_ctx.chat_db));
+    }
+    int committed = chat_write_commit();
+    mutex_unlock(&g_chat_lock);
+    if (!stored || committed != 0) {
+        return -5;  // Database error
+    }
+    
+    // Cache and audit every message, as if it had been created on its own
+    char current_holder[MAX_USERNAME_LEN];
+    int semaphore_value;
+    get_semaphore_status(room, current_holder, &semaphore_value);
+    for (int i = 0; i < count; i++) {
+        message_cache_insert((int)out_refs[i].id, room, username, messages[i], timestamp);
+        storage_publish_created(out_refs[i].id, room, username, messages[i], timestamp);
+        log_transaction("CREATE", username, messages[i], semaphore_value);
+    }
+    
+    LOG_DEBUG("Created %d messages by '%s' in room '%s' at %s\n", count, username, room, timestamp);
     return 0;
 }
 
-// Update an existing message
-int update_message(int id, const char *username, const char *message) {
+// Update an existing message in a room
+static int sqlite_update_message(const char *room, int id, const char *username, const char *message) {
     if (!g_db_initialized) {
-        fprintf(stderr, "Database not initialized\n");
+        LOG_ERROR("Database not initialized\n");
         return -1;
     }
     
     if (username == NULL || message == NULL) {
-        fprintf(stderr, "Invalid parameters for update_message\n");
+        LOG_ERROR("Invalid parameters for update_message\n");
         return -4;
     }
     
     if (strlen(username) == 0 || strlen(username) > MAX_USERNAME_LEN ||
         strlen(message) == 0 || strlen(message) > MAX_MESSAGE_LEN) {
-        fprintf(stderr, "Invalid username or message length\n");
+        LOG_DEBUG("Invalid username or message length\n");
+        return -4;
+    }
+    
+    if (!semaphore_valid_room(room)) {
+        LOG_DEBUG("Invalid room name for update_message\n");
         return -4;
     }
+    room = storage_room_or_default(room);
     
     // Validate semaphore ownership for write operation
-    int ownership_status = validate_semaphore_ownership(username);
+    int ownership_status = validate_semaphore_ownership(room, username);
     if (ownership_status != 0) {
         return ownership_status;  // Return the specific error code
     }
     
     // Bind parameters
+    if (chat_write_enter() != 0) {
+        return -5;  // Database error
+    }
     sqlite3_reset(g_db_ctx.stmt_update_message);
     sqlite3_bind_text(g_db_ctx.stmt_update_message, 1, message, -1, SQLITE_STATIC);
     sqlite3_bind_int(g_db_ctx.stmt_update_message, 2, id);
     sqlite3_bind_text(g_db_ctx.stmt_update_message, 3, username, -1, SQLITE_STATIC);
+    sqlite3_bind_text(g_db_ctx.stmt_update_message, 4, room, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(g_db_ctx.stmt_update_message, 5, ++g_change_seq);
     
     // Execute statement
-    int result = sqlite3_step(g_db_ctx.stmt_update_message);
+    int result = timed_step(g_db_ctx.stmt_update_message);
     if (result != SQLITE_DONE) {
-        fprintf(stderr, "Failed to update message: %s\n", sqlite3_errmsg(g_db_ctx.chat_db));
-        return -5;  // Database error
+        LOG_ERROR("Failed to update message: %s\n", sqlite3_errmsg(g_db_ctx.chat_db));
     }
     
-    // Check if any rows were affected
+    // Check if any rows were affected (before other writers in the group step)
     int changes = sqlite3_changes(g_db_ctx.chat_db);
+    sqlite3_reset(g_db_ctx.stmt_update_message);
+    int committed = chat_write_commit();
+    mutex_unlock(&g_chat_lock);
+    if (result != SQLITE_DONE || committed != 0) {
+        return -5;  // Database error
+    }
     if (changes == 0) {
-        printf("No message found with id %d for user '%s'\n", id, username);
+        LOG_DEBUG("No message found with id %d for user '%s' in room '%s'\n", id, username, room);
         return -2;  // Permission denied (message not found or not owned)
     }
     
+    message_cache_update(id, message);
+    storage_publish_updated(id, room, username, message);
+    
     // Log the transaction
     char current_holder[MAX_USERNAME_LEN];
     int semaphore_value;
-    get_semaphore_status(current_holder, &semaphore_value);
+    get_semaphore_status(room, current_holder, &semaphore_value);
     char log_content[256];
-    snprintf(log_content, sizeof(log_content), "Updated message ID %d", id);
+    snprintf(log_content, sizeof(log_content), "Updated message ID %d in room '%s'", id, room);
     log_transaction("UPDATE", username, log_content, semaphore_value);
     
-    printf("Updated message %d by '%s'\n", id, username);
+    LOG_DEBUG("Updated message %d by '%s' in room '%s'\n", id, username, room);
     return 0;
 }
 
-// Delete a message
-int delete_message(int id, const char *username) {
+// Delete a message from a room
+static int sqlite_delete_message(const char *room, int id, const char *username) {
     if (!g_db_initialized) {
-        fprintf(stderr, "Database not initialized\n");
+        LOG_ERROR("Database not initialized\n");
         return -1;
     }
     
     if (username == NULL) {
-        fprintf(stderr, "Invalid parameters for delete_message\n");
+        LOG_ERROR("Invalid parameters for delete_message\n");
         return -4;
     }
     
     if (strlen(username) == 0 || strlen(username) > MAX_USERNAME_LEN) {
-        fprintf(stderr, "Invalid username length\n");
+        LOG_DEBUG("Invalid username length\n");
+        return -4;
+    }
+    
+    if (!semaphore_valid_room(room)) {
+        LOG_DEBUG("Invalid room name for delete_message\n");
         return -4;
     }
+    room = storage_room_or_default(room);
     
     // Validate semaphore ownership for write operation
-    int ownership_status = validate_semaphore_ownership(username);
+    int ownership_status = validate_semaphore_ownership(room, username);
     if (ownership_status != 0) {
         return ownership_status;  // Return the specific error code
     }
     
-    // Bind parameters
-    sqlite3_reset(g_db_ctx.stmt_delete_message);
-    sqlite3_bind_int(g_db_ctx.stmt_delete_message, 1, id);
-    sqlite3_bind_text(g_db_ctx.stmt_delete_message, 2, username, -1, SQLITE_STATIC);
+    char deleted_at[MAX_TIMESTAMP_LEN];
+    get_current_timestamp(deleted_at, sizeof(deleted_at));
     
-    // Execute statement
-    int result = sqlite3_step(g_db_ctx.stmt_delete_message);
-    if (result != SQLITE_DONE) {
-        fprintf(stderr, "Failed to delete message: %s\n", sqlite3_errmsg(g_db_ctx.chat_db));
+    // The row and its tombstone change together; the savepoint takes the
+    // delete back if the tombstone cannot be written
+    if (chat_write_enter() != 0) {
+        return -5;  // Database error
+    }
+    int changes = 0;
+    int result = sqlite3_exec(g_db_ctx.chat_db, "SAVEPOINT delete_message", NULL, NULL, NULL) == SQLITE_OK
+                     ? SQLITE_DONE : SQLITE_ERROR;
+    if (result == SQLITE_DONE) {
+        sqlite3_reset(g_db_ctx.stmt_delete_message);
+        sqlite3_bind_int(g_db_ctx.stmt_delete_message, 1, id);
+        sqlite3_bind_text(g_db_ctx.stmt_delete_message, 2, username, -1, SQLITE_STATIC);
+        sqlite3_bind_text(g_db_ctx.stmt_delete_message, 3, room, -1, SQLITE_STATIC);
+        result = timed_step(g_db_ctx.stmt_delete_message);
+        
+        // Check if any rows were affected (before other writers in the group step)
+        changes = sqlite3_changes(g_db_ctx.chat_db);
+        if (result == SQLITE_DONE && changes > 0) {
+            sqlite3_stmt *tombstone = g_db_ctx.stmt_insert_tombstone;
+            sqlite3_reset(tombstone);
+            sqlite3_bind_int64(tombstone, 1, ++g_change_seq);
+            sqlite3_bind_int(tombstone, 2, id);
+            sqlite3_bind_text(tombstone, 3, room, -1, SQLITE_STATIC);
+            sqlite3_bind_text(tombstone, 4, deleted_at, -1, SQLITE_STATIC);
+            result = timed_step(tombstone);
+        }
+        if (result != SQLITE_DONE) {
+            LOG_ERROR("Failed to delete message: %s\n", sqlite3_errmsg(g_db_ctx.chat_db));
+            sqlite3_exec(g_db_ctx.chat_db, "ROLLBACK TO delete_message", NULL, NULL, NULL);
+        }
+        sqlite3_reset(g_db_ctx.stmt_delete_message);
+        sqlite3_reset(g_db_ctx.stmt_insert_tombstone);
+        sqlite3_exec(g_db_ctx.chat_db, "RELEASE delete_message", NULL, NULL, NULL);
+    } else {
+        LOG_ERROR("Failed to open delete savepoint: %s\n", sqlite3_errmsg(g_db_ctx.chat_db));
+    }
+    int committed = chat_write_commit();
+    mutex_unlock(&g_chat_lock);
+    if (result != SQLITE_DONE || committed != 0) {
         return -5;  // Database error
     }
-    
-    // Check if any rows were affected
-    int changes = sqlite3_changes(g_db_ctx.chat_db);
     if (changes == 0) {
-        printf("No message found with id %d for user '%s'\n", id, username);
+        LOG_DEBUG("No message found with id %d for user '%s' in room '%s'\n", id, username, room);
         return -2;  // Permission denied (message not found or not owned)
     }
     
+    message_cache_remove(id);
+    storage_publish_deleted(id, room, username);
+    
     // Log the transaction
     char current_holder[MAX_USERNAME_LEN];
     int semaphore_value;
-    get_semaphore_status(current_holder, &semaphore_value);
+    get_semaphore_status(room, current_holder, &semaphore_value);
     char log_content[256];
-    snprintf(log_content, sizeof(log_content), "Deleted message ID %d", id);
+    snprintf(log_content, sizeof(log_content), "Deleted message ID %d in room '%s'", id, room);
     log_transaction("DELETE", username, log_content, semaphore_value);
     
-    printf("Deleted message %d by '%s'\n", id, username);
+    LOG_DEBUG("Deleted message %d by '%s' in room '%s'\n", id, username, room);
     return 0;
 }
 
-// List messages with pagination
-int list_messages(int page, int limit, char *out_json) {
+// Validate the before/after pair; *cursor is set when one of them is given
+static int read_page_cursors(const char *before, const char *after, const char **cursor,
+                             char *ts, size_t ts_size, int *id) {
+    *cursor = before != NULL ? before : after;
+    if (before != NULL && after != NULL) {
+        return -1;
+    }
+    if (*cursor != NULL && storage_parse_page_cursor(*cursor, ts, ts_size, id) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// List messages with pagination, from one room or (room NULL) every room.
+// The page is appended to out, which grows to fit however long the rows are.
+// With a before/after cursor (the page's "next_cursor") page is ignored and
+// the query seeks directly to the cursor instead of skipping OFFSET rows.
+static int sqlite_list_messages(const char *room, int page, int limit, const char *before, const char *after,
+                                strbuf_t *out) {
     if (!g_db_initialized) {
-        fprintf(stderr, "Database not initialized\n");
+        LOG_ERROR("Database not initialized\n");
         return -1;
     }
     
-    if (out_json == NULL) {
-        fprintf(stderr, "Invalid parameters for list_messages\n");
+    if (out == NULL) {
+        LOG_ERROR("Invalid parameters for list_messages\n");
         return -4;
     }
     
     if (page < 1 || limit < 1 || limit > 100) {
-        fprintf(stderr, "Invalid page or limit parameters\n");
+        LOG_DEBUG("Invalid page or limit parameters\n");
         return -4;
     }
     
-    int offset = (page - 1) * limit;
-    
-    // Bind parameters
-    sqlite3_reset(g_db_ctx.stmt_list_messages);
-    sqlite3_bind_int(g_db_ctx.stmt_list_messages, 1, limit);
-    sqlite3_bind_int(g_db_ctx.stmt_list_messages, 2, offset);
+    if (room != NULL && (room[0] == '\0' || !semaphore_valid_room(room))) {
+        LOG_DEBUG("Invalid room name for list_messages\n");
+        return -4;
+    }
     
-    // Build JSON response
-    strcpy(out_json, "{\"messages\":[");
-    bool first = true;
+    const char *cursor;
+    char cursor_ts[MAX_CURSOR_LEN];
+    int cursor_id = 0;
+    if (read_page_cursors(before, after, &cursor, cursor_ts, sizeof(cursor_ts), &cursor_id) != 0) {
+        LOG_DEBUG("Invalid paging cursor for list_messages\n");
+        return -4;
+    }
     
-    while (sqlite3_step(g_db_ctx.stmt_list_messages) == SQLITE_ROW) {
-        if (!first) {
-            strcat(out_json, ",");
+    // Offset pages within the cached newest rows never reach SQLite
+    int cache_result = cursor == NULL ? message_cache_page(room, page, limit, out) : 1;
+    if (cache_result < 0) {
+        LOG_ERROR("Out of memory building message page\n");
+        return -1;
+    }
+    if (cache_result != 0) {
+        int offset = (page - 1) * limit;
+        
+        // Bind parameters
+        db_reader_t *reader = reader_checkout(&g_chat_lock);
+        sqlite3_stmt *stmt;
+        if (before != NULL) {
+            stmt = room != NULL ? reader->stmt_list_room_messages_before : reader->stmt_list_messages_before;
+        } else if (after != NULL) {
+            stmt = room != NULL ? reader->stmt_list_room_messages_after : reader->stmt_list_messages_after;
+        } else {
+            stmt = room != NULL ? reader->stmt_list_room_messages : reader->stmt_list_messages;
+        }
+        int param = 1;
+        sqlite3_reset(stmt);
+        if (room != NULL) {
+            sqlite3_bind_text(stmt, param++, room, -1, SQLITE_STATIC);
+        }
+        if (cursor != NULL) {
+            sqlite3_bind_text(stmt, param++, cursor_ts, -1, SQLITE_STATIC);
+            sqlite3_bind_int(stmt, param++, cursor_id);
+        }
+        sqlite3_bind_int(stmt, param++, limit + 1);  // One row past the page shows another follows
+        if (cursor == NULL) {
+            sqlite3_bind_int(stmt, param++, offset);
         }
-        first = false;
         
-        int id = sqlite3_column_int(g_db_ctx.stmt_list_messages, 0);
-        const char *username = (const char*)sqlite3_column_text(g_db_ctx.stmt_list_messages, 1);
-        const char *message = (const char*)sqlite3_column_text(g_db_ctx.stmt_list_messages, 2);
-        const char *created_at = (const char*)sqlite3_column_text(g_db_ctx.stmt_list_messages, 3);
+        // Build JSON response, escaping each row straight into the buffer
+        json_writer_t json;
+        json_writer_init(&json, out);
+        json_begin_object(&json);
+        json_key(&json, "messages");
+        json_begin_array(&json);
+        char next_cursor[MAX_CURSOR_LEN + 16] = "";
+        int count = 0;
+        bool more = false;
         
-        char message_json[4096];
-        snprintf(message_json, sizeof(message_json),
-                "{\"id\":%d,\"username\":\"%s\",\"message\":\"%s\",\"created_at\":\"%s\"}",
-                id, username ? username : "", message ? message : "", created_at ? created_at : "");
+        while (timed_step(stmt) == SQLITE_ROW) {
+            if (count++ == limit) {
+                more = true;
+                break;
+            }
+            int id = sqlite3_column_int(stmt, 0);
+            const char *username = (const char*)sqlite3_column_text(stmt, 1);
+            const char *message = (const char*)sqlite3_column_text(stmt, 2);
+            const char *created_at = (const char*)sqlite3_column_text(stmt, 3);
+            const char *message_room = (const char*)sqlite3_column_text(stmt, 4);
+            
+            json_begin_object(&json);
+            json_field_int(&json, "id", id);
+            json_field_string(&json, "room", message_room);
+            json_field_string(&json, "username", username);
+            json_field_string(&json, "message", message);
+            json_field_string(&json, "created_at", created_at);
+            json_end_object(&json);
+            snprintf(next_cursor, sizeof(next_cursor), "%s,%d", created_at ? created_at : "", id);
+        }
         
-        strcat(out_json, message_json);
+        json_end_array(&json);
+        if (more) {
+            json_field_string(&json, "next_cursor", next_cursor);
+        }
+        json_end_object(&json);
+        sqlite3_reset(stmt);  // End the read transaction
+        reader_checkin(reader, &g_chat_lock);
+        
+        if (json_writer_finish(&json) != 0) {
+            LOG_ERROR("Out of memory building message page\n");
+            return -1;
+        }
     }
     
-    strcat(out_json, "]}");
+    // Log the read operation
+    char current_holder[MAX_USERNAME_LEN];
+    int semaphore_value;
+    get_semaphore_status(room, current_holder, &semaphore_value);
+    char log_content[256];
+    if (cursor != NULL) {
+        snprintf(log_content, sizeof(log_content), "Listed messages in %s%s%s (%s %.64s, limit %d)",
+                 room ? "room '" : "all rooms", room ? room : "", room ? "'" : "",
+                 before != NULL ? "before" : "after", cursor, limit);
+    } else {
+        snprintf(log_content, sizeof(log_content), "Listed messages in %s%s%s (page %d, limit %d)",
+                 room ? "room '" : "all rooms", room ? room : "", room ? "'" : "", page, limit);
+    }
+    log_transaction("READ", NULL, log_content, semaphore_value);
+    
+    LOG_DEBUG("%s\n", log_content);
+    return 0;
+}
+
+// FTS5 query for the words of a search: each one quoted, all required. A
+// word cut at SEARCH_MAX_TERM_LEN matches as a prefix.
+static void build_match_query(const char *query, char *match, size_t size) {
+    char terms[SEARCH_MAX_QUERY_TERMS][SEARCH_MAX_TERM_LEN + 1];
+    int count = search_query_terms(query, terms);
+    size_t used = 0;
+    match[0] = '\0';
+    for (int i = 0; i < count; i++) {
+        int written = snprintf(match + used, size - used, "%s\"%s\"%s", i > 0 ? " " : "", terms[i],
+                               strlen(terms[i]) == SEARCH_MAX_TERM_LEN ? "*" : "");
+        if (written < 0 || (size_t)written >= size - used) {
+            break;
+        }
+        used += (size_t)written;
+    }
+}
+
+// Ranked full-text search over the FTS5 index, paged by offset. Until the
+// backfill finishes, older messages may be missing ("complete" is false).
+static int sqlite_search_messages(const char *room, const char *query, int page, int limit, strbuf_t *out) {
+    if (!g_db_initialized) {
+        LOG_ERROR("Database not initialized\n");
+        return -1;
+    }
+    if (!g_search_available) {
+        return -3;  // No FTS5 in this SQLite
+    }
+    
+    char match[SEARCH_MAX_QUERY_TERMS * (SEARCH_MAX_TERM_LEN + 4) + 1];
+    build_match_query(query, match, sizeof(match));
+    int offset = (page - 1) * limit;
+    
+    db_reader_t *reader = reader_checkout(&g_chat_lock);
+    sqlite3_stmt *stmt = reader->stmt_search_messages;
+    sqlite3_reset(stmt);
+    sqlite3_bind_text(stmt, 1, match, -1, SQLITE_STATIC);
+    if (room != NULL) {
+        sqlite3_bind_text(stmt, 2, room, -1, SQLITE_STATIC);
+    } else {
+        sqlite3_bind_null(stmt, 2);
+    }
+    sqlite3_bind_int(stmt, 3, limit);
+    sqlite3_bind_int(stmt, 4, offset);
+    
+    json_writer_t json;
+    json_writer_init(&json, out);
+    json_begin_object(&json);
+    json_field_string(&json, "query", query);
+    
+    // The total comes with the rows, so the hits are written into a
+    // scratch buffer and placed after it
+    strbuf_t rows;
+    strbuf_init_arena(&rows, request_arena());
+    json_writer_t hits;
+    json_writer_init(&hits, &rows);
+    json_begin_array(&hits);
+    long long total = -1;
+    int step;
+    while ((step = timed_step(stmt)) == SQLITE_ROW) {
+        json_begin_object(&hits);
+        json_field_int(&hits, "id", sqlite3_column_int(stmt, 0));
+        json_field_string(&hits, "room", (const char *)sqlite3_column_text(stmt, 4));
+        json_field_string(&hits, "username", (const char *)sqlite3_column_text(stmt, 1));
+        json_field_string(&hits, "message", (const char *)sqlite3_column_text(stmt, 2));
+        json_field_string(&hits, "created_at", (const char *)sqlite3_column_text(stmt, 3));
+        json_field_double(&hits, "score", sqlite3_column_double(stmt, 5));
+        json_end_object(&hits);
+        total = sqlite3_column_int64(stmt, 6);
+    }
+    json_end_array(&hits);
+    sqlite3_reset(stmt);
+    
+    // Past the last hit: count on its own
+    if (step == SQLITE_DONE && total < 0) {
+        total = 0;
+        if (offset > 0) {
+            sqlite3_stmt *count = reader->stmt_count_search_messages;
+            sqlite3_reset(count);
+            sqlite3_bind_text(count, 1, match, -1, SQLITE_STATIC);
+            if (room != NULL) {
+                sqlite3_bind_text(count, 2, room, -1, SQLITE_STATIC);
+            } else {
+                sqlite3_bind_null(count, 2);
+            }
+            step = timed_step(count);
+            if (step == SQLITE_ROW) {
+                total = sqlite3_column_int64(count, 0);
+                step = SQLITE_DONE;
+            }
+            sqlite3_reset(count);
+        }
+    }
+    if (step != SQLITE_DONE) {
+        LOG_ERROR("Failed to search messages: %s\n", sqlite3_errmsg(reader->chat_db));
+    }
+    reader_checkin(reader, &g_chat_lock);
+    if (step != SQLITE_DONE) {
+        strbuf_free(&rows);
+        return -5;
+    }
+    
+    json_field_int(&json, "total", total);
+    json_field_int(&json, "page", page);
+    json_field_int(&json, "limit", limit);
+    json_field_bool(&json, "complete", atomic_u32_load(&g_search_complete) != 0);
+    json_key(&json, "hits");
+    int finished = json_writer_finish(&hits);
+    if (finished == 0) {
+        json_raw(&json, rows.data, rows.len);
+    }
+    json_end_object(&json);
+    strbuf_free(&rows);
+    if (finished != 0 || json_writer_finish(&json) != 0) {
+        LOG_ERROR("Out of memory building search results\n");
+        return -1;
+    }
     
     // Log the read operation
     char current_holder[MAX_USERNAME_LEN];
     int semaphore_value;
-    get_semaphore_status(current_holder, &semaphore_value);
+    get_semaphore_status(room, current_holder, &semaphore_value);
     char log_content[256];
-    snprintf(log_content, sizeof(log_content), "Listed messages (page %d, limit %d)", page, limit);
+    snprintf(log_content, sizeof(log_content), "Searched messages in %s%s%s (page %d, limit %d)",
+             room ? "room '" : "all rooms", room ? room : "", room ? "'" : "", page, limit);
     log_transaction("READ", NULL, log_content, semaphore_value);
     
-    printf("Listed messages (page %d, limit %d)\n", page, limit);
+    LOG_DEBUG("%s: %lld hits\n", log_content, total);
+    return 0;
+}
+
+// Changes after since, oldest first. One row past the page is read to
+// tell whether another page follows.
+static int sqlite_get_changes(const char *room, long long since, int limit, strbuf_t *out) {
+    if (!g_db_initialized) {
+        LOG_ERROR("Database not initialized\n");
+        return -1;
+    }
+    
+    db_reader_t *reader = reader_checkout(&g_chat_lock);
+    sqlite3_stmt *stmt = reader->stmt_list_changes;
+    sqlite3_reset(stmt);
+    sqlite3_bind_int64(stmt, 1, since);
+    if (room != NULL) {
+        sqlite3_bind_text(stmt, 2, room, -1, SQLITE_STATIC);
+    } else {
+        sqlite3_bind_null(stmt, 2);
+    }
+    sqlite3_bind_int(stmt, 3, limit + 1);
+    
+    json_writer_t json;
+    json_writer_init(&json, out);
+    json_begin_object(&json);
+    json_key(&json, "changes");
+    json_begin_array(&json);
+    
+    long long next_since = since;
+    int count = 0;
+    bool has_more = false;
+    int step;
+    while ((step = timed_step(stmt)) == SQLITE_ROW) {
+        if (count == limit) {
+            has_more = true;
+            break;
+        }
+        next_since = sqlite3_column_int64(stmt, 0);
+        const char *username = (const char *)sqlite3_column_text(stmt, 3);
+        
+        json_begin_object(&json);
+        json_field_int(&json, "seq", next_since);
+        json_field_string(&json, "op", username != NULL ? "upsert" : "delete");
+        json_field_int(&json, "id", sqlite3_column_int(stmt, 1));
+        json_field_string(&json, "room", (const char *)sqlite3_column_text(stmt, 2));
+        if (username != NULL) {
+            json_field_string(&json, "username", username);
+            json_field_string(&json, "message", (const char *)sqlite3_column_text(stmt, 4));
+            json_field_string(&json, "created_at", (const char *)sqlite3_column_text(stmt, 5));
+        } else {
+            json_field_string(&json, "deleted_at", (const char *)sqlite3_column_text(stmt, 5));
+        }
+        json_end_object(&json);
+        count++;
+    }
+    if (step != SQLITE_ROW && step != SQLITE_DONE) {
+        LOG_ERROR("Failed to read changes: %s\n", sqlite3_errmsg(reader->chat_db));
+    }
+    sqlite3_reset(stmt);  // End the read transaction
+    reader_checkin(reader, &g_chat_lock);
+    
+    json_end_array(&json);
+    json_field_int(&json, "next_since", next_since);
+    json_field_bool(&json, "has_more", has_more);
+    json_end_object(&json);
+    
+    if (step != SQLITE_ROW && step != SQLITE_DONE) {
+        return -5;
+    }
+    if (json_writer_finish(&json) != 0) {
+        LOG_ERROR("Out of memory building change page\n");
+        return -1;
+    }
+    
+    LOG_DEBUG("Listed %d changes since %lld\n", count, since);
     return 0;
 }
 
 // Insert log entry
-int insert_log_entry(const char *action, const char *user, const char *content, int semaphore_value) {
+static int sqlite_insert_log_entry(const char *action, const char *user, const char *content, int semaphore_value) {
     if (!g_db_initialized) {
-        fprintf(stderr, "Database not initialized\n");
+        LOG_ERROR("Database not initialized\n");
         return -1;
     }
     
     if (action == NULL) {
-        fprintf(stderr, "Invalid action for log entry\n");
+        LOG_ERROR("Invalid action for log entry\n");
         return -4;
     }
     
-    // Generate timestamp
-    char timestamp[MAX_TIMESTAMP_LEN];
-    get_current_timestamp(timestamp, sizeof(timestamp));
+    mutex_lock(&g_logs_lock);
+    int result = insert_log_row(time(NULL), action, user, content, semaphore_value);
+    mutex_unlock(&g_logs_lock);
     
-    // Bind parameters
-    sqlite3_reset(g_db_ctx.stmt_insert_log);
-    sqlite3_bind_text(g_db_ctx.stmt_insert_log, 1, timestamp, -1, SQLITE_STATIC);
-    sqlite3_bind_text(g_db_ctx.stmt_insert_log, 2, action, -1, SQLITE_STATIC);
-    sqlite3_bind_text(g_db_ctx.stmt_insert_log, 3, user, -1, SQLITE_STATIC);
-    sqlite3_bind_text(g_db_ctx.stmt_insert_log, 4, content, -1, SQLITE_STATIC);
-    sqlite3_bind_int(g_db_ctx.stmt_insert_log, 5, semaphore_value);
+    return result;
+}
+
+// Insert a batch of log entries in one transaction, so the whole batch
+// costs one commit (and one fsync) rather than one per record. A row that
+// fails its constraints is reported and skipped; the rest still commit.
+static int sqlite_insert_log_entries(const log_entry_t *entries, int count) {
+    if (!g_db_initialized) {
+        LOG_ERROR("Database not initialized\n");
+        return -1;
+    }
     
-    // Execute statement
-    int result = sqlite3_step(g_db_ctx.stmt_insert_log);
-    if (result != SQLITE_DONE) {
-        fprintf(stderr, "Failed to insert log entry: %s\n", sqlite3_errmsg(g_db_ctx.logs_db));
-        return -5;  // Database error
+    if (entries == NULL || count < 0) {
+        LOG_ERROR("Invalid parameters for insert_log_entries\n");
+        return -4;
     }
     
-    return 0;
+    if (count == 0) {
+        return 0;
+    }
+    
+    mutex_lock(&g_logs_lock);
+    if (sqlite3_exec(g_db_ctx.logs_db, "BEGIN", NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_ERROR("Failed to begin log batch: %s\n", sqlite3_errmsg(g_db_ctx.logs_db));
+        mutex_unlock(&g_logs_lock);
+        return -5;
+    }
+    
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        const log_entry_t *entry = &entries[i];
+        if (entry->action == NULL ||
+            insert_log_row(entry->when, entry->action, entry->user, entry->content,
+                           entry->semaphore_value) != 0) {
+            failed++;
+        }
+    }
+    
+    if (sqlite3_exec(g_db_ctx.logs_db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_ERROR("Failed to commit log batch: %s\n", sqlite3_errmsg(g_db_ctx.logs_db));
+        sqlite3_exec(g_db_ctx.logs_db, "ROLLBACK", NULL, NULL, NULL);
+        g_insert_day = 0;  // A partition created in this batch is gone again
+        mutex_unlock(&g_logs_lock);
+        return -5;
+    }
+    mutex_unlock(&g_logs_lock);
+    
+    return failed > 0 ? -5 : 0;
 }
 
-// Get logs with pagination
-int get_logs(int page, int limit, char *out_json) {
+// Get logs with pagination, appended to out; cursors work as in list_messages()
+static int sqlite_get_logs(int page, int limit, const char *before, const char *after, strbuf_t *out) {
     if (!g_db_initialized) {
-        fprintf(stderr, "Database not initialized\n");
+        LOG_ERROR("Database not initialized\n");
         return -1;
     }
     
-    if (out_json == NULL) {
-        fprintf(stderr, "Invalid parameters for get_logs\n");
+    if (out == NULL) {
+        LOG_ERROR("Invalid parameters for get_logs\n");
         return -4;
     }
     
     if (page < 1 || limit < 1 || limit > 100) {
-        fprintf(stderr, "Invalid page or limit parameters\n");
+        LOG_DEBUG("Invalid page or limit parameters\n");
         return -4;
     }
     
-    int offset = (page - 1) * limit;
-    
-    // Bind parameters
-    sqlite3_reset(g_db_ctx.stmt_get_logs);
-    sqlite3_bind_int(g_db_ctx.stmt_get_logs, 1, limit);
-    sqlite3_bind_int(g_db_ctx.stmt_get_logs, 2, offset);
+    const char *cursor;
+    char cursor_ts[MAX_CURSOR_LEN];
+    int cursor_id = 0;
+    if (read_page_cursors(before, after, &cursor, cursor_ts, sizeof(cursor_ts), &cursor_id) != 0) {
+        LOG_DEBUG("Invalid paging cursor for get_logs\n");
+        return -4;
+    }
     
-    // Build JSON response
-    strcpy(out_json, "{\"logs\":[");
-    bool first = true;
+    int skip = (page - 1) * limit;
+    int remaining = limit + 1;  // One row past the page shows another follows
+    bool more = false;
+    int *days;
+    int day_count;
+    if (log_days_snapshot(&days, &day_count) != 0) {
+        LOG_ERROR("Out of memory building log page\n");
+        return -1;
+    }
     
-    while (sqlite3_step(g_db_ctx.stmt_get_logs) == SQLITE_ROW) {
-        if (!first) {
-            strcat(out_json, ",");
+    // Walk the partitions in page order. A cursor row lives in its own
+    // day's partition, so days past it in the other direction are never
+    // opened; the days beyond it take every row, which the sentinels
+    // "~" (after any timestamp) and "" (before any) select.
+    bool ascending = after != NULL;
+    int cursor_day = cursor != NULL ? timestamp_day(cursor_ts) : 0;
+    db_reader_t *reader = reader_checkout(&g_logs_lock);
+    
+    // Build JSON response, escaping each row straight into the buffer
+    json_writer_t json;
+    json_writer_init(&json, out);
+    json_begin_object(&json);
+    json_key(&json, "logs");
+    json_begin_array(&json);
+    char next_cursor[MAX_CURSOR_LEN + 16] = "";
+    
+    for (int n = 0; n < day_count && remaining > 0; n++) {
+        int day = ascending ? days[n] : days[day_count - 1 - n];
+        sqlite3_stmt *stmt;
+        if (cursor != NULL) {
+            if (cursor_day != 0 && (ascending ? day < cursor_day : day > cursor_day)) {
+                continue;
+            }
+            stmt = log_statement(reader, day, ascending ? LOG_QUERY_AFTER : LOG_QUERY_BEFORE);
+            if (stmt == NULL) {
+                continue;
+            }
+            bool cursor_partition = cursor_day == 0 || day == cursor_day;
+            sqlite3_bind_text(stmt, 1, cursor_partition ? cursor_ts : ascending ? "" : "~", -1, SQLITE_STATIC);
+            sqlite3_bind_int(stmt, 2, cursor_partition ? cursor_id : 0);
+            sqlite3_bind_int(stmt, 3, remaining);
+        } else {
+            // Whole days inside the offset are counted, not read
+            if (skip > 0) {
+                sqlite3_stmt *count_stmt = log_statement(reader, day, LOG_QUERY_COUNT);
+                int rows = 0;
+                if (count_stmt != NULL && timed_step(count_stmt) == SQLITE_ROW) {
+                    rows = sqlite3_column_int(count_stmt, 0);
+                }
+                if (count_stmt != NULL) {
+                    sqlite3_reset(count_stmt);
+                }
+                if (rows <= skip) {
+                    skip -= rows;
+                    continue;
+                }
+            }
+            stmt = log_statement(reader, day, LOG_QUERY_PAGE);
+            if (stmt == NULL) {
+                continue;
+            }
+            sqlite3_bind_int(stmt, 1, remaining);
+            sqlite3_bind_int(stmt, 2, skip);
+            skip = 0;
         }
-        first = false;
         
-        int id = sqlite3_column_int(g_db_ctx.stmt_get_logs, 0);
-        const char *ts = (const char*)sqlite3_column_text(g_db_ctx.stmt_get_logs, 1);
-        const char *action = (const char*)sqlite3_column_text(g_db_ctx.stmt_get_logs, 2);
-        const char *user = (const char*)sqlite3_column_text(g_db_ctx.stmt_get_logs, 3);
-        const char *content = (const char*)sqlite3_column_text(g_db_ctx.stmt_get_logs, 4);
-        int semaphore_value = sqlite3_column_int(g_db_ctx.stmt_get_logs, 5);
-        
-        char log_json[4096];
-        snprintf(log_json, sizeof(log_json),
-                "{\"id\":%d,\"ts\":\"%s\",\"action\":\"%s\",\"user\":\"%s\",\"content\":\"%s\",\"semaphore\":%d}",
-                id, ts ? ts : "", action ? action : "", user ? user : "", 
-                content ? content : "", semaphore_value);
-        
-        strcat(out_json, log_json);
+        while (timed_step(stmt) == SQLITE_ROW) {
+            if (remaining == 1) {
+                more = true;
+                remaining = 0;
+                break;
+            }
+            int id = sqlite3_column_int(stmt, 0);
+            const char *ts = (const char*)sqlite3_column_text(stmt, 1);
+            const char *action = (const char*)sqlite3_column_text(stmt, 2);
+            const char *user = (const char*)sqlite3_column_text(stmt, 3);
+            const char *content = (const char*)sqlite3_column_text(stmt, 4);
+            int semaphore_value = sqlite3_column_int(stmt, 5);
+            
+            json_begin_object(&json);
+            json_field_int(&json, "id", id);
+            json_field_string(&json, "ts", ts);
+            json_field_string(&json, "action", action);
+            json_field_string(&json, "user", user);
+            json_field_string(&json, "content", content);
+            json_field_int(&json, "semaphore", semaphore_value);
+            json_end_object(&json);
+            snprintf(next_cursor, sizeof(next_cursor), "%s,%d", ts ? ts : "", id);
+            remaining--;
+        }
+        sqlite3_reset(stmt);  // End the read transaction
     }
     
-    strcat(out_json, "]}");
+    json_end_array(&json);
+    if (more) {
+        json_field_string(&json, "next_cursor", next_cursor);
+    }
+    json_end_object(&json);
+    reader_checkin(reader, &g_logs_lock);
+    free(days);
+    
+    if (json_writer_finish(&json) != 0) {
+        LOG_ERROR("Out of memory building log page\n");
+        return -1;
+    }
     
-    printf("Retrieved logs (page %d, limit %d)\n", page, limit);
+    LOG_DEBUG("Retrieved logs (page %d, limit %d)\n", page, limit);
     return 0;
 }
 
 // Cleanup database resources
-void cleanup_databases(void) {
+static void sqlite_cleanup(void) {
     if (!g_db_initialized) {
         return;
     }
     
+    // Background writers stop before the connection they write through
+    if (g_search_backfill_running) {
+        atomic_u32_store(&g_search_backfill_stop, 1);
+        thread_join(g_search_backfill);
+        g_search_backfill_running = false;
+    }
+    
+    // Stop the pruner before the connection it drops partitions on
+    if (g_log_pruner_running) {
+        mutex_lock(&g_log_pruner_lock);
+        g_log_pruner_running = false;
+        cond_signal(&g_log_pruner_cond);
+        mutex_unlock(&g_log_pruner_lock);
+        thread_join(g_log_pruner);
+        cond_destroy(&g_log_pruner_cond);
+        mutex_destroy(&g_log_pruner_lock);
+    }
+    
+    // Every write has returned, so the cache matches what is stored
+    message_cache_save(g_cache_snapshot_path, stored_change_seq(g_db_ctx.chat_db));
+    
+    // Readers first: their connections hold the WAL open too
+    close_reader_pool();
+    
     // Finalize prepared statements
     if (g_db_ctx.stmt_create_message) sqlite3_finalize(g_db_ctx.stmt_create_message);
     if (g_db_ctx.stmt_update_message) sqlite3_finalize(g_db_ctx.stmt_update_message);
     if (g_db_ctx.stmt_delete_message) sqlite3_finalize(g_db_ctx.stmt_delete_message);
-    if (g_db_ctx.stmt_list_messages) sqlite3_finalize(g_db_ctx.stmt_list_messages);
+    if (g_db_ctx.stmt_insert_tombstone) sqlite3_finalize(g_db_ctx.stmt_insert_tombstone);
+    if (g_db_ctx.stmt_search_backfill) sqlite3_finalize(g_db_ctx.stmt_search_backfill);
+    if (g_db_ctx.stmt_search_backfill_advance) sqlite3_finalize(g_db_ctx.stmt_search_backfill_advance);
     if (g_db_ctx.stmt_insert_log) sqlite3_finalize(g_db_ctx.stmt_insert_log);
-    if (g_db_ctx.stmt_get_logs) sqlite3_finalize(g_db_ctx.stmt_get_logs);
+    finalize_read_statements(&g_db_ctx.reads);
     
     // Close databases
     if (g_db_ctx.chat_db) sqlite3_close(g_db_ctx.chat_db);
     if (g_db_ctx.logs_db) sqlite3_close(g_db_ctx.logs_db);
     
+    LOG_INFO("Group commit: %lu writes in %lu commits\n", g_writes_committed, g_groups_committed);
+    LOG_INFO("Audit log: %lu day partitions dropped by retention\n", g_log_days_dropped);
+    message_cache_cleanup();
+    
     // Clear context
     memset(&g_db_ctx, 0, sizeof(g_db_ctx));
+    cond_destroy(&g_group_leader_cond);
+    cond_destroy(&g_group_done_cond);
+    mutex_destroy(&g_chat_lock);
+    mutex_destroy(&g_logs_lock);
+    free(g_log_days);
+    g_log_days = NULL;
+    g_log_day_count = 0;
+    g_log_day_capacity = 0;
+    g_insert_day = 0;
+    mutex_destroy(&g_log_days_lock);
     g_db_initialized = false;
     
-    printf("Database manager cleanup complete\n");
-}
\ No newline at end of file
+    LOG_INFO("Database manager cleanup complete\n");
+}
+
+const storage_backend_t storage_sqlite_backend = {
+    "sqlite",
+    sqlite_configure_commit,
+    sqlite_configure_readers,
+    sqlite_configure_log_retention,
+    sqlite_configure_cache,
+    sqlite_init,
+    sqlite_create_message,
+    sqlite_create_message_batch,
+    sqlite_update_message,
+    sqlite_delete_message,
+    sqlite_list_messages,
+    sqlite_search_messages,
+    sqlite_get_changes,
+    sqlite_get_logs,
+    sqlite_insert_log_entry,
+    sqlite_insert_log_entries,
+    sqlite_cleanup
+};
\ No newline at end of file
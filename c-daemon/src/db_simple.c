@@ -1,5 +1,5 @@
 // Simple File-Based Database Manager Implementation
-// Alternative to SQLite for Windows compatibility
+// Segment-log storage backends: "file" (../data) and "memory" (process only)
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,51 +15,251 @@
     #include <unistd.h>
 #endif
 
-#include "db_simple.h"
+#include "storage.h"
+#include "json_writer.h"
+#include "message_cache.h"
+#include "segment_store.h"
+#include "search_index.h"
 #include "semaphore.h"
+#include "platform.h"
+#include "diag.h"
 
 // Global database context
 static bool g_db_initialized = false;
 static char g_data_dir[256];
-static char g_messages_file[512];
+static char g_messages_file[512];          // Pre-segment text file, imported once
+static char g_segment_file[512];
+static char g_index_file[512];
 static char g_logs_file[512];
+static mutex_t g_file_lock;                // Serializes file access (and strtok) across workers
+static bool g_sync_writes = true;          // synchronous=OFF skips msync() on commit
+static size_t g_prefetch_bytes = (size_t)DB_DEFAULT_MMAP_MB * 1024 * 1024;  // Read ahead at startup
 
-// Generate ISO 8601 timestamp
-void get_current_timestamp(char *timestamp, size_t size) {
-    time_t now = time(NULL);
-    struct tm *utc_tm = gmtime(&now);
-    strftime(timestamp, size, "%Y-%m-%dT%H:%M:%S", utc_tm);
-}
+// Startup search index build over the messages already in the store
+#define SEARCH_BUILD_CHUNK 1000            // Rows indexed per hold of the store lock
+
+static thread_t g_search_builder;
+static bool g_search_builder_started = false;
+static atomic_u32_t g_search_builder_stop;
+
+// Audit rows of the memory backend, oldest first in a ring
+#define MEMORY_LOG_CAPACITY 10000
 
-// Helper function to validate semaphore ownership for write operations
-int validate_semaphore_ownership(const char *username) {
-    char current_holder[MAX_USERNAME_LEN];
+typedef struct {
+    int id;
+    char ts[MAX_TIMESTAMP_LEN];
+    char *action;                  // One allocation holds action, user and content
+    char *user;
+    char *content;
     int semaphore_value;
+} memory_log_t;
+
+static memory_log_t *g_memory_logs = NULL;
+static int g_memory_log_head = 0;          // Slot of the oldest row
+static int g_memory_log_count = 0;
+static int g_memory_log_next_id = 1;
+
+// Longest messages.txt line: timestamp@room|username|message plus newline
+#define MESSAGE_LINE_MAX (MAX_TIMESTAMP_LEN + MAX_ROOM_NAME_LEN + MAX_USERNAME_LEN + MAX_MESSAGE_LEN + 8)
+
+// Group commit is a SQLite concern; the segment store already syncs a
+// batch once. Only synchronous=OFF changes anything: it skips the msync().
+static void simple_configure_commit(int window_ms, const char *synchronous) {
+    (void)window_ms;
+    g_sync_writes = synchronous == NULL || strcmp(synchronous, "OFF") != 0;
+}
+
+// The store is mapped whole, so SQLite's cache sizes mean nothing here; the
+// larger of them is how much of the index and segment is read ahead on open
+static void file_configure_cache(int cache_mb, int mmap_mb) {
+    g_prefetch_bytes = (size_t)(mmap_mb > cache_mb ? mmap_mb : cache_mb) * 1024 * 1024;
+}
+
+// Read the index (which every listing walks) and then the segment into the
+// OS page cache before the store is opened and the first request served
+static void prefetch_store(void) {
+    long long start_ms = monotonic_ms();
+    long long index_bytes = platform_prefetch_file(g_index_file, g_prefetch_bytes);
+    size_t left = index_bytes > 0 ? g_prefetch_bytes - (size_t)index_bytes : g_prefetch_bytes;
+    long long segment_bytes = platform_prefetch_file(g_segment_file, left);
+    if (index_bytes > 0 || segment_bytes > 0) {
+        LOG_INFO("Prefetched %lld KB of the message store in %lld ms\n",
+                 ((index_bytes > 0 ? index_bytes : 0) + (segment_bytes > 0 ? segment_bytes : 0)) / 1024,
+                 monotonic_ms() - start_ms);
+    }
+}
+
+// Split a messages.txt line (timestamp[@room]|username|message) in place;
+// false if the line is malformed
+static bool split_message_line(char *line, const char **timestamp, const char **room,
+                               const char **username, const char **message) {
+    char *ts = strtok(line, "|");
+    *username = strtok(NULL, "|");
+    *message = strtok(NULL, "\n");
+    if (ts == NULL || *username == NULL || *message == NULL) {
+        return false;
+    }
     
-    int status = get_semaphore_status(current_holder, &semaphore_value);
-    if (status != 0) {
-        fprintf(stderr, "Failed to get semaphore status\n");
-        return -1;  // General error
+    *room = SEMAPHORE_DEFAULT_ROOM;
+    char *room_mark = strchr(ts, '@');
+    if (room_mark != NULL) {
+        *room_mark = '\0';
+        *room = room_mark + 1;
+    }
+    *timestamp = ts;
+    return true;
+}
+
+// Move rows from a messages.txt left by an older build into the segment
+// store, then set the file aside so it is imported only once
+static int import_text_messages(void) {
+    FILE *f = fopen(g_messages_file, "r");
+    if (!f) {
+        return 0;
     }
     
-    // Check if semaphore is available (value = 1 means no one holds it)
-    if (semaphore_value == 1) {
-        fprintf(stderr, "No writer currently holds the semaphore\n");
-        return -2;  // Permission denied
+    char line[MESSAGE_LINE_MAX];
+    int imported = 0;
+    while (fgets(line, sizeof(line), f)) {
+        const char *timestamp, *room, *username, *message;
+        int id;
+        if (split_message_line(line, &timestamp, &room, &username, &message) &&
+            segment_store_append(room, username, message, timestamp, &id, NULL) == 0) {
+            imported++;
+        }
     }
+    fclose(f);
     
-    // Check if the requesting user is the current holder
-    if (strcmp(current_holder, username) != 0) {
-        fprintf(stderr, "User '%s' does not hold the semaphore (held by '%s')\n", 
-                username, current_holder);
-        return -2;  // Permission denied
+    if (segment_store_commit() != 0) {
+        return -1;
+    }
+    char imported_file[sizeof(g_messages_file) + 16];
+    snprintf(imported_file, sizeof(imported_file), "%s.imported", g_messages_file);
+    if (platform_replace_file(g_messages_file, imported_file) != 0) {
+        LOG_ERROR("Failed to rename %s after import\n", g_messages_file);
+        return -1;
+    }
+    LOG_INFO("Imported %d messages from %s\n", imported, g_messages_file);
+    return 0;
+}
+
+// Copy a scanned field (not NUL-terminated) into dst
+static const char *copy_field(char *dst, size_t size, const char *src, size_t len) {
+    if (len >= size) {
+        len = size - 1;
+    }
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+    return dst;
+}
+
+typedef struct {
+    int capacity;
+    int rows;
+} cache_warm_t;
+
+static bool warm_row(const segment_row_t *row, void *ctx) {
+    cache_warm_t *warm = ctx;
+    char room[MAX_ROOM_NAME_LEN + 1];
+    char username[MAX_USERNAME_LEN + 1];
+    char message[MAX_MESSAGE_LEN + 1];
+    message_cache_insert(row->id, copy_field(room, sizeof(room), row->room, row->room_len),
+                         copy_field(username, sizeof(username), row->username, row->username_len),
+                         copy_field(message, sizeof(message), row->message, row->message_len),
+                         row->created_at);
+    return ++warm->rows < warm->capacity;
+}
+
+// Warm the message cache with the newest rows
+static int warm_message_cache(void) {
+    if (message_cache_init() != 0) {
+        return -1;
     }
+    cache_warm_t warm = { message_cache_capacity(), 0 };
+    if (warm.capacity == 0) {
+        return 0;
+    }
+    
+    segment_store_scan(SEGMENT_SCAN_NEWEST_FIRST, NULL, 0, warm_row, &warm);
     
-    return 0;  // Ownership validated
+    // A short read means the store holds nothing the cache lacks
+    message_cache_set_complete(warm.rows < warm.capacity);
+    LOG_INFO("Message cache warmed with %d of up to %d rows\n", warm.rows, warm.capacity);
+    return 0;
+}
+
+typedef struct {
+    int rows;
+    bool failed;
+    char cursor_ts[SEGMENT_CREATED_AT_LEN + 1];
+    int cursor_id;
+} search_build_t;
+
+// Index one stored row unless a live write has already indexed its id.
+// Runs under the store lock, so no write can land between the read and the
+// put and leave the older text behind.
+static bool index_row(const segment_row_t *row, void *ctx) {
+    search_build_t *build = ctx;
+    if (search_index_put(row->id, row->room, row->room_len, row->message, row->message_len, false) < 0) {
+        build->failed = true;
+        return false;
+    }
+    copy_field(build->cursor_ts, sizeof(build->cursor_ts), row->created_at, strlen(row->created_at));
+    build->cursor_id = row->id;
+    return ++build->rows < SEARCH_BUILD_CHUNK;
+}
+
+// Index the store oldest first in chunks, letting writers in between
+static void *search_builder_main(void *arg) {
+    (void)arg;
+    search_build_t build = { 0, false, "", 0 };
+    long long indexed = 0;
+    while (atomic_u32_load(&g_search_builder_stop) == 0) {
+        build.rows = 0;
+        int result = segment_store_scan(SEGMENT_SCAN_OLDEST_FIRST, build.cursor_id > 0 ? build.cursor_ts : NULL,
+                                        build.cursor_id, index_row, &build);
+        indexed += build.rows;
+        if (result != 0 || build.failed) {
+            LOG_WARN("Search index build stopped after %lld messages; search stays incomplete\n", indexed);
+            return NULL;
+        }
+        if (build.rows < SEARCH_BUILD_CHUNK) {
+            search_index_set_complete(true);
+            LOG_INFO("Search index built over %lld messages\n", indexed);
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+static void start_search_builder(void) {
+    atomic_u32_store(&g_search_builder_stop, 0);
+    g_search_builder_started = thread_create(&g_search_builder, search_builder_main, NULL) == 0;
+    if (!g_search_builder_started) {
+        LOG_WARN("Failed to start the search index build; search covers new messages only\n");
+    }
 }
 
-// Initialize databases
-int init_databases(const char *chat_db_path, const char *log_db_path) {
+static void stop_search_builder(void) {
+    if (g_search_builder_started) {
+        atomic_u32_store(&g_search_builder_stop, 1);
+        thread_join(g_search_builder);
+        g_search_builder_started = false;
+    }
+}
+
+// Keep the index in step with a stored message (caller holds g_file_lock,
+// so concurrent writes to one id reach the index in store order)
+static void index_message(int id, const char *room, const char *message) {
+    if (search_index_put(id, room, strlen(room), message, strlen(message), true) != 0) {
+        LOG_WARN("Out of memory indexing message %d; search will miss it\n", id);
+    }
+}
+
+// Initialize the file backend: the segment log and logs.txt in ../data
+static int file_init(const char *chat_db_path, const char *log_db_path) {
+    (void)chat_db_path;
+    (void)log_db_path;
     if (g_db_initialized) {
         return 0;  // Already initialized
     }
@@ -70,43 +270,94 @@ int init_databases(const char *chat_db_path, const char *log_db_path) {
     
     // Set up file paths
     snprintf(g_messages_file, sizeof(g_messages_file), "%s/messages.txt", g_data_dir);
+    snprintf(g_segment_file, sizeof(g_segment_file), "%s/messages.seg", g_data_dir);
+    snprintf(g_index_file, sizeof(g_index_file), "%s/messages.idx", g_data_dir);
     snprintf(g_logs_file, sizeof(g_logs_file), "%s/logs.txt", g_data_dir);
     
     // Create files if they don't exist
-    FILE *f = fopen(g_messages_file, "a");
+    FILE *f = fopen(g_logs_file, "a");
     if (f) fclose(f);
     
-    f = fopen(g_logs_file, "a");
-    if (f) fclose(f);
+    prefetch_store();
+    if (search_index_init() != 0 || segment_store_open(g_segment_file, g_index_file, g_sync_writes) != 0) {
+        LOG_ERROR("Failed to open message store\n");
+        search_index_cleanup();
+        return -1;
+    }
     
+    if (import_text_messages() != 0 || warm_message_cache() != 0) {
+        LOG_ERROR("Failed to load messages\n");
+        message_cache_cleanup();
+        search_index_cleanup();
+        segment_store_close();
+        return -1;
+    }
+    
+    mutex_init(&g_file_lock);
     g_db_initialized = true;
-    printf("Simple file-based database manager initialized\n");
-    printf("Messages file: %s\n", g_messages_file);
-    printf("Logs file: %s\n", g_logs_file);
+    start_search_builder();
+    LOG_INFO("Simple file-based database manager initialized\n");
+    LOG_INFO("Messages file: %s (index %s)\n", g_segment_file, g_index_file);
+    LOG_INFO("Logs file: %s\n", g_logs_file);
+    
+    return 0;
+}
+
+// Initialize the memory backend: the same segment log on the heap, and the
+// newest audit rows in a ring. Nothing is written to disk. The message cache
+// is left off, as every read is already served from memory.
+static int memory_init(const char *chat_db_path, const char *log_db_path) {
+    (void)chat_db_path;
+    (void)log_db_path;
+    if (g_db_initialized) {
+        return 0;  // Already initialized
+    }
     
+    g_memory_logs = calloc(MEMORY_LOG_CAPACITY, sizeof(memory_log_t));
+    if (g_memory_logs == NULL || search_index_init() != 0 || segment_store_open(NULL, NULL, false) != 0) {
+        LOG_ERROR("Failed to set up in-memory storage\n");
+        search_index_cleanup();
+        free(g_memory_logs);
+        g_memory_logs = NULL;
+        return -1;
+    }
+    search_index_set_complete(true);       // Nothing stored yet to build from
+    g_memory_log_head = 0;
+    g_memory_log_count = 0;
+    g_memory_log_next_id = 1;
+    
+    mutex_init(&g_file_lock);
+    g_db_initialized = true;
+    LOG_INFO("In-memory database manager initialized (keeps the newest %d audit rows)\n", MEMORY_LOG_CAPACITY);
     return 0;
 }
 
-// Create a new message
-int create_message(const char *username, const char *message, char *out_timestamp) {
+// Create a new message in a room
+static int simple_create_message(const char *room, const char *username, const char *message, char *out_timestamp) {
     if (!g_db_initialized) {
-        fprintf(stderr, "Database not initialized\n");
+        LOG_ERROR("Database not initialized\n");
         return -1;
     }
     
     if (username == NULL || message == NULL || out_timestamp == NULL) {
-        fprintf(stderr, "Invalid parameters for create_message\n");
+        LOG_ERROR("Invalid parameters for create_message\n");
         return -4;
     }
     
     if (strlen(username) == 0 || strlen(username) > MAX_USERNAME_LEN ||
         strlen(message) == 0 || strlen(message) > MAX_MESSAGE_LEN) {
-        fprintf(stderr, "Invalid username or message length\n");
+        LOG_DEBUG("Invalid username or message length\n");
+        return -4;
+    }
+    
+    if (!semaphore_valid_room(room)) {
+        LOG_DEBUG("Invalid room name for create_message\n");
         return -4;
     }
+    room = storage_room_or_default(room);
     
     // Validate semaphore ownership for write operation
-    int ownership_status = validate_semaphore_ownership(username);
+    int ownership_status = validate_semaphore_ownership(room, username);
     if (ownership_status != 0) {
         return ownership_status;  // Return the specific error code
     }
@@ -115,126 +366,416 @@ int create_message(const char *username, const char *message, char *out_timestam
     char timestamp[MAX_TIMESTAMP_LEN];
     get_current_timestamp(timestamp, sizeof(timestamp));
     
-    // Write to messages file
-    FILE *f = fopen(g_messages_file, "a");
-    if (!f) {
-        fprintf(stderr, "Failed to open messages file\n");
+    // Append to the segment and make it durable
+    mutex_lock(&g_file_lock);
+    int id;
+    int result = segment_store_append(room, username, message, timestamp, &id, timestamp);
+    if (result == 0) {
+        result = segment_store_commit();
+    }
+    if (result == 0) {
+        index_message(id, room, message);
+    }
+    mutex_unlock(&g_file_lock);
+    if (result != 0) {
+        LOG_ERROR("Failed to store message\n");
         return -5;  // Database error
     }
-    
-    fprintf(f, "%s|%s|%s\n", timestamp, username, message);
-    fclose(f);
+    message_cache_insert(id, room, username, message, timestamp);
+    storage_publish_created(id, room, username, message, timestamp);
     
     // Copy timestamp to output
     strncpy(out_timestamp, timestamp, MAX_TIMESTAMP_LEN - 1);
     out_timestamp[MAX_TIMESTAMP_LEN - 1] = '\0';
     
     // Log the transaction
-    insert_log_entry("CREATE", username, message, 0);
+    log_transaction("CREATE", username, message, 0);
     
-    printf("Created message by '%s' at %s\n", username, timestamp);
+    LOG_DEBUG("Created message %d by '%s' in room '%s' at %s\n", id, username, room, timestamp);
     return 0;
 }
 
-// Update an existing message (simplified - just append new version)
-int update_message(int id, const char *username, const char *message) {
+// Create count messages in a room with one ownership check and one commit;
+// a failure part way leaves none of them behind
+static int simple_create_message_batch(const char *room, const char *username, const char *const *messages,
+                                       int count, message_ref_t *out_refs) {
     if (!g_db_initialized) {
-        fprintf(stderr, "Database not initialized\n");
+        LOG_ERROR("Database not initialized\n");
         return -1;
     }
     
+    if (username == NULL || messages == NULL || out_refs == NULL ||
+        count < 1 || count > DB_MAX_BATCH_MESSAGES ||
+        strlen(username) == 0 || strlen(username) > MAX_USERNAME_LEN) {
+        LOG_ERROR("Invalid parameters for create_message_batch\n");
+        return -4;
+    }
+    for (int i = 0; i < count; i++) {
+        if (messages[i] == NULL || strlen(messages[i]) == 0 || strlen(messages[i]) > MAX_MESSAGE_LEN) {
+            LOG_DEBUG("Invalid message %d of batch\n", i);
+            return -4;
+        }
+    }
+    
+    if (!semaphore_valid_room(room)) {
+        LOG_DEBUG("Invalid room name for create_message_batch\n");
+        return -4;
+    }
+    room = storage_room_or_default(room);
+    
+    int ownership_status = validate_semaphore_ownership(room, username);
+    if (ownership_status != 0) {
+        return ownership_status;
+    }
+    
+    char timestamp[MAX_TIMESTAMP_LEN];
+    get_current_timestamp(timestamp, sizeof(timestamp));
+    
+    mutex_lock(&g_file_lock);
+    int result = 0;
+    for (int i = 0; i < count && result == 0; i++) {
+        int id;
+        result = segment_store_append(room, username, messages[i], timestamp, &id, out_refs[i].timestamp);
+        out_refs[i].id = id;
+    }
+    if (result == 0) {
+        result = segment_store_commit();
+    } else {
+        segment_store_rollback();
+    }
+    for (int i = 0; i < count && result == 0; i++) {
+        index_message((int)out_refs[i].id, room, messages[i]);
+    }
+    mutex_unlock(&g_file_lock);
+    if (result != 0) {
+        LOG_ERROR("Failed to store message batch\n");
+        return -5;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        message_cache_insert((int)out_refs[i].id, room, username, messages[i], out_refs[i].timestamp);
+        storage_publish_created(out_refs[i].id, room, username, messages[i], out_refs[i].timestamp);
+        log_transaction("CREATE", username, messages[i], 0);
+    }
+    
+    LOG_DEBUG("Created %d messages by '%s' in room '%s' at %s\n", count, username, room, timestamp);
+    return 0;
+}
+
+// Update an existing message: the new text is appended as a fresh version
+// of the id, which keeps its place in the listing
+static int simple_update_message(const char *room, int id, const char *username, const char *message) {
+    if (!g_db_initialized) {
+        LOG_ERROR("Database not initialized\n");
+        return -1;
+    }
+    
+    if (username == NULL || message == NULL) {
+        LOG_ERROR("Invalid parameters for update_message\n");
+        return -4;
+    }
+    
+    if (strlen(username) == 0 || strlen(username) > MAX_USERNAME_LEN ||
+        strlen(message) == 0 || strlen(message) > MAX_MESSAGE_LEN) {
+        LOG_DEBUG("Invalid username or message length\n");
+        return -4;
+    }
+    
+    if (!semaphore_valid_room(room)) {
+        LOG_DEBUG("Invalid room name for update_message\n");
+        return -4;
+    }
+    room = storage_room_or_default(room);
+    
     // Validate semaphore ownership for write operation
-    int ownership_status = validate_semaphore_ownership(username);
+    int ownership_status = validate_semaphore_ownership(room, username);
     if (ownership_status != 0) {
         return ownership_status;
     }
     
-    // For simplicity, just create a new message with update prefix
-    char updated_message[MAX_MESSAGE_LEN + 50];
-    snprintf(updated_message, sizeof(updated_message), "[UPDATED ID:%d] %s", id, message);
+    mutex_lock(&g_file_lock);
+    int result = segment_store_update(id, room, username, message);
+    if (result == 0) {
+        index_message(id, room, message);
+    }
+    mutex_unlock(&g_file_lock);
+    if (result == -2) {
+        LOG_DEBUG("No message found with id %d for user '%s' in room '%s'\n", id, username, room);
+        return -2;  // Permission denied (message not found or not owned)
+    }
+    if (result != 0) {
+        return -5;  // Database error
+    }
+    
+    message_cache_update(id, message);
+    storage_publish_updated(id, room, username, message);
     
-    char timestamp[MAX_TIMESTAMP_LEN];
-    return create_message(username, updated_message, timestamp);
+    // Log the transaction
+    char log_content[256];
+    snprintf(log_content, sizeof(log_content), "Updated message ID %d in room '%s'", id, room);
+    log_transaction("UPDATE", username, log_content, 0);
+    
+    LOG_DEBUG("Updated message %d by '%s' in room '%s'\n", id, username, room);
+    return 0;
 }
 
-// Delete a message (simplified - just log the deletion)
-int delete_message(int id, const char *username) {
+// Delete a message by appending a tombstone for its id
+static int simple_delete_message(const char *room, int id, const char *username) {
     if (!g_db_initialized) {
-        fprintf(stderr, "Database not initialized\n");
+        LOG_ERROR("Database not initialized\n");
         return -1;
     }
     
+    if (username == NULL || strlen(username) == 0 || strlen(username) > MAX_USERNAME_LEN) {
+        LOG_ERROR("Invalid parameters for delete_message\n");
+        return -4;
+    }
+    
+    if (!semaphore_valid_room(room)) {
+        LOG_DEBUG("Invalid room name for delete_message\n");
+        return -4;
+    }
+    room = storage_room_or_default(room);
+    
     // Validate semaphore ownership for write operation
-    int ownership_status = validate_semaphore_ownership(username);
+    int ownership_status = validate_semaphore_ownership(room, username);
     if (ownership_status != 0) {
         return ownership_status;
     }
     
+    mutex_lock(&g_file_lock);
+    int result = segment_store_delete(id, room, username);
+    if (result == 0) {
+        search_index_remove(id);
+    }
+    mutex_unlock(&g_file_lock);
+    if (result == -2) {
+        LOG_DEBUG("No message found with id %d for user '%s' in room '%s'\n", id, username, room);
+        return -2;  // Permission denied (message not found or not owned)
+    }
+    if (result != 0) {
+        return -5;  // Database error
+    }
+    
+    message_cache_remove(id);
+    storage_publish_deleted(id, room, username);
+    
     // Log the deletion
     char log_content[256];
-    snprintf(log_content, sizeof(log_content), "Deleted message ID %d", id);
-    insert_log_entry("DELETE", username, log_content, 0);
+    snprintf(log_content, sizeof(log_content), "Deleted message ID %d in room '%s'", id, room);
+    log_transaction("DELETE", username, log_content, 0);
     
-    printf("Deleted message %d by '%s'\n", id, username);
+    LOG_DEBUG("Deleted message %d by '%s' in room '%s'\n", id, username, room);
     return 0;
 }
 
-// List messages with pagination (simplified - return last N messages)
-int list_messages(int page, int limit, char *out_json) {
+// Whether a log line lies past the cursor, in the order db.c pages in
+// (timestamp descending, ties by ascending id). Ids here are line numbers.
+static bool row_after_cursor(const char *ts, int id, int direction, const char *cursor_ts, int cursor_id) {
+    int order = strcmp(ts, cursor_ts);
+    if (direction < 0) {
+        return order < 0 || (order == 0 && id > cursor_id);
+    }
+    return order > 0 || (order == 0 && id < cursor_id);
+}
+
+typedef struct {
+    const char *room;              // NULL for every room
+    long skip;                     // Rows still to pass over (OFFSET)
+    int limit;
+    int count;
+    bool more;                     // A row past the page was seen
+    json_writer_t *json;
+    char next_cursor[MAX_CURSOR_LEN + 16];
+} message_page_t;
+
+static bool page_row(const segment_row_t *row, void *ctx) {
+    message_page_t *page = ctx;
+    if (page->room != NULL &&
+        (row->room_len != strlen(page->room) || memcmp(row->room, page->room, row->room_len) != 0)) {
+        return true;
+    }
+    if (page->skip > 0) {
+        page->skip--;
+        return true;
+    }
+    if (page->count == page->limit) {
+        page->more = true;
+        return false;
+    }
+    
+    char room[MAX_ROOM_NAME_LEN + 1];
+    char username[MAX_USERNAME_LEN + 1];
+    char message[MAX_MESSAGE_LEN + 1];
+    json_begin_object(page->json);
+    json_field_int(page->json, "id", row->id);
+    json_field_string(page->json, "room", copy_field(room, sizeof(room), row->room, row->room_len));
+    json_field_string(page->json, "username",
+                      copy_field(username, sizeof(username), row->username, row->username_len));
+    json_field_string(page->json, "message",
+                      copy_field(message, sizeof(message), row->message, row->message_len));
+    json_field_string(page->json, "created_at", row->created_at);
+    json_end_object(page->json);
+    snprintf(page->next_cursor, sizeof(page->next_cursor), "%s,%d", row->created_at, row->id);
+    page->count++;
+    return true;
+}
+
+// List messages with pagination, from one room or (room NULL) every room, in
+// the same order and cursor format as db.c. A cursor is found in the index
+// by binary search, so a page costs O(limit) rows however deep it is.
+static int simple_list_messages(const char *room, int page, int limit, const char *before, const char *after,
+                                strbuf_t *out) {
     if (!g_db_initialized) {
-        fprintf(stderr, "Database not initialized\n");
+        LOG_ERROR("Database not initialized\n");
         return -1;
     }
     
-    if (out_json == NULL) {
-        fprintf(stderr, "Invalid parameters for list_messages\n");
+    if (out == NULL) {
+        LOG_ERROR("Invalid parameters for list_messages\n");
         return -4;
     }
     
-    FILE *f = fopen(g_messages_file, "r");
-    if (!f) {
-        strcpy(out_json, "{\"messages\":[]}");
-        return 0;
+    if (page < 1 || limit < 1 || limit > 100) {
+        LOG_DEBUG("Invalid page or limit parameters\n");
+        return -4;
     }
     
-    // Simple implementation - just return a few recent messages
-    strcpy(out_json, "{\"messages\":[");
+    if (room != NULL && (room[0] == '\0' || !semaphore_valid_room(room))) {
+        LOG_DEBUG("Invalid room name for list_messages\n");
+        return -4;
+    }
     
-    char line[2048];
-    int count = 0;
-    bool first = true;
+    const char *cursor = before != NULL ? before : after;
+    char cursor_ts[MAX_CURSOR_LEN];
+    int cursor_id = 0;
+    if ((before != NULL && after != NULL) ||
+        (cursor != NULL && storage_parse_page_cursor(cursor, cursor_ts, sizeof(cursor_ts), &cursor_id) != 0)) {
+        LOG_DEBUG("Invalid paging cursor for list_messages\n");
+        return -4;
+    }
     
-    while (fgets(line, sizeof(line), f) && count < limit) {
-        // Parse line: timestamp|username|message
-        char *timestamp = strtok(line, "|");
-        char *username = strtok(NULL, "|");
-        char *message = strtok(NULL, "\n");
-        
-        if (timestamp && username && message) {
-            if (!first) {
-                strcat(out_json, ",");
-            }
-            first = false;
-            
-            char message_json[4096];
-            snprintf(message_json, sizeof(message_json),
-                    "{\"id\":%d,\"username\":\"%s\",\"message\":\"%s\",\"created_at\":\"%s\"}",
-                    count + 1, username, message, timestamp);
-            
-            strcat(out_json, message_json);
-            count++;
+    // Page requests are answered newest first from the cache when it covers them
+    if (cursor == NULL) {
+        int cache_result = message_cache_page(room, page, limit, out);
+        if (cache_result <= 0) {
+            LOG_DEBUG("Listed messages (page %d, limit %d)\n", page, limit);
+            return cache_result;
         }
     }
     
-    strcat(out_json, "]}");
-    fclose(f);
+    json_writer_t json;
+    json_writer_init(&json, out);
+    json_begin_object(&json);
+    json_key(&json, "messages");
+    json_begin_array(&json);
+    
+    // "before" continues the newest-first order; "after" returns newer rows oldest first
+    message_page_t rows = { room, cursor == NULL ? (long)(page - 1) * limit : 0, limit, 0, false, &json, "" };
+    mutex_lock(&g_file_lock);
+    int result = segment_store_scan(after != NULL ? SEGMENT_SCAN_OLDEST_FIRST : SEGMENT_SCAN_NEWEST_FIRST,
+                                    cursor != NULL ? cursor_ts : NULL, cursor_id, page_row, &rows);
+    mutex_unlock(&g_file_lock);
     
-    printf("Listed messages (page %d, limit %d)\n", page, limit);
+    json_end_array(&json);
+    if (rows.more) {
+        json_field_string(&json, "next_cursor", rows.next_cursor);
+    }
+    json_end_object(&json);
+    
+    if (result != 0) {
+        return -5;
+    }
+    if (json_writer_finish(&json) != 0) {
+        return -1;
+    }
+    
+    LOG_DEBUG("Listed messages (page %d, limit %d)\n", page, limit);
+    return 0;
+}
+
+typedef struct {
+    const search_hit_t *hits;
+    int count;
+    int next;                      // Fetched rows come in hit order, minus any deleted since
+    json_writer_t *json;
+} search_page_t;
+
+static bool search_row(const segment_row_t *row, void *ctx) {
+    search_page_t *page = ctx;
+    while (page->next < page->count && page->hits[page->next].id != row->id) {
+        page->next++;
+    }
+    double score = page->next < page->count ? page->hits[page->next++].score : 0.0;
+    
+    char room[MAX_ROOM_NAME_LEN + 1];
+    char username[MAX_USERNAME_LEN + 1];
+    char message[MAX_MESSAGE_LEN + 1];
+    json_begin_object(page->json);
+    json_field_int(page->json, "id", row->id);
+    json_field_string(page->json, "room", copy_field(room, sizeof(room), row->room, row->room_len));
+    json_field_string(page->json, "username",
+                      copy_field(username, sizeof(username), row->username, row->username_len));
+    json_field_string(page->json, "message",
+                      copy_field(message, sizeof(message), row->message, row->message_len));
+    json_field_string(page->json, "created_at", row->created_at);
+    json_field_double(page->json, "score", score);
+    json_end_object(page->json);
+    return true;
+}
+
+// Ranked search from the in-memory index; the rows of the page's hits are
+// then read from the store by id
+static int simple_search_messages(const char *room, const char *query, int page, int limit, strbuf_t *out) {
+    if (!g_db_initialized) {
+        LOG_ERROR("Database not initialized\n");
+        return -1;
+    }
+    
+    search_hit_t hits[100];
+    int count = 0;
+    int total = 0;
+    int result = search_index_query(room, query, (page - 1) * limit, limit, hits, &count, &total);
+    if (result != 0) {
+        return result;
+    }
+    int ids[100];
+    for (int i = 0; i < count; i++) {
+        ids[i] = hits[i].id;
+    }
+    
+    json_writer_t json;
+    json_writer_init(&json, out);
+    json_begin_object(&json);
+    json_field_string(&json, "query", query);
+    json_field_int(&json, "total", total);
+    json_field_int(&json, "page", page);
+    json_field_int(&json, "limit", limit);
+    json_field_bool(&json, "complete", search_index_complete());
+    json_key(&json, "hits");
+    json_begin_array(&json);
+    
+    search_page_t rows = { hits, count, 0, &json };
+    mutex_lock(&g_file_lock);
+    result = segment_store_fetch(ids, count, search_row, &rows);
+    mutex_unlock(&g_file_lock);
+    
+    json_end_array(&json);
+    json_end_object(&json);
+    
+    if (result != 0) {
+        return -5;
+    }
+    if (json_writer_finish(&json) != 0) {
+        return -1;
+    }
+    
+    LOG_DEBUG("Searched messages (page %d, limit %d, %d of %d hits)\n", page, limit, count, total);
     return 0;
 }
 
 // Insert log entry
-int insert_log_entry(const char *action, const char *user, const char *content, int semaphore_value) {
+static int file_insert_log_entry(const char *action, const char *user, const char *content, int semaphore_value) {
     if (!g_db_initialized) {
         return -1;
     }
@@ -248,8 +789,10 @@ int insert_log_entry(const char *action, const char *user, const char *content,
     get_current_timestamp(timestamp, sizeof(timestamp));
     
     // Write to logs file
+    mutex_lock(&g_file_lock);
     FILE *f = fopen(g_logs_file, "a");
     if (!f) {
+        mutex_unlock(&g_file_lock);
         return -5;
     }
     
@@ -260,74 +803,449 @@ int insert_log_entry(const char *action, const char *user, const char *content,
             content ? content : "NULL", 
             semaphore_value);
     fclose(f);
+    mutex_unlock(&g_file_lock);
     
     return 0;
 }
 
-// Get logs with pagination
-int get_logs(int page, int limit, char *out_json) {
+// Append a batch of log entries with one open and one write-out
+static int file_insert_log_entries(const log_entry_t *entries, int count) {
     if (!g_db_initialized) {
-        fprintf(stderr, "Database not initialized\n");
         return -1;
     }
     
-    if (out_json == NULL) {
+    if (entries == NULL || count < 0) {
         return -4;
     }
     
-    FILE *f = fopen(g_logs_file, "r");
+    mutex_lock(&g_file_lock);
+    FILE *f = fopen(g_logs_file, "a");
     if (!f) {
-        strcpy(out_json, "{\"logs\":[]}");
-        return 0;
+        mutex_unlock(&g_file_lock);
+        return -5;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        char timestamp[MAX_TIMESTAMP_LEN];
+        struct tm utc_tm;
+        platform_gmtime(entries[i].when, &utc_tm);
+        strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &utc_tm);
+        
+        fprintf(f, "%s|%s|%s|%s|%d\n", 
+                timestamp, 
+                entries[i].action ? entries[i].action : "NULL", 
+                entries[i].user ? entries[i].user : "NULL", 
+                entries[i].content ? entries[i].content : "NULL", 
+                entries[i].semaphore_value);
+    }
+    fclose(f);
+    mutex_unlock(&g_file_lock);
+    
+    return 0;
+}
+
+// One audit line of the logs file, located for a second read
+typedef struct {
+    long offset;                   // Start of the line in the file
+    int id;                        // Line number
+    char ts[MAX_TIMESTAMP_LEN];
+} file_log_row_t;
+
+// Timestamp ascending, ties by descending id: db.c's listing order reversed
+static int compare_file_log_rows(const void *a, const void *b) {
+    const file_log_row_t *x = a;
+    const file_log_row_t *y = b;
+    int order = strcmp(x->ts, y->ts);
+    if (order != 0) {
+        return order;
+    }
+    return x->id < y->id ? 1 : x->id > y->id ? -1 : 0;
+}
+
+// Split a log line into timestamp|action|user|content|semaphore_value in place
+static bool parse_log_line(char *line, char **fields) {
+    fields[0] = strtok(line, "|");
+    fields[1] = strtok(NULL, "|");
+    fields[2] = strtok(NULL, "|");
+    fields[3] = strtok(NULL, "|");
+    fields[4] = strtok(NULL, "\n");
+    return fields[0] && fields[1] && fields[2] && fields[3] && fields[4];
+}
+
+// Get logs with pagination, in db.c's order and cursor format. The file is
+// written oldest first, so the lines past the cursor are indexed and sorted
+// before the page is read back from their offsets.
+static int file_get_logs(int page, int limit, const char *before, const char *after, strbuf_t *out) {
+    if (!g_db_initialized) {
+        LOG_ERROR("Database not initialized\n");
+        return -1;
+    }
+    
+    if (out == NULL) {
+        return -4;
+    }
+    
+    if (page < 1 || limit < 1 || limit > 100) {
+        LOG_DEBUG("Invalid page or limit parameters\n");
+        return -4;
     }
     
-    strcpy(out_json, "{\"logs\":[");
+    const char *cursor = before != NULL ? before : after;
+    int direction = before != NULL ? -1 : 1;
+    char cursor_ts[MAX_CURSOR_LEN];
+    int cursor_id = 0;
+    if ((before != NULL && after != NULL) ||
+        (cursor != NULL && storage_parse_page_cursor(cursor, cursor_ts, sizeof(cursor_ts), &cursor_id) != 0)) {
+        return -4;
+    }
+    
+    mutex_lock(&g_file_lock);
+    FILE *f = fopen(g_logs_file, "r");
+    if (!f) {
+        mutex_unlock(&g_file_lock);
+        return strbuf_append_str(out, "{\"logs\":[]}");
+    }
     
     char line[2048];
-    int count = 0;
-    bool first = true;
-    
-    while (fgets(line, sizeof(line), f) && count < limit) {
-        // Parse line: timestamp|action|user|content|semaphore_value
-        char *timestamp = strtok(line, "|");
-        char *action = strtok(NULL, "|");
-        char *user = strtok(NULL, "|");
-        char *content = strtok(NULL, "|");
-        char *sem_val_str = strtok(NULL, "\n");
-        
-        if (timestamp && action && user && content && sem_val_str) {
-            if (!first) {
-                strcat(out_json, ",");
+    char *fields[5];
+    file_log_row_t *rows = NULL;
+    int row_count = 0;
+    int capacity = 0;
+    int line_number = 0;
+    long offset = ftell(f);
+    
+    while (fgets(line, sizeof(line), f)) {
+        long line_offset = offset;
+        offset = ftell(f);
+        line_number++;
+        if (!parse_log_line(line, fields) ||
+            (cursor != NULL && !row_after_cursor(fields[0], line_number, direction, cursor_ts, cursor_id))) {
+            continue;
+        }
+        if (row_count == capacity) {
+            capacity = capacity == 0 ? 256 : capacity * 2;
+            file_log_row_t *grown = realloc(rows, (size_t)capacity * sizeof(file_log_row_t));
+            if (grown == NULL) {
+                free(rows);
+                fclose(f);
+                mutex_unlock(&g_file_lock);
+                return -1;
             }
-            first = false;
-            
-            int sem_val = atoi(sem_val_str);
-            char log_json[4096];
-            snprintf(log_json, sizeof(log_json),
-                    "{\"id\":%d,\"ts\":\"%s\",\"action\":\"%s\",\"user\":\"%s\",\"content\":\"%s\",\"semaphore\":%d}",
-                    count + 1, timestamp, action, 
-                    strcmp(user, "NULL") == 0 ? "" : user,
-                    strcmp(content, "NULL") == 0 ? "" : content,
-                    sem_val);
-            
-            strcat(out_json, log_json);
-            count++;
+            rows = grown;
+        }
+        file_log_row_t *row = &rows[row_count++];
+        row->offset = line_offset;
+        row->id = line_number;
+        snprintf(row->ts, sizeof(row->ts), "%s", fields[0]);
+    }
+    if (row_count > 0) {
+        qsort(rows, (size_t)row_count, sizeof(file_log_row_t), compare_file_log_rows);
+    }
+    
+    json_writer_t json;
+    json_writer_init(&json, out);
+    json_begin_object(&json);
+    json_key(&json, "logs");
+    json_begin_array(&json);
+    
+    // Rows in page order: "after" oldest first from the front, everything
+    // else newest first from the back, past the offset of earlier pages
+    long skip = cursor == NULL ? (long)(page - 1) * limit : 0;
+    long end = skip + limit < row_count ? skip + limit : row_count;
+    char next_cursor[MAX_CURSOR_LEN + 16] = "";
+    
+    for (long k = skip; k < end; k++) {
+        const file_log_row_t *row = &rows[after != NULL ? k : row_count - 1 - k];
+        if (fseek(f, row->offset, SEEK_SET) != 0 || !fgets(line, sizeof(line), f) ||
+            !parse_log_line(line, fields)) {
+            continue;  // Rewritten since indexing, which g_file_lock rules out
         }
+        json_begin_object(&json);
+        json_field_int(&json, "id", row->id);
+        json_field_string(&json, "ts", fields[0]);
+        json_field_string(&json, "action", fields[1]);
+        json_field_string(&json, "user", strcmp(fields[2], "NULL") == 0 ? "" : fields[2]);
+        json_field_string(&json, "content", strcmp(fields[3], "NULL") == 0 ? "" : fields[3]);
+        json_field_int(&json, "semaphore", atoi(fields[4]));
+        json_end_object(&json);
+        snprintf(next_cursor, sizeof(next_cursor), "%s,%d", row->ts, row->id);
     }
     
-    strcat(out_json, "]}");
+    json_end_array(&json);
+    if (end < row_count && next_cursor[0] != '\0') {
+        json_field_string(&json, "next_cursor", next_cursor);
+    }
+    json_end_object(&json);
     fclose(f);
+    mutex_unlock(&g_file_lock);
+    free(rows);
+    
+    if (json_writer_finish(&json) != 0) {
+        return -1;
+    }
     
-    printf("Retrieved logs (page %d, limit %d)\n", page, limit);
+    LOG_DEBUG("Retrieved logs (page %d, limit %d)\n", page, limit);
     return 0;
 }
 
-// Cleanup database resources
-void cleanup_databases(void) {
+// --- In-memory audit log (memory backend) ---
+
+static memory_log_t *memory_log_at(int position) {
+    return &g_memory_logs[(g_memory_log_head + position) % MEMORY_LOG_CAPACITY];
+}
+
+// Append one row (g_file_lock held), dropping the oldest when the ring is full.
+// Times never go backwards, so the ring stays in listing order.
+static int memory_log_append(const char *ts, const char *action, const char *user, const char *content,
+                             int semaphore_value) {
+    user = user != NULL ? user : "";
+    content = content != NULL ? content : "";
+    size_t action_len = strlen(action) + 1;
+    size_t user_len = strlen(user) + 1;
+    size_t content_len = strlen(content) + 1;
+    char *strings = malloc(action_len + user_len + content_len);
+    if (strings == NULL) {
+        return -5;
+    }
+    
+    if (g_memory_log_count == MEMORY_LOG_CAPACITY) {
+        free(memory_log_at(0)->action);
+        g_memory_log_head = (g_memory_log_head + 1) % MEMORY_LOG_CAPACITY;
+        g_memory_log_count--;
+    }
+    memory_log_t *row = memory_log_at(g_memory_log_count);
+    row->id = g_memory_log_next_id++;
+    strncpy(row->ts, ts, MAX_TIMESTAMP_LEN - 1);
+    row->ts[MAX_TIMESTAMP_LEN - 1] = '\0';
+    if (g_memory_log_count > 0 && strcmp(row->ts, memory_log_at(g_memory_log_count - 1)->ts) < 0) {
+        strcpy(row->ts, memory_log_at(g_memory_log_count - 1)->ts);
+    }
+    row->action = memcpy(strings, action, action_len);
+    row->user = memcpy(strings + action_len, user, user_len);
+    row->content = memcpy(strings + action_len + user_len, content, content_len);
+    row->semaphore_value = semaphore_value;
+    g_memory_log_count++;
+    return 0;
+}
+
+static int memory_insert_log_entry(const char *action, const char *user, const char *content,
+                                   int semaphore_value) {
+    if (!g_db_initialized) {
+        return -1;
+    }
+    
+    if (action == NULL) {
+        return -4;
+    }
+    
+    char timestamp[MAX_TIMESTAMP_LEN];
+    get_current_timestamp(timestamp, sizeof(timestamp));
+    
+    mutex_lock(&g_file_lock);
+    int result = memory_log_append(timestamp, action, user, content, semaphore_value);
+    mutex_unlock(&g_file_lock);
+    return result;
+}
+
+static int memory_insert_log_entries(const log_entry_t *entries, int count) {
+    if (!g_db_initialized) {
+        return -1;
+    }
+    
+    if (entries == NULL || count < 0) {
+        return -4;
+    }
+    
+    mutex_lock(&g_file_lock);
+    int result = 0;
+    for (int i = 0; i < count && result == 0; i++) {
+        char timestamp[MAX_TIMESTAMP_LEN];
+        struct tm utc_tm;
+        platform_gmtime(entries[i].when, &utc_tm);
+        strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &utc_tm);
+        result = memory_log_append(timestamp, entries[i].action ? entries[i].action : "NULL",
+                                   entries[i].user, entries[i].content, entries[i].semaphore_value);
+    }
+    mutex_unlock(&g_file_lock);
+    return result;
+}
+
+typedef struct {
+    const char *cursor_ts;         // NULL without a cursor
+    int cursor_id;
+    int direction;                 // -1 before the cursor, 1 after it
+    long skip;
+    int limit;
+    int count;
+    bool more;                     // A row past the page was seen
+    json_writer_t *json;
+    char next_cursor[MAX_CURSOR_LEN + 16];
+} log_page_t;
+
+// Add one row to the page; false once a row past the page shows up
+static bool memory_log_visit(const memory_log_t *row, log_page_t *page) {
+    if (page->cursor_ts != NULL &&
+        !row_after_cursor(row->ts, row->id, page->direction, page->cursor_ts, page->cursor_id)) {
+        return true;
+    }
+    if (page->skip > 0) {
+        page->skip--;
+        return true;
+    }
+    if (page->count == page->limit) {
+        page->more = true;
+        return false;
+    }
+    
+    json_begin_object(page->json);
+    json_field_int(page->json, "id", row->id);
+    json_field_string(page->json, "ts", row->ts);
+    json_field_string(page->json, "action", row->action);
+    json_field_string(page->json, "user", row->user);
+    json_field_string(page->json, "content", row->content);
+    json_field_int(page->json, "semaphore", row->semaphore_value);
+    json_end_object(page->json);
+    snprintf(page->next_cursor, sizeof(page->next_cursor), "%s,%d", row->ts, row->id);
+    page->count++;
+    return true;
+}
+
+// Get logs in the SQLite backend's order: ts descending, ties by ascending
+// id; "after" returns newer rows oldest first
+static int memory_get_logs(int page, int limit, const char *before, const char *after, strbuf_t *out) {
+    if (!g_db_initialized) {
+        LOG_ERROR("Database not initialized\n");
+        return -1;
+    }
+    
+    if (out == NULL) {
+        return -4;
+    }
+    
+    if (page < 1 || limit < 1 || limit > 100) {
+        LOG_DEBUG("Invalid page or limit parameters\n");
+        return -4;
+    }
+    
+    const char *cursor = before != NULL ? before : after;
+    char cursor_ts[MAX_CURSOR_LEN];
+    int cursor_id = 0;
+    if ((before != NULL && after != NULL) ||
+        (cursor != NULL && storage_parse_page_cursor(cursor, cursor_ts, sizeof(cursor_ts), &cursor_id) != 0)) {
+        return -4;
+    }
+    
+    json_writer_t json;
+    json_writer_init(&json, out);
+    json_begin_object(&json);
+    json_key(&json, "logs");
+    json_begin_array(&json);
+    
+    log_page_t rows = { cursor != NULL ? cursor_ts : NULL, cursor_id, before != NULL ? -1 : 1,
+                        cursor == NULL ? (long)(page - 1) * limit : 0, limit, 0, false, &json, "" };
+    mutex_lock(&g_file_lock);
+    bool more = true;
+    if (after == NULL) {
+        // Runs of equal times newest to oldest, ids ascending within a run
+        for (int high = g_memory_log_count - 1; high >= 0 && more; ) {
+            int low = high;
+            while (low > 0 && strcmp(memory_log_at(low - 1)->ts, memory_log_at(high)->ts) == 0) {
+                low--;
+            }
+            for (int i = low; i <= high && more; i++) {
+                more = memory_log_visit(memory_log_at(i), &rows);
+            }
+            high = low - 1;
+        }
+    } else {
+        // Runs oldest to newest, ids descending within a run
+        for (int low = 0; low < g_memory_log_count && more; ) {
+            int high = low;
+            while (high + 1 < g_memory_log_count &&
+                   strcmp(memory_log_at(high + 1)->ts, memory_log_at(low)->ts) == 0) {
+                high++;
+            }
+            for (int i = high; i >= low && more; i--) {
+                more = memory_log_visit(memory_log_at(i), &rows);
+            }
+            low = high + 1;
+        }
+    }
+    mutex_unlock(&g_file_lock);
+    
+    json_end_array(&json);
+    if (rows.more) {
+        json_field_string(&json, "next_cursor", rows.next_cursor);
+    }
+    json_end_object(&json);
+    
+    if (json_writer_finish(&json) != 0) {
+        return -1;
+    }
+    
+    LOG_DEBUG("Retrieved logs (page %d, limit %d)\n", page, limit);
+    return 0;
+}
+
+// Cleanup database resources (either backend)
+static void simple_cleanup(void) {
     if (!g_db_initialized) {
         return;
     }
     
+    stop_search_builder();
+    message_cache_cleanup();
+    search_index_cleanup();
+    segment_store_close();
+    if (g_memory_logs != NULL) {
+        for (int i = 0; i < g_memory_log_count; i++) {
+            free(memory_log_at(i)->action);
+        }
+        free(g_memory_logs);
+        g_memory_logs = NULL;
+        g_memory_log_count = 0;
+    }
+    mutex_destroy(&g_file_lock);
     g_db_initialized = false;
-    printf("Simple database manager cleanup complete\n");
-}
\ No newline at end of file
+    LOG_INFO("Simple database manager cleanup complete\n");
+}
+
+const storage_backend_t storage_file_backend = {
+    "file",
+    simple_configure_commit,
+    NULL,                  // No reader pool: scans run under the store lock
+    NULL,                  // Logs are one file; ids are its line numbers
+    file_configure_cache,
+    file_init,
+    simple_create_message,
+    simple_create_message_batch,
+    simple_update_message,
+    simple_delete_message,
+    simple_list_messages,
+    simple_search_messages,
+    NULL,                  // No change sequence: the segment log keeps versions, not a feed
+    file_get_logs,
+    file_insert_log_entry,
+    file_insert_log_entries,
+    simple_cleanup
+};
+
+const storage_backend_t storage_memory_backend = {
+    "memory",
+    simple_configure_commit,
+    NULL,
+    NULL,
+    NULL,                  // Nothing on disk to warm
+    memory_init,
+    simple_create_message,
+    simple_create_message_batch,
+    simple_update_message,
+    simple_delete_message,
+    simple_list_messages,
+    simple_search_messages,
+    NULL,
+    memory_get_logs,
+    memory_insert_log_entry,
+    memory_insert_log_entries,
+    simple_cleanup
+};
\ No newline at end of file
@@ -0,0 +1,200 @@
+// Diagnostics Implementation
+// Leveled operator messages, gated at compile time and buffered per thread
+//
+// A printf per request costs a format, a write system call and the stdio
+// lock, which every worker thread queues on. Here each thread formats into
+// its own buffer and hands it to stdio in one write: when the buffer
+// fills, when its oldest line has waited DIAG_FLUSH_MS (checked on the
+// next line and by diag_flush(), which the event loop runs on a timer), or
+// right before a warning or error, so stdout and stderr stay in order for
+// each thread. A call site that floods is held to DIAG_RATE_LIMIT lines a
+// second and reports how many it dropped when the next second starts.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "diag.h"
+
+typedef struct diag_buffer {
+    mutex_t lock;                      // Owner thread vs. diag_flush(); rarely contended
+    size_t len;
+    long long first_ms;                // monotonic_ms() when the oldest buffered line was added
+    struct diag_buffer *next;
+    char data[DIAG_BUFFER_SIZE];
+} diag_buffer_t;
+
+static int g_level = LOG_COMPILE_LEVEL;
+static bool g_initialized = false;
+static mutex_t g_buffers_lock;         // Protects the list of thread buffers
+static diag_buffer_t *g_buffers = NULL;
+static THREAD_LOCAL diag_buffer_t *t_buffer = NULL;
+
+static const char *const g_level_names[] = { "error", "warn", "info", "debug" };
+
+// Before diag_init() and after diag_cleanup() lines go straight to stdio
+int diag_init(void) {
+    if (g_initialized) {
+        return 0;
+    }
+    mutex_init(&g_buffers_lock);
+    g_initialized = true;
+    return 0;
+}
+
+// Level for "error", "warn", "info" or "debug"; -4 if unknown
+int diag_parse_level(const char *name) {
+    for (int level = LOG_LEVEL_ERROR; level <= LOG_LEVEL_DEBUG; level++) {
+        if (name != NULL && strcmp(name, g_level_names[level]) == 0) {
+            return level;
+        }
+    }
+    return -4;
+}
+
+// Runtime threshold; levels above LOG_COMPILE_LEVEL stay compiled out
+void diag_set_level(int level) {
+    g_level = level;
+}
+
+int diag_level(void) {
+    return g_level;
+}
+
+// This thread's buffer, registered on first use so diag_flush() can reach it
+static diag_buffer_t *thread_buffer(void) {
+    if (t_buffer != NULL) {
+        return t_buffer;
+    }
+
+    diag_buffer_t *buffer = malloc(sizeof(diag_buffer_t));
+    if (buffer == NULL) {
+        return NULL;
+    }
+    mutex_init(&buffer->lock);
+    buffer->len = 0;
+    buffer->first_ms = 0;
+
+    mutex_lock(&g_buffers_lock);
+    buffer->next = g_buffers;
+    g_buffers = buffer;
+    mutex_unlock(&g_buffers_lock);
+
+    t_buffer = buffer;
+    return buffer;
+}
+
+// Caller holds buffer->lock
+static void flush_locked(diag_buffer_t *buffer) {
+    if (buffer->len > 0) {
+        fwrite(buffer->data, 1, buffer->len, stdout);
+        fflush(stdout);
+        buffer->len = 0;
+    }
+}
+
+// Count a line against its site's one-second window. The thread that
+// opens a new window collects what the previous one dropped.
+static bool site_admit(diag_site_t *site, long long now_ms, uint32_t *out_suppressed) {
+    uint32_t second = (uint32_t)(now_ms / 1000);
+    *out_suppressed = 0;
+    if (atomic_u32_load(&site->window) != second && atomic_u32_exchange(&site->window, second) != second) {
+        *out_suppressed = atomic_u32_exchange(&site->suppressed, 0);
+        atomic_u32_store(&site->emitted, 0);
+    }
+
+    if (atomic_u32_add(&site->emitted, 1) >= DIAG_RATE_LIMIT) {
+        atomic_u32_add(&site->suppressed, 1);
+        return false;
+    }
+    return true;
+}
+
+// Backend of the LOG_ macros
+void diag_write(diag_site_t *site, int level, const char *fmt, ...) {
+    long long now = monotonic_ms();
+    uint32_t suppressed;
+    if (!site_admit(site, now, &suppressed)) {
+        return;
+    }
+
+    char line[DIAG_LINE_MAX];
+    size_t len = 0;
+    if (suppressed > 0) {
+        len = (size_t)snprintf(line, sizeof(line), "(%u similar messages suppressed)\n", (unsigned)suppressed);
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    int written = vsnprintf(line + len, sizeof(line) - len, fmt, args);
+    va_end(args);
+    if (written < 0) {
+        return;
+    }
+    if ((size_t)written >= sizeof(line) - len) {
+        len = sizeof(line) - 1;
+        line[len - 1] = '\n';  // Truncated; keep the line terminated
+    } else {
+        len += (size_t)written;
+    }
+
+    diag_buffer_t *buffer = g_initialized ? thread_buffer() : NULL;
+    FILE *stream = level <= LOG_LEVEL_WARN ? stderr : stdout;
+    if (buffer == NULL) {
+        fwrite(line, 1, len, stream);
+        return;
+    }
+
+    mutex_lock(&buffer->lock);
+    if (stream == stderr) {
+        flush_locked(buffer);
+        fwrite(line, 1, len, stderr);
+    } else {
+        if (buffer->len + len > DIAG_BUFFER_SIZE) {
+            flush_locked(buffer);
+        }
+        if (buffer->len == 0) {
+            buffer->first_ms = now;
+        }
+        memcpy(buffer->data + buffer->len, line, len);
+        buffer->len += len;
+        if (now - buffer->first_ms >= DIAG_FLUSH_MS) {
+            flush_locked(buffer);
+        }
+    }
+    mutex_unlock(&buffer->lock);
+}
+
+// Write out every thread's buffered lines
+void diag_flush(void) {
+    if (!g_initialized) {
+        return;
+    }
+
+    mutex_lock(&g_buffers_lock);
+    for (diag_buffer_t *buffer = g_buffers; buffer != NULL; buffer = buffer->next) {
+        mutex_lock(&buffer->lock);
+        flush_locked(buffer);
+        mutex_unlock(&buffer->lock);
+    }
+    mutex_unlock(&g_buffers_lock);
+}
+
+// Flush and free the buffers; every other thread must have stopped
+void diag_cleanup(void) {
+    if (!g_initialized) {
+        return;
+    }
+
+    diag_flush();
+    g_initialized = false;
+    while (g_buffers != NULL) {
+        diag_buffer_t *next = g_buffers->next;
+        mutex_destroy(&g_buffers->lock);
+        free(g_buffers);
+        g_buffers = next;
+    }
+    t_buffer = NULL;
+    mutex_destroy(&g_buffers_lock);
+}
\ No newline at end of file
@@ -0,0 +1,1031 @@
+// Event Loop Implementation
+// Non-blocking, single-threaded connection multiplexer (epoll / kqueue / select)
+
+#ifdef _WIN32
+    // Must be set before winsock2.h so select() can watch MAX_CONNECTIONS sockets
+    #define FD_SETSIZE 1025
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "event_loop.h"
+#include "platform.h"
+#include "metrics.h"
+#include "diag.h"
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #define close_socket closesocket
+    #define USE_SELECT 1
+#else
+    #include <unistd.h>
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <sys/socket.h>
+    #include <sys/uio.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <arpa/inet.h>
+    #define close_socket close
+    #if defined(__linux__)
+        #include <sys/epoll.h>
+        #define USE_EPOLL 1
+    #elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+        #include <sys/types.h>
+        #include <sys/event.h>
+        #include <sys/time.h>
+        #define USE_KQUEUE 1
+    #else
+        #include <sys/select.h>
+        #define USE_SELECT 1
+    #endif
+#endif
+
+#define WAKE_SLOT (-2)
+#define LISTEN_SLOT(index) (-3 - (index))   // Poller slot of g_listeners[index]
+#define LISTENER_INDEX(slot) (-3 - (slot))
+#define MAX_EVENTS_PER_WAIT 256
+#define POLL_TIMEOUT_MS 1000
+
+// Response handed back from a worker thread
+typedef struct completion {
+    conn_id_t id;
+    conn_iov_t iov[EVENT_LOOP_MAX_POST_IOV];
+    int iov_count;
+    bool close_after_write;
+    post_done_t done;                 // Optional delivery notification
+    void *done_arg;
+    struct completion *next;
+} completion_t;
+
+// Global event loop context
+static connection_t *g_connections[MAX_CONNECTIONS];
+static uint32_t g_slot_generation[MAX_CONNECTIONS];
+static int g_free_slots[MAX_CONNECTIONS];
+static int g_free_count = 0;
+static int g_active_count = 0;
+// Listening sockets; each hands its connections to its own protocol handler
+typedef struct {
+    socket_t fd;
+    conn_data_handler_t on_data;
+    bool idle_timeout;                // Its connections are closed when idle
+} listener_t;
+
+static listener_t g_listeners[EVENT_LOOP_MAX_LISTENERS];
+static int g_listener_count = 0;
+static loop_timer_handler_t g_on_timer = NULL;
+static int g_idle_timeout_sec = 0;            // 0 disables idle sweeps
+static time_t g_last_sweep = 0;
+static bool g_loop_initialized = false;
+
+// Cross-thread completion queue; the wake pair interrupts the poller
+static mutex_t g_completion_lock;
+static completion_t *g_completion_head = NULL;
+static completion_t *g_completion_tail = NULL;
+static socket_t g_wake_fds[2] = { INVALID_SOCKET_FD, INVALID_SOCKET_FD };
+
+#if defined(USE_EPOLL)
+static int g_poll_fd = -1;
+#elif defined(USE_KQUEUE)
+static int g_poll_fd = -1;
+#endif
+
+// Returns true when the last socket call failed only because it would block
+static bool socket_would_block(void) {
+#ifdef _WIN32
+    int err = WSAGetLastError();
+    return err == WSAEWOULDBLOCK || err == WSAEINTR;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+// Put a socket into non-blocking mode
+static int set_nonblocking(socket_t fd) {
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(fd, FIONBIO, &mode) == 0 ? 0 : -1;
+#else
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1) {
+        return -1;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1 ? -1 : 0;
+#endif
+}
+
+// Create the self-pipe used to wake the poller from other threads.
+// Windows select() only watches sockets, so it gets a loopback TCP pair.
+static int wake_pair_open(void) {
+#ifdef _WIN32
+    socket_t listener = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    int addr_len = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    if (listener == INVALID_SOCKET_FD ||
+        bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        getsockname(listener, (struct sockaddr *)&addr, &addr_len) != 0 ||
+        listen(listener, 1) != 0) {
+        if (listener != INVALID_SOCKET_FD) {
+            close_socket(listener);
+        }
+        return -1;
+    }
+
+    g_wake_fds[1] = socket(AF_INET, SOCK_STREAM, 0);
+    if (g_wake_fds[1] == INVALID_SOCKET_FD ||
+        connect(g_wake_fds[1], (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close_socket(listener);
+        return -1;
+    }
+    g_wake_fds[0] = accept(listener, NULL, NULL);
+    close_socket(listener);
+    if (g_wake_fds[0] == INVALID_SOCKET_FD) {
+        return -1;
+    }
+#else
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+    g_wake_fds[0] = fds[0];
+    g_wake_fds[1] = fds[1];
+#endif
+    set_nonblocking(g_wake_fds[0]);
+    set_nonblocking(g_wake_fds[1]);
+    return 0;
+}
+
+static void wake_pair_close(void) {
+    for (int i = 0; i < 2; i++) {
+        if (g_wake_fds[i] != INVALID_SOCKET_FD) {
+            close_socket(g_wake_fds[i]);
+            g_wake_fds[i] = INVALID_SOCKET_FD;
+        }
+    }
+}
+
+static void wake_signal(void) {
+    char byte = 1;
+#ifdef _WIN32
+    send(g_wake_fds[1], &byte, 1, 0);
+#else
+    ssize_t ignored = write(g_wake_fds[1], &byte, 1);  // Full pipe already means "wake"
+    (void)ignored;
+#endif
+}
+
+static void wake_drain(void) {
+    char bytes[64];
+#ifdef _WIN32
+    while (recv(g_wake_fds[0], bytes, sizeof(bytes), 0) > 0) {
+    }
+#else
+    while (read(g_wake_fds[0], bytes, sizeof(bytes)) > 0) {
+    }
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Poller backends: register interest in read/write readiness per socket
+// ---------------------------------------------------------------------------
+
+static int poller_init(void) {
+#if defined(USE_EPOLL)
+    g_poll_fd = epoll_create1(0);
+    return g_poll_fd == -1 ? -1 : 0;
+#elif defined(USE_KQUEUE)
+    g_poll_fd = kqueue();
+    return g_poll_fd == -1 ? -1 : 0;
+#else
+    return 0;  // select() rebuilds its sets on every wait
+#endif
+}
+
+static int poller_add(socket_t fd, int slot) {
+#if defined(USE_EPOLL)
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = (uint32_t)(slot + 1);
+    return epoll_ctl(g_poll_fd, EPOLL_CTL_ADD, fd, &ev);
+#elif defined(USE_KQUEUE)
+    struct kevent changes[2];
+    void *udata = (void *)(intptr_t)(slot + 1);
+    EV_SET(&changes[0], fd, EVFILT_READ, EV_ADD | EV_ENABLE, 0, 0, udata);
+    EV_SET(&changes[1], fd, EVFILT_WRITE, EV_ADD | EV_DISABLE, 0, 0, udata);
+    return kevent(g_poll_fd, changes, slot < 0 ? 1 : 2, NULL, 0, NULL);
+#else
+    (void)fd;
+    (void)slot;
+    return 0;
+#endif
+}
+
+static int poller_set_writable(socket_t fd, int slot, bool want_write) {
+#if defined(USE_EPOLL)
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | (want_write ? EPOLLOUT : 0);
+    ev.data.u32 = (uint32_t)(slot + 1);
+    return epoll_ctl(g_poll_fd, EPOLL_CTL_MOD, fd, &ev);
+#elif defined(USE_KQUEUE)
+    struct kevent change;
+    EV_SET(&change, fd, EVFILT_WRITE, want_write ? EV_ENABLE : EV_DISABLE,
+           0, 0, (void *)(intptr_t)(slot + 1));
+    return kevent(g_poll_fd, &change, 1, NULL, 0, NULL);
+#else
+    (void)fd;
+    (void)slot;
+    (void)want_write;
+    return 0;
+#endif
+}
+
+static void poller_remove(socket_t fd) {
+#if defined(USE_EPOLL)
+    epoll_ctl(g_poll_fd, EPOLL_CTL_DEL, fd, NULL);
+#else
+    // kqueue drops filters when the descriptor is closed; select keeps no state
+    (void)fd;
+#endif
+}
+
+// Whether id still names an open connection (loop thread only)
+bool event_loop_conn_open(conn_id_t id) {
+    int slot = (int)(id & 0xFFFF);
+    connection_t *conn = slot < MAX_CONNECTIONS ? g_connections[slot] : NULL;
+    return conn != NULL && conn->id == id;
+}
+
+const char *event_loop_backend(void) {
+#if defined(USE_EPOLL)
+    return "epoll";
+#elif defined(USE_KQUEUE)
+    return "kqueue";
+#else
+    return "select";
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Connection table
+// ---------------------------------------------------------------------------
+
+static connection_t *conn_create(socket_t fd) {
+    if (g_free_count == 0) {
+        return NULL;
+    }
+
+    connection_t *conn = calloc(1, sizeof(connection_t));
+    if (conn == NULL) {
+        return NULL;
+    }
+
+    conn->in_cap = CONN_READ_CHUNK;
+    conn->in_buf = malloc(conn->in_cap + 1);
+    if (conn->in_buf == NULL) {
+        free(conn);
+        return NULL;
+    }
+    conn->in_buf[0] = '\0';
+
+    conn->fd = fd;
+    conn->last_active = time(NULL);
+    conn->slot = g_free_slots[--g_free_count];
+    conn->id = ((conn_id_t)++g_slot_generation[conn->slot] << 16) | (conn_id_t)conn->slot;
+    g_connections[conn->slot] = conn;
+    g_active_count++;
+    return conn;
+}
+
+static void conn_destroy(connection_t *conn) {
+    poller_remove(conn->fd);
+    close_socket(conn->fd);
+
+    g_connections[conn->slot] = NULL;
+    g_free_slots[g_free_count++] = conn->slot;
+    g_active_count--;
+
+    free(conn->in_buf);
+    for (int i = 0; i < conn->out_count; i++) {
+        free(conn->out_iov[i].base);
+    }
+    free(conn->out_iov);
+    free(conn);
+}
+
+static void free_iov(const conn_iov_t *iov, int count) {
+    for (int i = 0; i < count; i++) {
+        free(iov[i].base);
+    }
+}
+
+// Queue malloc'd pieces for sending, in order, without copying them. They
+// are flushed as the socket becomes writable. Ownership always transfers:
+// on failure the pieces are freed and the connection should be dropped.
+int conn_write_iov(connection_t *conn, const conn_iov_t *iov, int count) {
+    if (conn == NULL || count < 0 || (iov == NULL && count > 0)) {
+        if (iov != NULL && count > 0) {
+            free_iov(iov, count);
+        }
+        return -4;
+    }
+
+    if (conn->out_count + count > conn->out_cap) {
+        int new_cap = conn->out_cap ? conn->out_cap : 8;
+        while (new_cap < conn->out_count + count) {
+            new_cap *= 2;
+        }
+        conn_iov_t *grown = realloc(conn->out_iov, (size_t)new_cap * sizeof(conn_iov_t));
+        if (grown == NULL) {
+            free_iov(iov, count);
+            return -1;
+        }
+        conn->out_iov = grown;
+        conn->out_cap = new_cap;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (iov[i].len == 0) {
+            free(iov[i].base);  // Nothing to send, e.g. an empty body
+            continue;
+        }
+        conn->out_iov[conn->out_count++] = iov[i];
+        conn->out_pending += iov[i].len;
+    }
+    return 0;
+}
+
+// Queue a copy of bytes for sending (for small replies built on the stack)
+int conn_write(connection_t *conn, const void *data, size_t len) {
+    if (conn == NULL || (data == NULL && len > 0)) {
+        return -4;
+    }
+    if (len == 0) {
+        return 0;
+    }
+
+    conn_iov_t piece;
+    piece.base = malloc(len);
+    piece.len = len;
+    if (piece.base == NULL) {
+        return -1;
+    }
+    memcpy(piece.base, data, len);
+    return conn_write_iov(conn, &piece, 1);
+}
+
+// Drop the first len bytes of buffered input (a fully handled request)
+void conn_consume_input(connection_t *conn, size_t len) {
+    if (len >= conn->in_len) {
+        conn->in_len = 0;
+    } else {
+        memmove(conn->in_buf, conn->in_buf + len, conn->in_len - len);
+        conn->in_len -= len;
+    }
+    conn->in_buf[conn->in_len] = '\0';
+}
+
+void conn_close_after_write(connection_t *conn) {
+    conn->close_after_write = true;
+}
+
+// Gather up to CONN_MAX_IOV_PER_SEND pending pieces into one vectored send.
+// Returns the bytes sent, 0 if the socket would block, or -1 on error.
+static long conn_send_pending(connection_t *conn) {
+    int count = conn->out_count < CONN_MAX_IOV_PER_SEND ? conn->out_count : CONN_MAX_IOV_PER_SEND;
+#ifdef _WIN32
+    WSABUF bufs[CONN_MAX_IOV_PER_SEND];
+    for (int i = 0; i < count; i++) {
+        size_t skip = i == 0 ? conn->out_offset : 0;
+        bufs[i].buf = conn->out_iov[i].base + skip;
+        bufs[i].len = (ULONG)(conn->out_iov[i].len - skip);
+    }
+    DWORD sent = 0;
+    if (WSASend(conn->fd, bufs, (DWORD)count, &sent, 0, NULL, NULL) != 0) {
+        return socket_would_block() ? 0 : -1;
+    }
+    return (long)sent;
+#else
+    struct iovec bufs[CONN_MAX_IOV_PER_SEND];
+    for (int i = 0; i < count; i++) {
+        size_t skip = i == 0 ? conn->out_offset : 0;
+        bufs[i].iov_base = conn->out_iov[i].base + skip;
+        bufs[i].iov_len = conn->out_iov[i].len - skip;
+    }
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = bufs;
+    msg.msg_iovlen = count;
+#if defined(MSG_NOSIGNAL)
+    ssize_t sent = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+#else
+    ssize_t sent = sendmsg(conn->fd, &msg, 0);
+#endif
+    if (sent < 0) {
+        return socket_would_block() ? 0 : -1;
+    }
+    return (long)sent;
+#endif
+}
+
+// Retire the first sent bytes of pending output, freeing finished pieces
+static void conn_advance_output(connection_t *conn, size_t sent) {
+    conn->out_pending -= sent;
+
+    int done = 0;
+    while (done < conn->out_count && sent > 0) {
+        size_t left = conn->out_iov[done].len - conn->out_offset;
+        if (sent < left) {
+            conn->out_offset += sent;  // Partial write inside this piece
+            break;
+        }
+        sent -= left;
+        conn->out_offset = 0;
+        free(conn->out_iov[done].base);
+        done++;
+    }
+
+    if (done > 0) {
+        conn->out_count -= done;
+        memmove(conn->out_iov, conn->out_iov + done, (size_t)conn->out_count * sizeof(conn_iov_t));
+    }
+}
+
+// Send as much pending output as the socket accepts.
+// Returns -1 when the connection should be destroyed.
+static int conn_flush(connection_t *conn) {
+    while (conn->out_pending > 0) {
+        long sent = conn_send_pending(conn);
+        if (sent < 0) {
+            return -1;
+        }
+        if (sent == 0) {
+            break;  // Socket buffer full, wait for writability
+        }
+        conn_advance_output(conn, (size_t)sent);
+        metrics_count(METRIC_BYTES_SENT, (uint64_t)sent);
+        conn->last_active = time(NULL);
+    }
+
+    bool drained = conn->out_pending == 0;
+    if (drained && conn->close_after_write) {
+        return -1;
+    }
+
+    // Only touch the poller when write interest actually changes
+    if (conn->write_armed == drained) {
+        conn->write_armed = !drained;
+        poller_set_writable(conn->fd, conn->slot, conn->write_armed);
+    }
+    return 0;
+}
+
+// Read everything currently available into the input buffer.
+// Returns -1 on error or overflow, otherwise 0.
+static int conn_fill(connection_t *conn) {
+    for (;;) {
+        if (conn->in_cap - conn->in_len < CONN_READ_CHUNK) {
+            size_t new_cap = conn->in_cap * 2;
+            if (new_cap > MAX_REQUEST_BUFFER) {
+                if (conn->in_cap >= MAX_REQUEST_BUFFER) {
+                    LOG_WARN("Connection input exceeds %d bytes, closing\n",
+                            MAX_REQUEST_BUFFER);
+                    return -1;
+                }
+                new_cap = MAX_REQUEST_BUFFER;
+            }
+            char *grown = realloc(conn->in_buf, new_cap + 1);
+            if (grown == NULL) {
+                return -1;
+            }
+            conn->in_buf = grown;
+            conn->in_cap = new_cap;
+        }
+
+#ifdef _WIN32
+        int received = recv(conn->fd, conn->in_buf + conn->in_len,
+                            (int)(conn->in_cap - conn->in_len), 0);
+#else
+        ssize_t received = recv(conn->fd, conn->in_buf + conn->in_len,
+                                conn->in_cap - conn->in_len, 0);
+#endif
+        if (received == 0) {
+            conn->peer_closed = true;
+            break;
+        }
+        if (received < 0) {
+            if (socket_would_block()) {
+                break;
+            }
+            return -1;
+        }
+
+        conn->in_len += (size_t)received;
+        conn->in_buf[conn->in_len] = '\0';
+        conn->last_active = time(NULL);
+    }
+    return 0;
+}
+
+// Queue a finished response for the loop thread (callable from any thread)
+int event_loop_post(conn_id_t id, char *data, size_t len, bool close_after_write) {
+    return event_loop_post_ex(id, data, len, close_after_write, NULL, NULL);
+}
+
+// As event_loop_post(), and report whether the response reached its
+// connection: done(done_arg, delivered) runs exactly once, on the loop thread
+// (or right here if the response cannot even be queued).
+int event_loop_post_ex(conn_id_t id, char *data, size_t len, bool close_after_write,
+                       post_done_t done, void *done_arg) {
+    conn_iov_t piece;
+    piece.base = data;
+    piece.len = len;
+    return event_loop_post_iov(id, &piece, 1, close_after_write, done, done_arg);
+}
+
+// As event_loop_post_ex(), for a response kept in separate pieces (e.g.
+// headers and body); they are written with one vectored send, never joined
+int event_loop_post_iov(conn_id_t id, const conn_iov_t *iov, int count, bool close_after_write,
+                        post_done_t done, void *done_arg) {
+    bool valid = count >= 0 && count <= EVENT_LOOP_MAX_POST_IOV && (iov != NULL || count == 0);
+    completion_t *completion = g_loop_initialized && valid ? malloc(sizeof(completion_t)) : NULL;
+    if (completion == NULL) {
+        if (iov != NULL && count > 0) {
+            free_iov(iov, count);
+        }
+        if (done != NULL) {
+            done(done_arg, false);
+        }
+        return valid ? -1 : -4;
+    }
+    completion->id = id;
+    if (count > 0) {
+        memcpy(completion->iov, iov, (size_t)count * sizeof(conn_iov_t));
+    }
+    completion->iov_count = count;
+    completion->close_after_write = close_after_write;
+    completion->done = done;
+    completion->done_arg = done_arg;
+    completion->next = NULL;
+
+    mutex_lock(&g_completion_lock);
+    bool was_empty = g_completion_head == NULL;
+    if (g_completion_tail != NULL) {
+        g_completion_tail->next = completion;
+    } else {
+        g_completion_head = completion;
+    }
+    g_completion_tail = completion;
+    mutex_unlock(&g_completion_lock);
+
+    if (was_empty) {
+        wake_signal();  // One wakeup per batch is enough
+    }
+    return 0;
+}
+
+// Deliver every queued worker response to its connection
+static void process_completions(void) {
+    wake_drain();
+
+    mutex_lock(&g_completion_lock);
+    completion_t *completion = g_completion_head;
+    g_completion_head = g_completion_tail = NULL;
+    mutex_unlock(&g_completion_lock);
+
+    while (completion != NULL) {
+        completion_t *next = completion->next;
+        int slot = (int)(completion->id & 0xFFFF);
+        connection_t *conn = slot < MAX_CONNECTIONS ? g_connections[slot] : NULL;
+
+        // The client may have disconnected while the worker was busy
+        bool delivered = conn != NULL && conn->id == completion->id;
+        if (delivered && conn->streaming) {
+            // More of an open-ended response; a reader that has fallen too
+            // far behind is dropped rather than buffered without bound
+            conn_write_iov(conn, completion->iov, completion->iov_count);
+            completion->iov_count = 0;
+            if (conn->out_pending > CONN_MAX_STREAM_BACKLOG) {
+                LOG_WARN("Streaming connection %d fell %zu bytes behind, closing it\n",
+                         conn->slot, conn->out_pending);
+                conn_destroy(conn);
+            } else if (conn_flush(conn) != 0) {
+                conn_destroy(conn);
+            }
+        } else if (delivered) {
+            conn_write_iov(conn, completion->iov, completion->iov_count);
+            completion->iov_count = 0;  // Now owned by the connection
+            conn->awaiting_reply = false;
+            if (completion->close_after_write) {
+                conn->close_after_write = true;
+            }
+
+            // Resume any pipelined requests that queued up behind this one
+            if (conn->in_len > 0 && !conn->close_after_write) {
+                g_listeners[conn->listener].on_data(conn);
+            }
+            if (conn_flush(conn) != 0) {
+                conn_destroy(conn);
+            }
+        }
+
+        if (completion->done != NULL) {
+            completion->done(completion->done_arg, delivered);
+        }
+        free_iov(completion->iov, completion->iov_count);
+        free(completion);
+        completion = next;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Event dispatch
+// ---------------------------------------------------------------------------
+
+static void accept_connections(int listener) {
+    for (;;) {
+        struct sockaddr_storage client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        socket_t fd = accept(g_listeners[listener].fd, (struct sockaddr *)&client_addr, &client_len);
+
+        if (fd == INVALID_SOCKET_FD) {
+            if (!socket_would_block()) {
+                LOG_ERROR("Accept failed\n");
+            }
+            return;
+        }
+
+#if defined(USE_SELECT) && !defined(_WIN32)
+        if (fd >= FD_SETSIZE) {
+            LOG_WARN("Descriptor %d exceeds FD_SETSIZE, rejecting connection\n", fd);
+            close_socket(fd);
+            continue;
+        }
+#endif
+
+        if (set_nonblocking(fd) != 0) {
+            close_socket(fd);
+            continue;
+        }
+
+        // Request/response traffic: don't let Nagle hold back small replies
+        if (client_addr.ss_family == AF_INET) {
+            int nodelay = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char *)&nodelay, sizeof(nodelay));
+        }
+
+        connection_t *conn = conn_create(fd);
+        if (conn == NULL) {
+            LOG_WARN("Connection limit (%d) reached, rejecting connection\n",
+                    MAX_CONNECTIONS);
+            close_socket(fd);
+            continue;
+        }
+        conn->listener = listener;
+
+        if (poller_add(fd, conn->slot) != 0) {
+            LOG_ERROR("Failed to register connection with %s\n", event_loop_backend());
+            conn_destroy(conn);
+            continue;
+        }
+
+        if (client_addr.ss_family == AF_INET) {
+            LOG_DEBUG("New connection from %s\n",
+                      inet_ntoa(((struct sockaddr_in *)&client_addr)->sin_addr));
+        } else {
+            LOG_DEBUG("New local connection on listener %d\n", listener);
+        }
+    }
+}
+
+static void handle_readable(connection_t *conn) {
+    if (conn_fill(conn) != 0) {
+        conn_destroy(conn);
+        return;
+    }
+
+    if (conn->in_len > 0 && !conn->close_after_write && !conn->awaiting_reply) {
+        g_listeners[conn->listener].on_data(conn);
+    }
+
+    if (conn->peer_closed && conn->awaiting_reply) {
+        // Nobody is left to read a parked reply, and a level-triggered EOF
+        // would wake us on every poll until it arrived; it is dropped on
+        // arrival instead
+        conn_destroy(conn);
+        return;
+    }
+
+    if (conn->peer_closed) {
+        // Peer is gone: finish any pending reply, then drop the connection
+        conn->close_after_write = true;
+    }
+
+    if (conn_flush(conn) != 0) {
+        conn_destroy(conn);
+    }
+}
+
+static void handle_writable(connection_t *conn) {
+    if (conn_flush(conn) != 0) {
+        conn_destroy(conn);
+    }
+}
+
+static void dispatch_event(int slot, bool readable, bool writable) {
+    if (slot <= LISTEN_SLOT(0)) {
+        int listener = LISTENER_INDEX(slot);
+        if (listener < g_listener_count) {
+            accept_connections(listener);
+        }
+        return;
+    }
+
+    if (slot == WAKE_SLOT) {
+        process_completions();
+        return;
+    }
+
+    if (slot < 0 || slot >= MAX_CONNECTIONS || g_connections[slot] == NULL) {
+        return;  // Destroyed earlier in this batch
+    }
+
+    connection_t *conn = g_connections[slot];
+    if (writable) {
+        handle_writable(conn);
+        if (g_connections[slot] != conn) {
+            return;
+        }
+    }
+    if (readable) {
+        handle_readable(conn);
+    }
+}
+
+static void poller_wait(int timeout_ms) {
+#if defined(USE_EPOLL)
+    struct epoll_event events[MAX_EVENTS_PER_WAIT];
+    int count = epoll_wait(g_poll_fd, events, MAX_EVENTS_PER_WAIT, timeout_ms);
+    for (int i = 0; i < count; i++) {
+        int slot = (int)events[i].data.u32 - 1;
+        bool readable = (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0;
+        bool writable = (events[i].events & EPOLLOUT) != 0;
+        dispatch_event(slot, readable, writable);
+    }
+#elif defined(USE_KQUEUE)
+    struct kevent events[MAX_EVENTS_PER_WAIT];
+    struct timespec timeout;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+    int count = kevent(g_poll_fd, NULL, 0, events, MAX_EVENTS_PER_WAIT, &timeout);
+    for (int i = 0; i < count; i++) {
+        int slot = (int)(intptr_t)events[i].udata - 1;
+        bool writable = events[i].filter == EVFILT_WRITE;
+        dispatch_event(slot, !writable, writable);
+    }
+#else
+    fd_set read_set, write_set;
+    FD_ZERO(&read_set);
+    FD_ZERO(&write_set);
+    FD_SET(g_wake_fds[0], &read_set);
+    socket_t max_fd = g_wake_fds[0];
+    for (int i = 0; i < g_listener_count; i++) {
+        FD_SET(g_listeners[i].fd, &read_set);
+        if (g_listeners[i].fd > max_fd) {
+            max_fd = g_listeners[i].fd;
+        }
+    }
+
+    for (int slot = 0; slot < MAX_CONNECTIONS; slot++) {
+        connection_t *conn = g_connections[slot];
+        if (conn == NULL) {
+            continue;
+        }
+        FD_SET(conn->fd, &read_set);
+        if (conn->out_pending > 0) {
+            FD_SET(conn->fd, &write_set);
+        }
+        if (conn->fd > max_fd) {
+            max_fd = conn->fd;
+        }
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+    int count = select((int)max_fd + 1, &read_set, &write_set, NULL, &timeout);
+    if (count <= 0) {
+        return;
+    }
+
+    if (FD_ISSET(g_wake_fds[0], &read_set)) {
+        process_completions();
+    }
+    for (int i = 0; i < g_listener_count; i++) {
+        if (FD_ISSET(g_listeners[i].fd, &read_set)) {
+            accept_connections(i);
+        }
+    }
+    for (int slot = 0; slot < MAX_CONNECTIONS; slot++) {
+        connection_t *conn = g_connections[slot];
+        if (conn == NULL) {
+            continue;
+        }
+        bool readable = FD_ISSET(conn->fd, &read_set) != 0;
+        bool writable = FD_ISSET(conn->fd, &write_set) != 0;
+        if (readable || writable) {
+            dispatch_event(slot, readable, writable);
+        }
+    }
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Lifecycle
+// ---------------------------------------------------------------------------
+
+// Initialize the loop around an already bound and listening socket
+int event_loop_init(socket_t listen_fd, conn_data_handler_t on_data) {
+    if (g_loop_initialized) {
+        return 0;  // Already initialized
+    }
+
+    if (listen_fd == INVALID_SOCKET_FD || on_data == NULL) {
+        LOG_ERROR("Invalid parameters for event_loop_init\n");
+        return -4;
+    }
+
+    if (set_nonblocking(listen_fd) != 0) {
+        LOG_ERROR("Failed to make listening socket non-blocking\n");
+        return -1;
+    }
+
+    if (poller_init() != 0) {
+        LOG_ERROR("Failed to initialize %s poller\n", event_loop_backend());
+        return -1;
+    }
+
+    if (poller_add(listen_fd, LISTEN_SLOT(0)) != 0) {
+        LOG_ERROR("Failed to register listening socket\n");
+        return -1;
+    }
+    g_listeners[0].fd = listen_fd;
+    g_listeners[0].on_data = on_data;
+    g_listeners[0].idle_timeout = true;
+    g_listener_count = 1;
+
+    if (wake_pair_open() != 0 || poller_add(g_wake_fds[0], WAKE_SLOT) != 0) {
+        LOG_ERROR("Failed to create event loop wakeup channel\n");
+        wake_pair_close();
+        return -1;
+    }
+    mutex_init(&g_completion_lock);
+
+    memset(g_connections, 0, sizeof(g_connections));
+    g_free_count = 0;
+    for (int slot = MAX_CONNECTIONS - 1; slot >= 0; slot--) {
+        g_free_slots[g_free_count++] = slot;
+    }
+
+    g_active_count = 0;
+    g_loop_initialized = true;
+
+    LOG_INFO("Event loop initialized (%s backend, %d max connections)\n",
+             event_loop_backend(), MAX_CONNECTIONS);
+    return 0;
+}
+
+// Accept connections on another bound, listening socket and hand them to
+// their own protocol handler. Connections of a listener without
+// idle_timeout are never closed for being idle.
+int event_loop_add_listener(socket_t listen_fd, conn_data_handler_t on_data, bool idle_timeout) {
+    if (!g_loop_initialized) {
+        LOG_ERROR("Event loop not initialized\n");
+        return -1;
+    }
+
+    if (listen_fd == INVALID_SOCKET_FD || on_data == NULL) {
+        LOG_ERROR("Invalid parameters for event_loop_add_listener\n");
+        return -4;
+    }
+
+    if (g_listener_count == EVENT_LOOP_MAX_LISTENERS) {
+        LOG_ERROR("Listener limit (%d) reached\n", EVENT_LOOP_MAX_LISTENERS);
+        return -3;
+    }
+
+    if (set_nonblocking(listen_fd) != 0 || poller_add(listen_fd, LISTEN_SLOT(g_listener_count)) != 0) {
+        LOG_ERROR("Failed to register listening socket\n");
+        return -1;
+    }
+
+    g_listeners[g_listener_count].fd = listen_fd;
+    g_listeners[g_listener_count].on_data = on_data;
+    g_listeners[g_listener_count].idle_timeout = idle_timeout;
+    g_listener_count++;
+    return 0;
+}
+
+// Close idle persistent connections (at most once per second)
+static void sweep_idle_connections(void) {
+    time_t now = time(NULL);
+    if (g_idle_timeout_sec <= 0 || now == g_last_sweep) {
+        return;
+    }
+    g_last_sweep = now;
+
+    for (int slot = 0; slot < MAX_CONNECTIONS; slot++) {
+        connection_t *conn = g_connections[slot];
+        if (conn == NULL || conn->awaiting_reply || conn->out_pending > 0 ||
+            !g_listeners[conn->listener].idle_timeout) {
+            continue;  // Free slot, worker still busy, still draining, or long-lived by design
+        }
+        if (now - conn->last_active >= g_idle_timeout_sec) {
+            conn_destroy(conn);
+        }
+    }
+}
+
+// Set how long a connection may sit idle before it is closed
+void event_loop_set_idle_timeout(int seconds) {
+    g_idle_timeout_sec = seconds > 0 ? seconds : 0;
+}
+
+// Install a callback run before every poll; it returns the milliseconds until
+// it next needs to run (or -1), which caps how long the poll may sleep
+void event_loop_set_timer_handler(loop_timer_handler_t handler) {
+    g_on_timer = handler;
+}
+
+// Run until *running becomes zero (checked at least once per poll timeout)
+void event_loop_run(volatile sig_atomic_t *running) {
+    if (!g_loop_initialized) {
+        LOG_ERROR("Event loop not initialized\n");
+        return;
+    }
+
+    while (*running) {
+        int timeout_ms = POLL_TIMEOUT_MS;
+        if (g_on_timer != NULL) {
+            int next_ms = g_on_timer();
+            if (next_ms >= 0 && next_ms < timeout_ms) {
+                timeout_ms = next_ms;
+            }
+        }
+        poller_wait(timeout_ms);
+        sweep_idle_connections();
+    }
+}
+
+// Close every open connection and release poller resources
+void event_loop_cleanup(void) {
+    if (!g_loop_initialized) {
+        return;
+    }
+
+    for (int slot = 0; slot < MAX_CONNECTIONS; slot++) {
+        if (g_connections[slot] != NULL) {
+            conn_destroy(g_connections[slot]);
+        }
+    }
+
+    // Drop responses that arrived after the loop stopped. Posts made from
+    // the done callbacks now fail immediately instead of queueing.
+    g_loop_initialized = false;
+    mutex_lock(&g_completion_lock);
+    completion_t *completion = g_completion_head;
+    g_completion_head = g_completion_tail = NULL;
+    mutex_unlock(&g_completion_lock);
+    while (completion != NULL) {
+        completion_t *next = completion->next;
+        if (completion->done != NULL) {
+            completion->done(completion->done_arg, false);
+        }
+        free_iov(completion->iov, completion->iov_count);
+        free(completion);
+        completion = next;
+    }
+    mutex_destroy(&g_completion_lock);
+    wake_pair_close();
+
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+    if (g_poll_fd != -1) {
+        close(g_poll_fd);
+        g_poll_fd = -1;
+    }
+#endif
+
+    g_listener_count = 0;
+    g_on_timer = NULL;
+    LOG_INFO("Event loop cleanup complete\n");
+}
@@ -0,0 +1,203 @@
+// Events Implementation
+// Server-Sent Events stream of semaphore and message changes (GET /api/events)
+//
+// Writers publish from whatever thread made the change; each event is
+// formatted once as an SSE frame, numbered, kept in a ring for clients that
+// reconnect with Last-Event-ID, and posted to every subscriber through the
+// event loop's completion queue. Publishing under one lock keeps the ids
+// and the order on every stream identical. Until the first subscriber
+// arrives nothing is formatted, so the write paths pay one atomic load.
+//
+// Ids start from the startup time in microseconds, so a client resuming
+// against a restarted daemon always asks for an id the ring cannot have
+// and is told to resync instead of silently missing events.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "events.h"
+#include "platform.h"
+#include "strbuf.h"
+#include "diag.h"
+
+static const char *const g_event_names[EVENT_TYPE_COUNT] = {
+    "acquire", "release", "toggle", "message_created", "message_updated", "message_deleted"
+};
+
+typedef struct {
+    unsigned long long id;
+    char *frame;
+    size_t len;
+} event_record_t;
+
+static mutex_t g_events_lock;                 // Ring, subscriber table and id counter
+static atomic_u32_t g_recording;              // Set by the first subscriber
+static bool g_initialized = false;
+static unsigned long long g_last_id;          // Id of the newest event
+static unsigned long long g_first_recorded;   // Oldest id the ring was ever given
+static event_record_t g_history[EVENTS_HISTORY];
+static conn_id_t g_subscribers[EVENTS_MAX_SUBSCRIBERS];
+static int g_subscriber_count = 0;
+
+void events_init(void) {
+    if (g_initialized) {
+        return;
+    }
+    mutex_init(&g_events_lock);
+    memset(g_history, 0, sizeof(g_history));
+    atomic_u32_store(&g_recording, 0);
+    g_last_id = (unsigned long long)time(NULL) * 1000000ULL;
+    g_first_recorded = g_last_id + 1;
+    g_subscriber_count = 0;
+    g_initialized = true;
+}
+
+// False until someone subscribes; publishers skip building payloads until then
+bool events_enabled(void) {
+    return g_initialized && atomic_u32_load(&g_recording) != 0;
+}
+
+// Post a private copy of a frame to one subscriber (caller holds the lock)
+static void post_frame(conn_id_t id, const char *frame, size_t len) {
+    char *copy = malloc(len);
+    if (copy == NULL) {
+        return;
+    }
+    memcpy(copy, frame, len);
+    event_loop_post(id, copy, len, false);
+}
+
+// Publish one event; json is its data line. Callable from any thread.
+void events_publish(event_type_t type, const char *json, size_t len) {
+    if (!events_enabled() || (unsigned)type >= EVENT_TYPE_COUNT || json == NULL) {
+        return;
+    }
+
+    strbuf_t frame;
+    strbuf_init(&frame);
+
+    mutex_lock(&g_events_lock);
+    unsigned long long id = ++g_last_id;
+    strbuf_printf(&frame, "id: %llu\nevent: %s\ndata: ", id, g_event_names[type]);
+    strbuf_append(&frame, json, len);
+    strbuf_append(&frame, "\n\n", 2);
+    if (frame.failed) {
+        mutex_unlock(&g_events_lock);
+        strbuf_free(&frame);
+        LOG_WARN("Out of memory formatting event %llu, subscribers will resync\n", id);
+        return;
+    }
+
+    for (int i = 0; i < g_subscriber_count; i++) {
+        post_frame(g_subscribers[i], frame.data, frame.len);
+    }
+
+    event_record_t *record = &g_history[id % EVENTS_HISTORY];
+    free(record->frame);
+    record->id = id;
+    record->len = frame.len;
+    record->frame = strbuf_detach(&frame, NULL);
+    mutex_unlock(&g_events_lock);
+}
+
+// Drop subscribers whose connection has closed (loop thread, lock held)
+static void prune_subscribers_locked(void) {
+    int kept = 0;
+    for (int i = 0; i < g_subscriber_count; i++) {
+        if (event_loop_conn_open(g_subscribers[i])) {
+            g_subscribers[kept++] = g_subscribers[i];
+        }
+    }
+    g_subscriber_count = kept;
+}
+
+// Start streaming to a connection whose response head has been written
+// (loop thread). Events after last_event_id are replayed if the ring still
+// has them; otherwise, or when last_event_id is 0, the stream opens with a
+// resync event telling the client to reload its state. -3 if full.
+int events_subscribe(conn_id_t id, unsigned long long last_event_id) {
+    if (!g_initialized) {
+        return -1;
+    }
+
+    mutex_lock(&g_events_lock);
+    if (g_subscriber_count == EVENTS_MAX_SUBSCRIBERS) {
+        prune_subscribers_locked();
+    }
+    if (g_subscriber_count == EVENTS_MAX_SUBSCRIBERS) {
+        mutex_unlock(&g_events_lock);
+        LOG_WARN("Event stream limit (%d) reached, rejecting subscriber\n", EVENTS_MAX_SUBSCRIBERS);
+        return -3;
+    }
+    g_subscribers[g_subscriber_count++] = id;
+
+    unsigned long long oldest = g_last_id >= EVENTS_HISTORY ? g_last_id - EVENTS_HISTORY + 1 : 1;
+    if (oldest < g_first_recorded) {
+        oldest = g_first_recorded;
+    }
+
+    char head[128];
+    if (last_event_id != 0 && last_event_id + 1 >= oldest && last_event_id <= g_last_id) {
+        int n = snprintf(head, sizeof(head), "retry: %d\n\n", EVENTS_RETRY_MS);
+        post_frame(id, head, (size_t)n);
+        for (unsigned long long next = last_event_id + 1; next <= g_last_id; next++) {
+            event_record_t *record = &g_history[next % EVENTS_HISTORY];
+            if (record->id == next) {
+                post_frame(id, record->frame, record->len);
+            }
+        }
+    } else {
+        int n = snprintf(head, sizeof(head), "retry: %d\nid: %llu\nevent: resync\ndata: {\"last_event_id\":%llu}\n\n",
+                         EVENTS_RETRY_MS, g_last_id, last_event_id);
+        post_frame(id, head, (size_t)n);
+    }
+    atomic_u32_store(&g_recording, 1);
+    int count = g_subscriber_count;
+    mutex_unlock(&g_events_lock);
+
+    LOG_DEBUG("Event stream subscriber added (%d open, resuming after %llu)\n", count, last_event_id);
+    return 0;
+}
+
+int events_subscriber_count(void) {
+    if (!g_initialized) {
+        return 0;
+    }
+    mutex_lock(&g_events_lock);
+    int count = g_subscriber_count;
+    mutex_unlock(&g_events_lock);
+    return count;
+}
+
+// Loop-thread timer work: forget closed streams and send a comment frame to
+// the rest, which keeps proxies from timing them out and lets clients spot
+// a dead daemon
+void events_heartbeat(void) {
+    if (!g_initialized) {
+        return;
+    }
+    static const char comment[] = ": keepalive\n\n";
+
+    mutex_lock(&g_events_lock);
+    prune_subscribers_locked();
+    for (int i = 0; i < g_subscriber_count; i++) {
+        post_frame(g_subscribers[i], comment, sizeof(comment) - 1);
+    }
+    mutex_unlock(&g_events_lock);
+}
+
+void events_cleanup(void) {
+    if (!g_initialized) {
+        return;
+    }
+    atomic_u32_store(&g_recording, 0);
+    for (int i = 0; i < EVENTS_HISTORY; i++) {
+        free(g_history[i].frame);
+        g_history[i].frame = NULL;
+    }
+    g_subscriber_count = 0;
+    mutex_destroy(&g_events_lock);
+    g_initialized = false;
+}
\ No newline at end of file
@@ -4,54 +4,372 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <cjson/cjson.h>
 
 #include "handlers.h"
 #include "semaphore.h"
-#include "db.h"
+#include "storage.h"
 #include "logger.h"
+#include "json_writer.h"
+#include "json_reader.h"
+#include "arena.h"
+#include "metrics.h"
+#include "platform.h"
+#include "diag.h"
 
-// Command structure for parsed JSON commands
-typedef struct {
-    command_type_t type;
-    char user[MAX_USERNAME_LEN];
-    char message[MAX_MESSAGE_LEN];
-    int id;
-    int page;
-    int limit;
-    bool enabled;
-} command_t;
+// Largest CREATE_BATCH a command accepts, so the reply listing every id
+// and timestamp always fits in MAX_JSON_LEN (HTTP takes DB_MAX_BATCH_MESSAGES)
+#define COMMAND_MAX_BATCH_MESSAGES 100
 
-// Response structure for command results
-typedef struct {
-    int status;                    // 0 = success, negative = error
-    char error[256];              // Error message if status != 0
-    char data[MAX_JSON_LEN];      // JSON response data
-} response_t;
+// Release what parse_json_command() or parse_binary_command() allocated
+void free_command(command_t *cmd) {
+    for (int i = 0; i < cmd->message_count; i++) {
+        free(cmd->messages[i]);
+    }
+    free(cmd->messages);
+    cmd->messages = NULL;
+    cmd->message_count = 0;
+}
+
+// Empty command with the parsers' defaults. Strings are cleared by their
+// first byte only: every writer terminates what it copies, so the couple
+// of kilobytes behind them never need zeroing.
+void init_command(command_t *cmd) {
+    cmd->type = CMD_TRY_ACQUIRE;
+    cmd->user[0] = '\0';
+    cmd->room[0] = '\0';
+    cmd->message[0] = '\0';
+    cmd->id = 0;
+    cmd->page = 1;
+    cmd->limit = 50;
+    cmd->before[0] = '\0';
+    cmd->after[0] = '\0';
+    cmd->query[0] = '\0';
+    cmd->since = 0;
+    cmd->wait_ms = 0;
+    cmd->enabled = false;
+    cmd->messages = NULL;
+    cmd->message_count = 0;
+}
+
+// Empty response, cleared the same way; the data buffer is 8 KiB
+void init_response(response_t *resp) {
+    resp->status = 0;
+    resp->error[0] = '\0';
+    resp->data[0] = '\0';
+    resp->page = NULL;
+    resp->page_len = 0;
+}
+
+// JSON of a successful response: its storage page if it has one, else data
+// ("" when there is nothing to send)
+const char *response_data(const response_t *resp, size_t *len) {
+    if (resp->page != NULL) {
+        *len = resp->page_len;
+        return resp->page;
+    }
+    *len = strlen(resp->data);
+    return resp->data;
+}
+
+// Command type named by an action string: a switch on its length and
+// first bytes picks the one candidate, a memcmp confirms it. -1 if none.
+static int command_from_action(const json_view_t *action) {
+    const char *s = action->data;
+    const char *name = NULL;
+    command_type_t type = CMD_TRY_ACQUIRE;
+    if (action->escaped || action->len < 4) {
+        return -1;
+    }
+    
+    switch (action->len) {
+        case 4:
+            if (s[1] == 'I') {
+                name = "LIST";
+                type = CMD_LIST_MESSAGES;
+            } else {
+                name = "LOGS";
+                type = CMD_GET_LOGS;
+            }
+            break;
+        case 6:
+            switch (s[0]) {
+                case 'C': name = "CREATE"; type = CMD_CREATE_MESSAGE; break;
+                case 'U': name = "UPDATE"; type = CMD_UPDATE_MESSAGE; break;
+                case 'D': name = "DELETE"; type = CMD_DELETE_MESSAGE; break;
+                case 'S':
+                    if (s[1] == 'T') {
+                        name = "STATUS";
+                        type = CMD_GET_STATUS;
+                    } else {
+                        name = "SEARCH";
+                        type = CMD_SEARCH_MESSAGES;
+                    }
+                    break;
+                case 'T': name = "TOGGLE"; type = CMD_TOGGLE_WRITER; break;
+                default: break;
+            }
+            break;
+        case 7:
+            if (s[0] == 'R') {
+                name = "RELEASE";
+                type = CMD_RELEASE;
+            } else {
+                name = "CHANGES";
+                type = CMD_GET_CHANGES;
+            }
+            break;
+        case 9:
+            name = "HEARTBEAT";
+            type = CMD_HEARTBEAT;
+            break;
+        case 11:
+            name = "TRY_ACQUIRE";
+            type = CMD_TRY_ACQUIRE;
+            break;
+        case 12:
+            if (s[0] == 'A') {
+                name = "ACQUIRE_WAIT";
+                type = CMD_ACQUIRE_WAIT;
+            } else {
+                name = "CREATE_BATCH";
+                type = CMD_CREATE_BATCH;
+            }
+            break;
+        default:
+            break;
+    }
+    return name != NULL && memcmp(s, name, action->len) == 0 ? (int)type : -1;
+}
+
+// Copy a string member, truncating like the cJSON path's strncpy.
+// Returns the decoded length, or -1 if it cannot become a C string.
+static long long copy_member_string(const json_member_t *member, char *out, size_t out_size) {
+    return member->type == JSON_VALUE_STRING ? json_view_copy_string(&member->value, out, out_size) : -1;
+}
+
+// Integer member clamped to [min, max]; false for non-integers
+static bool member_int(const json_member_t *member, int min, int max, int *out) {
+    int value;
+    if (member->type != JSON_VALUE_NUMBER || json_view_int(&member->value, &value) != 0) {
+        return false;
+    }
+    *out = value < min ? min : value > max ? max : value;
+    return true;
+}
+
+// CREATE_BATCH texts, copied straight from the input into their own buffers
+static bool parse_messages_fast(const json_member_t *member, command_t *cmd) {
+    json_reader_t reader;
+    json_member_t entry;
+    int capacity = 0;
+    int next;
+    
+    if (json_reader_init_array(&reader, &member->value) != 0) {
+        return false;
+    }
+    while ((next = json_reader_next(&reader, &entry)) == 1) {
+        long long len = entry.type == JSON_VALUE_STRING ? json_view_copy_string(&entry.value, NULL, 0) : -1;
+        if (len < 0 || len > MAX_MESSAGE_LEN || cmd->message_count == COMMAND_MAX_BATCH_MESSAGES) {
+            return false;
+        }
+        if (cmd->message_count == capacity) {
+            capacity = capacity == 0 ? 8 : capacity * 2;
+            char **grown = realloc(cmd->messages, (size_t)capacity * sizeof(char *));
+            if (grown == NULL) {
+                return false;
+            }
+            cmd->messages = grown;
+        }
+        char *copy = malloc((size_t)len + 1);
+        if (copy == NULL) {
+            return false;
+        }
+        json_view_copy_string(&entry.value, copy, (size_t)len + 1);
+        cmd->messages[cmd->message_count++] = copy;
+    }
+    if (next == 0 && cmd->messages == NULL) {
+        cmd->messages = calloc(1, sizeof(char *));  // Empty array, as the cJSON path leaves it
+        return cmd->messages != NULL;
+    }
+    return next == 0;
+}
+
+// Members of the command schema (bit per key; the first occurrence wins,
+// as with cJSON_GetObjectItem())
+enum {
+    KEY_ACTION = 1 << 0, KEY_USER = 1 << 1, KEY_ROOM = 1 << 2, KEY_MESSAGE = 1 << 3,
+    KEY_ID = 1 << 4, KEY_PAGE = 1 << 5, KEY_LIMIT = 1 << 6, KEY_BEFORE = 1 << 7,
+    KEY_AFTER = 1 << 8, KEY_WAIT_MS = 1 << 9, KEY_ENABLED = 1 << 10, KEY_MESSAGES = 1 << 11,
+    KEY_QUERY = 1 << 12, KEY_SINCE = 1 << 13
+};
+
+// Key of the command schema a member name matches (any case, like cJSON); 0 if none
+static int command_key(const json_view_t *key) {
+    if (key->escaped || key->len < 2) {
+        return 0;
+    }
+    int candidate = 0;
+    const char *name = NULL;
+    char first = (char)(key->data[0] | 0x20);
+    
+    switch (key->len) {
+        case 2: candidate = KEY_ID; name = "id"; break;
+        case 4:
+            if (first == 'u') { candidate = KEY_USER; name = "user"; }
+            else if (first == 'r') { candidate = KEY_ROOM; name = "room"; }
+            else { candidate = KEY_PAGE; name = "page"; }
+            break;
+        case 5:
+            if (first == 'l') { candidate = KEY_LIMIT; name = "limit"; }
+            else if (first == 'q') { candidate = KEY_QUERY; name = "query"; }
+            else if (first == 's') { candidate = KEY_SINCE; name = "since"; }
+            else { candidate = KEY_AFTER; name = "after"; }
+            break;
+        case 6:
+            if (first == 'a') { candidate = KEY_ACTION; name = "action"; }
+            else { candidate = KEY_BEFORE; name = "before"; }
+            break;
+        case 7:
+            if (first == 'm') { candidate = KEY_MESSAGE; name = "message"; }
+            else if (first == 'w') { candidate = KEY_WAIT_MS; name = "wait_ms"; }
+            else { candidate = KEY_ENABLED; name = "enabled"; }
+            break;
+        case 8: candidate = KEY_MESSAGES; name = "messages"; break;
+        default: break;
+    }
+    return name != NULL && json_view_equals_nocase(key, name) ? candidate : 0;
+}
+
+// One pass over the command object with no tree and no intermediate
+// copies. Returns false whenever the input strays from what this path
+// handles exactly like cJSON, and the caller then re-parses with cJSON;
+// that costs only malformed or unusual commands a second look.
+static bool parse_json_command_fast(const char *input, command_t *cmd) {
+    json_reader_t reader;
+    json_member_t member;
+    int seen = 0;
+    int next;
+    
+    if (json_reader_init(&reader, input, strlen(input)) != 0) {
+        return false;
+    }
+    while ((next = json_reader_next(&reader, &member)) == 1) {
+        int key = command_key(&member.key);
+        if (key == 0 || (seen & key) != 0) {
+            if (member.key.escaped) {
+                return false;  // Might spell a known key
+            }
+            continue;
+        }
+        seen |= key;
+        
+        bool ok = true;
+        long long len;
+        switch (key) {
+            case KEY_ACTION: {
+                int type = member.type == JSON_VALUE_STRING ? command_from_action(&member.value) : -1;
+                ok = type >= 0;
+                cmd->type = (command_type_t)type;
+                break;
+            }
+            case KEY_USER:
+                ok = member.type != JSON_VALUE_STRING || copy_member_string(&member, cmd->user, sizeof(cmd->user)) >= 0;
+                break;
+            case KEY_ROOM:
+                if (member.type == JSON_VALUE_STRING) {
+                    len = copy_member_string(&member, cmd->room, sizeof(cmd->room));
+                    ok = len >= 0 && (size_t)len < sizeof(cmd->room) && semaphore_valid_room(cmd->room);
+                }
+                break;
+            case KEY_MESSAGE:
+                ok = member.type != JSON_VALUE_STRING ||
+                     copy_member_string(&member, cmd->message, sizeof(cmd->message)) >= 0;
+                break;
+            case KEY_ID:
+                ok = member.type != JSON_VALUE_NUMBER || member_int(&member, INT_MIN, INT_MAX, &cmd->id);
+                break;
+            case KEY_PAGE:
+                ok = member.type != JSON_VALUE_NUMBER || member_int(&member, 1, INT_MAX, &cmd->page);
+                break;
+            case KEY_LIMIT:
+                ok = member.type != JSON_VALUE_NUMBER || member_int(&member, 1, 100, &cmd->limit);
+                break;
+            case KEY_WAIT_MS:
+                ok = member.type != JSON_VALUE_NUMBER ||
+                     member_int(&member, 0, SEMAPHORE_MAX_WAIT_MS, &cmd->wait_ms);
+                break;
+            case KEY_SINCE:
+                if (member.type == JSON_VALUE_NUMBER) {
+                    long long since;
+                    ok = json_view_int64(&member.value, &since) == 0;
+                    if (ok) {
+                        cmd->since = since < 0 ? 0 : since;
+                    }
+                }
+                break;
+            case KEY_BEFORE:
+            case KEY_AFTER:
+                if (member.type == JSON_VALUE_STRING) {
+                    char *cursor = key == KEY_BEFORE ? cmd->before : cmd->after;
+                    len = copy_member_string(&member, cursor, MAX_CURSOR_LEN);
+                    ok = len >= 0 && len < MAX_CURSOR_LEN;
+                }
+                break;
+            case KEY_QUERY:
+                if (member.type == JSON_VALUE_STRING) {
+                    len = copy_member_string(&member, cmd->query, sizeof(cmd->query));
+                    ok = len >= 0 && (size_t)len < sizeof(cmd->query);
+                }
+                break;
+            case KEY_ENABLED:
+                if (member.type == JSON_VALUE_TRUE || member.type == JSON_VALUE_FALSE) {
+                    cmd->enabled = member.type == JSON_VALUE_TRUE;
+                }
+                break;
+            case KEY_MESSAGES:
+                ok = member.type != JSON_VALUE_ARRAY || parse_messages_fast(&member, cmd);
+                break;
+            default:
+                break;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return next == 0 && (seen & KEY_ACTION) != 0;
+}
 
 // Parse JSON command string into command structure
 int parse_json_command(const char *input, command_t *cmd) {
     if (input == NULL || cmd == NULL) {
-        fprintf(stderr, "Invalid parameters for parse_json_command\n");
+        LOG_ERROR("Invalid parameters for parse_json_command\n");
         return -4;
     }
     
+    // Known commands take the single-pass path; cJSON has the final word
+    // on everything else
+    init_command(cmd);
+    if (parse_json_command_fast(input, cmd)) {
+        return 0;
+    }
+    free_command(cmd);
+    
     // Initialize command structure
-    memset(cmd, 0, sizeof(command_t));
-    cmd->page = 1;      // Default page
-    cmd->limit = 50;    // Default limit
+    init_command(cmd);
     
     // Parse JSON
     cJSON *json = cJSON_Parse(input);
     if (json == NULL) {
-        fprintf(stderr, "Failed to parse JSON: %s\n", cJSON_GetErrorPtr());
+        LOG_DEBUG("Failed to parse JSON: %s\n", cJSON_GetErrorPtr());
         return -4;  // Invalid input
     }
     
     // Extract action (required)
     cJSON *action_item = cJSON_GetObjectItem(json, "action");
     if (!cJSON_IsString(action_item)) {
-        fprintf(stderr, "Missing or invalid 'action' field\n");
+        LOG_DEBUG("Missing or invalid 'action' field\n");
         cJSON_Delete(json);
         return -4;
     }
@@ -61,10 +379,16 @@ int parse_json_command(const char *input, command_t *cmd) {
     // Map action string to command type
     if (strcmp(action, "TRY_ACQUIRE") == 0) {
         cmd->type = CMD_TRY_ACQUIRE;
+    } else if (strcmp(action, "ACQUIRE_WAIT") == 0) {
+        cmd->type = CMD_ACQUIRE_WAIT;
     } else if (strcmp(action, "RELEASE") == 0) {
         cmd->type = CMD_RELEASE;
+    } else if (strcmp(action, "HEARTBEAT") == 0) {
+        cmd->type = CMD_HEARTBEAT;
     } else if (strcmp(action, "CREATE") == 0) {
         cmd->type = CMD_CREATE_MESSAGE;
+    } else if (strcmp(action, "CREATE_BATCH") == 0) {
+        cmd->type = CMD_CREATE_BATCH;
     } else if (strcmp(action, "UPDATE") == 0) {
         cmd->type = CMD_UPDATE_MESSAGE;
     } else if (strcmp(action, "DELETE") == 0) {
@@ -77,8 +401,12 @@ int parse_json_command(const char *input, command_t *cmd) {
         cmd->type = CMD_GET_LOGS;
     } else if (strcmp(action, "TOGGLE") == 0) {
         cmd->type = CMD_TOGGLE_WRITER;
+    } else if (strcmp(action, "SEARCH") == 0) {
+        cmd->type = CMD_SEARCH_MESSAGES;
+    } else if (strcmp(action, "CHANGES") == 0) {
+        cmd->type = CMD_GET_CHANGES;
     } else {
-        fprintf(stderr, "Unknown action: %s\n", action);
+        LOG_DEBUG("Unknown action: %s\n", action);
         cJSON_Delete(json);
         return -4;
     }
@@ -90,6 +418,17 @@ int parse_json_command(const char *input, command_t *cmd) {
         cmd->user[MAX_USERNAME_LEN - 1] = '\0';
     }
     
+    // Extract room (optional; semaphore and message commands)
+    cJSON *room_item = cJSON_GetObjectItem(json, "room");
+    if (cJSON_IsString(room_item)) {
+        if (!semaphore_valid_room(room_item->valuestring)) {
+            LOG_DEBUG("Invalid 'room' field\n");
+            cJSON_Delete(json);
+            return -4;
+        }
+        strcpy(cmd->room, room_item->valuestring);
+    }
+    
     // Extract message (for CREATE and UPDATE commands)
     cJSON *message_item = cJSON_GetObjectItem(json, "message");
     if (cJSON_IsString(message_item)) {
@@ -118,69 +457,352 @@ int parse_json_command(const char *input, command_t *cmd) {
         if (cmd->limit > 100) cmd->limit = 100;
     }
     
+    // Extract before/after paging cursors (for LIST and LOGS commands)
+    cJSON *before_item = cJSON_GetObjectItem(json, "before");
+    cJSON *after_item = cJSON_GetObjectItem(json, "after");
+    if ((cJSON_IsString(before_item) && strlen(before_item->valuestring) >= MAX_CURSOR_LEN) ||
+        (cJSON_IsString(after_item) && strlen(after_item->valuestring) >= MAX_CURSOR_LEN)) {
+        LOG_DEBUG("Paging cursor too long\n");
+        cJSON_Delete(json);
+        return -4;
+    }
+    if (cJSON_IsString(before_item)) {
+        strcpy(cmd->before, before_item->valuestring);
+    }
+    if (cJSON_IsString(after_item)) {
+        strcpy(cmd->after, after_item->valuestring);
+    }
+    
+    // Extract query (for SEARCH command)
+    cJSON *query_item = cJSON_GetObjectItem(json, "query");
+    if (cJSON_IsString(query_item)) {
+        if (strlen(query_item->valuestring) > SEARCH_MAX_QUERY_LEN) {
+            LOG_DEBUG("Search query too long\n");
+            cJSON_Delete(json);
+            return -4;
+        }
+        strcpy(cmd->query, query_item->valuestring);
+    }
+    
+    // Extract since (for CHANGES command)
+    cJSON *since_item = cJSON_GetObjectItem(json, "since");
+    if (cJSON_IsNumber(since_item)) {
+        // valueint saturates at INT_MAX, short of a change sequence number
+        double since = since_item->valuedouble;
+        cmd->since = since < 0 ? 0 : since >= (double)LLONG_MAX ? LLONG_MAX : (long long)since;
+    }
+    
+    // Extract wait_ms (for ACQUIRE_WAIT command)
+    cJSON *wait_item = cJSON_GetObjectItem(json, "wait_ms");
+    if (cJSON_IsNumber(wait_item)) {
+        cmd->wait_ms = wait_item->valueint;
+        if (cmd->wait_ms < 0) cmd->wait_ms = 0;
+        if (cmd->wait_ms > SEMAPHORE_MAX_WAIT_MS) cmd->wait_ms = SEMAPHORE_MAX_WAIT_MS;
+    }
+    
     // Extract enabled (for TOGGLE command)
     cJSON *enabled_item = cJSON_GetObjectItem(json, "enabled");
     if (cJSON_IsBool(enabled_item)) {
         cmd->enabled = cJSON_IsTrue(enabled_item);
     }
     
+    // Extract messages (for CREATE_BATCH); copied so the tree can go now
+    cJSON *messages_item = cJSON_GetObjectItem(json, "messages");
+    if (cJSON_IsArray(messages_item)) {
+        int count = cJSON_GetArraySize(messages_item);
+        if (count > COMMAND_MAX_BATCH_MESSAGES) {
+            LOG_DEBUG("Too many messages in batch (%d, max %d)\n", count, COMMAND_MAX_BATCH_MESSAGES);
+            cJSON_Delete(json);
+            return -4;
+        }
+        cmd->messages = calloc(count > 0 ? (size_t)count : 1, sizeof(char *));
+        if (cmd->messages == NULL) {
+            cJSON_Delete(json);
+            return -1;
+        }
+        cJSON *entry = NULL;
+        cJSON_ArrayForEach(entry, messages_item) {
+            if (!cJSON_IsString(entry) || strlen(entry->valuestring) > MAX_MESSAGE_LEN) {
+                LOG_DEBUG("Invalid entry in 'messages' array\n");
+                free_command(cmd);
+                cJSON_Delete(json);
+                return -4;
+            }
+            size_t len = strlen(entry->valuestring);
+            char *copy = malloc(len + 1);
+            if (copy == NULL) {
+                free_command(cmd);
+                cJSON_Delete(json);
+                return -1;
+            }
+            memcpy(copy, entry->valuestring, len + 1);
+            cmd->messages[cmd->message_count++] = copy;
+        }
+    }
+    
     cJSON_Delete(json);
     return 0;
 }
 
+// Big-endian field readers for parse_binary_command()
+static uint32_t read_u32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static uint64_t read_u64(const unsigned char *p) {
+    return ((uint64_t)read_u32(p) << 32) | read_u32(p + 4);
+}
+
+// Copy an unterminated string field; -4 if it does not fit
+static int copy_field(char *out, size_t out_size, const unsigned char *value, size_t len) {
+    if (len >= out_size) {
+        return -4;
+    }
+    memcpy(out, value, len);
+    out[len] = '\0';
+    return 0;
+}
+
+// Clamp an unsigned wire integer into an int range
+static int field_int(uint32_t value, int min, int max) {
+    if (value > (uint32_t)max) {
+        return max;
+    }
+    return (int)value < min ? min : (int)value;
+}
+
+// Decode the fields of a binary command frame (see handlers.h) into the
+// same structure, defaults and limits as parse_json_command()
+int parse_binary_command(const unsigned char *fields, size_t len, command_type_t type, command_t *cmd) {
+    if (cmd == NULL || (fields == NULL && len > 0)) {
+        LOG_ERROR("Invalid parameters for parse_binary_command\n");
+        return -4;
+    }
+    
+    init_command(cmd);
+    if ((unsigned)type >= CMD_TYPE_COUNT) {
+        LOG_DEBUG("Unknown binary command type %u\n", (unsigned)type);
+        return -4;
+    }
+    cmd->type = type;
+    
+    size_t offset = 0;
+    while (offset < len) {
+        if (len - offset < 3) {
+            LOG_DEBUG("Truncated field header in binary command\n");
+            free_command(cmd);
+            return -4;
+        }
+        int tag = fields[offset];
+        size_t value_len = ((size_t)fields[offset + 1] << 8) | fields[offset + 2];
+        const unsigned char *value = fields + offset + 3;
+        offset += 3;
+        if (value_len > len - offset) {
+            LOG_DEBUG("Truncated field %d in binary command\n", tag);
+            free_command(cmd);
+            return -4;
+        }
+        offset += value_len;
+    
+        bool numeric = tag == FIELD_ID || tag == FIELD_PAGE || tag == FIELD_LIMIT || tag == FIELD_WAIT_MS;
+        if ((numeric && value_len != 4) || (tag == FIELD_SINCE && value_len != 4 && value_len != 8) ||
+            (tag == FIELD_ENABLED && value_len != 1)) {
+            LOG_DEBUG("Bad length %zu for field %d\n", value_len, tag);
+            free_command(cmd);
+            return -4;
+        }
+    
+        int status = 0;
+        switch (tag) {
+            case FIELD_USER:
+                // Over-long names are cut like the JSON parser's
+                status = copy_field(cmd->user, sizeof(cmd->user), value,
+                                    value_len < MAX_USERNAME_LEN ? value_len : MAX_USERNAME_LEN - 1);
+                break;
+            case FIELD_ROOM:
+                status = copy_field(cmd->room, sizeof(cmd->room), value, value_len);
+                if (status == 0 && !semaphore_valid_room(cmd->room)) {
+                    status = -4;
+                }
+                break;
+            case FIELD_MESSAGE:
+                if (type != CMD_CREATE_BATCH) {
+                    status = copy_field(cmd->message, sizeof(cmd->message), value,
+                                        value_len < MAX_MESSAGE_LEN ? value_len : MAX_MESSAGE_LEN - 1);
+                    break;
+                }
+                if (cmd->message_count == COMMAND_MAX_BATCH_MESSAGES || value_len > MAX_MESSAGE_LEN) {
+                    status = -4;
+                    break;
+                }
+                if (cmd->messages == NULL) {
+                    cmd->messages = calloc(COMMAND_MAX_BATCH_MESSAGES, sizeof(char *));
+                }
+                char *copy = cmd->messages != NULL ? malloc(value_len + 1) : NULL;
+                if (copy == NULL) {
+                    status = -1;
+                    break;
+                }
+                memcpy(copy, value, value_len);
+                copy[value_len] = '\0';
+                cmd->messages[cmd->message_count++] = copy;
+                break;
+            case FIELD_ID:
+                cmd->id = field_int(read_u32(value), 0, 0x7FFFFFFF);
+                break;
+            case FIELD_PAGE:
+                cmd->page = field_int(read_u32(value), 1, 0x7FFFFFFF);
+                break;
+            case FIELD_LIMIT:
+                cmd->limit = field_int(read_u32(value), 1, 100);
+                break;
+            case FIELD_WAIT_MS:
+                cmd->wait_ms = field_int(read_u32(value), 0, SEMAPHORE_MAX_WAIT_MS);
+                break;
+            case FIELD_BEFORE:
+                status = copy_field(cmd->before, sizeof(cmd->before), value, value_len);
+                break;
+            case FIELD_AFTER:
+                status = copy_field(cmd->after, sizeof(cmd->after), value, value_len);
+                break;
+            case FIELD_ENABLED:
+                cmd->enabled = value[0] != 0;
+                break;
+            case FIELD_QUERY:
+                status = copy_field(cmd->query, sizeof(cmd->query), value, value_len);
+                break;
+            case FIELD_SINCE: {
+                uint64_t since = value_len == 8 ? read_u64(value) : read_u32(value);
+                cmd->since = since > (uint64_t)LLONG_MAX ? LLONG_MAX : (long long)since;
+                break;
+            }
+            default:
+                break;  // Unknown tags are skipped, so clients may send newer fields
+        }
+        if (status != 0) {
+            LOG_DEBUG("Invalid field %d in binary command\n", tag);
+            free_command(cmd);
+            return status;
+        }
+    }
+    
+    return 0;
+}
+
+// Hand a page built in the request arena to the response without copying
+// it, whatever its size; strbuf_free() of an arena buffer leaves it in place
+static int store_page(response_t *resp, strbuf_t *page) {
+    if (page->failed || page->data == NULL) {
+        strcpy(resp->error, "Out of memory building reply");
+        return -1;
+    }
+    resp->page = page->data;
+    resp->page_len = page->len;
+    return 0;
+}
+
+// An unset cursor field is passed to the database layer as NULL
+static const char *cursor_arg(const char *cursor) {
+    return cursor[0] != '\0' ? cursor : NULL;
+}
+
+// Room a command applies to, as reported back to the client
+static const char *room_name(const command_t *cmd) {
+    return cmd->room[0] != '\0' ? cmd->room : SEMAPHORE_DEFAULT_ROOM;
+}
+
+// Fill in the data or error of an acquire whose outcome is resp->status;
+// also used for acquires that completed asynchronously
+void describe_acquire(const command_t *cmd, response_t *resp) {
+    if (resp->status == 0) {
+        snprintf(resp->data, sizeof(resp->data), 
+                "{\"room\":\"%s\",\"semaphore\":0,\"holder\":\"%s\"}",
+                room_name(cmd), cmd->user);
+    } else if (resp->status == -3) {
+        char current_holder[MAX_USERNAME_LEN];
+        int semaphore_value;
+        get_semaphore_status(cmd->room, current_holder, &semaphore_value);
+        snprintf(resp->data, sizeof(resp->data), 
+                "{\"room\":\"%s\",\"semaphore\":%d,\"holder\":\"%s\"}", 
+                room_name(cmd), semaphore_value, current_holder);
+        strcpy(resp->error, "Semaphore unavailable");
+    } else if (resp->status == -2) {
+        strcpy(resp->error, "Writer access disabled");
+    } else {
+        strcpy(resp->error, "Failed to acquire semaphore");
+    }
+}
+
 // Execute a parsed command and generate response
 int execute_command(const command_t *cmd, response_t *resp) {
     if (cmd == NULL || resp == NULL) {
-        fprintf(stderr, "Invalid parameters for execute_command\n");
+        LOG_ERROR("Invalid parameters for execute_command\n");
         return -4;
     }
     
     // Initialize response
-    memset(resp, 0, sizeof(response_t));
+    init_response(resp);
     
     switch (cmd->type) {
-        case CMD_TRY_ACQUIRE: {
+        case CMD_TRY_ACQUIRE:
+        case CMD_ACQUIRE_WAIT: {
+            if (strlen(cmd->user) == 0) {
+                resp->status = -4;
+                strcpy(resp->error, cmd->type == CMD_ACQUIRE_WAIT
+                                    ? "Username required for ACQUIRE_WAIT"
+                                    : "Username required for TRY_ACQUIRE");
+                return resp->status;
+            }
+            
+            // Waiting would park this thread (the event loop or a pool worker)
+            // for up to wait_ms; the front ends queue ACQUIRE_WAIT themselves
+            // through acquire_writer_queued() and answer when it resolves
+            if (cmd->type == CMD_ACQUIRE_WAIT && cmd->wait_ms > 0) {
+                resp->status = -4;
+                strcpy(resp->error, "ACQUIRE_WAIT is only served by the HTTP and command socket front ends");
+                return resp->status;
+            }
+            
+            resp->status = try_acquire_writer(cmd->room, cmd->user);
+            describe_acquire(cmd, resp);
+            break;
+        }
+        
+        case CMD_RELEASE: {
             if (strlen(cmd->user) == 0) {
                 resp->status = -4;
-                strcpy(resp->error, "Username required for TRY_ACQUIRE");
+                strcpy(resp->error, "Username required for RELEASE");
                 return resp->status;
             }
             
-            resp->status = try_acquire_writer(cmd->user);
+            resp->status = release_writer(cmd->room, cmd->user);
             if (resp->status == 0) {
                 snprintf(resp->data, sizeof(resp->data), 
-                        "{\"semaphore\":0,\"holder\":\"%s\"}", cmd->user);
-            } else if (resp->status == -3) {
-                char current_holder[MAX_USERNAME_LEN];
-                int semaphore_value;
-                get_semaphore_status(current_holder, &semaphore_value);
-                snprintf(resp->data, sizeof(resp->data), 
-                        "{\"semaphore\":%d,\"holder\":\"%s\"}", 
-                        semaphore_value, current_holder);
-                strcpy(resp->error, "Semaphore unavailable");
+                        "{\"room\":\"%s\",\"semaphore\":1,\"holder\":\"\"}", room_name(cmd));
             } else if (resp->status == -2) {
-                strcpy(resp->error, "Writer access disabled");
+                strcpy(resp->error, "Permission denied - not semaphore holder");
             } else {
-                strcpy(resp->error, "Failed to acquire semaphore");
+                strcpy(resp->error, "Failed to release semaphore");
             }
             break;
         }
         
-        case CMD_RELEASE: {
+        case CMD_HEARTBEAT: {
             if (strlen(cmd->user) == 0) {
                 resp->status = -4;
-                strcpy(resp->error, "Username required for RELEASE");
+                strcpy(resp->error, "Username required for HEARTBEAT");
                 return resp->status;
             }
             
-            resp->status = release_writer(cmd->user);
+            resp->status = semaphore_renew_lease(cmd->room, cmd->user);
             if (resp->status == 0) {
                 snprintf(resp->data, sizeof(resp->data), 
-                        "{\"semaphore\":1,\"holder\":\"\"}");
+                        "{\"room\":\"%s\",\"holder\":\"%s\",\"lease_ms\":%d}",
+                        room_name(cmd), cmd->user, semaphore_lease_remaining_ms(cmd->room));
             } else if (resp->status == -2) {
                 strcpy(resp->error, "Permission denied - not semaphore holder");
             } else {
-                strcpy(resp->error, "Failed to release semaphore");
+                strcpy(resp->error, "Failed to renew lease");
             }
             break;
         }
@@ -193,10 +815,10 @@ int execute_command(const command_t *cmd, response_t *resp) {
             }
             
             char timestamp[MAX_TIMESTAMP_LEN];
-            resp->status = create_message(cmd->user, cmd->message, timestamp);
+            resp->status = create_message(cmd->room, cmd->user, cmd->message, timestamp);
             if (resp->status == 0) {
                 snprintf(resp->data, sizeof(resp->data), 
-                        "{\"timestamp\":\"%s\"}", timestamp);
+                        "{\"room\":\"%s\",\"timestamp\":\"%s\"}", room_name(cmd), timestamp);
             } else if (resp->status == -2) {
                 strcpy(resp->error, "Permission denied - semaphore not held");
             } else if (resp->status == -5) {
@@ -207,6 +829,58 @@ int execute_command(const command_t *cmd, response_t *resp) {
             break;
         }
         
+        case CMD_CREATE_BATCH: {
+            if (strlen(cmd->user) == 0 || cmd->message_count == 0) {
+                resp->status = -4;
+                strcpy(resp->error, "Username and a non-empty messages array required for CREATE_BATCH");
+                return resp->status;
+            }
+            
+            message_ref_t *refs = arena_alloc(request_arena(), (size_t)cmd->message_count * sizeof(message_ref_t));
+            if (refs == NULL) {
+                resp->status = -1;
+                strcpy(resp->error, "Out of memory");
+                return resp->status;
+            }
+            resp->status = create_message_batch(cmd->room, cmd->user, (const char *const *)cmd->messages,
+                                                cmd->message_count, refs);
+            if (resp->status == 0) {
+                strbuf_t data;
+                json_writer_t w;
+                strbuf_init_arena(&data, request_arena());
+                json_writer_init(&w, &data);
+                json_begin_object(&w);
+                json_field_string(&w, "room", room_name(cmd));
+                json_field_int(&w, "count", cmd->message_count);
+                json_key(&w, "messages");
+                json_begin_array(&w);
+                for (int i = 0; i < cmd->message_count; i++) {
+                    json_begin_object(&w);
+                    json_field_int(&w, "id", refs[i].id);
+                    json_field_string(&w, "timestamp", refs[i].timestamp);
+                    json_end_object(&w);
+                }
+                json_end_array(&w);
+                json_end_object(&w);
+                if (json_writer_finish(&w) == 0) {
+                    resp->status = store_page(resp, &data);
+                } else {
+                    resp->status = -1;
+                    strcpy(resp->error, "Out of memory building reply");
+                }
+                strbuf_free(&data);
+            } else if (resp->status == -2) {
+                strcpy(resp->error, "Permission denied - semaphore not held");
+            } else if (resp->status == -4) {
+                strcpy(resp->error, "Invalid message in batch");
+            } else if (resp->status == -5) {
+                strcpy(resp->error, "Database error - no messages stored");
+            } else {
+                strcpy(resp->error, "Failed to create messages");
+            }
+            break;
+        }
+        
         case CMD_UPDATE_MESSAGE: {
             if (strlen(cmd->user) == 0 || strlen(cmd->message) == 0 || cmd->id <= 0) {
                 resp->status = -4;
@@ -214,7 +888,7 @@ int execute_command(const command_t *cmd, response_t *resp) {
                 return resp->status;
             }
             
-            resp->status = update_message(cmd->id, cmd->user, cmd->message);
+            resp->status = update_message(cmd->room, cmd->id, cmd->user, cmd->message);
             if (resp->status == 0) {
                 snprintf(resp->data, sizeof(resp->data), 
                         "{\"id\":%d}", cmd->id);
@@ -235,7 +909,7 @@ int execute_command(const command_t *cmd, response_t *resp) {
                 return resp->status;
             }
             
-            resp->status = delete_message(cmd->id, cmd->user);
+            resp->status = delete_message(cmd->room, cmd->id, cmd->user);
             if (resp->status == 0) {
                 snprintf(resp->data, sizeof(resp->data), 
                         "{\"id\":%d}", cmd->id);
@@ -250,27 +924,36 @@ int execute_command(const command_t *cmd, response_t *resp) {
         }
         
         case CMD_LIST_MESSAGES: {
-            resp->status = list_messages(cmd->page, cmd->limit, resp->data);
-            if (resp->status != 0) {
+            // No room lists every room
+            strbuf_t page;
+            strbuf_init_arena(&page, request_arena());
+            resp->status = list_messages(cmd->room[0] != '\0' ? cmd->room : NULL,
+                                         cmd->page, cmd->limit, cursor_arg(cmd->before),
+                                         cursor_arg(cmd->after), &page);
+            if (resp->status == 0) {
+                resp->status = store_page(resp, &page);
+            } else {
                 if (resp->status == -4) {
-                    strcpy(resp->error, "Invalid page or limit parameters");
+                    strcpy(resp->error, "Invalid page, limit or cursor parameters");
                 } else if (resp->status == -5) {
                     strcpy(resp->error, "Database error");
                 } else {
                     strcpy(resp->error, "Failed to list messages");
                 }
             }
+            strbuf_free(&page);
             break;
         }
         
         case CMD_GET_STATUS: {
             char current_holder[MAX_USERNAME_LEN];
             int semaphore_value;
-            resp->status = get_semaphore_status(current_holder, &semaphore_value);
+            resp->status = get_semaphore_status(cmd->room, current_holder, &semaphore_value);
             if (resp->status == 0) {
                 snprintf(resp->data, sizeof(resp->data), 
-                        "{\"semaphore\":%d,\"holder\":\"%s\"}", 
-                        semaphore_value, current_holder);
+                        "{\"room\":\"%s\",\"semaphore\":%d,\"holder\":\"%s\",\"lease_ms\":%d,\"waiting\":%d}", 
+                        room_name(cmd), semaphore_value, current_holder,
+                        semaphore_lease_remaining_ms(cmd->room), semaphore_queue_length(cmd->room));
             } else {
                 strcpy(resp->error, "Failed to get semaphore status");
             }
@@ -278,16 +961,22 @@ int execute_command(const command_t *cmd, response_t *resp) {
         }
         
         case CMD_GET_LOGS: {
-            resp->status = get_logs(cmd->page, cmd->limit, resp->data);
-            if (resp->status != 0) {
+            strbuf_t page;
+            strbuf_init_arena(&page, request_arena());
+            resp->status = get_logs(cmd->page, cmd->limit, cursor_arg(cmd->before),
+                                    cursor_arg(cmd->after), &page);
+            if (resp->status == 0) {
+                resp->status = store_page(resp, &page);
+            } else {
                 if (resp->status == -4) {
-                    strcpy(resp->error, "Invalid page or limit parameters");
+                    strcpy(resp->error, "Invalid page, limit or cursor parameters");
                 } else if (resp->status == -5) {
                     strcpy(resp->error, "Database error");
                 } else {
                     strcpy(resp->error, "Failed to get logs");
                 }
             }
+            strbuf_free(&page);
             break;
         }
         
@@ -308,6 +997,51 @@ int execute_command(const command_t *cmd, response_t *resp) {
             break;
         }
         
+        case CMD_SEARCH_MESSAGES: {
+            // No room searches every room
+            strbuf_t page;
+            strbuf_init_arena(&page, request_arena());
+            resp->status = search_messages(cmd->room[0] != '\0' ? cmd->room : NULL, cmd->query,
+                                           cmd->page, cmd->limit, &page);
+            if (resp->status == 0) {
+                resp->status = store_page(resp, &page);
+            } else {
+                if (resp->status == -4) {
+                    strcpy(resp->error, "Invalid query, page or limit parameters");
+                } else if (resp->status == -3) {
+                    strcpy(resp->error, "Search not available");
+                } else if (resp->status == -5) {
+                    strcpy(resp->error, "Database error");
+                } else {
+                    strcpy(resp->error, "Failed to search messages");
+                }
+            }
+            strbuf_free(&page);
+            break;
+        }
+        
+        case CMD_GET_CHANGES: {
+            // No room follows every room
+            strbuf_t page;
+            strbuf_init_arena(&page, request_arena());
+            resp->status = get_changes(cmd->room[0] != '\0' ? cmd->room : NULL, cmd->since, cmd->limit, &page);
+            if (resp->status == 0) {
+                resp->status = store_page(resp, &page);
+            } else {
+                if (resp->status == -4) {
+                    strcpy(resp->error, "Invalid since or limit parameters");
+                } else if (resp->status == -3) {
+                    strcpy(resp->error, "Change feed not available");
+                } else if (resp->status == -5) {
+                    strcpy(resp->error, "Database error");
+                } else {
+                    strcpy(resp->error, "Failed to get changes");
+                }
+            }
+            strbuf_free(&page);
+            break;
+        }
+        
         default:
             resp->status = -4;
             strcpy(resp->error, "Unknown command type");
@@ -317,18 +1051,25 @@ int execute_command(const command_t *cmd, response_t *resp) {
     return resp->status;
 }
 
-// Main command handler function - parses JSON input and generates JSON output
+// Main command handler function - parses JSON input and generates JSON output.
+// The command and response live in the calling thread's request arena, which
+// the worker pool and event loop reset once the request is answered.
 int handle_command(const char *json_input, char *json_output) {
     if (json_input == NULL || json_output == NULL) {
-        fprintf(stderr, "Invalid parameters for handle_command\n");
+        LOG_ERROR("Invalid parameters for handle_command\n");
         return -4;
     }
     
-    command_t cmd;
-    response_t resp;
+    command_t *cmd = arena_alloc(request_arena(), sizeof(command_t));
+    response_t *resp = arena_alloc(request_arena(), sizeof(response_t));
+    if (cmd == NULL || resp == NULL) {
+        snprintf(json_output, MAX_JSON_LEN, 
+                "{\"status\":\"ERROR\",\"error\":\"Out of memory\"}");
+        return -1;
+    }
     
     // Parse the JSON command
-    int parse_result = parse_json_command(json_input, &cmd);
+    int parse_result = parse_json_command(json_input, cmd);
     if (parse_result != 0) {
         // Generate error response for parsing failure
         snprintf(json_output, MAX_JSON_LEN, 
@@ -337,14 +1078,24 @@ int handle_command(const char *json_input, char *json_output) {
     }
     
     // Execute the command
-    int exec_result = execute_command(&cmd, &resp);
+    uint64_t started = monotonic_ns();
+    int exec_result = execute_command(cmd, resp);
+    metrics_observe((metric_histogram_t)(METRIC_COMMAND_BASE + cmd->type), monotonic_ns() - started);
+    free_command(cmd);
     
     // Generate JSON response
-    if (resp.status == 0) {
+    if (resp->status == 0) {
         // Success response
-        if (strlen(resp.data) > 0) {
+        size_t data_len;
+        const char *data = response_data(resp, &data_len);
+        if (data_len + 32 > MAX_JSON_LEN) {
+            // handle_command() output is MAX_JSON_LEN by contract; refuse rather than cut a row
+            snprintf(json_output, MAX_JSON_LEN, 
+                    "{\"status\":\"ERROR\",\"error\":\"Page too large for command response; lower the limit\"}");
+            return -5;
+        } else if (data_len > 0) {
             snprintf(json_output, MAX_JSON_LEN, 
-                    "{\"status\":\"OK\",\"data\":%s}", resp.data);
+                    "{\"status\":\"OK\",\"data\":%s}", data);
         } else {
             snprintf(json_output, MAX_JSON_LEN, 
                     "{\"status\":\"OK\"}");
@@ -353,7 +1104,7 @@ int handle_command(const char *json_input, char *json_output) {
         // Error response
         snprintf(json_output, MAX_JSON_LEN, 
                 "{\"status\":\"ERROR\",\"error\":\"%s\"}", 
-                strlen(resp.error) > 0 ? resp.error : "Unknown error");
+                strlen(resp->error) > 0 ? resp->error : "Unknown error");
     }
     
     return exec_result;
@@ -0,0 +1,329 @@
+// HTTP Parser Implementation
+// Incremental HTTP/1.x request parser working in place on a connection's input
+//
+// The parser is a state machine over the raw bytes at the front of the
+// buffer. It remembers how far it has looked, so a request trickling in
+// over many reads is examined once rather than rescanned from the start
+// each time. Results are spans into the buffer itself: nothing is copied
+// out, and a chunked body is decoded by sliding each chunk down over the
+// chunk framing, leaving the whole body contiguous right after the head.
+//
+// Requests carrying both Content-Length and Transfer-Encoding, and
+// conflicting Content-Length values, are rejected; a proxy in front of the
+// daemon might frame them differently.
+
+#include <string.h>
+#include <ctype.h>
+
+#include "http_parser.h"
+
+#define CHUNK_LINE_MAX 64                    // Hex size plus any extensions
+
+void http_parser_reset(http_parser_t *parser) {
+    memset(parser, 0, sizeof(*parser));
+}
+
+http_slice_t http_parser_slice(const char *buf, http_span_t span) {
+    http_slice_t slice;
+    slice.data = buf + span.offset;
+    slice.length = span.length;
+    return slice;
+}
+
+// Case-insensitive comparison against a NUL-terminated string
+bool http_slice_equals(http_slice_t slice, const char *text) {
+    size_t length = strlen(text);
+    if (slice.length != length) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (tolower((unsigned char)slice.data[i]) != tolower((unsigned char)text[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// First header called name (any case); value points into buf
+bool http_parser_header(const http_parser_t *parser, const char *buf, const char *name, http_slice_t *value) {
+    for (int i = 0; i < parser->header_count; i++) {
+        if (http_slice_equals(http_parser_slice(buf, parser->headers[i].name), name)) {
+            *value = http_parser_slice(buf, parser->headers[i].value);
+            return true;
+        }
+    }
+    return false;
+}
+
+static http_span_t make_span(size_t start, size_t end) {
+    http_span_t span;
+    span.offset = start;
+    span.length = end - start;
+    return span;
+}
+
+// Offset of the next "\r\n" in buf[from, end), or end if there is none
+static size_t find_crlf(const char *buf, size_t from, size_t end) {
+    for (size_t i = from; i + 1 < end; i++) {
+        if (buf[i] == '\r' && buf[i + 1] == '\n') {
+            return i;
+        }
+    }
+    return end;
+}
+
+static bool is_token_char(unsigned char c) {
+    return isalnum(c) || (c != '\0' && strchr("!#$%&'*+-.^_`|~", c) != NULL);
+}
+
+// Content-Length must be all digits; anything else cannot be framed safely
+static http_parse_status_t parse_content_length(http_slice_t value, size_t limit, size_t *out) {
+    if (value.length == 0) {
+        return HTTP_PARSE_INVALID;
+    }
+    size_t length = 0;
+    for (size_t i = 0; i < value.length; i++) {
+        if (!isdigit((unsigned char)value.data[i])) {
+            return HTTP_PARSE_INVALID;
+        }
+        length = length * 10 + (size_t)(value.data[i] - '0');
+        if (length > limit) {
+            return HTTP_PARSE_TOO_LARGE;
+        }
+    }
+    *out = length;
+    return HTTP_PARSE_COMPLETE;
+}
+
+// Split the request line and header lines of a complete head
+static http_parse_status_t parse_head(http_parser_t *parser, const char *buf, size_t max_request) {
+    size_t end = parser->head_length - 2;    // Past the last header's CRLF
+    size_t line_end = find_crlf(buf, 0, end);
+
+    // Request line: method SP target [SP version]
+    size_t pos = 0;
+    while (pos < line_end && is_token_char((unsigned char)buf[pos])) {
+        pos++;
+    }
+    if (pos == 0 || pos == line_end || buf[pos] != ' ') {
+        return HTTP_PARSE_INVALID;
+    }
+    parser->method = make_span(0, pos);
+
+    size_t target_start = ++pos;
+    size_t query_start = 0;
+    while (pos < line_end && buf[pos] != ' ') {
+        if (buf[pos] == '?' && query_start == 0) {
+            query_start = pos + 1;
+        }
+        pos++;
+    }
+    if (pos == target_start) {
+        return HTTP_PARSE_INVALID;
+    }
+    if (query_start != 0) {
+        parser->path = make_span(target_start, query_start - 1);
+        parser->query = make_span(query_start, pos);
+        parser->has_query = true;
+    } else {
+        parser->path = make_span(target_start, pos);
+    }
+    parser->version = make_span(pos < line_end ? pos + 1 : pos, line_end);
+
+    // Header lines
+    bool has_length = false;
+    for (size_t line = line_end + 2; line < end; line = line_end + 2) {
+        line_end = find_crlf(buf, line, end + 2);
+        if (buf[line] == ' ' || buf[line] == '\t') {
+            return HTTP_PARSE_INVALID;       // Obsolete line folding
+        }
+
+        size_t colon = line;
+        while (colon < line_end && is_token_char((unsigned char)buf[colon])) {
+            colon++;
+        }
+        if (colon == line || colon == line_end || buf[colon] != ':') {
+            return HTTP_PARSE_INVALID;
+        }
+        if (parser->header_count == HTTP_MAX_HEADERS) {
+            return HTTP_PARSE_TOO_LARGE;
+        }
+
+        size_t value_start = colon + 1;
+        size_t value_end = line_end;
+        while (value_start < value_end && (buf[value_start] == ' ' || buf[value_start] == '\t')) {
+            value_start++;
+        }
+        while (value_end > value_start && (buf[value_end - 1] == ' ' || buf[value_end - 1] == '\t')) {
+            value_end--;
+        }
+
+        http_header_t *header = &parser->headers[parser->header_count++];
+        header->name = make_span(line, colon);
+        header->value = make_span(value_start, value_end);
+
+        http_slice_t name = http_parser_slice(buf, header->name);
+        http_slice_t value = http_parser_slice(buf, header->value);
+        if (http_slice_equals(name, "Content-Length")) {
+            size_t length = 0;
+            http_parse_status_t status = parse_content_length(value, max_request - parser->head_length, &length);
+            if (status != HTTP_PARSE_COMPLETE) {
+                return status;
+            }
+            if (has_length && length != parser->content_length) {
+                return HTTP_PARSE_INVALID;
+            }
+            parser->content_length = length;
+            has_length = true;
+        } else if (http_slice_equals(name, "Transfer-Encoding")) {
+            if (!http_slice_equals(value, "chunked")) {
+                return HTTP_PARSE_UNSUPPORTED;
+            }
+            parser->chunked = true;
+        }
+    }
+
+    if (parser->chunked && has_length) {
+        return HTTP_PARSE_INVALID;
+    }
+    return HTTP_PARSE_COMPLETE;
+}
+
+// Hex size at the start of a chunk line; extensions after ';' are ignored
+static http_parse_status_t parse_chunk_size(const char *buf, size_t start, size_t end, size_t limit,
+                                            size_t *out) {
+    size_t size = 0;
+    size_t pos = start;
+    while (pos < end && isxdigit((unsigned char)buf[pos])) {
+        int digit = isdigit((unsigned char)buf[pos]) ? buf[pos] - '0'
+                                                     : tolower((unsigned char)buf[pos]) - 'a' + 10;
+        size = size * 16 + (size_t)digit;
+        if (size > limit) {
+            return HTTP_PARSE_TOO_LARGE;
+        }
+        pos++;
+    }
+    if (pos == start) {
+        return HTTP_PARSE_INVALID;
+    }
+    while (pos < end && (buf[pos] == ' ' || buf[pos] == '\t')) {
+        pos++;
+    }
+    if (pos < end && buf[pos] != ';') {
+        return HTTP_PARSE_INVALID;
+    }
+    *out = size;
+    return HTTP_PARSE_COMPLETE;
+}
+
+// Advance over buf[0, len), the input received so far. Requests whose head
+// and body come to more than max_request bytes are refused. On completion the body is body_length bytes at
+// buf + head_length and the request occupies request_length bytes;
+// chunked input before request_length has been rewritten by then.
+http_parse_status_t http_parser_execute(http_parser_t *parser, char *buf, size_t len, size_t max_request) {
+    for (;;) {
+        switch (parser->phase) {
+            case HTTP_PHASE_HEAD: {
+                // Resume just before where the last search gave up, in case
+                // the blank line was split across reads
+                size_t from = parser->scanned >= 3 ? parser->scanned - 3 : 0;
+                size_t limit = len < HTTP_MAX_HEAD_LENGTH ? len : HTTP_MAX_HEAD_LENGTH;
+                size_t found = limit;
+                for (size_t i = from; i + 3 < limit; i++) {
+                    if (buf[i] == '\r' && buf[i + 1] == '\n' && buf[i + 2] == '\r' && buf[i + 3] == '\n') {
+                        found = i;
+                        break;
+                    }
+                }
+                if (found == limit) {
+                    parser->scanned = limit;
+                    return len >= HTTP_MAX_HEAD_LENGTH ? HTTP_PARSE_TOO_LARGE : HTTP_PARSE_INCOMPLETE;
+                }
+
+                parser->head_length = found + 4;
+                http_parse_status_t status = parse_head(parser, buf, max_request);
+                if (status != HTTP_PARSE_COMPLETE) {
+                    return status;
+                }
+                parser->scanned = parser->head_length;
+                parser->phase = parser->chunked ? HTTP_PHASE_CHUNK_SIZE : HTTP_PHASE_BODY;
+                break;
+            }
+
+            case HTTP_PHASE_BODY:
+                if (len - parser->head_length < parser->content_length) {
+                    parser->scanned = len;
+                    return HTTP_PARSE_INCOMPLETE;
+                }
+                parser->body_length = parser->content_length;
+                parser->request_length = parser->head_length + parser->content_length;
+                parser->phase = HTTP_PHASE_DONE;
+                break;
+
+            case HTTP_PHASE_CHUNK_SIZE: {
+                // A size line is short, so an incomplete one is simply
+                // looked at again when the rest arrives
+                size_t line_end = find_crlf(buf, parser->scanned, len);
+                if (line_end == len) {
+                    return len - parser->scanned > CHUNK_LINE_MAX ? HTTP_PARSE_INVALID : HTTP_PARSE_INCOMPLETE;
+                }
+                size_t size = 0;
+                http_parse_status_t status = parse_chunk_size(buf, parser->scanned, line_end,
+                                                              max_request - parser->head_length - parser->body_length, &size);
+                if (status != HTTP_PARSE_COMPLETE) {
+                    return status;
+                }
+                parser->scanned = line_end + 2;
+                parser->chunk_left = size;
+                parser->phase = size > 0 ? HTTP_PHASE_CHUNK_DATA : HTTP_PHASE_TRAILER;
+                break;
+            }
+
+            case HTTP_PHASE_CHUNK_DATA: {
+                size_t available = len - parser->scanned;
+                size_t take = available < parser->chunk_left ? available : parser->chunk_left;
+                // The decoded body only ever trails the raw input, so this
+                // never overwrites bytes that are still unread
+                memmove(buf + parser->head_length + parser->body_length, buf + parser->scanned, take);
+                parser->body_length += take;
+                parser->scanned += take;
+                parser->chunk_left -= take;
+                if (parser->chunk_left > 0) {
+                    return HTTP_PARSE_INCOMPLETE;
+                }
+                parser->phase = HTTP_PHASE_CHUNK_END;
+                break;
+            }
+
+            case HTTP_PHASE_CHUNK_END:
+                if (len - parser->scanned < 2) {
+                    return HTTP_PARSE_INCOMPLETE;
+                }
+                if (buf[parser->scanned] != '\r' || buf[parser->scanned + 1] != '\n') {
+                    return HTTP_PARSE_INVALID;
+                }
+                parser->scanned += 2;
+                parser->phase = HTTP_PHASE_CHUNK_SIZE;
+                break;
+
+            case HTTP_PHASE_TRAILER: {
+                // Trailer fields are skipped; an empty line ends the request
+                size_t line_end = find_crlf(buf, parser->scanned, len);
+                if (line_end == len) {
+                    return len - parser->scanned > HTTP_MAX_HEAD_LENGTH ? HTTP_PARSE_TOO_LARGE
+                                                                        : HTTP_PARSE_INCOMPLETE;
+                }
+                bool last = line_end == parser->scanned;
+                parser->scanned = line_end + 2;
+                if (last) {
+                    parser->request_length = parser->scanned;
+                    parser->phase = HTTP_PHASE_DONE;
+                }
+                break;
+            }
+
+            case HTTP_PHASE_DONE:
+                return HTTP_PARSE_COMPLETE;
+        }
+    }
+}
\ No newline at end of file
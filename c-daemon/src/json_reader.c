@@ -0,0 +1,451 @@
+// JSON Reader Implementation
+// Single-pass reader for the members of a JSON object, without building a tree
+//
+// Commands are small flat objects, and a DOM allocates a node and a string
+// copy per member only for the caller to copy each string again. The reader
+// instead walks the text once and hands out views: a member's key and value
+// point into the input, and a string is unescaped only when the caller
+// copies it out, straight into its destination. Nested values are checked
+// and skipped. Runs of plain string bytes are found with the same SSE2
+// scan the writer uses for escaping.
+//
+// The grammar is RFC 8259's; anything else is reported as -4 so a caller
+// can fall back to cJSON for the final word.
+
+#include <string.h>
+#include <limits.h>
+
+#include "json_reader.h"
+#include "json_writer.h"
+
+#define JSON_READER_MAX_DEPTH 32
+
+static const char *skip_space(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Scan the string starting at the quote p; NULL if it is malformed
+static const char *scan_string(const char *p, const char *end, json_view_t *view) {
+    const char *start = ++p;
+    bool escaped = false;
+
+    for (;;) {
+        p += json_plain_run(p, (size_t)(end - p));
+        if (p == end || (unsigned char)*p < 0x20) {
+            return NULL;
+        }
+        if (*p == '"') {
+            break;
+        }
+        // Backslash: validate the escape, decode it later
+        escaped = true;
+        if (end - p < 2) {
+            return NULL;
+        }
+        if (p[1] == 'u') {
+            if (end - p < 6) {
+                return NULL;
+            }
+            for (int i = 2; i < 6; i++) {
+                if (hex_value(p[i]) < 0) {
+                    return NULL;
+                }
+            }
+            p += 6;
+        } else if (strchr("\"\\/bfnrt", p[1]) != NULL && p[1] != '\0') {
+            p += 2;
+        } else {
+            return NULL;
+        }
+    }
+
+    view->data = start;
+    view->len = (size_t)(p - start);
+    view->escaped = escaped;
+    return p + 1;
+}
+
+// Scan a number in JSON's grammar; NULL if it is malformed
+static const char *scan_number(const char *p, const char *end) {
+    if (p < end && *p == '-') {
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9') {
+        return NULL;
+    }
+    if (*p == '0') {
+        p++;
+    } else {
+        while (p < end && *p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    if (p < end && *p == '.') {
+        const char *digits = ++p;
+        while (p < end && *p >= '0' && *p <= '9') {
+            p++;
+        }
+        if (p == digits) {
+            return NULL;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p < end && (*p == '+' || *p == '-')) {
+            p++;
+        }
+        const char *digits = p;
+        while (p < end && *p >= '0' && *p <= '9') {
+            p++;
+        }
+        if (p == digits) {
+            return NULL;
+        }
+    }
+    return p;
+}
+
+static const char *scan_literal(const char *p, const char *end, const char *word) {
+    size_t len = strlen(word);
+    if ((size_t)(end - p) < len || memcmp(p, word, len) != 0) {
+        return NULL;
+    }
+    return p + len;
+}
+
+static const char *scan_value(const char *p, const char *end, int depth, json_value_type_t *type,
+                              json_view_t *view);
+
+// Check an object or array starting at p and return the byte after it
+static const char *scan_container(const char *p, const char *end, int depth) {
+    if (depth >= JSON_READER_MAX_DEPTH) {
+        return NULL;
+    }
+    char close = *p == '{' ? '}' : ']';
+    p = skip_space(p + 1, end);
+    if (p < end && *p == close) {
+        return p + 1;
+    }
+
+    for (;;) {
+        json_value_type_t type;
+        json_view_t view;
+        if (close == '}') {
+            if (p == end || *p != '"' || (p = scan_string(p, end, &view)) == NULL) {
+                return NULL;
+            }
+            p = skip_space(p, end);
+            if (p == end || *p != ':') {
+                return NULL;
+            }
+            p = skip_space(p + 1, end);
+        }
+        p = scan_value(p, end, depth + 1, &type, &view);
+        if (p == NULL) {
+            return NULL;
+        }
+        p = skip_space(p, end);
+        if (p < end && *p == ',') {
+            p = skip_space(p + 1, end);
+        } else if (p < end && *p == close) {
+            return p + 1;
+        } else {
+            return NULL;
+        }
+    }
+}
+
+// Scan any value at p; NULL if it is malformed
+static const char *scan_value(const char *p, const char *end, int depth, json_value_type_t *type,
+                              json_view_t *view) {
+    if (p == end) {
+        return NULL;
+    }
+    const char *next;
+    view->escaped = false;
+
+    switch (*p) {
+        case '"':
+            *type = JSON_VALUE_STRING;
+            return scan_string(p, end, view);
+        case '{':
+        case '[':
+            *type = *p == '{' ? JSON_VALUE_OBJECT : JSON_VALUE_ARRAY;
+            next = scan_container(p, end, depth);
+            break;
+        case 't':
+            *type = JSON_VALUE_TRUE;
+            next = scan_literal(p, end, "true");
+            break;
+        case 'f':
+            *type = JSON_VALUE_FALSE;
+            next = scan_literal(p, end, "false");
+            break;
+        case 'n':
+            *type = JSON_VALUE_NULL;
+            next = scan_literal(p, end, "null");
+            break;
+        default:
+            *type = JSON_VALUE_NUMBER;
+            next = scan_number(p, end);
+            break;
+    }
+    if (next != NULL) {
+        view->data = p;
+        view->len = (size_t)(next - p);
+    }
+    return next;
+}
+
+// Start reading the members of the object in json[0, len); -4 if it is not one
+int json_reader_init(json_reader_t *reader, const char *json, size_t len) {
+    const char *end = json + len;
+    const char *p = skip_space(json, end);
+    if (p == end || *p != '{') {
+        return -4;
+    }
+    reader->pos = p + 1;
+    reader->end = end;
+    reader->close = '}';
+    reader->started = false;
+    return 0;
+}
+
+// Start reading the elements of an array value
+int json_reader_init_array(json_reader_t *reader, const json_view_t *array) {
+    if (array->len < 2 || array->data[0] != '[') {
+        return -4;
+    }
+    reader->pos = array->data + 1;
+    reader->end = array->data + array->len;
+    reader->close = ']';
+    reader->started = false;
+    return 0;
+}
+
+// Read the next member (or array element). Returns 1 with *member filled,
+// 0 at the end of the object, -4 on malformed input.
+int json_reader_next(json_reader_t *reader, json_member_t *member) {
+    const char *p = skip_space(reader->pos, reader->end);
+    if (p == reader->end) {
+        return -4;
+    }
+    if (*p == reader->close) {
+        reader->pos = p + 1;
+        return 0;
+    }
+    if (reader->started) {
+        if (*p != ',') {
+            return -4;
+        }
+        p = skip_space(p + 1, reader->end);
+    }
+
+    memset(&member->key, 0, sizeof(member->key));
+    if (reader->close == '}') {
+        if (p == reader->end || *p != '"' || (p = scan_string(p, reader->end, &member->key)) == NULL) {
+            return -4;
+        }
+        p = skip_space(p, reader->end);
+        if (p == reader->end || *p != ':') {
+            return -4;
+        }
+        p = skip_space(p + 1, reader->end);
+    }
+
+    p = scan_value(p, reader->end, 1, &member->type, &member->value);
+    if (p == NULL) {
+        return -4;
+    }
+    reader->pos = p;
+    reader->started = true;
+    return 1;
+}
+
+// Raw comparison; an escaped view never matches
+bool json_view_equals(const json_view_t *view, const char *text) {
+    size_t len = strlen(text);
+    return !view->escaped && view->len == len && memcmp(view->data, text, len) == 0;
+}
+
+// ASCII case-insensitive comparison, as cJSON_GetObjectItem() matches keys
+bool json_view_equals_nocase(const json_view_t *view, const char *text) {
+    size_t len = strlen(text);
+    if (view->escaped || view->len != len) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char a = view->data[i];
+        char b = text[i];
+        if (a >= 'A' && a <= 'Z') {
+            a = (char)(a - 'A' + 'a');
+        }
+        if (b >= 'A' && b <= 'Z') {
+            b = (char)(b - 'A' + 'a');
+        }
+        if (a != b) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Append code point cp as UTF-8 at out[pos] while it fits
+static size_t put_utf8(char *out, size_t out_size, size_t pos, unsigned long cp) {
+    char bytes[4];
+    size_t n;
+    if (cp < 0x80) {
+        bytes[0] = (char)cp;
+        n = 1;
+    } else if (cp < 0x800) {
+        bytes[0] = (char)(0xC0 | (cp >> 6));
+        bytes[1] = (char)(0x80 | (cp & 0x3F));
+        n = 2;
+    } else if (cp < 0x10000) {
+        bytes[0] = (char)(0xE0 | (cp >> 12));
+        bytes[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        bytes[2] = (char)(0x80 | (cp & 0x3F));
+        n = 3;
+    } else {
+        bytes[0] = (char)(0xF0 | (cp >> 18));
+        bytes[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        bytes[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        bytes[3] = (char)(0x80 | (cp & 0x3F));
+        n = 4;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (pos + i + 1 < out_size) {
+            out[pos + i] = bytes[i];
+        }
+    }
+    return n;
+}
+
+static unsigned long read_hex4(const char *p) {
+    return ((unsigned long)hex_value(p[0]) << 12) | ((unsigned long)hex_value(p[1]) << 8) |
+           ((unsigned long)hex_value(p[2]) << 4) | (unsigned long)hex_value(p[3]);
+}
+
+// Unescape a string view into out, truncating to out_size - 1 bytes (out
+// may be NULL to measure). Returns the full decoded length, like snprintf,
+// or -1 for escapes with no C-string form (\u0000, lone surrogates).
+long long json_view_copy_string(const json_view_t *view, char *out, size_t out_size) {
+    if (out == NULL) {
+        out_size = 0;
+    }
+    if (!view->escaped) {
+        if (out_size > 0) {
+            size_t n = view->len < out_size - 1 ? view->len : out_size - 1;
+            memcpy(out, view->data, n);
+            out[n] = '\0';
+        }
+        return (long long)view->len;
+    }
+
+    const char *p = view->data;
+    const char *end = view->data + view->len;
+    size_t pos = 0;
+    while (p < end) {
+        size_t run = json_plain_run(p, (size_t)(end - p));
+        for (size_t i = 0; i < run; i++) {
+            if (pos + i + 1 < out_size) {
+                out[pos + i] = p[i];
+            }
+        }
+        pos += run;
+        p += run;
+        if (p == end) {
+            break;
+        }
+
+        // Escapes were validated by scan_string()
+        char c = p[1];
+        if (c != 'u') {
+            char decoded = c == 'b' ? '\b' : c == 'f' ? '\f' : c == 'n' ? '\n'
+                         : c == 'r' ? '\r' : c == 't' ? '\t' : c;
+            if (pos + 1 < out_size) {
+                out[pos] = decoded;
+            }
+            pos++;
+            p += 2;
+            continue;
+        }
+
+        unsigned long cp = read_hex4(p + 2);
+        p += 6;
+        if (cp == 0 || (cp >= 0xDC00 && cp <= 0xDFFF)) {
+            return -1;
+        }
+        if (cp >= 0xD800 && cp <= 0xDBFF) {
+            if (end - p < 6 || p[0] != '\\' || p[1] != 'u') {
+                return -1;
+            }
+            unsigned long low = read_hex4(p + 2);
+            if (low < 0xDC00 || low > 0xDFFF) {
+                return -1;
+            }
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+            p += 6;
+        }
+        pos += put_utf8(out, out_size, pos, cp);
+    }
+
+    if (out_size > 0) {
+        out[pos < out_size - 1 ? pos : out_size - 1] = '\0';
+    }
+    return (long long)pos;
+}
+
+// Integer value of a number view, saturated to long long; -1 for
+// fractions and exponents, which the caller should not truncate
+int json_view_int64(const json_view_t *view, long long *out) {
+    const char *p = view->data;
+    const char *end = view->data + view->len;
+    bool negative = p < end && *p == '-';
+    if (negative) {
+        p++;
+    }
+
+    unsigned long long value = 0;
+    for (; p < end; p++) {
+        if (*p < '0' || *p > '9') {
+            return -1;
+        }
+        if (value < ULLONG_MAX / 10) {
+            value = value * 10 + (unsigned)(*p - '0');
+        }
+    }
+    if (value > (unsigned long long)LLONG_MAX) {
+        *out = negative ? LLONG_MIN : LLONG_MAX;
+    } else {
+        *out = negative ? -(long long)value : (long long)value;
+    }
+    return 0;
+}
+
+// Integer value of a number view, saturated to int like cJSON's valueint;
+// -1 for fractions and exponents, which the caller should not truncate
+int json_view_int(const json_view_t *view, int *out) {
+    long long value;
+    if (json_view_int64(view, &value) != 0) {
+        return -1;
+    }
+    *out = value > INT_MAX ? INT_MAX : value < INT_MIN ? INT_MIN : (int)value;
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,219 @@
+// JSON Writer Implementation
+// Streaming JSON output into a strbuf, with strings escaped in a single pass
+//
+// Every byte is written once at the buffer's end, so a page of n rows costs
+// O(n). Escaping copies clean runs in bulk; on SSE2 targets the scan for the
+// next '"', '\\' or control byte checks 16 bytes per step. Bytes >= 0x80 are
+// passed through, so valid UTF-8 stays valid.
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define JSON_HAVE_SSE2 1
+#endif
+
+#include "json_writer.h"
+#include "diag.h"
+
+static bool needs_escape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+// Length of the leading run of str free of '"', '\\' and control bytes:
+// what can be copied without escaping, or read without unescaping
+size_t json_plain_run(const char *str, size_t len) {
+    const unsigned char *s = (const unsigned char *)str;
+    size_t i = 0;
+
+#ifdef JSON_HAVE_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control_max = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= len; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(s + i));
+        // Unsigned chunk <= 0x1F exactly when min(chunk, 0x1F) == chunk
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(chunk, control_max), chunk);
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash));
+        if (_mm_movemask_epi8(_mm_or_si128(control, special)) != 0) {
+            break;  // The scalar loop pins down the byte within this block
+        }
+    }
+#endif
+
+    while (i < len && !needs_escape(s[i])) {
+        i++;
+    }
+    return i;
+}
+
+// Append str as the contents of a JSON string (no surrounding quotes)
+int json_escape_append(strbuf_t *out, const char *str, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char *s = (const unsigned char *)str;
+    size_t pos = 0;
+
+    while (pos < len) {
+        size_t run = json_plain_run((const char *)s + pos, len - pos);
+        strbuf_append(out, s + pos, run);
+        pos += run;
+        if (pos == len) {
+            break;
+        }
+
+        unsigned char c = s[pos++];
+        char escape[6] = { '\\', 0, 0, 0, 0, 0 };
+        size_t escape_len = 2;
+        switch (c) {
+            case '"':  escape[1] = '"'; break;
+            case '\\': escape[1] = '\\'; break;
+            case '\n': escape[1] = 'n'; break;
+            case '\r': escape[1] = 'r'; break;
+            case '\t': escape[1] = 't'; break;
+            case '\b': escape[1] = 'b'; break;
+            case '\f': escape[1] = 'f'; break;
+            default:
+                escape[1] = 'u';
+                escape[2] = '0';
+                escape[3] = '0';
+                escape[4] = hex[c >> 4];
+                escape[5] = hex[c & 0xF];
+                escape_len = 6;
+                break;
+        }
+        strbuf_append(out, escape, escape_len);
+    }
+    return out->failed ? -1 : 0;
+}
+
+void json_writer_init(json_writer_t *w, strbuf_t *out) {
+    memset(w, 0, sizeof(*w));
+    w->out = out;
+}
+
+// Separator before a value or key at the current level
+static void begin_item(json_writer_t *w) {
+    if (w->after_key) {
+        w->after_key = false;
+        return;
+    }
+    if (w->depth > 0) {
+        if (w->need_comma[w->depth - 1]) {
+            strbuf_append(w->out, ",", 1);
+        }
+        w->need_comma[w->depth - 1] = true;
+    }
+}
+
+static void open_container(json_writer_t *w, char bracket) {
+    begin_item(w);
+    if (w->depth >= JSON_WRITER_MAX_DEPTH) {
+        w->misuse = true;
+        return;
+    }
+    strbuf_append(w->out, &bracket, 1);
+    w->need_comma[w->depth++] = false;
+}
+
+static void close_container(json_writer_t *w, char bracket) {
+    if (w->depth == 0 || w->after_key) {
+        w->misuse = true;
+        return;
+    }
+    w->depth--;
+    strbuf_append(w->out, &bracket, 1);
+}
+
+void json_begin_object(json_writer_t *w) {
+    open_container(w, '{');
+}
+
+void json_end_object(json_writer_t *w) {
+    close_container(w, '}');
+}
+
+void json_begin_array(json_writer_t *w) {
+    open_container(w, '[');
+}
+
+void json_end_array(json_writer_t *w) {
+    close_container(w, ']');
+}
+
+void json_key(json_writer_t *w, const char *key) {
+    if (w->after_key) {
+        w->misuse = true;
+    }
+    begin_item(w);
+    strbuf_append(w->out, "\"", 1);
+    json_escape_append(w->out, key, strlen(key));
+    strbuf_append(w->out, "\":", 2);
+    w->after_key = true;
+}
+
+// NULL is written as an empty string, matching how rows report missing columns
+void json_string(json_writer_t *w, const char *value) {
+    begin_item(w);
+    strbuf_append(w->out, "\"", 1);
+    if (value != NULL) {
+        json_escape_append(w->out, value, strlen(value));
+    }
+    strbuf_append(w->out, "\"", 1);
+}
+
+void json_int(json_writer_t *w, long long value) {
+    begin_item(w);
+    strbuf_printf(w->out, "%lld", value);
+}
+
+// JSON has no NaN or infinity; those are written as null
+void json_double(json_writer_t *w, double value) {
+    begin_item(w);
+    if (isfinite(value)) {
+        strbuf_printf(w->out, "%.6g", value);
+    } else {
+        strbuf_append(w->out, "null", 4);
+    }
+}
+
+void json_bool(json_writer_t *w, bool value) {
+    begin_item(w);
+    strbuf_append_str(w->out, value ? "true" : "false");
+}
+
+// Splice in a value that is already valid JSON, e.g. a cached row
+void json_raw(json_writer_t *w, const char *json, size_t len) {
+    begin_item(w);
+    strbuf_append(w->out, json, len);
+}
+
+void json_field_string(json_writer_t *w, const char *key, const char *value) {
+    json_key(w, key);
+    json_string(w, value);
+}
+
+void json_field_int(json_writer_t *w, const char *key, long long value) {
+    json_key(w, key);
+    json_int(w, value);
+}
+
+void json_field_double(json_writer_t *w, const char *key, double value) {
+    json_key(w, key);
+    json_double(w, value);
+}
+
+void json_field_bool(json_writer_t *w, const char *key, bool value) {
+    json_key(w, key);
+    json_bool(w, value);
+}
+
+// 0 once every container is closed and nothing failed, -1 otherwise
+int json_writer_finish(json_writer_t *w) {
+    if (w->misuse || w->depth != 0 || w->after_key) {
+        LOG_ERROR("Malformed JSON writer usage\n");
+        return -1;
+    }
+    return w->out->failed ? -1 : 0;
+}
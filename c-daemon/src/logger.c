@@ -1,5 +1,20 @@
 // Transaction Logger Implementation
 // Handles dual logging (database + file) for all operations
+//
+// Request threads never touch SQLite or the log file. log_transaction()
+// copies the record into a bounded multi-producer ring (a slot sequence
+// per cell, so producers claim slots with one compare-and-swap) and
+// returns. A single writer thread drains the ring in batches: one SQLite
+// transaction and one buffered file write per batch. It wakes when a batch
+// fills, when the flush interval elapses, or when a durable record is
+// waiting. log_transaction_durable() returns only once its record is
+// committed and fsync'd, for admin actions that must survive a crash, and
+// reports whether its batch actually reached both.
+//
+// The writer also rotates the file: when a batch would take it past the
+// size limit, or is the first of a new UTC day, the file is renamed to
+// <path>.1 (older copies shift up, the oldest beyond the kept count is
+// deleted) and a new one is started.
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,46 +28,207 @@
     #include <sys/stat.h>
     #define F_OK 0
     #define access _access
+    #define fsync _commit
+    #define fileno _fileno
 #else
     #include <unistd.h>
     #include <sys/stat.h>
 #endif
 
 #include "logger.h"
-#include "db.h"
+#include "storage.h"
 #include "semaphore.h"
+#include "json_writer.h"
+#include "platform.h"
+#include "diag.h"
+
+#define LOGGER_FULL_WAIT_MS 10         // Producer back-off while the ring is full
+
+// One ring cell. sequence == position when free for that position's
+// producer, position + 1 once filled, and position + capacity once the
+// writer has released it for the next lap.
+typedef struct {
+    atomic_u64_t sequence;
+    time_t when;
+    int semaphore_value;
+    bool has_user;
+    bool has_content;
+    int *result;                   // Durable records: where the batch's outcome goes
+    char action[LOGGER_MAX_ACTION_LEN];
+    char user[LOGGER_MAX_USER_LEN];
+    char content[LOGGER_MAX_CONTENT_LEN + 1];
+} log_slot_t;
 
 // Global logger context
 static FILE *log_file = NULL;
 static char log_file_path[512];
 static bool logger_initialized = false;
 
+static log_slot_t g_slots[LOGGER_RING_CAPACITY];
+static CACHE_ALIGNED atomic_u64_t g_enqueue_pos;   // Next position a producer claims
+static CACHE_ALIGNED atomic_u64_t g_written_pos;   // Every record before this is written
+static mutex_t g_log_mutex;                        // Protects the flags below and both conds
+static cond_t g_log_wake;                          // Wakes the writer thread
+static cond_t g_log_progress;                      // Broadcast after every batch
+static bool g_flush_requested = false;
+static bool g_log_stopping = false;
+static bool g_writer_running = false;
+static thread_t g_writer_thread;
+static int g_flush_interval_ms = LOGGER_DEFAULT_FLUSH_MS;
+static int g_batch_size = LOGGER_DEFAULT_BATCH;
+static long long g_rotate_bytes = LOGGER_DEFAULT_ROTATE_BYTES;
+static int g_keep_files = LOGGER_DEFAULT_KEEP_FILES;
+static long long g_file_bytes = 0;                 // Size of the open file (writer thread)
+static int g_file_day = 0;                         // UTC day (YYYYMMDD) it was last written
+static unsigned long g_rotations = 0;
+
 // Generate ISO 8601 timestamp for logging
+static void format_log_timestamp(time_t when, char *timestamp, size_t size) {
+    struct tm utc_tm;
+    platform_gmtime(when, &utc_tm);
+    strftime(timestamp, size, "%Y-%m-%dT%H:%M:%SZ", &utc_tm);
+}
+
 void get_log_timestamp(char *timestamp, size_t size) {
-    time_t now = time(NULL);
-    struct tm *utc_tm = gmtime(&now);
-    strftime(timestamp, size, "%Y-%m-%dT%H:%M:%SZ", utc_tm);
+    format_log_timestamp(time(NULL), timestamp, size);
 }
 
-// Initialize logger with file path
-int init_logger(const char *log_file_path_param) {
-    if (logger_initialized) {
-        return 0;  // Already initialized
+static int utc_day(time_t when) {
+    struct tm utc_tm;
+    platform_gmtime(when, &utc_tm);
+    return (utc_tm.tm_year + 1900) * 10000 + (utc_tm.tm_mon + 1) * 100 + utc_tm.tm_mday;
+}
+
+// Set batching before init_logger(); out-of-range values keep the defaults
+void logger_configure(int flush_interval_ms, int batch_size) {
+    if (flush_interval_ms >= 1 && flush_interval_ms <= 60000) {
+        g_flush_interval_ms = flush_interval_ms;
     }
-    
-    if (log_file_path_param == NULL) {
-        fprintf(stderr, "Invalid log file path\n");
-        return -1;
+    if (batch_size >= 1 && batch_size <= LOGGER_RING_CAPACITY) {
+        g_batch_size = batch_size;
+    }
+}
+
+// Set file rotation before init_logger(). rotate_bytes 0 rotates only when
+// the day changes; keep_files 0 never rotates. Out-of-range values keep the
+// defaults.
+void logger_configure_rotation(long long rotate_bytes, int keep_files) {
+    if (rotate_bytes >= 0) {
+        g_rotate_bytes = rotate_bytes;
+    }
+    if (keep_files >= 0 && keep_files <= LOGGER_MAX_KEEP_FILES) {
+        g_keep_files = keep_files;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Ring buffer
+// ---------------------------------------------------------------------------
+
+static void copy_field(char *dest, size_t size, const char *src) {
+    size_t len = strlen(src);
+    if (len >= size) {
+        len = size - 1;
+    }
+    memcpy(dest, src, len);
+    dest[len] = '\0';
+}
+
+// Claim a slot and copy the record into it; false if the ring is full
+static bool ring_try_push(const char *action, const char *user, const char *content,
+                          int semaphore_value, int *result, uint64_t *out_pos) {
+    uint64_t pos = atomic_u64_load(&g_enqueue_pos);
+    for (;;) {
+        log_slot_t *slot = &g_slots[pos & (LOGGER_RING_CAPACITY - 1)];
+        int64_t lag = (int64_t)(atomic_u64_load(&slot->sequence) - pos);
+        if (lag < 0) {
+            return false;  // Still holds a record from the previous lap
+        }
+        if (lag > 0) {
+            pos = atomic_u64_load(&g_enqueue_pos);  // Another producer took it
+            continue;
+        }
+        if (!atomic_u64_cas(&g_enqueue_pos, &pos, pos + 1)) {
+            continue;  // pos now holds the current claim position
+        }
+        
+        slot->when = time(NULL);
+        slot->semaphore_value = semaphore_value;
+        slot->has_user = user != NULL;
+        slot->has_content = content != NULL;
+        slot->result = result;
+        copy_field(slot->action, sizeof(slot->action), action);
+        copy_field(slot->user, sizeof(slot->user), user ? user : "");
+        copy_field(slot->content, sizeof(slot->content), content ? content : "");
+        atomic_u64_store(&slot->sequence, pos + 1);  // Publish to the writer
+        *out_pos = pos;
+        return true;
+    }
+}
+
+// Queue a record, waiting for room if the writer has fallen a full ring
+// behind. A durable record passes result, which its batch's writer fills
+// in before the record counts as written.
+static bool enqueue_record(const char *action, const char *user, const char *content,
+                           int semaphore_value, int *result, uint64_t *out_pos) {
+    bool durable = result != NULL;
+    while (!ring_try_push(action, user, content, semaphore_value, result, out_pos)) {
+        mutex_lock(&g_log_mutex);
+        if (!g_writer_running) {
+            mutex_unlock(&g_log_mutex);
+            return false;
+        }
+        g_flush_requested = true;
+        cond_signal(&g_log_wake);
+        cond_timedwait_ms(&g_log_progress, &g_log_mutex, LOGGER_FULL_WAIT_MS);
+        mutex_unlock(&g_log_mutex);
     }
     
-    // Store log file path
-    strncpy(log_file_path, log_file_path_param, sizeof(log_file_path) - 1);
-    log_file_path[sizeof(log_file_path) - 1] = '\0';
-    
-    // Open log file in append mode
+    // A full batch is worth writing now rather than at the next interval
+    uint64_t backlog = *out_pos + 1 - atomic_u64_load(&g_written_pos);
+    if (durable || backlog == (uint64_t)g_batch_size) {
+        mutex_lock(&g_log_mutex);
+        g_flush_requested = true;
+        cond_signal(&g_log_wake);
+        mutex_unlock(&g_log_mutex);
+    }
+    return true;
+}
+
+// Block until every record before target has been written. -1 if the
+// writer stopped first.
+static int wait_written(uint64_t target) {
+    mutex_lock(&g_log_mutex);
+    while (atomic_u64_load(&g_written_pos) < target && g_writer_running) {
+        g_flush_requested = true;
+        cond_signal(&g_log_wake);
+        cond_wait(&g_log_progress, &g_log_mutex);
+    }
+    int result = atomic_u64_load(&g_written_pos) >= target ? 0 : -1;
+    mutex_unlock(&g_log_mutex);
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Writer thread
+// ---------------------------------------------------------------------------
+
+static void append_json_string(strbuf_t *out, bool present, const char *value) {
+    if (!present) {
+        strbuf_append_str(out, "null");
+        return;
+    }
+    strbuf_append(out, "\"", 1);
+    json_escape_append(out, value, strlen(value));
+    strbuf_append(out, "\"", 1);
+}
+
+// Open log_file_path for appending, owner read/write only, and pick up
+// where an existing file left off
+static int open_log_file(void) {
     log_file = fopen(log_file_path, "a");
     if (log_file == NULL) {
-        fprintf(stderr, "Failed to open log file '%s': %s\n", 
+        LOG_ERROR("Failed to open log file '%s': %s\n",
                 log_file_path, strerror(errno));
         return -1;
     }
@@ -61,15 +237,199 @@ int init_logger(const char *log_file_path_param) {
 #ifdef _WIN32
     // Windows doesn't have the same permission model, but we can try to restrict access
     if (_chmod(log_file_path, _S_IREAD | _S_IWRITE) != 0) {
-        fprintf(stderr, "Warning: Could not set file permissions on '%s'\n", log_file_path);
+        LOG_WARN("Could not set file permissions on '%s'\n", log_file_path);
     }
 #else
     if (chmod(log_file_path, 0600) != 0) {
-        fprintf(stderr, "Warning: Could not set file permissions on '%s': %s\n", 
+        LOG_WARN("Could not set file permissions on '%s': %s\n",
                 log_file_path, strerror(errno));
     }
 #endif
     
+    // A file last written on an earlier day rotates with the first batch
+    struct stat st;
+    time_t modified = time(NULL);
+    g_file_bytes = 0;
+    if (stat(log_file_path, &st) == 0) {
+        g_file_bytes = (long long)st.st_size;
+        if (st.st_size > 0) {
+            modified = st.st_mtime;
+        }
+    }
+    g_file_day = utc_day(modified);
+    return 0;
+}
+
+static bool rotation_due(size_t pending, time_t first_record) {
+    if (g_keep_files == 0 || g_file_bytes == 0) {
+        return false;
+    }
+    return (g_rotate_bytes > 0 && g_file_bytes + (long long)pending > g_rotate_bytes) ||
+           utc_day(first_record) != g_file_day;
+}
+
+// Shift <path>.1 .. <path>.N-1 up by one (dropping <path>.N), move the
+// current file to <path>.1 and start a new one
+static void rotate_log_file(void) {
+    char from[sizeof(log_file_path) + 16];
+    char to[sizeof(log_file_path) + 16];
+    
+    fclose(log_file);
+    log_file = NULL;
+    
+    snprintf(to, sizeof(to), "%s.%d", log_file_path, g_keep_files);
+    remove(to);
+    for (int i = g_keep_files - 1; i >= 1; i--) {
+        snprintf(from, sizeof(from), "%s.%d", log_file_path, i);
+        snprintf(to, sizeof(to), "%s.%d", log_file_path, i + 1);
+        rename(from, to);
+    }
+    snprintf(to, sizeof(to), "%s.1", log_file_path);
+    if (rename(log_file_path, to) != 0) {
+        LOG_ERROR("Failed to rotate log file '%s': %s\n", log_file_path, strerror(errno));
+    }
+    
+    if (open_log_file() != 0) {
+        LOG_ERROR("File logging stopped after rotation\n");
+        return;
+    }
+    g_rotations++;
+}
+
+// Write one batch to the database and the log file, then hand its outcome
+// (0, or -5 if either store missed it) to its durable records and release
+// its slots
+static void write_batch(uint64_t head, int count, log_entry_t *entries, strbuf_t *lines) {
+    bool durable = false;
+    int status = 0;
+    strbuf_truncate(lines, 0);
+    
+    for (int i = 0; i < count; i++) {
+        log_slot_t *slot = &g_slots[(head + (uint64_t)i) & (LOGGER_RING_CAPACITY - 1)];
+        entries[i].when = slot->when;
+        entries[i].action = slot->action;
+        entries[i].user = slot->has_user ? slot->user : NULL;
+        entries[i].content = slot->has_content ? slot->content : NULL;
+        entries[i].semaphore_value = slot->semaphore_value;
+        durable = durable || slot->result != NULL;
+        
+        char timestamp[64];
+        format_log_timestamp(slot->when, timestamp, sizeof(timestamp));
+        strbuf_printf(lines, "{\"ts\": \"%s\", \"action\": ", timestamp);
+        append_json_string(lines, true, slot->action);
+        strbuf_append_str(lines, ", \"user\": ");
+        append_json_string(lines, slot->has_user, slot->user);
+        strbuf_append_str(lines, ", \"content\": ");
+        append_json_string(lines, slot->has_content, slot->content);
+        strbuf_printf(lines, ", \"semaphore\": %d}\n", slot->semaphore_value);
+    }
+    
+    if (insert_log_entries(entries, count) != 0) {
+        LOG_ERROR("Failed to log transaction batch to database\n");
+        status = -5;  // Continue with file logging even if database logging fails
+    }
+    
+    if (log_file != NULL && lines->len > 0 && rotation_due(lines->len, entries[0].when)) {
+        rotate_log_file();
+    }
+    if (log_file != NULL && lines->len > 0) {
+        if (fwrite(lines->data, 1, lines->len, log_file) != lines->len || fflush(log_file) != 0 ||
+            (durable && fsync(fileno(log_file)) != 0)) {
+            LOG_ERROR("Failed to write transaction batch to '%s': %s\n", log_file_path, strerror(errno));
+            status = -5;
+        }
+        g_file_bytes += (long long)lines->len;
+        g_file_day = utc_day(entries[count - 1].when);
+    } else if (log_file == NULL) {
+        status = -5;  // File logging stopped after a failed rotation
+    }
+    
+    // Outcomes are stored before g_written_pos moves under g_log_mutex,
+    // which is what their waiters read it under
+    for (int i = 0; i < count; i++) {
+        log_slot_t *slot = &g_slots[(head + (uint64_t)i) & (LOGGER_RING_CAPACITY - 1)];
+        if (slot->result != NULL) {
+            *slot->result = status;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        uint64_t pos = head + (uint64_t)i;
+        atomic_u64_store(&g_slots[pos & (LOGGER_RING_CAPACITY - 1)].sequence, pos + LOGGER_RING_CAPACITY);
+    }
+}
+
+static void *logger_writer_main(void *arg) {
+    (void)arg;
+    log_entry_t *entries = malloc((size_t)g_batch_size * sizeof(log_entry_t));
+    strbuf_t lines;
+    strbuf_init(&lines);
+    uint64_t head = 0;
+    
+    for (;;) {
+        mutex_lock(&g_log_mutex);
+        uint64_t backlog = atomic_u64_load(&g_enqueue_pos) - head;
+        if (!g_log_stopping && !g_flush_requested && backlog < (uint64_t)g_batch_size) {
+            cond_timedwait_ms(&g_log_wake, &g_log_mutex, g_flush_interval_ms);
+        }
+        g_flush_requested = false;
+        bool stopping = g_log_stopping;
+        mutex_unlock(&g_log_mutex);
+        
+        // Take every published record, a batch at a time
+        for (;;) {
+            int count = 0;
+            while (count < g_batch_size) {
+                uint64_t pos = head + (uint64_t)count;
+                log_slot_t *slot = &g_slots[pos & (LOGGER_RING_CAPACITY - 1)];
+                if (atomic_u64_load(&slot->sequence) != pos + 1) {
+                    break;  // Not yet published (or nothing queued)
+                }
+                count++;
+            }
+            if (count == 0 || entries == NULL) {
+                break;
+            }
+            
+            write_batch(head, count, entries, &lines);
+            head += (uint64_t)count;
+            
+            mutex_lock(&g_log_mutex);
+            atomic_u64_store(&g_written_pos, head);
+            cond_broadcast(&g_log_progress);
+            mutex_unlock(&g_log_mutex);
+        }
+        
+        // On shutdown, finish records whose producers are still copying them in
+        if (stopping && atomic_u64_load(&g_enqueue_pos) == head) {
+            break;
+        }
+    }
+    
+    strbuf_free(&lines);
+    free(entries);
+    return NULL;
+}
+
+// Initialize logger with file path
+int init_logger(const char *log_file_path_param) {
+    if (logger_initialized) {
+        return 0;  // Already initialized
+    }
+    
+    if (log_file_path_param == NULL) {
+        LOG_ERROR("Invalid log file path\n");
+        return -1;
+    }
+    
+    // Store log file path
+    strncpy(log_file_path, log_file_path_param, sizeof(log_file_path) - 1);
+    log_file_path[sizeof(log_file_path) - 1] = '\0';
+    
+    // Open log file in append mode
+    if (open_log_file() != 0) {
+        return -1;
+    }
+    
     // Write initialization log entry
     char timestamp[64];
     get_log_timestamp(timestamp, sizeof(timestamp));
@@ -79,80 +439,129 @@ int init_logger(const char *log_file_path_param) {
                      "\"semaphore\": 1}\n", timestamp);
     fflush(log_file);
     
+    // Every slot starts free for the producer of its first-lap position
+    for (uint64_t i = 0; i < LOGGER_RING_CAPACITY; i++) {
+        atomic_u64_store(&g_slots[i].sequence, i);
+    }
+    atomic_u64_store(&g_enqueue_pos, 0);
+    atomic_u64_store(&g_written_pos, 0);
+    mutex_init(&g_log_mutex);
+    cond_init(&g_log_wake);
+    cond_init(&g_log_progress);
+    g_flush_requested = false;
+    g_log_stopping = false;
+    
+    g_writer_running = true;
+    if (thread_create(&g_writer_thread, logger_writer_main, NULL) != 0) {
+        LOG_ERROR("Failed to start log writer thread\n");
+        g_writer_running = false;
+        cond_destroy(&g_log_progress);
+        cond_destroy(&g_log_wake);
+        mutex_destroy(&g_log_mutex);
+        fclose(log_file);
+        log_file = NULL;
+        return -1;
+    }
+    
     logger_initialized = true;
-    printf("Transaction logger initialized: %s\n", log_file_path);
+    LOG_INFO("Transaction logger initialized: %s (flush every %d ms or %d records, keep %d rotated files)\n",
+             log_file_path, g_flush_interval_ms, g_batch_size, g_keep_files);
     return 0;
 }
 
-// Log a transaction to both database and file
-void log_transaction(const char *action, const char *user, 
-                    const char *content, int semaphore_value) {
+// Check a record before it is queued; false if it must be dropped
+static bool valid_record(const char *action, int semaphore_value) {
     if (!logger_initialized) {
-        fprintf(stderr, "Logger not initialized\n");
-        return;
+        LOG_ERROR("Logger not initialized\n");
+        return false;
     }
     
     if (action == NULL) {
-        fprintf(stderr, "Invalid action for log_transaction\n");
-        return;
+        LOG_ERROR("Invalid action for log_transaction\n");
+        return false;
     }
     
     // Validate semaphore_value
     if (semaphore_value != 0 && semaphore_value != 1) {
-        fprintf(stderr, "Invalid semaphore value: %d (must be 0 or 1)\n", semaphore_value);
-        return;
+        LOG_ERROR("Invalid semaphore value: %d (must be 0 or 1)\n", semaphore_value);
+        return false;
     }
-    
-    char timestamp[64];
-    get_log_timestamp(timestamp, sizeof(timestamp));
-    
-    // Log to database (if database is initialized)
-    if (insert_log_entry(action, user, content, semaphore_value) != 0) {
-        fprintf(stderr, "Failed to log transaction to database\n");
-        // Continue with file logging even if database logging fails
+    return true;
+}
+
+// Log a transaction to both database and file. Returns once the record is
+// queued; the writer thread stores it within the flush interval.
+void log_transaction(const char *action, const char *user,
+                    const char *content, int semaphore_value) {
+    uint64_t pos;
+    if (valid_record(action, semaphore_value) &&
+        !enqueue_record(action, user, content, semaphore_value, NULL, &pos)) {
+        LOG_ERROR("Failed to queue transaction log record\n");
     }
-    
-    // Log to file in structured JSON format
-    if (log_file != NULL) {
-        fprintf(log_file, "{\"ts\": \"%s\", \"action\": \"%s\", "
-                         "\"user\": %s%s%s, \"content\": %s%s%s, \"semaphore\": %d}\n",
-                timestamp, 
-                action,
-                user ? "\"" : "null",
-                user ? user : "",
-                user ? "\"" : "",
-                content ? "\"" : "null",
-                content ? content : "",
-                content ? "\"" : "",
-                semaphore_value);
-        fflush(log_file);  // Ensure immediate write
+}
+
+// As log_transaction(), but return only once the record (and everything
+// queued before it) is committed to the database and fsync'd to the file.
+// Returns 0 if it was, -4 for an invalid record, -5 if the database or the
+// file missed it, or -1 if the logger stopped first.
+int log_transaction_durable(const char *action, const char *user,
+                            const char *content, int semaphore_value) {
+    uint64_t pos;
+    if (!valid_record(action, semaphore_value)) {
+        return -4;
     }
+    int result = -1;
+    if (!enqueue_record(action, user, content, semaphore_value, &result, &pos)) {
+        LOG_ERROR("Failed to queue transaction log record\n");
+        return -1;
+    }
+    if (wait_written(pos + 1) != 0) {
+        return -1;
+    }
+    return result;
+}
+
+// Wait until every record queued so far has been written
+void logger_flush(void) {
+    if (logger_initialized) {
+        wait_written(atomic_u64_load(&g_enqueue_pos));
+    }
+}
+
+// Records queued but not yet written, for monitoring
+int logger_queue_depth(void) {
+    if (!logger_initialized) {
+        return 0;
+    }
+    uint64_t written = atomic_u64_load(&g_written_pos);
+    uint64_t queued = atomic_u64_load(&g_enqueue_pos);
+    return queued > written ? (int)(queued - written) : 0;
 }
 
 // Log semaphore-specific events
 void log_semaphore_event(const char *action, const char *user, int value) {
     if (!logger_initialized) {
-        fprintf(stderr, "Logger not initialized\n");
+        LOG_ERROR("Logger not initialized\n");
         return;
     }
     
     if (action == NULL) {
-        fprintf(stderr, "Invalid action for log_semaphore_event\n");
+        LOG_ERROR("Invalid action for log_semaphore_event\n");
         return;
     }
     
     // Validate semaphore value
     if (value != 0 && value != 1) {
-        fprintf(stderr, "Invalid semaphore value: %d (must be 0 or 1)\n", value);
+        LOG_ERROR("Invalid semaphore value: %d (must be 0 or 1)\n", value);
         return;
     }
     
     char content[256];
     if (strcmp(action, "ACQUIRE_MUTEX") == 0) {
-        snprintf(content, sizeof(content), "User '%s' acquired semaphore", 
+        snprintf(content, sizeof(content), "User '%s' acquired semaphore",
                 user ? user : "unknown");
     } else if (strcmp(action, "RELEASE_MUTEX") == 0) {
-        snprintf(content, sizeof(content), "User '%s' released semaphore", 
+        snprintf(content, sizeof(content), "User '%s' released semaphore",
                 user ? user : "unknown");
     } else {
         snprintf(content, sizeof(content), "Semaphore event: %s", action);
@@ -161,11 +570,24 @@ void log_semaphore_event(const char *action, const char *user, int value) {
     log_transaction(action, user, content, value);
 }
 
-// Cleanup logger resources
+// Cleanup logger resources. Drains the ring first, so call it before
+// cleanup_databases() and after every thread that logs has stopped.
 void cleanup_logger(void) {
     if (!logger_initialized) {
         return;
     }
+    logger_initialized = false;  // Refuse new records from here on
+    
+    mutex_lock(&g_log_mutex);
+    g_log_stopping = true;
+    cond_signal(&g_log_wake);
+    mutex_unlock(&g_log_mutex);
+    thread_join(g_writer_thread);
+    
+    mutex_lock(&g_log_mutex);
+    g_writer_running = false;
+    cond_broadcast(&g_log_progress);
+    mutex_unlock(&g_log_mutex);
     
     if (log_file != NULL) {
         // Write shutdown log entry
@@ -181,6 +603,8 @@ void cleanup_logger(void) {
         log_file = NULL;
     }
     
-    logger_initialized = false;
-    printf("Transaction logger cleanup complete\n");
-}
\ No newline at end of file
+    cond_destroy(&g_log_progress);
+    cond_destroy(&g_log_wake);
+    mutex_destroy(&g_log_mutex);
+    LOG_INFO("Transaction logger cleanup complete (%lu file rotations)\n", g_rotations);
+}
@@ -4,7 +4,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <signal.h>
+#include <cjson/cjson.h>
 
 #ifdef _WIN32
     #include <winsock2.h>
@@ -25,195 +27,1192 @@
 #endif
 
 #include "semaphore.h"
-#include "db_simple.h"
+#include "storage.h"
+#include "event_loop.h"
+#include "thread_pool.h"
+#include "platform.h"
+#include "timer_wheel.h"
+#include "strbuf.h"
+#include "arena.h"
+#include "json_writer.h"
+#include "json_reader.h"
+#include "message_cache.h"
+#include "logger.h"
+#include "metrics.h"
+#include "diag.h"
+#include "events.h"
+#include "command_socket.h"
+#include "handlers.h"
 
 // Global variables for graceful shutdown
 static volatile sig_atomic_t running = 1;
 static int server_socket = -1;
 static const int server_port = 8081;
+static const char *semaphore_state = SEMAPHORE_STATE_DEFAULT_PATH;  // NULL when --state-file off
+
+// Persistent connection limits
+#define HTTP_KEEPALIVE_TIMEOUT_SEC 15     // Idle seconds before a kept-alive socket is closed
+#define HTTP_KEEPALIVE_MAX_REQUESTS 1000  // Requests served per connection before closing
 
 // Signal handler for graceful shutdown
 void signal_handler(int sig) {
     printf("\nReceived signal %d, shutting down gracefully...\n", sig);
-    running = 0;
-    
-    if (server_socket != -1) {
-        close(server_socket);
-        server_socket = -1;
-    }
+    running = 0;  // Event loop notices on its next wakeup
 }
 
-// Simple HTTP response helper
-void send_http_response(int client_socket, const char* status, const char* content) {
-    char response[4096];
-    int content_length = strlen(content);
+// One parsed HTTP request and, once routed, its response. Headers and body
+// stay in separate buffers and go out with one vectored send, so a large
+// body is never copied after it is built.
+// Requests answered on a worker thread carry private copies of their inputs.
+typedef struct route route_t;
+
+typedef struct {
+    conn_id_t conn_id;
+    bool keep_alive;
+    char method[16];
+    char path[256];                 // Path without the query string
+    const char *query;              // Text after '?', or NULL
+    char *body;                     // NUL-terminated body, or NULL
+    size_t body_length;             // Bytes before the terminator (a body may hold NULs)
+    const route_t *route;           // Matched endpoint, or NULL
+    int path_id;                    // Id segment of the path (/api/messages/42), else 0
+    bool method_not_allowed;        // Path exists, but not for this method
+    strbuf_t response_head;         // Status line + headers
+    strbuf_t response_body;
+    bool parked;                    // Reply will be posted later via event_loop_post()
+    bool streaming;                 // Head only; the connection becomes an event stream
+    unsigned long long last_event_id;  // Last-Event-ID of a reconnecting event-stream client
+} http_request_t;
+
+// One endpoint of the route table (see g_routes)
+struct route {
+    const char *method;
+    const char *path;               // Whole path, or the prefix of an id segment
+    size_t path_length;
+    bool id_segment;
+    bool on_worker;                 // Touches storage; runs on the worker pool
+    int command;                    // command_type_t for the latency histogram, or -1
+    void (*handler)(http_request_t *req);
+};
+
+// HTTP response helper - takes ownership of a body built in a strbuf and
+// writes the matching headers next to it
+static void send_http_response_typed(http_request_t *req, const char *status, const char *content_type,
+                                     strbuf_t *content) {
+    char connection_header[64];
+    
+    strbuf_free(&req->response_head);
+    strbuf_free(&req->response_body);
+    req->response_body = *content;
+    strbuf_init(content);
+    
+    if (req->response_body.failed) {
+        // The body ran out of memory part way; never send a truncated page
+        strbuf_free(&req->response_body);
+        strbuf_append_str(&req->response_body, "{\"status\":\"error\",\"message\":\"Out of memory\"}");
+        status = "500 Internal Server Error";
+        content_type = "application/json";
+    }
     
-    snprintf(response, sizeof(response),
+    if (req->keep_alive) {
+        snprintf(connection_header, sizeof(connection_header),
+                 "Connection: keep-alive\r\nKeep-Alive: timeout=%d\r\n",
+                 HTTP_KEEPALIVE_TIMEOUT_SEC);
+    } else {
+        strcpy(connection_header, "Connection: close\r\n");
+    }
+    
+    strbuf_printf(&req->response_head,
         "HTTP/1.1 %s\r\n"
-        "Content-Type: application/json\r\n"
-        "Content-Length: %d\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Length: %zu\r\n"
+        "%s"
         "Access-Control-Allow-Origin: *\r\n"
-        "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+        "Access-Control-Allow-Methods: GET, POST, PUT, DELETE, OPTIONS\r\n"
         "Access-Control-Allow-Headers: Content-Type\r\n"
-        "\r\n"
-        "%s",
-        status, content_length, content);
+        "\r\n",
+        status, content_type, req->response_body.len, connection_header);
+}
+
+static void send_http_response_buf(http_request_t *req, const char *status, strbuf_t *content) {
+    send_http_response_typed(req, status, "application/json", content);
+}
+
+// Simple HTTP response helper for fixed replies
+void send_http_response(http_request_t *req, const char* status, const char* content) {
+    strbuf_t body;
+    strbuf_init(&body);
+    strbuf_append_str(&body, content);
+    send_http_response_buf(req, status, &body);
+}
+
+// Open a Server-Sent Events response: headers without a length, then the
+// connection stays open and events_subscribe() feeds it
+static void start_event_stream(http_request_t *req) {
+    strbuf_free(&req->response_head);
+    strbuf_free(&req->response_body);
+    strbuf_append_str(&req->response_head,
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/event-stream\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Connection: keep-alive\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "\r\n");
+    req->streaming = true;
+}
+
+// Detach the response into output pieces for the event loop (which frees
+// them). Returns the piece count, 0 if there is nothing sendable.
+static int take_http_response(http_request_t *req, conn_iov_t iov[2]) {
+    int count = 0;
+    if (!req->response_head.failed && req->response_head.len > 0) {
+        iov[count].base = strbuf_detach(&req->response_head, &iov[count].len);
+        count++;
+        iov[count].base = strbuf_detach(&req->response_body, &iov[count].len);
+        count++;
+    }
+    strbuf_free(&req->response_head);
+    strbuf_free(&req->response_body);
+    return count;
+}
+
+// Read an integer query-string parameter, falling back to default_value
+static int query_param_int(const char *query, const char *name, int default_value) {
+    size_t name_len = strlen(name);
     
-    send(client_socket, response, strlen(response), 0);
+    while (query != NULL && *query != '\0') {
+        if (strncmp(query, name, name_len) == 0 && query[name_len] == '=') {
+            return atoi(query + name_len + 1);
+        }
+        query = strchr(query, '&');
+        if (query != NULL) {
+            query++;
+        }
+    }
+    return default_value;
 }
 
-// Extract username from JSON request body
-int extract_username_from_json(const char* body, char* username, size_t username_size) {
-    // Simple JSON parsing to extract username
-    const char* username_start = strstr(body, "\"username\":");
-    if (!username_start) {
-        return -1;
+// Read a 64-bit integer query-string parameter, falling back to default_value
+static long long query_param_int64(const char *query, const char *name, long long default_value) {
+    size_t name_len = strlen(name);
+    
+    while (query != NULL && *query != '\0') {
+        if (strncmp(query, name, name_len) == 0 && query[name_len] == '=') {
+            return strtoll(query + name_len + 1, NULL, 10);
+        }
+        query = strchr(query, '&');
+        if (query != NULL) {
+            query++;
+        }
     }
+    return default_value;
+}
+
+// Copy a string query-string parameter (undecoded) into out; returns 0 if present
+static int query_param_string(const char *query, const char *name, char *out, size_t out_size) {
+    size_t name_len = strlen(name);
     
-    // Skip to the value
-    username_start = strchr(username_start, ':');
-    if (!username_start) {
+    while (query != NULL && *query != '\0') {
+        if (strncmp(query, name, name_len) == 0 && query[name_len] == '=') {
+            const char *value = query + name_len + 1;
+            size_t len = strcspn(value, "&");
+            if (len >= out_size) {
+                len = out_size - 1;
+            }
+            memcpy(out, value, len);
+            out[len] = '\0';
+            return 0;
+        }
+        query = strchr(query, '&');
+        if (query != NULL) {
+            query++;
+        }
+    }
+    return -1;
+}
+
+// Decode %XX escapes (and '+') in place, e.g. for cursors sent through URLSearchParams
+static void url_decode(char *value) {
+    char *out = value;
+    for (const char *in = value; *in != '\0'; in++) {
+        if (*in == '%' && isxdigit((unsigned char)in[1]) && isxdigit((unsigned char)in[2])) {
+            char hex[3] = { in[1], in[2], '\0' };
+            *out++ = (char)strtol(hex, NULL, 16);
+            in += 2;
+        } else {
+            *out++ = *in == '+' ? ' ' : *in;
+        }
+    }
+    *out = '\0';
+}
+
+// Read a keyset paging cursor (?before= or ?after=); NULL when absent
+static const char *query_param_cursor(const char *query, const char *name, char *out, size_t out_size) {
+    if (query_param_string(query, name, out, out_size) != 0) {
+        return NULL;
+    }
+    url_decode(out);
+    return out;
+}
+
+// Extract a top-level string member of a JSON request body, unescaped and
+// truncated to fit out. Reads members in place; no tree is built.
+static int extract_string_from_json(const char* body, const char* key, char* out, size_t out_size) {
+    json_reader_t reader;
+    json_member_t member;
+    
+    if (json_reader_init(&reader, body, strlen(body)) != 0) {
         return -1;
     }
-    username_start++;
+    while (json_reader_next(&reader, &member) == 1) {
+        if (json_view_equals(&member.key, key)) {
+            if (member.type != JSON_VALUE_STRING) {
+                return -1;
+            }
+            return json_view_copy_string(&member.value, out, out_size) >= 0 ? 0 : -1;
+        }
+    }
+    return -1;
+}
+int extract_username_from_json(const char* body, char* username, size_t username_size) {
+    return extract_string_from_json(body, "username", username, username_size);
+}
+
+// Room a semaphore request targets: "room" in the body, else ?room=, else
+// the default room (left empty). Returns false if the name is malformed.
+static bool extract_room(const http_request_t *req, char *room, size_t room_size) {
+    room[0] = '\0';
+    if (!(req->body != NULL && extract_string_from_json(req->body, "room", room, room_size) == 0)) {
+        query_param_string(req->query, "room", room, room_size);
+    }
+    return semaphore_valid_room(room);
+}
+
+// Name a room is reported under
+static const char *room_label(const char *room) {
+    return room[0] != '\0' ? room : SEMAPHORE_DEFAULT_ROOM;
+}
+
+// Decide whether the connection stays open after this request.
+// HTTP/1.1 defaults to persistent connections, HTTP/1.0 must opt in.
+static bool http_wants_keep_alive(http_slice_t version, const http_slice_t *connection_value) {
+    if (connection_value != NULL) {
+        char token[32];
+        size_t i = 0;
+        while (i < sizeof(token) - 1 && i < connection_value->length) {
+            token[i] = (char)tolower((unsigned char)connection_value->data[i]);
+            i++;
+        }
+        token[i] = '\0';
+        
+        if (strstr(token, "close") != NULL) {
+            return false;
+        }
+        if (strstr(token, "keep-alive") != NULL) {
+            return true;
+        }
+    }
+    return http_slice_equals(version, "HTTP/1.1");
+}
+
+// A POST /api/semaphore/acquire?wait_ms=N parked in a room's FIFO queue
+typedef struct {
+    conn_id_t conn_id;
+    bool keep_alive;
+    char username[64];
+    char room[MAX_ROOM_NAME_LEN];
+} parked_acquire_t;
+
+// A granted acquire whose client left before hearing about it must not keep
+// the semaphore
+static void finish_parked_grant(void *arg, bool delivered) {
+    parked_acquire_t *parked = (parked_acquire_t *)arg;
+    if (!delivered) {
+        LOG_INFO("Client of '%s' left before its queued acquire completed, releasing\n",
+                 parked->username);
+        release_writer(parked->room, parked->username);
+    }
+    free(parked);
+}
+
+// Outcome of a parked acquire (may run on any thread)
+static void on_parked_acquire(void *ctx, int status) {
+    parked_acquire_t *parked = (parked_acquire_t *)ctx;
+    http_request_t reply;
+    char content[384];
+    
+    memset(&reply, 0, sizeof(reply));
+    reply.keep_alive = parked->keep_alive;
     
-    // Skip whitespace and opening quote
-    while (*username_start == ' ' || *username_start == '\t') {
-        username_start++;
+    if (status == 0) {
+        snprintf(content, sizeof(content),
+                "{\"status\":\"success\",\"message\":\"Semaphore acquired\",\"room\":\"%s\",\"holder\":\"%s\"}",
+                room_label(parked->room), parked->username);
+        send_http_response(&reply, "200 OK", content);
+        conn_iov_t iov[2];
+        int count = take_http_response(&reply, iov);
+        event_loop_post_iov(parked->conn_id, iov, count, !parked->keep_alive,
+                            finish_parked_grant, parked);
+        return;
     }
-    if (*username_start != '"') {
-        return -1;
+    
+    if (status == -3) {
+        char current_holder[64];
+        int value;
+        get_semaphore_status(parked->room, current_holder, &value);
+        snprintf(content, sizeof(content),
+                "{\"status\":\"error\",\"message\":\"Semaphore unavailable (wait timed out)\",\"room\":\"%s\",\"holder\":\"%s\"}",
+                room_label(parked->room), current_holder);
+        send_http_response(&reply, "409 Conflict", content);
+    } else {
+        send_http_response(&reply, "503 Service Unavailable",
+                          "{\"status\":\"error\",\"message\":\"Server shutting down\"}");
     }
-    username_start++;
+    conn_iov_t iov[2];
+    int count = take_http_response(&reply, iov);
+    event_loop_post_iov(parked->conn_id, iov, count, !parked->keep_alive, NULL, NULL);
+    free(parked);
+}
+
+// POST /api/messages/batch: {"username":..., "room":..., "messages":[...]}
+// stores every message under one ownership check and one transaction, and
+// answers with the id and timestamp each one was given
+static void route_message_batch(http_request_t *req) {
+    cJSON *json = req->body != NULL ? cJSON_Parse(req->body) : NULL;
+    cJSON *username_item = cJSON_GetObjectItem(json, "username");
+    cJSON *room_item = cJSON_GetObjectItem(json, "room");
+    cJSON *messages_item = cJSON_GetObjectItem(json, "messages");
+    int count = cJSON_IsArray(messages_item) ? cJSON_GetArraySize(messages_item) : 0;
     
-    // Find closing quote
-    const char* username_end = strchr(username_start, '"');
-    if (!username_end) {
-        return -1;
+    if (!cJSON_IsString(username_item) || count == 0) {
+        send_http_response(req, "400 Bad Request",
+                          "{\"status\":\"error\",\"message\":\"Username and a non-empty messages array required\"}");
+        cJSON_Delete(json);
+        return;
+    }
+    if (count > DB_MAX_BATCH_MESSAGES) {
+        send_http_response(req, "413 Payload Too Large",
+                          "{\"status\":\"error\",\"message\":\"Too many messages in one batch\"}");
+        cJSON_Delete(json);
+        return;
     }
+    const char *room = cJSON_IsString(room_item) ? room_item->valuestring : "";
     
-    // Copy username
-    size_t len = username_end - username_start;
-    if (len >= username_size) {
-        len = username_size - 1;
+    // The texts stay in the parse tree until the batch is stored
+    const char **messages = arena_alloc(request_arena(), (size_t)count * sizeof(char *));
+    message_ref_t *refs = arena_alloc(request_arena(), (size_t)count * sizeof(message_ref_t));
+    int result = messages != NULL && refs != NULL ? 0 : -1;
+    int index = 0;
+    cJSON *entry = NULL;
+    cJSON_ArrayForEach(entry, messages_item) {
+        if (result == 0 && !cJSON_IsString(entry)) {
+            result = -4;
+        } else if (result == 0) {
+            messages[index++] = entry->valuestring;
+        }
+    }
+    if (result == 0) {
+        result = create_message_batch(room, username_item->valuestring, messages, count, refs);
     }
-    strncpy(username, username_start, len);
-    username[len] = '\0';
     
-    return 0;
+    if (result == 0) {
+        strbuf_t content;
+        json_writer_t w;
+        strbuf_init(&content);
+        json_writer_init(&w, &content);
+        json_begin_object(&w);
+        json_field_string(&w, "status", "success");
+        json_field_string(&w, "room", room_label(room));
+        json_field_int(&w, "count", count);
+        json_key(&w, "data");
+        json_begin_array(&w);
+        for (int i = 0; i < count; i++) {
+            json_begin_object(&w);
+            json_field_int(&w, "id", refs[i].id);
+            json_field_string(&w, "timestamp", refs[i].timestamp);
+            json_end_object(&w);
+        }
+        json_end_array(&w);
+        json_end_object(&w);
+        if (json_writer_finish(&w) == 0) {
+            send_http_response_buf(req, "200 OK", &content);
+        } else {
+            send_http_response(req, "500 Internal Server Error",
+                              "{\"status\":\"error\",\"message\":\"Out of memory\"}");
+        }
+        strbuf_free(&content);
+    } else if (result == -2) {
+        send_http_response(req, "403 Forbidden",
+                          "{\"status\":\"error\",\"message\":\"Permission denied - semaphore not held\"}");
+    } else if (result == -4) {
+        send_http_response(req, "400 Bad Request",
+                          "{\"status\":\"error\",\"message\":\"Invalid room or message in batch\"}");
+    } else {
+        send_http_response(req, "500 Internal Server Error",
+                          "{\"status\":\"error\",\"message\":\"Cannot store messages - none were stored\"}");
+    }
+    
+    cJSON_Delete(json);
 }
 
-// Handle HTTP requests
-void handle_http_request(int client_socket) {
-    char buffer[4096];
+// POST /api/semaphore/acquire[?wait_ms=N]: {"username":..., "room":...}
+static void route_acquire(http_request_t *req) {
     char response_content[2048];
+    char *body = req->body;
+    char username[64] = {0};
+    char room[MAX_ROOM_NAME_LEN];
     
-    // Read HTTP request
-    ssize_t bytes_read = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
-    if (bytes_read <= 0) {
+    // Extract username from request body
+    if (!body || extract_username_from_json(body, username, sizeof(username)) != 0) {
+        send_http_response(req, "400 Bad Request", 
+                          "{\"status\":\"error\",\"message\":\"Username required in request body\"}");
+        return;
+    }
+    if (!extract_room(req, room, sizeof(room))) {
+        send_http_response(req, "400 Bad Request", 
+                          "{\"status\":\"error\",\"message\":\"Invalid room name\"}");
         return;
     }
-    buffer[bytes_read] = '\0';
     
-    printf("Received request: %.100s...\n", buffer);
+    int wait_ms = query_param_int(req->query, "wait_ms", 0);
+    LOG_DEBUG("User '%s' requesting semaphore acquisition for room '%s' (wait %d ms)\n",
+              username, room_label(room), wait_ms);
     
-    // Parse HTTP method and path
-    char method[16], path[256];
-    if (sscanf(buffer, "%15s %255s", method, path) != 2) {
-        send_http_response(client_socket, "400 Bad Request", 
-                          "{\"error\":\"Invalid HTTP request\"}");
+    // Try to acquire semaphore for the specified user, optionally queueing
+    int result;
+    if (wait_ms > 0) {
+        parked_acquire_t *parked = malloc(sizeof(parked_acquire_t));
+        if (parked == NULL) {
+            send_http_response(req, "500 Internal Server Error",
+                              "{\"status\":\"error\",\"message\":\"Out of memory\"}");
+            return;
+        }
+        parked->conn_id = req->conn_id;
+        parked->keep_alive = req->keep_alive;
+        strcpy(parked->username, username);
+        strcpy(parked->room, room);
+        
+        result = acquire_writer_queued(room, username, wait_ms, on_parked_acquire, parked);
+        if (result == 1) {
+            req->parked = true;  // on_parked_acquire() answers later
+            return;
+        }
+        free(parked);
+    } else {
+        result = try_acquire_writer(room, username);
+    }
+    
+    if (result == 0) {
+        snprintf(response_content, sizeof(response_content),
+                "{\"status\":\"success\",\"message\":\"Semaphore acquired\",\"room\":\"%s\",\"holder\":\"%s\"}",
+                room_label(room), username);
+        send_http_response(req, "200 OK", response_content);
+    } else if (result == -3) {
+        // Get current holder info
+        char current_holder[64];
+        int value;
+        get_semaphore_status(room, current_holder, &value);
+        snprintf(response_content, sizeof(response_content),
+                "{\"status\":\"error\",\"message\":\"Semaphore unavailable\",\"room\":\"%s\",\"holder\":\"%s\"}",
+                room_label(room), current_holder);
+        send_http_response(req, "409 Conflict", response_content);
+    } else if (result == -2) {
+        strcpy(response_content, "{\"status\":\"error\",\"message\":\"Writer access disabled\"}");
+        send_http_response(req, "403 Forbidden", response_content);
+    } else {
+        strcpy(response_content, "{\"status\":\"error\",\"message\":\"Failed to acquire semaphore\"}");
+        send_http_response(req, "500 Internal Server Error", response_content);
+    }
+}
+
+// POST /api/semaphore/release: {"username":..., "room":...}
+static void route_release(http_request_t *req) {
+    char response_content[2048];
+    char *body = req->body;
+    char username[64] = {0};
+    
+    // Extract username from request body
+    if (!body || extract_username_from_json(body, username, sizeof(username)) != 0) {
+        send_http_response(req, "400 Bad Request", 
+                          "{\"status\":\"error\",\"message\":\"Username required in request body\"}");
+        return;
+    }
+    
+    char room[MAX_ROOM_NAME_LEN];
+    if (!extract_room(req, room, sizeof(room))) {
+        send_http_response(req, "400 Bad Request", 
+                          "{\"status\":\"error\",\"message\":\"Invalid room name\"}");
         return;
     }
     
-    // Handle OPTIONS for CORS
-    if (strcmp(method, "OPTIONS") == 0) {
-        send_http_response(client_socket, "200 OK", "");
+    LOG_DEBUG("User '%s' requesting semaphore release for room '%s'\n", username, room_label(room));
+    
+    // Release semaphore for the specified user
+    int result = release_writer(room, username);
+    if (result == 0) {
+        strcpy(response_content, "{\"status\":\"success\",\"message\":\"Semaphore released\"}");
+        send_http_response(req, "200 OK", response_content);
+    } else if (result == -2) {
+        strcpy(response_content, "{\"status\":\"error\",\"message\":\"Permission denied - not semaphore holder\"}");
+        send_http_response(req, "403 Forbidden", response_content);
+    } else {
+        strcpy(response_content, "{\"status\":\"error\",\"message\":\"Cannot release semaphore\"}");
+        send_http_response(req, "500 Internal Server Error", response_content);
+    }
+}
+
+// POST /api/semaphore/heartbeat: renew the holder's lease
+static void route_heartbeat(http_request_t *req) {
+    char response_content[2048];
+    char *body = req->body;
+    char username[64] = {0};
+    
+    // Extract username from request body
+    if (!body || extract_username_from_json(body, username, sizeof(username)) != 0) {
+        send_http_response(req, "400 Bad Request", 
+                          "{\"status\":\"error\",\"message\":\"Username required in request body\"}");
         return;
     }
     
-    // Find request body (after double CRLF)
-    char* body = strstr(buffer, "\r\n\r\n");
-    if (body) {
-        body += 4; // Skip the double CRLF
+    char room[MAX_ROOM_NAME_LEN];
+    if (!extract_room(req, room, sizeof(room))) {
+        send_http_response(req, "400 Bad Request", 
+                          "{\"status\":\"error\",\"message\":\"Invalid room name\"}");
+        return;
     }
     
-    // Route handling
-    if (strcmp(path, "/api/semaphore/acquire") == 0 && strcmp(method, "POST") == 0) {
-        char username[64] = {0};
-        
-        // Extract username from request body
-        if (!body || extract_username_from_json(body, username, sizeof(username)) != 0) {
-            send_http_response(client_socket, "400 Bad Request", 
-                              "{\"status\":\"error\",\"message\":\"Username required in request body\"}");
-            return;
+    // Renew the holder's lease
+    if (semaphore_renew_lease(room, username) == 0) {
+        snprintf(response_content, sizeof(response_content),
+                "{\"status\":\"success\",\"message\":\"Lease renewed\",\"room\":\"%s\",\"lease_remaining_ms\":%d}",
+                room_label(room), semaphore_lease_remaining_ms(room));
+        send_http_response(req, "200 OK", response_content);
+    } else {
+        strcpy(response_content, "{\"status\":\"error\",\"message\":\"Permission denied - not semaphore holder\"}");
+        send_http_response(req, "403 Forbidden", response_content);
+    }
+}
+
+// GET /api/semaphore/status: one room's semaphore (?room=, default room otherwise)
+static void route_status(http_request_t *req) {
+    char response_content[2048];
+    char room[MAX_ROOM_NAME_LEN];
+    if (!extract_room(req, room, sizeof(room))) {
+        send_http_response(req, "400 Bad Request", 
+                          "{\"status\":\"error\",\"message\":\"Invalid room name\"}");
+        return;
+    }
+    
+    char holder[64];
+    int value;
+    int result = get_semaphore_status(room, holder, &value);
+    if (result == 0) {
+        snprintf(response_content, sizeof(response_content),
+                "{\"status\":\"success\",\"room\":\"%s\",\"semaphore_value\":%d,\"holder\":\"%s\","
+                "\"lease_remaining_ms\":%d,\"waiting\":%d}",
+                room_label(room), value, holder, semaphore_lease_remaining_ms(room),
+                semaphore_queue_length(room));
+        send_http_response(req, "200 OK", response_content);
+    } else {
+        strcpy(response_content, "{\"status\":\"error\",\"message\":\"Cannot get status\"}");
+        send_http_response(req, "500 Internal Server Error", response_content);
+    }
+}
+
+// GET /api/semaphore/rooms: every room's semaphore at a glance
+static void route_rooms(http_request_t *req) {
+    char *rooms_json = arena_alloc(request_arena(), MAX_JSON_LEN);
+    char *content = arena_alloc(request_arena(), MAX_JSON_LEN + 32);
+    if (rooms_json == NULL || content == NULL) {
+        send_http_response(req, "500 Internal Server Error",
+                          "{\"status\":\"error\",\"message\":\"Out of memory\"}");
+        return;
+    }
+    
+    if (semaphore_rooms_json(rooms_json, MAX_JSON_LEN) == 0) {
+        snprintf(content, MAX_JSON_LEN + 32, "{\"status\":\"success\",\"data\":%s}", rooms_json);
+        send_http_response(req, "200 OK", content);
+    } else {
+        send_http_response(req, "500 Internal Server Error",
+                          "{\"status\":\"error\",\"message\":\"Too many rooms to list\"}");
+    }
+}
+
+// GET /api/messages and GET /api/logs: paged storage reads (worker thread)
+static void route_storage_page(http_request_t *req) {
+    int page = query_param_int(req->query, "page", 1);
+    int limit = query_param_int(req->query, "limit", 50);
+    bool messages = req->route->command == CMD_LIST_MESSAGES;
+    char room[MAX_ROOM_NAME_LEN];
+    bool one_room = query_param_string(req->query, "room", room, sizeof(room)) == 0;
+    char before_buf[MAX_CURSOR_LEN * 3];  // Room for a fully percent-encoded cursor
+    char after_buf[MAX_CURSOR_LEN * 3];
+    const char *before = query_param_cursor(req->query, "before", before_buf, sizeof(before_buf));
+    const char *after = query_param_cursor(req->query, "after", after_buf, sizeof(after_buf));
+    
+    // The page is formatted straight into the response body, wrapped in place
+    strbuf_t content;
+    strbuf_init(&content);
+    strbuf_append_str(&content, "{\"status\":\"success\",\"data\":");
+    
+    int result = messages ? list_messages(one_room ? room : NULL, page, limit, before, after, &content)
+                          : get_logs(page, limit, before, after, &content);
+    if (result == 0) {
+        strbuf_append_str(&content, "}");
+        send_http_response_buf(req, "200 OK", &content);
+    } else if (result == -4) {
+        send_http_response(req, "400 Bad Request",
+                          "{\"status\":\"error\",\"message\":\"Invalid page, limit, cursor or room parameters\"}");
+    } else {
+        send_http_response(req, "500 Internal Server Error",
+                          messages ? "{\"status\":\"error\",\"message\":\"Cannot list messages\"}"
+                                   : "{\"status\":\"error\",\"message\":\"Cannot get logs\"}");
+    }
+    
+    strbuf_free(&content);
+}
+
+// GET /api/messages/search?q=...: ranked full-text search (worker thread)
+static void route_search(http_request_t *req) {
+    int page = query_param_int(req->query, "page", 1);
+    int limit = query_param_int(req->query, "limit", 50);
+    char room[MAX_ROOM_NAME_LEN];
+    bool one_room = query_param_string(req->query, "room", room, sizeof(room)) == 0;
+    char query[SEARCH_MAX_QUERY_LEN * 3 + 2];  // A fully percent-encoded query, plus one to spot longer
+    if (query_param_string(req->query, "q", query, sizeof(query)) != 0 ||
+        strlen(query) > SEARCH_MAX_QUERY_LEN * 3) {
+        send_http_response(req, "400 Bad Request",
+                          "{\"status\":\"error\",\"message\":\"A search query (q) is required\"}");
+        return;
+    }
+    url_decode(query);
+    
+    strbuf_t content;
+    strbuf_init(&content);
+    strbuf_append_str(&content, "{\"status\":\"success\",\"data\":");
+    
+    int result = search_messages(one_room ? room : NULL, query, page, limit, &content);
+    if (result == 0) {
+        strbuf_append_str(&content, "}");
+        send_http_response_buf(req, "200 OK", &content);
+    } else if (result == -4) {
+        send_http_response(req, "400 Bad Request",
+                          "{\"status\":\"error\",\"message\":\"Invalid query, page, limit or room parameters\"}");
+    } else if (result == -3) {
+        send_http_response(req, "503 Service Unavailable",
+                          "{\"status\":\"error\",\"message\":\"Search is not available\"}");
+    } else {
+        send_http_response(req, "500 Internal Server Error",
+                          "{\"status\":\"error\",\"message\":\"Cannot search messages\"}");
+    }
+    
+    strbuf_free(&content);
+}
+
+// GET /api/messages/changes?since=N: what changed after sequence number N (worker thread)
+static void route_changes(http_request_t *req) {
+    long long since = query_param_int64(req->query, "since", 0);
+    int limit = query_param_int(req->query, "limit", 50);
+    char room[MAX_ROOM_NAME_LEN];
+    bool one_room = query_param_string(req->query, "room", room, sizeof(room)) == 0;
+    
+    strbuf_t content;
+    strbuf_init(&content);
+    strbuf_append_str(&content, "{\"status\":\"success\",\"data\":");
+    
+    int result = get_changes(one_room ? room : NULL, since, limit, &content);
+    if (result == 0) {
+        strbuf_append_str(&content, "}");
+        send_http_response_buf(req, "200 OK", &content);
+    } else if (result == -4) {
+        send_http_response(req, "400 Bad Request",
+                          "{\"status\":\"error\",\"message\":\"Invalid since, limit or room parameters\"}");
+    } else if (result == -3) {
+        send_http_response(req, "501 Not Implemented",
+                          "{\"status\":\"error\",\"message\":\"Change feed not available with this storage engine\"}");
+    } else {
+        send_http_response(req, "500 Internal Server Error",
+                          "{\"status\":\"error\",\"message\":\"Cannot get changes\"}");
+    }
+    
+    strbuf_free(&content);
+}
+
+// GET /metrics: Prometheus scrape (worker thread)
+static void route_metrics(http_request_t *req) {
+    strbuf_t content;
+    strbuf_init(&content);
+    if (metrics_render(&content) == 0) {
+        send_http_response_typed(req, "200 OK", "text/plain; version=0.0.4", &content);
+    } else {
+        send_http_response(req, "500 Internal Server Error",
+                          "{\"status\":\"error\",\"message\":\"Cannot render metrics\"}");
+    }
+    strbuf_free(&content);
+}
+
+// GET /api/events: push stream of semaphore and message events. A
+// reconnecting EventSource sends Last-Event-ID, other clients may use the query.
+static void route_events(http_request_t *req) {
+    char last_id_text[24];
+    if (query_param_string(req->query, "last_event_id", last_id_text, sizeof(last_id_text)) == 0) {
+        req->last_event_id = strtoull(last_id_text, NULL, 10);
+    }
+    if (events_subscribe(req->conn_id, req->last_event_id) == 0) {
+        start_event_stream(req);
+    } else {
+        send_http_response(req, "503 Service Unavailable",
+                          "{\"status\":\"error\",\"message\":\"Too many event streams\"}");
+    }
+}
+
+// GET /api/pool/status: worker pool sizing information
+static void route_pool_status(http_request_t *req) {
+    char response_content[2048];
+    char pool_json[4096];
+    if (thread_pool_stats_json(pool_json, sizeof(pool_json)) == 0) {
+        snprintf(response_content, sizeof(response_content),
+                "{\"status\":\"success\",\"data\":%.2000s}", pool_json);
+        send_http_response(req, "200 OK", response_content);
+    } else {
+        strcpy(response_content, "{\"status\":\"error\",\"message\":\"Cannot get pool status\"}");
+        send_http_response(req, "500 Internal Server Error", response_content);
+    }
+}
+// HTTP status for an execute_command() result
+static const char *command_http_status(int status) {
+    switch (status) {
+        case 0:
+            return "200 OK";
+        case -2:
+            return "403 Forbidden";
+        case -3:
+            return "409 Conflict";
+        case -4:
+            return "400 Bad Request";
+        default:
+            return "500 Internal Server Error";
+    }
+}
+
+// Copy a string member of the request body; false if it is not one or too long
+static bool copy_member_string(const json_member_t *member, char *out, size_t out_size) {
+    if (member->type != JSON_VALUE_STRING) {
+        return false;
+    }
+    long long len = json_view_copy_string(&member->value, out, out_size);
+    return len >= 0 && (size_t)len < out_size;
+}
+
+// Endpoints backed by a handlers.c command, so HTTP and the command socket
+// share one implementation. The body and the path's id fill the command_t:
+//   POST   /api/messages         {"username", "room", "message"}
+//   PUT    /api/messages/{id}    {"username", "room", "message"}
+//   DELETE /api/messages/{id}    {"username", "room"}
+//   POST   /api/admin/writer     {"username", "enabled"}
+static void route_execute(http_request_t *req) {
+    command_t cmd;
+    init_command(&cmd);
+    cmd.type = (command_type_t)req->route->command;
+    cmd.id = req->path_id;
+    
+    // One pass over the body; a member seen twice keeps its first value
+    bool has_user = false, has_message = false, has_enabled = false;
+    json_reader_t reader;
+    json_member_t member;
+    int next = req->body != NULL ? json_reader_init(&reader, req->body, req->body_length) : -4;
+    bool valid = next == 0;
+    while (valid && (next = json_reader_next(&reader, &member)) == 1) {
+        if (!has_user && json_view_equals(&member.key, "username")) {
+            valid = has_user = copy_member_string(&member, cmd.user, sizeof(cmd.user));
+        } else if (!has_message && json_view_equals(&member.key, "message")) {
+            valid = has_message = copy_member_string(&member, cmd.message, sizeof(cmd.message));
+        } else if (!has_enabled && json_view_equals(&member.key, "enabled")) {
+            valid = has_enabled = member.type == JSON_VALUE_TRUE || member.type == JSON_VALUE_FALSE;
+            cmd.enabled = member.type == JSON_VALUE_TRUE;
         }
-        
-        printf("User '%s' requesting semaphore acquisition\n", username);
-        
-        // Try to acquire semaphore for the specified user
-        int result = try_acquire_writer(username);
-        if (result == 0) {
-            snprintf(response_content, sizeof(response_content),
-                    "{\"status\":\"success\",\"message\":\"Semaphore acquired\",\"holder\":\"%s\"}", username);
-            send_http_response(client_socket, "200 OK", response_content);
-        } else if (result == -3) {
-            // Get current holder info
-            char current_holder[64];
-            int value;
-            get_semaphore_status(current_holder, &value);
-            snprintf(response_content, sizeof(response_content),
-                    "{\"status\":\"error\",\"message\":\"Semaphore unavailable\",\"holder\":\"%s\"}", current_holder);
-            send_http_response(client_socket, "409 Conflict", response_content);
-        } else {
-            strcpy(response_content, "{\"status\":\"error\",\"message\":\"Failed to acquire semaphore\"}");
-            send_http_response(client_socket, "500 Internal Server Error", response_content);
+    }
+    valid = valid && next == 0 && has_user && extract_room(req, cmd.room, sizeof(cmd.room));
+    if (cmd.type == CMD_CREATE_MESSAGE || cmd.type == CMD_UPDATE_MESSAGE) {
+        valid = valid && has_message;
+    }
+    if (cmd.type == CMD_TOGGLE_WRITER) {
+        valid = valid && has_enabled;
+    }
+    if (!valid) {
+        send_http_response(req, "400 Bad Request",
+                          "{\"status\":\"error\",\"message\":\"Invalid request body\"}");
+        return;
+    }
+    
+    response_t *resp = arena_alloc(request_arena(), sizeof(response_t));  // Carries an 8 KiB payload
+    if (resp == NULL) {
+        send_http_response(req, "500 Internal Server Error",
+                          "{\"status\":\"error\",\"message\":\"Out of memory\"}");
+        return;
+    }
+    execute_command(&cmd, resp);
+    
+    strbuf_t content;
+    json_writer_t w;
+    strbuf_init(&content);
+    json_writer_init(&w, &content);
+    json_begin_object(&w);
+    if (resp->status == 0) {
+        json_field_string(&w, "status", "success");
+        json_key(&w, "data");
+        size_t data_len;
+        const char *data = response_data(resp, &data_len);
+        json_raw(&w, data_len > 0 ? data : "{}", data_len > 0 ? data_len : 2);
+    } else {
+        json_field_string(&w, "status", "error");
+        json_field_string(&w, "message", resp->error[0] != '\0' ? resp->error : "Unknown error");
+    }
+    json_end_object(&w);
+    json_writer_finish(&w);
+    send_http_response_buf(req, command_http_status(resp->status), &content);
+    strbuf_free(&content);
+    
+    free_command(&cmd);
+}
+
+// Route table. Paths are matched by length first, so a lookup is a few
+// integer compares plus one memcmp per candidate of the right length;
+// ROUTE_ID entries match their prefix followed by a positive decimal id.
+#define ROUTE(method, path, worker, command, handler) \
+    { method, path, sizeof(path) - 1, false, worker, command, handler }
+#define ROUTE_ID(method, prefix, worker, command, handler) \
+    { method, prefix, sizeof(prefix) - 1, true, worker, command, handler }
+
+static const route_t g_routes[] = {
+    ROUTE("POST", "/api/semaphore/acquire", false, CMD_TRY_ACQUIRE, route_acquire),
+    ROUTE("POST", "/api/semaphore/release", false, CMD_RELEASE, route_release),
+    ROUTE("POST", "/api/semaphore/heartbeat", false, CMD_HEARTBEAT, route_heartbeat),
+    ROUTE("GET", "/api/semaphore/status", false, CMD_GET_STATUS, route_status),
+    ROUTE("GET", "/api/semaphore/rooms", false, -1, route_rooms),
+    ROUTE("GET", "/api/messages", true, CMD_LIST_MESSAGES, route_storage_page),
+    ROUTE("POST", "/api/messages", true, CMD_CREATE_MESSAGE, route_execute),
+    ROUTE("POST", "/api/messages/batch", true, CMD_CREATE_BATCH, route_message_batch),
+    ROUTE("GET", "/api/messages/search", true, CMD_SEARCH_MESSAGES, route_search),
+    ROUTE("GET", "/api/messages/changes", true, CMD_GET_CHANGES, route_changes),
+    ROUTE_ID("PUT", "/api/messages/", true, CMD_UPDATE_MESSAGE, route_execute),
+    ROUTE_ID("DELETE", "/api/messages/", true, CMD_DELETE_MESSAGE, route_execute),
+    ROUTE("GET", "/api/logs", true, CMD_GET_LOGS, route_storage_page),
+    ROUTE("POST", "/api/admin/writer", false, CMD_TOGGLE_WRITER, route_execute),
+    ROUTE("GET", "/api/events", false, -1, route_events),
+    ROUTE("GET", "/api/pool/status", false, -1, route_pool_status),
+    ROUTE("GET", "/metrics", true, -1, route_metrics),
+};
+
+#define ROUTE_COUNT ((int)(sizeof(g_routes) / sizeof(g_routes[0])))
+
+// Id of an id-segment path, or 0 if the rest of it is not one
+static int parse_path_id(const char *text, size_t length) {
+    if (length == 0 || length > 9) {
+        return 0;
+    }
+    int id = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] < '0' || text[i] > '9') {
+            return 0;
         }
+        id = id * 10 + (text[i] - '0');
     }
-    else if (strcmp(path, "/api/semaphore/release") == 0 && strcmp(method, "POST") == 0) {
-        char username[64] = {0};
-        
-        // Extract username from request body
-        if (!body || extract_username_from_json(body, username, sizeof(username)) != 0) {
-            send_http_response(client_socket, "400 Bad Request", 
-                              "{\"status\":\"error\",\"message\":\"Username required in request body\"}");
-            return;
+    return id;
+}
+
+// Find the request's route and its path id. Sets *path_known when the
+// path exists under another method, so the caller can answer 405.
+static const route_t *match_route(const http_request_t *req, int *path_id, bool *path_known) {
+    size_t path_length = strlen(req->path);
+    *path_id = 0;
+    *path_known = false;
+    
+    for (int i = 0; i < ROUTE_COUNT; i++) {
+        const route_t *route = &g_routes[i];
+        int id = 0;
+        if (route->id_segment) {
+            if (path_length <= route->path_length ||
+                memcmp(req->path, route->path, route->path_length) != 0) {
+                continue;
+            }
+            id = parse_path_id(req->path + route->path_length, path_length - route->path_length);
+            if (id <= 0) {
+                continue;
+            }
+        } else if (path_length != route->path_length || memcmp(req->path, route->path, path_length) != 0) {
+            continue;
         }
         
-        printf("User '%s' requesting semaphore release\n", username);
-        
-        // Release semaphore for the specified user
-        int result = release_writer(username);
-        if (result == 0) {
-            strcpy(response_content, "{\"status\":\"success\",\"message\":\"Semaphore released\"}");
-            send_http_response(client_socket, "200 OK", response_content);
-        } else if (result == -2) {
-            strcpy(response_content, "{\"status\":\"error\",\"message\":\"Permission denied - not semaphore holder\"}");
-            send_http_response(client_socket, "403 Forbidden", response_content);
-        } else {
-            strcpy(response_content, "{\"status\":\"error\",\"message\":\"Cannot release semaphore\"}");
-            send_http_response(client_socket, "500 Internal Server Error", response_content);
+        if (strcmp(req->method, route->method) == 0) {
+            *path_id = id;
+            return route;
         }
+        *path_known = true;
     }
-    else if (strcmp(path, "/api/semaphore/status") == 0 && strcmp(method, "GET") == 0) {
-        // Get semaphore status
-        char holder[64];
-        int value;
-        int result = get_semaphore_status(holder, &value);
-        if (result == 0) {
-            snprintf(response_content, sizeof(response_content),
-                    "{\"status\":\"success\",\"semaphore_value\":%d,\"holder\":\"%s\"}",
-                    value, holder);
-            send_http_response(client_socket, "200 OK", response_content);
+    return NULL;
+}
+
+// Attach the route to a parsed request (loop thread, before dispatch)
+static void resolve_route(http_request_t *req) {
+    bool path_known = false;
+    req->route = match_route(req, &req->path_id, &path_known);
+    req->method_not_allowed = req->route == NULL && path_known;
+}
+
+// Storage routes run on the worker pool; semaphore calls are O(1) and stay
+// on the event loop thread
+static bool route_runs_on_worker(const http_request_t *req) {
+    return req->route != NULL && req->route->on_worker;
+}
+
+// Route a single, fully received HTTP request
+static void route_endpoint(http_request_t *req) {
+    if (req->route != NULL) {
+        req->route->handler(req);
+    } else if (req->method_not_allowed) {
+        send_http_response(req, "405 Method Not Allowed",
+                          "{\"status\":\"error\",\"message\":\"Method not allowed\"}");
+    } else {
+        send_http_response(req, "404 Not Found",
+                          "{\"status\":\"error\",\"message\":\"Endpoint not found\"}");
+    }
+}
+
+// Command an endpoint performs, for its latency histogram; -1 for the rest
+static int route_command(const http_request_t *req) {
+    if (req->route == NULL) {
+        return -1;
+    }
+    if (req->route->command == CMD_TRY_ACQUIRE && query_param_int(req->query, "wait_ms", 0) > 0) {
+        return CMD_ACQUIRE_WAIT;
+    }
+    return req->route->command;
+}
+
+// Route and time a request. A parked acquire is timed up to parking; its
+// wait shows in the semaphore wait histogram.
+static void route_http_request(http_request_t *req) {
+    metrics_count(METRIC_REQUESTS, 1);
+    int command = route_command(req);
+    if (command < 0) {
+        route_endpoint(req);
+        return;
+    }
+    
+    uint64_t started = monotonic_ns();
+    route_endpoint(req);
+    metrics_observe((metric_histogram_t)(METRIC_COMMAND_BASE + command), monotonic_ns() - started);
+}
+
+// Worker thread entry: route the request and hand the response to the loop
+static void http_worker_task(void *arg) {
+    http_request_t *req = (http_request_t *)arg;
+    
+    route_http_request(req);
+    conn_iov_t iov[2];
+    int count = take_http_response(req, iov);
+    event_loop_post_iov(req->conn_id, iov, count, !req->keep_alive, NULL, NULL);
+    
+    free(req->body);
+    free(req);
+}
+
+// Queue a response produced on the loop thread; the connection takes its buffers
+static void reply_inline(connection_t *conn, http_request_t *req) {
+    conn_iov_t iov[2];
+    int count = take_http_response(req, iov);
+    if (count > 0) {
+        conn_write_iov(conn, iov, count);
+    }
+}
+
+// Copy the request into heap memory and queue it on the worker pool.
+// Returns false if the pool is unavailable and the caller should answer inline.
+static bool dispatch_to_worker(connection_t *conn, const http_request_t *req) {
+    http_request_t *job = malloc(sizeof(http_request_t));
+    if (job == NULL) {
+        return false;
+    }
+    *job = *req;
+    job->query = NULL;
+    job->body = NULL;
+    
+    // query points into path; rebase it onto the copy
+    if (req->query != NULL) {
+        job->query = job->path + (req->query - req->path);
+    }
+    if (req->body != NULL) {
+        job->body = malloc(req->body_length + 1);
+        if (job->body == NULL) {
+            free(job);
+            return false;
+        }
+        memcpy(job->body, req->body, req->body_length + 1);
+    }
+    
+    if (thread_pool_submit(http_worker_task, job) != 0) {
+        free(job->body);
+        free(job);
+        return false;
+    }
+    
+    conn->awaiting_reply = true;  // Hold pipelined requests until this one answers
+    return true;
+}
+
+// Reject a request the parser could not frame; nothing after it on the
+// connection can be trusted, so it is closed once the reply is out
+static size_t reject_http_request(connection_t *conn, http_request_t *req, http_parse_status_t status) {
+    conn->keep_alive = false;
+    if (status == HTTP_PARSE_TOO_LARGE) {
+        send_http_response(req, "413 Payload Too Large", 
+                          "{\"error\":\"Request too large\"}");
+    } else if (status == HTTP_PARSE_UNSUPPORTED) {
+        send_http_response(req, "501 Not Implemented", 
+                          "{\"error\":\"Unsupported Transfer-Encoding\"}");
+    } else {
+        send_http_response(req, "400 Bad Request", 
+                          "{\"error\":\"Invalid HTTP request\"}");
+    }
+    reply_inline(conn, req);
+    http_parser_reset(&conn->http);
+    return conn->in_len;
+}
+
+// Parse and answer the request at the front of the input buffer.
+// Returns the number of bytes it occupied, or 0 if it is still incomplete.
+static size_t handle_one_http_request(connection_t *conn) {
+    char *buffer = conn->in_buf;
+    http_parser_t *parser = &conn->http;
+    http_request_t req;
+    memset(&req, 0, sizeof(req));
+    req.conn_id = conn->id;
+    
+    // Picks up where the previous read left off
+    http_parse_status_t status = http_parser_execute(parser, buffer, conn->in_len,
+                                                     MAX_REQUEST_BUFFER);
+    if (status == HTTP_PARSE_INCOMPLETE) {
+        return 0;
+    }
+    if (status != HTTP_PARSE_COMPLETE) {
+        return reject_http_request(conn, &req, status);
+    }
+    
+    http_slice_t method = http_parser_slice(buffer, parser->method);
+    http_slice_t path = http_parser_slice(buffer, parser->path);
+    http_slice_t query = http_parser_slice(buffer, parser->query);
+    size_t path_length = path.length + (parser->has_query ? 1 + query.length : 0);
+    if (method.length >= sizeof(req.method) || path_length >= sizeof(req.path)) {
+        return reject_http_request(conn, &req, HTTP_PARSE_INVALID);
+    }
+    size_t request_length = parser->request_length;
+    
+    LOG_DEBUG("Received request: %.*s %.*s (%zu byte body)\n", (int)method.length, method.data,
+              (int)path.length, path.data, parser->body_length);
+    
+    // Method and target are small and outlive the input buffer on a worker,
+    // so they are copied; the body stays where it was received
+    memcpy(req.method, method.data, method.length);
+    memcpy(req.path, path.data, path.length);
+    if (parser->has_query) {
+        memcpy(req.path + path.length + 1, query.data, query.length);
+        req.query = req.path + path.length + 1;
+    }
+    
+    resolve_route(&req);
+    
+    http_slice_t header;
+    if (http_parser_header(parser, buffer, "Last-Event-ID", &header)) {
+        req.last_event_id = strtoull(header.data, NULL, 10);
+    }
+    
+    conn->requests_served++;
+    bool has_connection = http_parser_header(parser, buffer, "Connection", &header);
+    conn->keep_alive = http_wants_keep_alive(http_parser_slice(buffer, parser->version),
+                                             has_connection ? &header : NULL) &&
+                       conn->requests_served < HTTP_KEEPALIVE_MAX_REQUESTS;
+    req.keep_alive = conn->keep_alive;
+    
+    // The (decoded) body sits right after the head; terminate it in place
+    // without clobbering the first byte of a pipelined request behind it
+    char *body_end = buffer + parser->head_length + parser->body_length;
+    req.body = parser->body_length > 0 ? buffer + parser->head_length : NULL;
+    req.body_length = parser->body_length;
+    char saved_byte = *body_end;
+    *body_end = '\0';
+    http_parser_reset(parser);
+    
+    if (strcmp(req.method, "OPTIONS") == 0) {
+        // Handle OPTIONS for CORS
+        send_http_response(&req, "200 OK", "");
+        reply_inline(conn, &req);
+    } else if (!(thread_pool_size() > 0 && route_runs_on_worker(&req) &&
+                 dispatch_to_worker(conn, &req))) {
+        route_http_request(&req);
+        if (req.parked) {
+            conn->awaiting_reply = true;  // Hold pipelined requests until it is answered
+        } else if (req.streaming) {
+            reply_inline(conn, &req);
+            conn->awaiting_reply = true;  // Nothing after it is ever parsed
+            conn->streaming = true;
         } else {
-            strcpy(response_content, "{\"status\":\"error\",\"message\":\"Cannot get status\"}");
-            send_http_response(client_socket, "500 Internal Server Error", response_content);
+            reply_inline(conn, &req);
+        }
+    }
+    
+    *body_end = saved_byte;
+    return request_length;
+}
+
+// Handle HTTP requests - called by the event loop as request bytes arrive.
+// Pipelined requests are answered in order while the connection stays open.
+void handle_http_request(connection_t *conn) {
+    while (conn->in_len > 0 && !conn->close_after_write && !conn->awaiting_reply) {
+        size_t consumed = handle_one_http_request(conn);
+        if (consumed == 0) {
+            break;  // Incomplete request, wait for more bytes
+        }
+        conn_consume_input(conn, consumed);
+        request_arena_reset();  // Scratch of a request answered inline
+        
+        // Worker replies close the connection themselves when they are delivered
+        if (!conn->keep_alive && !conn->awaiting_reply) {
+            conn_close_after_write(conn);
         }
     }
-    else {
-        // Default response
-        strcpy(response_content, "{\"status\":\"error\",\"message\":\"Endpoint not found\"}");
-        send_http_response(client_socket, "404 Not Found", response_content);
+}
+
+// Buffered diagnostics of idle threads still reach stdout within DIAG_FLUSH_MS
+static timer_entry_t g_diag_flush_timer;
+
+static void flush_diagnostics(void *arg) {
+    (void)arg;
+    diag_flush();
+    timer_schedule(&g_diag_flush_timer, DIAG_FLUSH_MS);
+}
+
+// Event streams are pruned and kept alive every EVENTS_HEARTBEAT_MS
+static timer_entry_t g_events_heartbeat_timer;
+
+static void heartbeat_event_streams(void *arg) {
+    (void)arg;
+    events_heartbeat();
+    timer_schedule(&g_events_heartbeat_timer, EVENTS_HEARTBEAT_MS);
+}
+
+// Loop-thread timer hook: lease expiry and parked-acquire timeouts
+static int run_timers(void) {
+    int next_timer = timer_wheel_advance();
+    int next_waiter = semaphore_expire_waiters();
+    
+    if (next_timer < 0) {
+        return next_waiter;
+    }
+    if (next_waiter < 0) {
+        return next_timer;
     }
+    return next_timer < next_waiter ? next_timer : next_waiter;
 }
 
 // Initialize TCP socket server
@@ -221,7 +1220,7 @@ int init_socket_server() {
 #ifdef _WIN32
     WSADATA wsaData;
     if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
-        printf("WSAStartup failed\n");
+        LOG_ERROR("WSAStartup failed\n");
         return -1;
     }
 #endif
@@ -231,7 +1230,7 @@ int init_socket_server() {
     // Create socket
     server_socket = socket(AF_INET, SOCK_STREAM, 0);
     if (server_socket == -1) {
-        printf("Socket creation failed\n");
+        LOG_ERROR("Socket creation failed\n");
         return -1;
     }
     
@@ -247,57 +1246,65 @@ int init_socket_server() {
     
     // Bind socket
     if (bind(server_socket, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
-        printf("Bind failed\n");
+        LOG_ERROR("Bind failed\n");
+        close(server_socket);
+        return -1;
+    }
+    
+    // Listen for connections (let the kernel size the accept backlog)
+    if (listen(server_socket, SOMAXCONN) == -1) {
+        LOG_ERROR("Listen failed\n");
         close(server_socket);
         return -1;
     }
     
-    // Listen for connections
-    if (listen(server_socket, 10) == -1) {
-        printf("Listen failed\n");
+    // Hand the listening socket to the event loop
+    if (event_loop_init(server_socket, handle_http_request) != 0) {
+        LOG_ERROR("Event loop initialization failed\n");
         close(server_socket);
         return -1;
     }
+    event_loop_set_idle_timeout(HTTP_KEEPALIVE_TIMEOUT_SEC);
+    event_loop_set_timer_handler(run_timers);
     
-    printf("HTTP server listening on http://127.0.0.1:%d\n", server_port);
+    LOG_INFO("HTTP server listening on http://127.0.0.1:%d\n", server_port);
     return 0;
 }
 
 // Main server loop
 void run_server() {
-    struct sockaddr_in client_addr;
-    socklen_t client_len = sizeof(client_addr);
-    
-    printf("Server running, waiting for HTTP requests...\n");
-    printf("Test endpoints:\n");
-    printf("  POST http://127.0.0.1:%d/api/semaphore/acquire\n", server_port);
-    printf("  POST http://127.0.0.1:%d/api/semaphore/release\n", server_port);
-    printf("  GET  http://127.0.0.1:%d/api/semaphore/status\n", server_port);
-    
-    while (running) {
-        // Accept client connection
-        int client_socket = accept(server_socket, (struct sockaddr*)&client_addr, &client_len);
-        
-        if (client_socket == -1) {
-            if (running) {
-                printf("Accept failed\n");
-            }
-            continue;
-        }
-        
-        printf("New connection from %s\n", inet_ntoa(client_addr.sin_addr));
-        
-        // Handle request
-        handle_http_request(client_socket);
-        
-        // Close connection
-        close(client_socket);
-    }
+    LOG_INFO("Server running, waiting for HTTP requests...\n");
+    LOG_INFO("Test endpoints:\n");
+    LOG_INFO("  POST http://127.0.0.1:%d/api/semaphore/acquire[?wait_ms=N][&room=R]\n", server_port);
+    LOG_INFO("  POST http://127.0.0.1:%d/api/semaphore/release\n", server_port);
+    LOG_INFO("  POST http://127.0.0.1:%d/api/semaphore/heartbeat\n", server_port);
+    LOG_INFO("  GET  http://127.0.0.1:%d/api/semaphore/status[?room=R]\n", server_port);
+    LOG_INFO("  GET  http://127.0.0.1:%d/api/semaphore/rooms\n", server_port);
+    LOG_INFO("  GET  http://127.0.0.1:%d/api/messages?page=1&limit=50[&room=R]\n", server_port);
+    LOG_INFO("  POST http://127.0.0.1:%d/api/messages\n", server_port);
+    LOG_INFO("  POST http://127.0.0.1:%d/api/messages/batch\n", server_port);
+    LOG_INFO("  GET  http://127.0.0.1:%d/api/messages/search?q=words[&room=R][&page=1&limit=50]\n", server_port);
+    LOG_INFO("  GET  http://127.0.0.1:%d/api/messages/changes?since=SEQ[&room=R][&limit=50]\n", server_port);
+    LOG_INFO("  PUT  http://127.0.0.1:%d/api/messages/{id}\n", server_port);
+    LOG_INFO("  DEL  http://127.0.0.1:%d/api/messages/{id}\n", server_port);
+    LOG_INFO("  GET  http://127.0.0.1:%d/api/logs?page=1&limit=50\n", server_port);
+    LOG_INFO("  POST http://127.0.0.1:%d/api/admin/writer\n", server_port);
+    LOG_INFO("  GET  http://127.0.0.1:%d/api/pool/status\n", server_port);
+    LOG_INFO("  GET  http://127.0.0.1:%d/api/events (text/event-stream)\n", server_port);
+    
+    // Multiplex all client connections on this thread
+    event_loop_run(&running);
 }
 
 // Cleanup function
 void cleanup() {
-    printf("Cleaning up resources...\n");
+    LOG_INFO("Cleaning up resources...\n");
+    
+    // Let in-flight requests finish before their connections are torn down
+    thread_pool_shutdown();
+    event_loop_cleanup();
+    command_socket_close();
+    request_arena_release();  // The loop thread's
     
     if (server_socket != -1) {
         close(server_socket);
@@ -307,45 +1314,225 @@ void cleanup() {
     WSACleanup();
 #endif
     
+    // Holders get their rooms back after a restart; nothing can acquire by now
+    if (semaphore_state != NULL) {
+        semaphore_save_state(semaphore_state);
+    }
     cleanup_semaphore();
+    timer_wheel_cleanup();
+    cleanup_logger();  // Drains queued audit records while the databases are still open
     cleanup_databases();
-    printf("Cleanup complete\n");
+    events_cleanup();
+    LOG_INFO("Cleanup complete\n");
+}
+
+// Parse a non-negative integer option value, or return -1
+static int parse_count(const char *value) {
+    char *end = NULL;
+    long parsed = value ? strtol(value, &end, 10) : -1;
+    if (value == NULL || *value == '\0' || *end != '\0' || parsed < 0 || parsed > 100000) {
+        return -1;
+    }
+    return (int)parsed;
 }
 
 int main(int argc, char *argv[]) {
-    printf("Binary Semaphore Chat Daemon starting...\n");
+    diag_init();
+    LOG_INFO("Binary Semaphore Chat Daemon starting...\n");
+    
+    // Worker pool sizing: --workers N (0 answers everything on the loop thread)
+    int num_workers = parse_count(getenv("CHAT_DAEMON_WORKERS"));
+    int queue_depth = THREAD_POOL_DEFAULT_QUEUE_DEPTH;
+    int lease_ttl = parse_count(getenv("CHAT_DAEMON_LEASE_TTL"));
+    int log_flush_ms = LOGGER_DEFAULT_FLUSH_MS;
+    int log_batch = LOGGER_DEFAULT_BATCH;
+    int log_rotate_mb = (int)(LOGGER_DEFAULT_ROTATE_BYTES / (1024 * 1024));
+    int log_keep = LOGGER_DEFAULT_KEEP_FILES;
+    int log_retention_days = DB_DEFAULT_LOG_RETENTION_DAYS;
+    int commit_window_ms = DB_DEFAULT_COMMIT_WINDOW_MS;
+    const char *synchronous = DB_DEFAULT_SYNCHRONOUS;
+    int db_readers = DB_DEFAULT_READERS;
+    int message_cache_rows = MESSAGE_CACHE_DEFAULT_CAPACITY;
+    int db_cache_mb = DB_DEFAULT_CACHE_MB;
+    int db_mmap_mb = DB_DEFAULT_MMAP_MB;
+    const char *storage = getenv("CHAT_DAEMON_STORAGE");
+    const char *log_level_name = NULL;
+    const char *command_socket = getenv("CHAT_DAEMON_SOCKET");
+    if (num_workers < 0) {
+        num_workers = platform_cpu_count();
+    }
+    if (lease_ttl < 0) {
+        lease_ttl = SEMAPHORE_DEFAULT_LEASE_SEC;
+    }
+    if (storage == NULL || storage[0] == '\0') {
+        storage = STORAGE_DEFAULT_BACKEND;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            num_workers = parse_count(argv[++i]);
+        } else if (strcmp(argv[i], "--queue-depth") == 0 && i + 1 < argc) {
+            queue_depth = parse_count(argv[++i]);
+        } else if (strcmp(argv[i], "--lease-ttl") == 0 && i + 1 < argc) {
+            lease_ttl = parse_count(argv[++i]);
+        } else if (strcmp(argv[i], "--log-flush-ms") == 0 && i + 1 < argc) {
+            log_flush_ms = parse_count(argv[++i]);
+        } else if (strcmp(argv[i], "--log-batch") == 0 && i + 1 < argc) {
+            log_batch = parse_count(argv[++i]);
+        } else if (strcmp(argv[i], "--log-rotate-mb") == 0 && i + 1 < argc) {
+            log_rotate_mb = parse_count(argv[++i]);
+        } else if (strcmp(argv[i], "--log-keep") == 0 && i + 1 < argc) {
+            log_keep = parse_count(argv[++i]);
+        } else if (strcmp(argv[i], "--log-retention-days") == 0 && i + 1 < argc) {
+            log_retention_days = parse_count(argv[++i]);
+        } else if (strcmp(argv[i], "--commit-window-ms") == 0 && i + 1 < argc) {
+            commit_window_ms = parse_count(argv[++i]);
+        } else if (strcmp(argv[i], "--synchronous") == 0 && i + 1 < argc) {
+            synchronous = argv[++i];
+        } else if (strcmp(argv[i], "--db-readers") == 0 && i + 1 < argc) {
+            db_readers = parse_count(argv[++i]);
+        } else if (strcmp(argv[i], "--message-cache") == 0 && i + 1 < argc) {
+            message_cache_rows = parse_count(argv[++i]);
+        } else if (strcmp(argv[i], "--db-cache-mb") == 0 && i + 1 < argc) {
+            db_cache_mb = parse_count(argv[++i]);
+        } else if (strcmp(argv[i], "--db-mmap-mb") == 0 && i + 1 < argc) {
+            db_mmap_mb = parse_count(argv[++i]);
+        } else if (strcmp(argv[i], "--storage") == 0 && i + 1 < argc) {
+            storage = argv[++i];
+        } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            log_level_name = argv[++i];
+        } else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            command_socket = argv[++i];
+        } else if (strcmp(argv[i], "--state-file") == 0 && i + 1 < argc) {
+            semaphore_state = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--workers N] [--queue-depth N] [--lease-ttl SECONDS] "
+                            "[--log-flush-ms MS] [--log-batch N] [--log-rotate-mb MB] [--log-keep N] "
+                            "[--log-retention-days DAYS] [--commit-window-ms MS] "
+                            "[--synchronous OFF|NORMAL|FULL|EXTRA] [--db-readers N] [--message-cache ROWS] "
+                            "[--db-cache-mb MB] [--db-mmap-mb MB] "
+                            "[--storage sqlite|file|memory] [--log-level error|warn|info|debug] "
+                            "[--socket PATH|off] [--state-file PATH|off]\n", argv[0]);
+            return 1;
+        }
+        if (num_workers < 0 || num_workers > THREAD_POOL_MAX_WORKERS || queue_depth < 1 || lease_ttl < 0 ||
+            log_flush_ms < 1 || log_flush_ms > 60000 || log_batch < 1 || log_batch > LOGGER_RING_CAPACITY ||
+            log_rotate_mb < 0 || log_keep < 0 || log_keep > LOGGER_MAX_KEEP_FILES ||
+            db_configure_log_retention(log_retention_days) != 0 ||
+            db_configure_commit(commit_window_ms, synchronous) != 0 || db_configure_readers(db_readers) != 0 ||
+            message_cache_rows < 0 || message_cache_rows > MESSAGE_CACHE_MAX_CAPACITY ||
+            db_configure_cache(db_cache_mb, db_mmap_mb) != 0 ||
+            (log_level_name != NULL && diag_parse_level(log_level_name) < 0) ||
+            (command_socket != NULL && strlen(command_socket) >= COMMAND_SOCKET_PATH_MAX)) {
+            fprintf(stderr, "Invalid %s value (workers 0-%d, queue depth >= 1, lease ttl >= 0, "
+                            "log flush 1-60000 ms, log batch 1-%d, log keep 0-%d files, log retention 0-%d days, "
+                            "commit window 0-%d ms, "
+                            "synchronous OFF/NORMAL/FULL/EXTRA, db readers 0-%d, message cache 0-%d rows, "
+                            "db cache 0-%d MB, db mmap 0-%d MB, "
+                            "log level error/warn/info/debug, socket path < %d bytes)\n",
+                    argv[i - 1], THREAD_POOL_MAX_WORKERS, LOGGER_RING_CAPACITY, LOGGER_MAX_KEEP_FILES,
+                    DB_MAX_LOG_RETENTION_DAYS, DB_MAX_COMMIT_WINDOW_MS,
+                    DB_MAX_READERS, MESSAGE_CACHE_MAX_CAPACITY, DB_MAX_CACHE_MB, DB_MAX_MMAP_MB,
+                    COMMAND_SOCKET_PATH_MAX);
+            return 1;
+        }
+    }
+    if (log_level_name != NULL) {
+        int log_level = diag_parse_level(log_level_name);
+        diag_set_level(log_level);
+        if (log_level > LOG_COMPILE_LEVEL) {
+            LOG_WARN("Log level '%s' is not compiled in; rebuild with -DLOG_COMPILE_LEVEL=%d\n",
+                     log_level_name, log_level);
+        }
+    }
+    if (storage_select(storage) != 0) {
+        fprintf(stderr, "Unknown storage backend '%s' (sqlite, file or memory)\n", storage);
+        return 1;
+    }
     
     // Set up signal handlers
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN);  // Peers that vanish mid-write must not kill the daemon
+#endif
+    
+    // Timers must exist before the first lease is granted
+    timer_wheel_init();
+    timer_init(&g_diag_flush_timer, flush_diagnostics, NULL);
+    timer_schedule(&g_diag_flush_timer, DIAG_FLUSH_MS);
+    
+    // Event streams exist before anything can publish to them
+    events_init();
+    timer_init(&g_events_heartbeat_timer, heartbeat_event_streams, NULL);
+    timer_schedule(&g_events_heartbeat_timer, EVENTS_HEARTBEAT_MS);
     
     // Initialize semaphore manager
-    printf("Initializing semaphore manager...\n");
+    LOG_INFO("Initializing semaphore manager...\n");
+    semaphore_set_lease_ttl(lease_ttl);
     if (init_semaphore() != 0) {
-        fprintf(stderr, "Failed to initialize semaphore manager\n");
+        LOG_ERROR("Failed to initialize semaphore manager\n");
         return 1;
     }
     
-    // Initialize database manager
-    printf("Initializing database manager...\n");
+    // Initialize database manager (which warms the message cache)
+    LOG_INFO("Initializing database manager...\n");
+    message_cache_configure(message_cache_rows);
     if (init_databases("../data/chat.db", "../data/logs.db") != 0) {
-        fprintf(stderr, "Failed to initialize database manager\n");
+        LOG_ERROR("Failed to initialize database manager\n");
+        return 1;
+    }
+    
+    // Audit records are written in batches by the logger's own thread
+    logger_configure(log_flush_ms, log_batch);
+    logger_configure_rotation((long long)log_rotate_mb * 1024 * 1024, log_keep);
+    if (init_logger("../data/transactions.log") != 0) {
+        LOG_ERROR("Failed to initialize transaction logger\n");
         return 1;
     }
     
+    // Start the worker pool used for storage-backed requests
+    if (num_workers > 0) {
+        LOG_INFO("Initializing worker pool...\n");
+        if (thread_pool_init(num_workers, queue_depth) != 0) {
+            LOG_ERROR("Failed to initialize worker pool\n");
+            return 1;
+        }
+    }
+    
     // Initialize socket server
-    printf("Initializing HTTP server...\n");
+    LOG_INFO("Initializing HTTP server...\n");
     if (init_socket_server() != 0) {
-        fprintf(stderr, "Failed to initialize HTTP server\n");
+        LOG_ERROR("Failed to initialize HTTP server\n");
+        return 1;
+    }
+    
+    // Binary command socket for the Node bridge ("off" disables it)
+    if (command_socket == NULL || command_socket[0] == '\0') {
+        command_socket = COMMAND_SOCKET_DEFAULT_PATH;
+    }
+    if (strcmp(command_socket, "off") != 0 && command_socket_open(command_socket) != 0) {
+        LOG_ERROR("Failed to initialize command socket\n");
         return 1;
     }
     
+    // Holders saved by the last clean shutdown keep their rooms ("off"
+    // forgets them). Loading reads and removes the file and starts the
+    // restored leases, so it waits until startup can no longer fail and
+    // the loop is about to serve.
+    if (semaphore_state != NULL && strcmp(semaphore_state, "off") == 0) {
+        semaphore_state = NULL;
+    }
+    if (semaphore_state != NULL) {
+        semaphore_load_state(semaphore_state);
+    }
+    
     // Run main server loop
     run_server();
     
     // Cleanup on exit
     cleanup();
     
-    printf("Chat daemon shutdown complete\n");
+    LOG_INFO("Chat daemon shutdown complete\n");
+    diag_cleanup();
     return 0;
 }
\ No newline at end of file
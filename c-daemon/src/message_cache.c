@@ -0,0 +1,518 @@
+// Message Cache Implementation
+// Most recent messages kept in memory as ready-to-send JSON rows
+//
+// The cache holds a prefix of the listing order (created_at descending, ties
+// by ascending id) in a ring of entry pointers, slot 0 being the newest row.
+// Every row outside the cache sorts after every row inside it, so a page that
+// fits inside the prefix is exactly what the query would return. New rows
+// land at or next to the head, which the ring makes an O(1)-ish insert; when
+// it is full the oldest row falls off the tail. Each entry carries its row
+// already serialized, so a page is a run of memcpy()s.
+//
+// On a clean shutdown the storage layer may save the ring to a snapshot,
+// rows serialized as they are, tagged with a version of the storage it
+// mirrors; the next start loads it back instead of querying, provided
+// storage is still at that version.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "message_cache.h"
+#include "json_writer.h"
+#include "platform.h"
+#include "diag.h"
+
+typedef struct {
+    int id;
+    const char *created_at;        // These point into data[]
+    const char *room;
+    const char *username;
+    char *json;                    // {"id":..,"room":..,...} as list_messages() writes it
+    size_t json_len;
+    char data[];
+} cache_entry_t;
+
+static mutex_t g_cache_lock;
+static int g_capacity = MESSAGE_CACHE_DEFAULT_CAPACITY;
+static cache_entry_t **g_ring = NULL;
+static int g_head = 0;                     // Ring slot of listing position 0
+static int g_count = 0;
+static bool g_complete = true;             // No rows exist beyond the ones held
+static bool g_initialized = false;
+static unsigned long g_hits = 0;
+static unsigned long g_misses = 0;
+
+// Snapshot file: a header, then per row its lengths, its three strings with
+// their NULs (as laid out in data[]) and its JSON. Native byte order: it is
+// only read back by the same build on the same machine.
+#define SNAPSHOT_MAGIC "CHATMC01"
+#define SNAPSHOT_MAX_FIELD (1u << 20)      // Longer lengths mean a damaged file
+
+typedef struct {
+    char magic[8];
+    uint32_t count;
+    uint32_t complete;
+    int64_t version;
+} snapshot_header_t;
+
+typedef struct {
+    int32_t id;
+    uint32_t created_len;          // Lengths exclude the NUL
+    uint32_t room_len;
+    uint32_t username_len;
+    uint32_t json_len;
+} snapshot_row_t;
+
+// Set the number of rows kept (before message_cache_init())
+void message_cache_configure(int capacity) {
+    if (capacity < 0) {
+        capacity = 0;
+    }
+    if (capacity > MESSAGE_CACHE_MAX_CAPACITY) {
+        capacity = MESSAGE_CACHE_MAX_CAPACITY;
+    }
+    g_capacity = capacity;
+}
+
+int message_cache_capacity(void) {
+    return g_initialized ? g_capacity : 0;
+}
+
+int message_cache_init(void) {
+    if (g_initialized) {
+        return 0;
+    }
+    if (g_capacity > 0) {
+        g_ring = calloc((size_t)g_capacity, sizeof(cache_entry_t *));
+        if (g_ring == NULL) {
+            LOG_ERROR("Failed to allocate message cache\n");
+            return -1;
+        }
+    }
+    mutex_init(&g_cache_lock);
+    g_head = 0;
+    g_count = 0;
+    g_complete = true;
+    g_hits = 0;
+    g_misses = 0;
+    g_initialized = true;
+    return 0;
+}
+
+static cache_entry_t **slot(int position) {
+    return &g_ring[(g_head + position) % g_capacity];
+}
+
+// The row exactly as list_messages() serializes it
+static int serialize_row(cache_entry_t *entry, const char *message) {
+    strbuf_t row;
+    json_writer_t json;
+    strbuf_init(&row);
+    json_writer_init(&json, &row);
+    json_begin_object(&json);
+    json_field_int(&json, "id", entry->id);
+    json_field_string(&json, "room", entry->room);
+    json_field_string(&json, "username", entry->username);
+    json_field_string(&json, "message", message);
+    json_field_string(&json, "created_at", entry->created_at);
+    json_end_object(&json);
+    if (json_writer_finish(&json) != 0) {
+        strbuf_free(&row);
+        return -1;
+    }
+    entry->json = strbuf_detach(&row, &entry->json_len);
+    return 0;
+}
+
+static cache_entry_t *new_entry(int id, const char *room, const char *username, const char *message,
+                                const char *created_at) {
+    size_t created_len = strlen(created_at) + 1;
+    size_t room_len = strlen(room) + 1;
+    size_t user_len = strlen(username) + 1;
+    cache_entry_t *entry = malloc(sizeof(cache_entry_t) + created_len + room_len + user_len);
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    entry->id = id;
+    char *strings = entry->data;
+    entry->created_at = memcpy(strings, created_at, created_len);
+    entry->room = memcpy(strings + created_len, room, room_len);
+    entry->username = memcpy(strings + created_len + room_len, username, user_len);
+    if (serialize_row(entry, message) != 0) {
+        free(entry);
+        return NULL;
+    }
+    return entry;
+}
+
+static void free_entry(cache_entry_t *entry) {
+    free(entry->json);
+    free(entry);
+}
+
+// Whether entry is listed before the row (created_at, id)
+static bool sorts_before(const cache_entry_t *entry, const char *created_at, int id) {
+    int order = strcmp(entry->created_at, created_at);
+    return order > 0 || (order == 0 && entry->id < id);
+}
+
+// Listing position a row (created_at, id) belongs at
+static int find_position(const char *created_at, int id) {
+    int low = 0;
+    int high = g_count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (sorts_before(*slot(mid), created_at, id)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static int find_id(int id) {
+    for (int i = 0; i < g_count; i++) {
+        if ((*slot(i))->id == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Open a gap at position, moving whichever side of it is shorter
+static void open_gap(int position) {
+    if (position < g_count - position) {
+        g_head = (g_head + g_capacity - 1) % g_capacity;
+        for (int i = 0; i < position; i++) {
+            *slot(i) = *slot(i + 1);
+        }
+    } else {
+        for (int i = g_count; i > position; i--) {
+            *slot(i) = *slot(i - 1);
+        }
+    }
+    g_count++;
+}
+
+// Close the gap left at position by a removed entry
+static void close_gap(int position) {
+    if (position < g_count - 1 - position) {
+        for (int i = position; i > 0; i--) {
+            *slot(i) = *slot(i - 1);
+        }
+        g_head = (g_head + 1) % g_capacity;
+    } else {
+        for (int i = position; i < g_count - 1; i++) {
+            *slot(i) = *slot(i + 1);
+        }
+    }
+    g_count--;
+}
+
+// Record a committed row. A row that would sort past the tail of a partial
+// cache is not kept: rows there are not known to be adjacent to it.
+void message_cache_insert(int id, const char *room, const char *username, const char *message,
+                          const char *created_at) {
+    if (!g_initialized || g_capacity == 0 || room == NULL || username == NULL || message == NULL ||
+        created_at == NULL) {
+        return;
+    }
+
+    mutex_lock(&g_cache_lock);
+    int position = find_position(created_at, id);
+    if ((position == g_count && !g_complete) || position == g_capacity) {
+        mutex_unlock(&g_cache_lock);
+        return;
+    }
+
+    cache_entry_t *entry = new_entry(id, room, username, message, created_at);
+    if (entry == NULL) {
+        // Without the row the cache would hide it, so stop trusting the rest
+        for (int i = position; i < g_count; i++) {
+            free_entry(*slot(i));
+        }
+        g_count = position;
+        g_complete = false;
+        mutex_unlock(&g_cache_lock);
+        return;
+    }
+
+    if (g_count == g_capacity) {
+        free_entry(*slot(g_count - 1));
+        g_count--;
+        g_complete = false;
+    }
+    open_gap(position);
+    *slot(position) = entry;
+    mutex_unlock(&g_cache_lock);
+}
+
+void message_cache_update(int id, const char *message) {
+    if (!g_initialized || g_capacity == 0 || message == NULL) {
+        return;
+    }
+
+    mutex_lock(&g_cache_lock);
+    int position = find_id(id);
+    if (position >= 0) {
+        cache_entry_t *entry = *slot(position);
+        char *old_json = entry->json;
+        size_t old_len = entry->json_len;
+        if (serialize_row(entry, message) == 0) {
+            free(old_json);
+        } else {
+            // Keeping the stale text would serve it; drop the row and what follows
+            entry->json = old_json;
+            entry->json_len = old_len;
+            for (int i = position; i < g_count; i++) {
+                free_entry(*slot(i));
+            }
+            g_count = position;
+            g_complete = false;
+        }
+    }
+    mutex_unlock(&g_cache_lock);
+}
+
+void message_cache_remove(int id) {
+    if (!g_initialized || g_capacity == 0) {
+        return;
+    }
+
+    mutex_lock(&g_cache_lock);
+    int position = find_id(id);
+    if (position >= 0) {
+        free_entry(*slot(position));
+        close_gap(position);
+    }
+    mutex_unlock(&g_cache_lock);
+}
+
+// Mark whether the rows held are all the rows there are (after warming)
+void message_cache_set_complete(bool complete) {
+    if (!g_initialized) {
+        return;
+    }
+    mutex_lock(&g_cache_lock);
+    g_complete = complete;
+    mutex_unlock(&g_cache_lock);
+}
+
+// Append an OFFSET-style page, from one room or (room NULL) every room, in
+// list_messages() format. Returns 0 if served, 1 if storage must answer.
+int message_cache_page(const char *room, int page, int limit, strbuf_t *out) {
+    if (!g_initialized || g_capacity == 0 || page < 1 || limit < 1) {
+        return 1;
+    }
+
+    mutex_lock(&g_cache_lock);
+    long skip = (long)(page - 1) * limit;
+    int first = -1;
+    int last = -1;
+    int found = 0;
+    bool more = false;  // A row past the page is held, so another page follows
+    for (int i = 0; i < g_count && !more; i++) {
+        if (room != NULL && strcmp((*slot(i))->room, room) != 0) {
+            continue;
+        }
+        if (skip > 0) {
+            skip--;
+            continue;
+        }
+        if (found == limit) {
+            more = true;
+            break;
+        }
+        if (first < 0) {
+            first = i;
+        }
+        last = i;
+        found++;
+    }
+    if (!more && !g_complete) {
+        g_misses++;
+        mutex_unlock(&g_cache_lock);
+        return 1;  // The page, or the row after it, runs past the rows held
+    }
+
+    json_writer_t json;
+    json_writer_init(&json, out);
+    json_begin_object(&json);
+    json_key(&json, "messages");
+    json_begin_array(&json);
+    for (int i = first; found > 0 && i <= last; i++) {
+        cache_entry_t *entry = *slot(i);
+        if (room == NULL || strcmp(entry->room, room) == 0) {
+            json_raw(&json, entry->json, entry->json_len);
+        }
+    }
+    json_end_array(&json);
+    if (more) {
+        char next_cursor[96];
+        snprintf(next_cursor, sizeof(next_cursor), "%s,%d", (*slot(last))->created_at, (*slot(last))->id);
+        json_field_string(&json, "next_cursor", next_cursor);
+    }
+    json_end_object(&json);
+    g_hits++;
+    mutex_unlock(&g_cache_lock);
+
+    return json_writer_finish(&json) == 0 ? 0 : -1;
+}
+
+static bool write_bytes(FILE *f, const void *data, size_t len) {
+    return len == 0 || fwrite(data, 1, len, f) == len;
+}
+
+// Write the rows held to path (through a temporary file), for
+// message_cache_load() on the next start. version names the storage state
+// the rows mirror. Returns the rows written or -1.
+int message_cache_save(const char *path, long long version) {
+    if (!g_initialized || g_capacity == 0 || path == NULL) {
+        return -1;
+    }
+
+    char temp_path[512];
+    if (snprintf(temp_path, sizeof(temp_path), "%s.tmp", path) >= (int)sizeof(temp_path)) {
+        return -1;
+    }
+    FILE *f = fopen(temp_path, "wb");
+    if (f == NULL) {
+        LOG_WARN("Cannot write message cache snapshot %s\n", temp_path);
+        return -1;
+    }
+
+    mutex_lock(&g_cache_lock);
+    snapshot_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.count = (uint32_t)g_count;
+    header.complete = g_complete ? 1 : 0;
+    header.version = version;
+    bool ok = write_bytes(f, &header, sizeof(header));
+    for (int i = 0; ok && i < g_count; i++) {
+        const cache_entry_t *entry = *slot(i);
+        snapshot_row_t row = { entry->id, (uint32_t)strlen(entry->created_at), (uint32_t)strlen(entry->room),
+                               (uint32_t)strlen(entry->username), (uint32_t)entry->json_len };
+        size_t strings_len = (size_t)row.created_len + row.room_len + row.username_len + 3;
+        ok = write_bytes(f, &row, sizeof(row)) && write_bytes(f, entry->data, strings_len) &&
+             write_bytes(f, entry->json, entry->json_len);
+    }
+    int rows = g_count;
+    mutex_unlock(&g_cache_lock);
+
+    ok = fclose(f) == 0 && ok;
+    if (!ok || platform_replace_file(temp_path, path) != 0) {
+        LOG_WARN("Failed to write message cache snapshot %s\n", path);
+        remove(temp_path);
+        return -1;
+    }
+    LOG_INFO("Message cache saved %d rows to %s\n", rows, path);
+    return rows;
+}
+
+// One row of a snapshot, or NULL if the file is short or damaged
+static cache_entry_t *read_entry(FILE *f) {
+    snapshot_row_t row;
+    if (fread(&row, sizeof(row), 1, f) != 1 || row.created_len >= SNAPSHOT_MAX_FIELD ||
+        row.room_len >= SNAPSHOT_MAX_FIELD || row.username_len >= SNAPSHOT_MAX_FIELD ||
+        row.json_len >= SNAPSHOT_MAX_FIELD) {
+        return NULL;
+    }
+
+    size_t strings_len = (size_t)row.created_len + row.room_len + row.username_len + 3;
+    cache_entry_t *entry = malloc(sizeof(cache_entry_t) + strings_len);
+    char *json = malloc((size_t)row.json_len + 1);
+    char *strings = entry != NULL ? entry->data : NULL;
+    if (entry == NULL || json == NULL || fread(strings, 1, strings_len, f) != strings_len ||
+        fread(json, 1, row.json_len, f) != row.json_len || strings[row.created_len] != '\0' ||
+        strings[row.created_len + 1 + row.room_len] != '\0' || strings[strings_len - 1] != '\0') {
+        free(entry);
+        free(json);
+        return NULL;
+    }
+
+    json[row.json_len] = '\0';
+    entry->id = row.id;
+    entry->created_at = strings;
+    entry->room = strings + row.created_len + 1;
+    entry->username = strings + row.created_len + 1 + row.room_len + 1;
+    entry->json = json;
+    entry->json_len = row.json_len;
+    return entry;
+}
+
+// Fill the empty cache from a message_cache_save() snapshot of the same
+// version, so the first pages after a restart need no query. The file is
+// removed once read, since this run's writes will outdate it. Returns the
+// rows loaded, or -1 if storage has to warm the cache.
+int message_cache_load(const char *path, long long version) {
+    if (!g_initialized || g_capacity == 0 || path == NULL) {
+        return -1;
+    }
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return -1;
+    }
+
+    snapshot_header_t header;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 &&
+              memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) == 0 && header.version == version;
+    // A partial snapshot smaller than the cache would leave it colder than a query
+    ok = ok && (header.complete != 0 || header.count >= (uint32_t)g_capacity);
+    bool current = ok;
+
+    mutex_lock(&g_cache_lock);
+    int rows = 0;
+    if (ok && g_count == 0) {
+        int keep = header.count < (uint32_t)g_capacity ? (int)header.count : g_capacity;
+        while (rows < keep && (g_ring[rows] = read_entry(f)) != NULL) {
+            rows++;
+        }
+        ok = rows == keep;
+        if (ok) {
+            g_head = 0;
+            g_count = rows;
+            g_complete = header.complete != 0 && header.count <= (uint32_t)g_capacity;
+        } else {
+            for (int i = 0; i < rows; i++) {
+                free_entry(g_ring[i]);
+            }
+            rows = 0;
+        }
+    } else {
+        ok = false;
+    }
+    mutex_unlock(&g_cache_lock);
+
+    fclose(f);
+    remove(path);
+    if (!ok) {
+        LOG_INFO("Message cache snapshot %s is %s, warming from storage\n", path,
+                 current ? "unreadable" : "out of date");
+        return -1;
+    }
+    LOG_INFO("Message cache loaded %d rows from %s\n", rows, path);
+    return rows;
+}
+
+void message_cache_cleanup(void) {
+    if (!g_initialized) {
+        return;
+    }
+
+    if (g_capacity > 0) {
+        LOG_INFO("Message cache: %lu pages served, %lu passed to storage\n", g_hits, g_misses);
+    }
+    for (int i = 0; i < g_count; i++) {
+        free_entry(*slot(i));
+    }
+    free(g_ring);
+    g_ring = NULL;
+    g_count = 0;
+    g_head = 0;
+    mutex_destroy(&g_cache_lock);
+    g_initialized = false;
+}
@@ -0,0 +1,422 @@
+// Platform Compatibility Implementation
+// Cross-platform threading primitives shared by the daemon modules
+
+#ifndef _WIN32
+    #define _POSIX_C_SOURCE 200809L  // clock_gettime, sysconf, gmtime_r
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "platform.h"
+
+#include <time.h>
+
+#ifdef _WIN32
+    #include <process.h>
+#else
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+// Adapts thread_fn_t to the _beginthreadex calling convention
+typedef struct {
+    thread_fn_t fn;
+    void *arg;
+} thread_start_t;
+
+static unsigned __stdcall thread_trampoline(void *param) {
+    thread_start_t start = *(thread_start_t *)param;
+    free(param);
+    start.fn(start.arg);
+    return 0;
+}
+#endif
+
+// Start a joinable thread
+int thread_create(thread_t *thread, thread_fn_t fn, void *arg) {
+    if (thread == NULL || fn == NULL) {
+        return -4;  // Invalid input
+    }
+
+#ifdef _WIN32
+    thread_start_t *start = malloc(sizeof(thread_start_t));
+    if (start == NULL) {
+        return -1;
+    }
+    start->fn = fn;
+    start->arg = arg;
+
+    uintptr_t handle = _beginthreadex(NULL, 0, thread_trampoline, start, 0, NULL);
+    if (handle == 0) {
+        free(start);
+        return -1;
+    }
+    *thread = (HANDLE)handle;
+    return 0;
+#else
+    return pthread_create(thread, NULL, fn, arg) == 0 ? 0 : -1;
+#endif
+}
+
+// Wait for a thread started with thread_create to finish
+int thread_join(thread_t thread) {
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+    return 0;
+#else
+    return pthread_join(thread, NULL) == 0 ? 0 : -1;
+#endif
+}
+
+// Wait on a condition for at most timeout_ms.
+// Returns 0 when signaled, 1 on timeout, -1 on error.
+int cond_timedwait_ms(cond_t *cond, mutex_t *mutex, int timeout_ms) {
+#ifdef _WIN32
+    if (SleepConditionVariableCS(cond, mutex, (DWORD)timeout_ms)) {
+        return 0;
+    }
+    return GetLastError() == ERROR_TIMEOUT ? 1 : -1;
+#else
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    int result = pthread_cond_timedwait(cond, mutex, &deadline);
+    if (result == 0) {
+        return 0;
+    }
+    return result == ETIMEDOUT ? 1 : -1;
+#endif
+}
+
+// Milliseconds from an arbitrary, steadily increasing origin
+long long monotonic_ms(void) {
+#ifdef _WIN32
+    return (long long)GetTickCount64();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000LL + now.tv_nsec / 1000000L;
+#endif
+}
+
+// Monotonic clock in nanoseconds, for timing short operations
+uint64_t monotonic_ns(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER now;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / frequency.QuadPart) * 1000000000ULL +
+           (uint64_t)(now.QuadPart % frequency.QuadPart) * 1000000000ULL / (uint64_t)frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+#endif
+}
+
+// Number of online CPUs (at least 1)
+int platform_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+// Break a time down to UTC in the caller's struct. gmtime() returns one
+// process-wide struct that every thread stamping a row or log line would
+// share. On failure *out is zeroed and -1 returned.
+int platform_gmtime(time_t when, struct tm *out) {
+#ifdef _WIN32
+    if (gmtime_s(out, &when) == 0) {
+        return 0;
+    }
+#else
+    if (gmtime_r(&when, out) != NULL) {
+        return 0;
+    }
+#endif
+    memset(out, 0, sizeof(*out));
+    return -1;
+}
+
+// --- Memory-mapped files ---
+
+#ifdef _WIN32
+static int map_view(mapped_file_t *mf, size_t size) {
+    mf->mapping = CreateFileMappingA(mf->file, NULL, PAGE_READWRITE,
+                                     (DWORD)((unsigned long long)size >> 32), (DWORD)(size & 0xFFFFFFFFu), NULL);
+    if (mf->mapping == NULL) {
+        return -1;
+    }
+    mf->base = MapViewOfFile(mf->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (mf->base == NULL) {
+        CloseHandle(mf->mapping);
+        mf->mapping = NULL;
+        return -1;
+    }
+    mf->size = size;
+    return 0;
+}
+
+static void unmap_view(mapped_file_t *mf) {
+    if (mf->base != NULL) {
+        UnmapViewOfFile(mf->base);
+        CloseHandle(mf->mapping);
+    }
+    mf->base = NULL;
+    mf->mapping = NULL;
+}
+#else
+static int map_view(mapped_file_t *mf, size_t size) {
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, mf->fd, 0);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+    mf->base = base;
+    mf->size = size;
+    return 0;
+}
+
+static void unmap_view(mapped_file_t *mf) {
+    if (mf->base != NULL) {
+        munmap(mf->base, mf->size);
+    }
+    mf->base = NULL;
+}
+#endif
+
+// Open (creating if needed) and map a file, growing it to min_size first.
+// The mapping covers the whole file. A NULL path gives anonymous memory.
+int mapped_file_open(mapped_file_t *mf, const char *path, size_t min_size) {
+    if (mf == NULL || (path == NULL && min_size == 0)) {
+        return -4;
+    }
+    mf->base = NULL;
+    mf->size = 0;
+    mf->anonymous = path == NULL;
+    if (mf->anonymous) {
+        mf->base = calloc(1, min_size);
+        mf->size = mf->base != NULL ? min_size : 0;
+        return mf->base != NULL ? 0 : -1;
+    }
+
+#ifdef _WIN32
+    mf->mapping = NULL;
+    mf->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+    if (mf->file == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+    LARGE_INTEGER current;
+    if (!GetFileSizeEx(mf->file, &current)) {
+        CloseHandle(mf->file);
+        return -1;
+    }
+    size_t size = (size_t)current.QuadPart;
+#else
+    mf->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (mf->fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(mf->fd, &st) != 0) {
+        close(mf->fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+#endif
+
+    if (size < min_size) {
+        size = min_size;
+    }
+    if (size == 0 || mapped_file_resize(mf, size) != 0) {
+        mapped_file_close(mf);
+        return -1;
+    }
+    return 0;
+}
+
+// Change the file's length and map it again (old pointers become invalid)
+int mapped_file_resize(mapped_file_t *mf, size_t size) {
+    if (mf->anonymous) {
+        char *base = realloc(mf->base, size);
+        if (base == NULL) {
+            return -1;
+        }
+        if (size > mf->size) {
+            memset(base + mf->size, 0, size - mf->size);
+        }
+        mf->base = base;
+        mf->size = size;
+        return 0;
+    }
+    unmap_view(mf);
+
+#ifdef _WIN32
+    LARGE_INTEGER length;
+    length.QuadPart = (LONGLONG)size;
+    if (!SetFilePointerEx(mf->file, length, NULL, FILE_BEGIN) || !SetEndOfFile(mf->file)) {
+        return -1;
+    }
+#else
+    if (ftruncate(mf->fd, (off_t)size) != 0) {
+        return -1;
+    }
+#endif
+
+    return map_view(mf, size);
+}
+
+// Write a range of the mapping through to disk before returning
+int mapped_file_sync(mapped_file_t *mf, size_t offset, size_t length) {
+    if (mf->base == NULL || offset >= mf->size) {
+        return -4;
+    }
+    if (length > mf->size - offset) {
+        length = mf->size - offset;
+    }
+    if (mf->anonymous) {
+        return 0;
+    }
+
+#ifdef _WIN32
+    if (!FlushViewOfFile(mf->base + offset, length) || !FlushFileBuffers(mf->file)) {
+        return -1;
+    }
+    return 0;
+#else
+    // msync() wants a page-aligned start
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t aligned = offset - offset % page;
+    return msync(mf->base + aligned, length + (offset - aligned), MS_SYNC) == 0 ? 0 : -1;
+#endif
+}
+
+void mapped_file_close(mapped_file_t *mf) {
+    if (mf->anonymous) {
+        free(mf->base);
+        mf->base = NULL;
+        mf->size = 0;
+        return;
+    }
+    unmap_view(mf);
+#ifdef _WIN32
+    if (mf->file != INVALID_HANDLE_VALUE && mf->file != NULL) {
+        CloseHandle(mf->file);
+    }
+    mf->file = NULL;
+#else
+    if (mf->fd >= 0) {
+        close(mf->fd);
+    }
+    mf->fd = -1;
+#endif
+    mf->size = 0;
+}
+
+// Atomically put from in place of to (replacing it if it exists)
+int platform_replace_file(const char *from, const char *to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : -1;
+#else
+    return rename(from, to) == 0 ? 0 : -1;
+#endif
+}
+
+// Read up to max_bytes of a file into the OS page cache, so the first
+// queries after a restart find their pages in memory instead of waiting on
+// the disk one page at a time. The file is mapped read-only, the kernel is
+// told the range is needed (it reads ahead in large requests) and every
+// page is touched before returning. Returns the bytes covered, 0 for a
+// missing or empty file, -1 on error.
+long long platform_prefetch_file(const char *path, size_t max_bytes) {
+    if (path == NULL || max_bytes == 0) {
+        return 0;
+    }
+    volatile unsigned char sink = 0;
+    size_t page = 4096;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return GetLastError() == ERROR_FILE_NOT_FOUND ? 0 : -1;
+    }
+    LARGE_INTEGER current;
+    if (!GetFileSizeEx(file, &current)) {
+        CloseHandle(file);
+        return -1;
+    }
+    size_t length = (size_t)current.QuadPart < max_bytes ? (size_t)current.QuadPart : max_bytes;
+    if (length == 0) {
+        CloseHandle(file);
+        return 0;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    const unsigned char *base = mapping != NULL ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, length) : NULL;
+    if (base == NULL) {
+        if (mapping != NULL) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return -1;
+    }
+    for (size_t offset = 0; offset < length; offset += page) {
+        sink ^= base[offset];
+    }
+    UnmapViewOfFile(base);
+    CloseHandle(mapping);
+    CloseHandle(file);
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    size_t length = (size_t)st.st_size < max_bytes ? (size_t)st.st_size : max_bytes;
+    if (length == 0) {
+        close(fd);
+        return 0;
+    }
+    void *mapped = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // The mapping keeps the file open
+    if (mapped == MAP_FAILED) {
+        return -1;
+    }
+    const unsigned char *base = mapped;
+    posix_madvise(mapped, length, POSIX_MADV_WILLNEED);
+    page = (size_t)sysconf(_SC_PAGESIZE);
+    for (size_t offset = 0; offset < length; offset += page) {
+        sink ^= base[offset];
+    }
+    munmap(mapped, length);
+#endif
+
+    (void)sink;
+    return (long long)length;
+}
@@ -0,0 +1,649 @@
+// Search Index Implementation
+// Word tokenizer and in-memory inverted index over message text
+//
+// Backs SEARCH for the file and memory engines; SQLite answers it with
+// FTS5 instead. Every distinct word has a posting list of (id, occurrences)
+// kept sorted by id. A query intersects the lists of its words by walking
+// the shortest one and binary-searching the others, scores each match
+// with BM25 and keeps only the best offset + limit in a heap. An indexed
+// message remembers its own words, so an update or delete takes out
+// exactly its postings and nothing has to be rebuilt. Ids are dense, so a
+// message's entry is found by indexing an array.
+//
+// One mutex guards the whole index. A put holds it for one message, a
+// query for one walk of its shortest posting list.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "search_index.h"
+#include "arena.h"
+#include "platform.h"
+#include "diag.h"
+
+#define BM25_K1 1.2
+#define BM25_B 0.75
+#define TERM_SLOTS_MIN 1024                  // First size of the term hash table (power of two)
+
+typedef struct {
+    int id;
+    int count;                               // Occurrences in the message
+} posting_t;
+
+typedef struct {
+    char *text;
+    uint32_t hash;
+    posting_t *postings;                     // Ascending id
+    int count;
+    int capacity;
+    unsigned mark;                           // Put that last saw the term, see search_index_put()
+    int slot;                                // Its entry in g_scratch while mark is current
+} term_t;
+
+typedef struct {
+    int *terms;                              // Distinct words, as indexes into g_terms
+    int term_count;
+    int length;                              // Words, counting repeats
+    int room;                                // Index into g_rooms
+    bool indexed;
+} doc_t;
+
+typedef struct {
+    int term;
+    int count;
+} scratch_t;
+
+typedef struct {
+    char (*terms)[SEARCH_MAX_TERM_LEN + 1];
+    int count;
+} query_terms_t;
+
+static mutex_t g_lock;
+static bool g_initialized = false;
+static bool g_complete = false;            // Every stored message has been indexed
+
+static term_t *g_terms = NULL;
+static int g_term_count = 0;
+static int g_term_capacity = 0;
+static int *g_slots = NULL;                // Term hash table: g_terms index or -1
+static int g_slot_count = 0;
+
+static doc_t *g_docs = NULL;               // By id
+static int g_doc_capacity = 0;
+static int g_live_docs = 0;
+static long long g_total_length = 0;
+
+static char **g_rooms = NULL;              // Few (SEMAPHORE_MAX_ROOMS at most), so searched in order
+static int g_room_count = 0;
+
+static unsigned g_put_serial = 0;
+static scratch_t *g_scratch = NULL;        // Distinct words of the message being put
+static int g_scratch_capacity = 0;
+
+static bool is_word_byte(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+// Split text into words and hand each to fn; returns how many were handed over
+int search_tokenize(const char *text, size_t len, search_term_fn fn, void *ctx) {
+    char term[SEARCH_MAX_TERM_LEN + 1];
+    int terms = 0;
+    size_t i = 0;
+    while (i < len) {
+        if (!is_word_byte((unsigned char)text[i])) {
+            i++;
+            continue;
+        }
+
+        // An over-long word keeps its first bytes; the rest is skipped
+        size_t term_len = 0;
+        for (; i < len && is_word_byte((unsigned char)text[i]); i++) {
+            if (term_len < SEARCH_MAX_TERM_LEN) {
+                unsigned char c = (unsigned char)text[i];
+                term[term_len++] = (char)(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+            }
+        }
+        term[term_len] = '\0';
+        terms++;
+        if (!fn(term, term_len, ctx)) {
+            break;
+        }
+    }
+    return terms;
+}
+
+static bool add_query_term(const char *term, size_t len, void *ctx) {
+    query_terms_t *query = ctx;
+    for (int i = 0; i < query->count; i++) {
+        if (strcmp(query->terms[i], term) == 0) {
+            return true;
+        }
+    }
+    memcpy(query->terms[query->count], term, len + 1);
+    return ++query->count < SEARCH_MAX_QUERY_TERMS;
+}
+
+// The distinct words of a query, at most SEARCH_MAX_QUERY_TERMS; returns
+// how many were stored
+int search_query_terms(const char *query, char terms[][SEARCH_MAX_TERM_LEN + 1]) {
+    query_terms_t collected = { terms, 0 };
+    if (query != NULL) {
+        search_tokenize(query, strlen(query), add_query_term, &collected);
+    }
+    return collected.count;
+}
+
+static uint32_t term_hash(const char *text, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static int rehash_terms(int slot_count) {
+    int *slots = malloc((size_t)slot_count * sizeof(int));
+    if (slots == NULL) {
+        return -1;
+    }
+    memset(slots, 0xFF, (size_t)slot_count * sizeof(int));
+    for (int i = 0; i < g_term_count; i++) {
+        uint32_t slot = g_terms[i].hash & (uint32_t)(slot_count - 1);
+        while (slots[slot] >= 0) {
+            slot = (slot + 1) & (uint32_t)(slot_count - 1);
+        }
+        slots[slot] = i;
+    }
+    free(g_slots);
+    g_slots = slots;
+    g_slot_count = slot_count;
+    return 0;
+}
+
+// Index of a word in g_terms; added when create is set. -1 if absent or
+// out of memory.
+static int find_term(const char *text, size_t len, bool create) {
+    uint32_t hash = term_hash(text, len);
+    uint32_t slot = hash & (uint32_t)(g_slot_count - 1);
+    while (g_slots[slot] >= 0) {
+        term_t *term = &g_terms[g_slots[slot]];
+        if (term->hash == hash && strcmp(term->text, text) == 0) {
+            return g_slots[slot];
+        }
+        slot = (slot + 1) & (uint32_t)(g_slot_count - 1);
+    }
+    if (!create) {
+        return -1;
+    }
+
+    // Keep the table at most half full, so a probe always ends
+    if ((g_term_count + 1) * 2 > g_slot_count) {
+        if (rehash_terms(g_slot_count * 2) != 0) {
+            return -1;
+        }
+        slot = hash & (uint32_t)(g_slot_count - 1);
+        while (g_slots[slot] >= 0) {
+            slot = (slot + 1) & (uint32_t)(g_slot_count - 1);
+        }
+    }
+    if (g_term_count == g_term_capacity) {
+        int capacity = g_term_capacity * 2;
+        term_t *grown = realloc(g_terms, (size_t)capacity * sizeof(term_t));
+        if (grown == NULL) {
+            return -1;
+        }
+        g_terms = grown;
+        g_term_capacity = capacity;
+    }
+    char *copy = malloc(len + 1);
+    if (copy == NULL) {
+        return -1;
+    }
+    memcpy(copy, text, len + 1);
+
+    int index = g_term_count++;
+    term_t *term = &g_terms[index];
+    memset(term, 0, sizeof(*term));
+    term->text = copy;
+    term->hash = hash;
+    g_slots[slot] = index;
+    return index;
+}
+
+static int find_room(const char *room, size_t len) {
+    for (int i = 0; i < g_room_count; i++) {
+        if (strlen(g_rooms[i]) == len && memcmp(g_rooms[i], room, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int intern_room(const char *room, size_t len) {
+    int index = find_room(room, len);
+    if (index >= 0) {
+        return index;
+    }
+    char **grown = realloc(g_rooms, (size_t)(g_room_count + 1) * sizeof(char *));
+    if (grown == NULL) {
+        return -1;
+    }
+    g_rooms = grown;
+    char *copy = malloc(len + 1);
+    if (copy == NULL) {
+        return -1;
+    }
+    memcpy(copy, room, len);
+    copy[len] = '\0';
+    g_rooms[g_room_count] = copy;
+    return g_room_count++;
+}
+
+// First posting whose id is at least id, searching from start
+static int lower_bound(const term_t *term, int start, int id) {
+    int low = start;
+    int high = term->count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (term->postings[mid].id < id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static int reserve_postings(term_t *term) {
+    if (term->count < term->capacity) {
+        return 0;
+    }
+    int capacity = term->capacity > 0 ? term->capacity * 2 : 4;
+    posting_t *grown = realloc(term->postings, (size_t)capacity * sizeof(posting_t));
+    if (grown == NULL) {
+        return -1;
+    }
+    term->postings = grown;
+    term->capacity = capacity;
+    return 0;
+}
+
+static int reserve_docs(int id) {
+    if (id < g_doc_capacity) {
+        return 0;
+    }
+    int capacity = g_doc_capacity;
+    while (capacity <= id) {
+        capacity *= 2;
+    }
+    doc_t *grown = realloc(g_docs, (size_t)capacity * sizeof(doc_t));
+    if (grown == NULL) {
+        return -1;
+    }
+    memset(grown + g_doc_capacity, 0, (size_t)(capacity - g_doc_capacity) * sizeof(doc_t));
+    g_docs = grown;
+    g_doc_capacity = capacity;
+    return 0;
+}
+
+static void remove_locked(int id) {
+    if (id <= 0 || id >= g_doc_capacity || !g_docs[id].indexed) {
+        return;
+    }
+    doc_t *doc = &g_docs[id];
+    for (int i = 0; i < doc->term_count; i++) {
+        term_t *term = &g_terms[doc->terms[i]];
+        int at = lower_bound(term, 0, id);
+        if (at < term->count && term->postings[at].id == id) {
+            memmove(&term->postings[at], &term->postings[at + 1],
+                    (size_t)(term->count - at - 1) * sizeof(posting_t));
+            term->count--;
+        }
+    }
+    free(doc->terms);
+    g_live_docs--;
+    g_total_length -= doc->length;
+    memset(doc, 0, sizeof(*doc));
+}
+
+static bool scratch_reserve(int needed) {
+    if (needed <= g_scratch_capacity) {
+        return true;
+    }
+    int capacity = g_scratch_capacity > 0 ? g_scratch_capacity * 2 : 64;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    scratch_t *grown = realloc(g_scratch, (size_t)capacity * sizeof(scratch_t));
+    if (grown == NULL) {
+        return false;
+    }
+    g_scratch = grown;
+    g_scratch_capacity = capacity;
+    return true;
+}
+
+typedef struct {
+    int distinct;
+    int length;
+    bool failed;
+} put_words_t;
+
+// Count one word of the message being put (caller holds g_lock)
+static bool collect_word(const char *text, size_t len, void *ctx) {
+    put_words_t *words = ctx;
+    int index = find_term(text, len, true);
+    if (index < 0 || !scratch_reserve(words->distinct + 1)) {
+        words->failed = true;
+        return false;
+    }
+    term_t *term = &g_terms[index];
+    if (term->mark != g_put_serial) {
+        term->mark = g_put_serial;
+        term->slot = words->distinct;
+        g_scratch[words->distinct].term = index;
+        g_scratch[words->distinct].count = 0;
+        words->distinct++;
+    }
+    g_scratch[term->slot].count++;
+    words->length++;
+    return true;
+}
+
+// Index message id under room. An id already indexed is re-indexed when
+// replace is set and left alone otherwise (returns 1), which lets the
+// startup build run alongside live writes. -1 if out of memory.
+int search_index_put(int id, const char *room, size_t room_len, const char *text, size_t len, bool replace) {
+    if (id <= 0 || room == NULL || text == NULL) {
+        return -4;
+    }
+
+    mutex_lock(&g_lock);
+    if (!g_initialized) {
+        mutex_unlock(&g_lock);
+        return -1;
+    }
+    if (id < g_doc_capacity && g_docs[id].indexed) {
+        if (!replace) {
+            mutex_unlock(&g_lock);
+            return 1;
+        }
+        remove_locked(id);
+    }
+
+    // Gather the distinct words and make every allocation before any
+    // posting list changes, so running out of memory leaves no half entry
+    put_words_t words = { 0, 0, false };
+    g_put_serial++;
+    search_tokenize(text, len, collect_word, &words);
+    int room_index = intern_room(room, room_len);
+    bool ready = !words.failed && room_index >= 0 && reserve_docs(id) == 0;
+    for (int i = 0; ready && i < words.distinct; i++) {
+        ready = reserve_postings(&g_terms[g_scratch[i].term]) == 0;
+    }
+    int *terms = ready && words.distinct > 0 ? malloc((size_t)words.distinct * sizeof(int)) : NULL;
+    if (!ready || (words.distinct > 0 && terms == NULL)) {
+        mutex_unlock(&g_lock);
+        free(terms);
+        LOG_WARN("Out of memory indexing message %d for search\n", id);
+        return -1;
+    }
+
+    for (int i = 0; i < words.distinct; i++) {
+        term_t *term = &g_terms[g_scratch[i].term];
+        // New ids arrive in order, so this is nearly always an append
+        int at = term->count > 0 && term->postings[term->count - 1].id > id ? lower_bound(term, 0, id)
+                                                                            : term->count;
+        memmove(&term->postings[at + 1], &term->postings[at], (size_t)(term->count - at) * sizeof(posting_t));
+        term->postings[at].id = id;
+        term->postings[at].count = g_scratch[i].count;
+        term->count++;
+        terms[i] = g_scratch[i].term;
+    }
+
+    doc_t *doc = &g_docs[id];
+    doc->terms = terms;
+    doc->term_count = words.distinct;
+    doc->length = words.length;
+    doc->room = room_index;
+    doc->indexed = true;
+    g_live_docs++;
+    g_total_length += words.length;
+    mutex_unlock(&g_lock);
+    return 0;
+}
+
+// Forget message id (deleted, or about to be re-indexed)
+void search_index_remove(int id) {
+    mutex_lock(&g_lock);
+    if (g_initialized) {
+        remove_locked(id);
+    }
+    mutex_unlock(&g_lock);
+}
+
+// Hit ordering: higher score, then newer id. true if a ranks before b.
+static bool ranks_before(const search_hit_t *a, const search_hit_t *b) {
+    return a->score > b->score || (a->score == b->score && a->id > b->id);
+}
+
+static int compare_hits(const void *a, const void *b) {
+    return ranks_before(a, b) ? -1 : ranks_before(b, a) ? 1 : 0;
+}
+
+// Min-heap on rank: the root is the worst hit kept so far
+static void heap_sift_down(search_hit_t *heap, int size, int at) {
+    for (;;) {
+        int worst = at;
+        int left = 2 * at + 1;
+        int right = left + 1;
+        if (left < size && ranks_before(&heap[worst], &heap[left])) {
+            worst = left;
+        }
+        if (right < size && ranks_before(&heap[worst], &heap[right])) {
+            worst = right;
+        }
+        if (worst == at) {
+            return;
+        }
+        search_hit_t swap = heap[at];
+        heap[at] = heap[worst];
+        heap[worst] = swap;
+        at = worst;
+    }
+}
+
+static void heap_push(search_hit_t *heap, int *size, int capacity, search_hit_t hit) {
+    if (*size < capacity) {
+        int at = (*size)++;
+        heap[at] = hit;
+        while (at > 0 && ranks_before(&heap[(at - 1) / 2], &heap[at])) {
+            int parent = (at - 1) / 2;
+            search_hit_t swap = heap[at];
+            heap[at] = heap[parent];
+            heap[parent] = swap;
+            at = parent;
+        }
+    } else if (capacity > 0 && ranks_before(&hit, &heap[0])) {
+        heap[0] = hit;
+        heap_sift_down(heap, *size, 0);
+    }
+}
+
+// Messages containing every word of query (in room, or any room when NULL),
+// best first. Hits offset .. offset+limit-1 go to hits; *out_total counts
+// every match. -4 if the query has no words.
+int search_index_query(const char *room, const char *query, int offset, int limit,
+                       search_hit_t *hits, int *out_count, int *out_total) {
+    char words[SEARCH_MAX_QUERY_TERMS][SEARCH_MAX_TERM_LEN + 1];
+    int word_count = search_query_terms(query, words);
+    *out_count = 0;
+    *out_total = 0;
+    if (word_count == 0 || offset < 0 || limit < 1) {
+        return -4;
+    }
+
+    mutex_lock(&g_lock);
+    if (!g_initialized) {
+        mutex_unlock(&g_lock);
+        return -1;
+    }
+
+    term_t *lists[SEARCH_MAX_QUERY_TERMS];
+    int room_index = room != NULL ? find_room(room, strlen(room)) : -1;
+    bool possible = room == NULL || room_index >= 0;
+    for (int i = 0; possible && i < word_count; i++) {
+        int index = find_term(words[i], strlen(words[i]), false);
+        possible = index >= 0 && g_terms[index].count > 0;
+        lists[i] = possible ? &g_terms[index] : NULL;
+    }
+    if (!possible) {
+        mutex_unlock(&g_lock);
+        return 0;
+    }
+
+    // Walk the rarest word; the others are probed in it
+    for (int i = 1; i < word_count; i++) {
+        for (int j = i; j > 0 && lists[j]->count < lists[j - 1]->count; j--) {
+            term_t *swap = lists[j];
+            lists[j] = lists[j - 1];
+            lists[j - 1] = swap;
+        }
+    }
+
+    double idf[SEARCH_MAX_QUERY_TERMS];
+    int positions[SEARCH_MAX_QUERY_TERMS] = { 0 };
+    double docs = (double)g_live_docs;
+    double average_length = g_live_docs > 0 ? (double)g_total_length / g_live_docs : 1.0;
+    for (int i = 0; i < word_count; i++) {
+        double n = (double)lists[i]->count;
+        idf[i] = log(1.0 + (docs - n + 0.5) / (n + 0.5));
+    }
+
+    // No more hits than the rarest word has postings
+    int rarest = lists[0]->count;
+    int capacity = offset >= rarest ? 0 : limit > rarest - offset ? rarest : offset + limit;
+    search_hit_t *heap = capacity > 0 ? arena_alloc(request_arena(), (size_t)capacity * sizeof(search_hit_t)) : NULL;
+    if (capacity > 0 && heap == NULL) {
+        mutex_unlock(&g_lock);
+        return -1;
+    }
+    int kept = 0;
+    int total = 0;
+
+    for (int p = 0; p < lists[0]->count; p++) {
+        int id = lists[0]->postings[p].id;
+        const doc_t *doc = &g_docs[id];
+        if (room_index >= 0 && doc->room != room_index) {
+            continue;
+        }
+
+        double norm = BM25_K1 * (1.0 - BM25_B + BM25_B * (double)doc->length / average_length);
+        double score = 0.0;
+        bool match = true;
+        for (int i = 0; i < word_count && match; i++) {
+            const posting_t *posting = &lists[0]->postings[p];
+            if (i > 0) {
+                positions[i] = lower_bound(lists[i], positions[i], id);
+                match = positions[i] < lists[i]->count && lists[i]->postings[positions[i]].id == id;
+                posting = match ? &lists[i]->postings[positions[i]] : NULL;
+            }
+            if (match) {
+                double tf = (double)posting->count;
+                score += idf[i] * tf * (BM25_K1 + 1.0) / (tf + norm);
+            }
+        }
+        if (!match) {
+            continue;
+        }
+
+        total++;
+        search_hit_t hit = { id, score };
+        heap_push(heap, &kept, capacity, hit);
+    }
+    mutex_unlock(&g_lock);
+
+    if (kept > 0) {
+        qsort(heap, (size_t)kept, sizeof(search_hit_t), compare_hits);
+    }
+    for (int i = offset; i < kept && i < offset + limit; i++) {
+        hits[(*out_count)++] = heap[i];
+    }
+    *out_total = total;
+    return 0;
+}
+
+// Whether the startup build has reached every message stored before it
+void search_index_set_complete(bool complete) {
+    mutex_lock(&g_lock);
+    g_complete = complete;
+    mutex_unlock(&g_lock);
+}
+
+bool search_index_complete(void) {
+    mutex_lock(&g_lock);
+    bool complete = g_complete;
+    mutex_unlock(&g_lock);
+    return complete;
+}
+
+int search_index_init(void) {
+    if (g_initialized) {
+        return 0;
+    }
+    g_term_capacity = TERM_SLOTS_MIN / 2;
+    g_terms = malloc((size_t)g_term_capacity * sizeof(term_t));
+    g_doc_capacity = 1024;
+    g_docs = calloc((size_t)g_doc_capacity, sizeof(doc_t));
+    if (g_terms == NULL || g_docs == NULL || rehash_terms(TERM_SLOTS_MIN) != 0) {
+        free(g_terms);
+        free(g_docs);
+        g_terms = NULL;
+        g_docs = NULL;
+        return -1;
+    }
+    g_term_count = 0;
+    g_live_docs = 0;
+    g_total_length = 0;
+    g_complete = false;
+    mutex_init(&g_lock);
+    g_initialized = true;
+    return 0;
+}
+
+void search_index_cleanup(void) {
+    if (!g_initialized) {
+        return;
+    }
+    mutex_lock(&g_lock);
+    g_initialized = false;
+    for (int i = 0; i < g_doc_capacity; i++) {
+        free(g_docs[i].terms);
+    }
+    for (int i = 0; i < g_term_count; i++) {
+        free(g_terms[i].text);
+        free(g_terms[i].postings);
+    }
+    for (int i = 0; i < g_room_count; i++) {
+        free(g_rooms[i]);
+    }
+    free(g_docs);
+    free(g_terms);
+    free(g_slots);
+    free(g_rooms);
+    free(g_scratch);
+    g_docs = NULL;
+    g_terms = NULL;
+    g_slots = NULL;
+    g_rooms = NULL;
+    g_scratch = NULL;
+    g_doc_capacity = g_term_count = g_term_capacity = g_slot_count = 0;
+    g_room_count = g_scratch_capacity = 0;
+    g_live_docs = 0;
+    g_total_length = 0;
+    mutex_unlock(&g_lock);
+    mutex_destroy(&g_lock);
+}
\ No newline at end of file
@@ -0,0 +1,922 @@
+// Segment Store Implementation
+// Append-only, memory-mapped message log with an id index and compaction
+//
+// The segment file is a header followed by records, each a fixed 48-byte
+// header and its room, username and message bytes, padded to 8 bytes. A
+// record is never changed once written: an update appends a new version of
+// the id, a delete appends a tombstone, and the older record becomes dead
+// space that the background compactor reclaims by rewriting the live
+// records into a new file. The header's committed_end marks how far the
+// records are known complete, so a torn append is simply ignored.
+//
+// The index sidecar maps id -> record offset (0 once deleted) together with
+// the row's created_at. Timestamps never decrease with id, so the listing
+// order (created_at descending, ties by ascending id) is a walk over runs of
+// equal timestamps, and a cursor is found by binary search: every read costs
+// O(page). The index is trusted only after a clean shutdown; otherwise it is
+// rebuilt from the segment on open.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "segment_store.h"
+#include "platform.h"
+#include "diag.h"
+
+#define SEGMENT_MAGIC "CHATSEG1"
+#define INDEX_MAGIC "CHATIDX1"
+#define SEGMENT_VERSION 1
+#define RECORD_MAGIC 0x5245434Du   // "MCER" in little-endian memory order
+
+enum {
+    RECORD_PUT = 1,                // A message version
+    RECORD_TOMBSTONE = 2           // The id was deleted
+};
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_header_size;
+    uint64_t generation;           // Bumped by every compaction
+    uint64_t committed_end;        // File offset just past the last complete record
+    uint64_t dead_bytes;           // Superseded records and tombstones
+    int32_t next_id;
+    uint32_t reserved;
+    char padding[16];
+} segment_header_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t kind;
+    uint16_t room_len;
+    int32_t id;
+    uint32_t checksum;             // FNV-1a over this header (checksum 0) and the payload
+    uint32_t username_len;
+    uint32_t message_len;
+    char created_at[SEGMENT_CREATED_AT_LEN];
+} segment_record_t;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t generation;           // Segment generation the offsets belong to
+    uint64_t segment_end;          // committed_end when the index was last closed
+    int32_t id_count;
+    uint32_t clean;                // 1 only between a clean close and the next open
+    char padding[24];
+} index_header_t;
+
+typedef struct {
+    uint64_t offset;               // Live record, or 0
+    char created_at[SEGMENT_CREATED_AT_LEN];
+} index_entry_t;
+
+static mutex_t g_store_lock;
+static mapped_file_t g_segment;
+static mapped_file_t g_index;
+static char g_segment_path[512];
+static bool g_sync_writes = true;
+static bool g_open = false;
+static uint64_t g_write_end = 0;           // Appended, possibly not yet committed
+static uint64_t g_dead_bytes = 0;
+static int g_next_id = 1;
+
+static thread_t g_compactor;
+static cond_t g_compactor_cond;
+static bool g_compactor_running = false;
+static bool g_compacting = false;          // The compactor is reading the mapping unlocked
+static cond_t g_compaction_cond;           // Broadcast when a compaction ends
+static unsigned long g_compactions = 0;
+
+static segment_header_t *segment_header(void) {
+    return (segment_header_t *)g_segment.base;
+}
+
+static index_header_t *index_header(void) {
+    return (index_header_t *)g_index.base;
+}
+
+static index_entry_t *index_entry(int id) {
+    return (index_entry_t *)(g_index.base + sizeof(index_header_t)) + (id - 1);
+}
+
+static int index_capacity(void) {
+    return (int)((g_index.size - sizeof(index_header_t)) / sizeof(index_entry_t));
+}
+
+static segment_record_t *record_at(uint64_t offset) {
+    return (segment_record_t *)(g_segment.base + offset);
+}
+
+static uint64_t payload_size(const segment_record_t *record) {
+    return (uint64_t)record->room_len + record->username_len + record->message_len;
+}
+
+static uint64_t record_bytes(uint64_t payload) {
+    return (sizeof(segment_record_t) + payload + 7) & ~(uint64_t)7;
+}
+
+static uint64_t record_size(const segment_record_t *record) {
+    return record_bytes(payload_size(record));
+}
+
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t len) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t record_checksum(const segment_record_t *record) {
+    segment_record_t header = *record;
+    header.checksum = 0;
+    uint32_t hash = fnv1a(2166136261u, &header, sizeof(header));
+    return fnv1a(hash, record + 1, (size_t)payload_size(record));
+}
+
+// Grow the segment mapping so extra more bytes fit after g_write_end
+static int reserve_segment(uint64_t extra) {
+    if (g_write_end + extra <= g_segment.size) {
+        return 0;
+    }
+    if (g_compacting) {
+        return -1;  // The compactor is reading this mapping; see make_room()
+    }
+    size_t size = g_segment.size;
+    while (g_write_end + extra > size) {
+        size *= 2;
+    }
+    return mapped_file_resize(&g_segment, size);
+}
+
+// Called by writers before they look at any record (store locked): while a
+// compaction copies from the mapping, an append that would have to grow it
+// waits for the compaction to end. Fails if the store closed meanwhile.
+static int make_room(uint64_t size) {
+    while (g_open && g_compacting && g_write_end + size > g_segment.size) {
+        cond_wait(&g_compaction_cond, &g_store_lock);
+    }
+    return g_open ? 0 : -1;
+}
+
+// Grow the index mapping so it covers id
+static int reserve_index(int id) {
+    if (id <= index_capacity()) {
+        return 0;
+    }
+    size_t ids = (size_t)index_capacity();
+    while ((size_t)id > ids) {
+        ids *= 2;
+    }
+    return mapped_file_resize(&g_index, sizeof(index_header_t) + ids * sizeof(index_entry_t));
+}
+
+// Append one record at g_write_end; *out_offset is where it landed
+static int append_record(uint16_t kind, int id, const char *created_at, const char *room, size_t room_len,
+                         const char *username, size_t username_len, const char *message, size_t message_len,
+                         uint64_t *out_offset) {
+    segment_record_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = RECORD_MAGIC;
+    header.kind = kind;
+    header.room_len = (uint16_t)room_len;
+    header.id = id;
+    header.username_len = (uint32_t)username_len;
+    header.message_len = (uint32_t)message_len;
+    strncpy(header.created_at, created_at, SEGMENT_CREATED_AT_LEN - 1);
+
+    uint64_t size = record_size(&header);
+    if (reserve_segment(size) != 0) {
+        LOG_ERROR("Failed to grow message segment\n");
+        return -5;
+    }
+
+    uint64_t offset = g_write_end;
+    segment_record_t *record = record_at(offset);
+    char *payload = (char *)(record + 1);
+    memcpy(record, &header, sizeof(header));
+    memcpy(payload, room, room_len);
+    memcpy(payload + room_len, username, username_len);
+    memcpy(payload + room_len + username_len, message, message_len);
+    memset(payload + payload_size(&header), 0, (size_t)(size - sizeof(header) - payload_size(&header)));
+    record->checksum = record_checksum(record);
+
+    g_write_end += size;
+    *out_offset = offset;
+    return 0;
+}
+
+static bool compaction_due(void) {
+    uint64_t live = g_write_end - sizeof(segment_header_t) - g_dead_bytes;
+    return g_dead_bytes >= SEGMENT_COMPACT_MIN_DEAD && g_dead_bytes >= live;
+}
+
+// Publish everything appended so far: records first, then the header
+static int commit_locked(void) {
+    segment_header_t *header = segment_header();
+    uint64_t start = header->committed_end;
+    int result = 0;
+
+    if (g_sync_writes && g_write_end > start &&
+        mapped_file_sync(&g_segment, (size_t)start, (size_t)(g_write_end - start)) != 0) {
+        result = -5;
+    }
+    header->committed_end = g_write_end;
+    header->dead_bytes = g_dead_bytes;
+    header->next_id = g_next_id;
+    if (g_sync_writes && mapped_file_sync(&g_segment, 0, sizeof(segment_header_t)) != 0) {
+        result = -5;
+    }
+    if (result != 0) {
+        LOG_ERROR("Failed to sync message segment\n");
+    }
+
+    if (compaction_due()) {
+        cond_signal(&g_compactor_cond);
+    }
+    return result;
+}
+
+// Rebuild the index by replaying every complete record in the segment
+static int rebuild_index(void) {
+    segment_header_t *header = segment_header();
+    memset(g_index.base + sizeof(index_header_t), 0, g_index.size - sizeof(index_header_t));
+
+    int max_id = 0;
+    uint64_t offset = sizeof(segment_header_t);
+    while (offset < header->committed_end) {
+        segment_record_t *record = record_at(offset);
+        if (header->committed_end - offset < sizeof(segment_record_t) || record->magic != RECORD_MAGIC ||
+            record->id < 1 || record_size(record) > header->committed_end - offset ||
+            record->checksum != record_checksum(record)) {
+            LOG_WARN("Message segment damaged at offset %llu; dropping what follows\n",
+                    (unsigned long long)offset);
+            header->committed_end = offset;
+            break;
+        }
+
+        if (reserve_index(record->id) != 0) {
+            return -1;
+        }
+        header = segment_header();
+        record = record_at(offset);
+        index_entry_t *entry = index_entry(record->id);
+        entry->offset = record->kind == RECORD_PUT ? offset : 0;
+        memcpy(entry->created_at, record->created_at, SEGMENT_CREATED_AT_LEN);
+        entry->created_at[SEGMENT_CREATED_AT_LEN - 1] = '\0';
+        if (record->id > max_id) {
+            max_id = record->id;
+        }
+        offset += record_size(record);
+    }
+
+    // Ids compacted away after a delete inherit their predecessor's time,
+    // which keeps timestamps non-decreasing in id
+    uint64_t live = 0;
+    for (int id = 1; id <= max_id; id++) {
+        index_entry_t *entry = index_entry(id);
+        if (entry->created_at[0] == '\0' && id > 1) {
+            memcpy(entry->created_at, index_entry(id - 1)->created_at, SEGMENT_CREATED_AT_LEN);
+        }
+        if (entry->offset != 0) {
+            live += record_size(record_at(entry->offset));
+        }
+    }
+
+    if (header->next_id <= max_id) {
+        header->next_id = max_id + 1;
+    }
+    header->dead_bytes = header->committed_end - sizeof(segment_header_t) - live;
+    if (max_id > 0) {
+        LOG_INFO("Rebuilt message index: %d ids, %llu dead bytes\n", max_id,
+                 (unsigned long long)header->dead_bytes);
+    }
+    return 0;
+}
+
+// Sync a compacted copy, close it and move it over the segment file, then
+// map the segment again (store locked)
+static int replace_segment(mapped_file_t *fresh, const char *temp_path) {
+    int synced = mapped_file_sync(fresh, 0, fresh->size);
+    mapped_file_close(fresh);
+    if (synced != 0) {
+        remove(temp_path);
+        LOG_ERROR("Failed to sync compacted segment\n");
+        return -1;
+    }
+
+    mapped_file_close(&g_segment);
+    int replaced = platform_replace_file(temp_path, g_segment_path);
+    if (mapped_file_open(&g_segment, g_segment_path, 0) != 0) {
+        g_open = false;
+        LOG_ERROR("Failed to reopen message segment after compaction\n");
+        return -1;
+    }
+    if (replaced != 0) {
+        remove(temp_path);
+        LOG_WARN("Failed to replace message segment; keeping the old one\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Drop a compacted copy that will not be swapped in
+static void discard_compaction(mapped_file_t *fresh, const char *temp_path, uint64_t *offsets) {
+    bool anonymous = fresh->anonymous;
+    mapped_file_close(fresh);
+    if (!anonymous) {
+        remove(temp_path);
+    }
+    free(offsets);
+}
+
+// Append one record to the compacted copy, growing it as needed
+static int copy_record(mapped_file_t *fresh, const segment_record_t *record, uint64_t *position) {
+    uint64_t length = record_size(record);
+    if (*position + length > fresh->size) {
+        size_t size = fresh->size;
+        while (*position + length > size) {
+            size *= 2;
+        }
+        if (mapped_file_resize(fresh, size) != 0) {
+            return -1;
+        }
+    }
+    memcpy(fresh->base + *position, record, (size_t)length);
+    *position += length;
+    return 0;
+}
+
+// Rewrite the live records into a fresh segment and swap it in. Entered and
+// left with the store locked, but the bulk copy and its sync run unlocked:
+// committed records never change, and g_compacting keeps the mapping from
+// moving. Under the lock again only the ids written since are copied, then
+// the copy replaces the segment.
+static int compact_segment(void) {
+    bool anonymous = g_segment.anonymous;
+    char temp_path[sizeof(g_segment_path) + 16];
+    snprintf(temp_path, sizeof(temp_path), "%s.compact", g_segment_path);
+    if (!anonymous) {
+        remove(temp_path);
+    }
+
+    uint64_t live = g_write_end - sizeof(segment_header_t) - g_dead_bytes;
+    size_t size = SEGMENT_INITIAL_SIZE;
+    while (size < sizeof(segment_header_t) + live) {
+        size *= 2;
+    }
+
+    // Room for as many new bytes as the copy moves, so writers rarely wait
+    if (reserve_segment(live) != 0) {
+        return -1;
+    }
+    mapped_file_t fresh;
+    if (mapped_file_open(&fresh, anonymous ? NULL : temp_path, size) != 0) {
+        LOG_ERROR("Failed to create compacted segment\n");
+        return -1;
+    }
+
+    // Per snapshot id: the committed record copied unlocked (0 for none;
+    // appends past committed_end may still be rolled back), then its offset
+    // in the copy
+    int snapshot_ids = g_next_id - 1;
+    uint64_t committed = segment_header()->committed_end;
+    uint64_t *offsets = malloc(((size_t)snapshot_ids * 2 + 1) * sizeof(uint64_t));
+    if (offsets == NULL) {
+        discard_compaction(&fresh, temp_path, NULL);
+        return -1;
+    }
+    uint64_t *sources = offsets;
+    uint64_t *targets = offsets + snapshot_ids;
+    for (int id = 1; id <= snapshot_ids; id++) {
+        uint64_t offset = index_entry(id)->offset;
+        sources[id - 1] = offset < committed ? offset : 0;
+    }
+
+    g_compacting = true;
+    mutex_unlock(&g_store_lock);
+
+    // Ids keep their order, so the copy stays sorted by id and time
+    uint64_t position = sizeof(segment_header_t);
+    int result = 0;
+    for (int id = 1; id <= snapshot_ids && result == 0; id++) {
+        targets[id - 1] = position;
+        if (sources[id - 1] != 0) {
+            result = copy_record(&fresh, record_at(sources[id - 1]), &position);
+        }
+    }
+    if (result == 0 && !anonymous && mapped_file_sync(&fresh, 0, (size_t)position) != 0) {
+        result = -1;
+    }
+
+    mutex_lock(&g_store_lock);
+    g_compacting = false;
+    cond_broadcast(&g_compaction_cond);
+    if (result != 0) {
+        LOG_ERROR("Failed to copy live records into compacted segment\n");
+        discard_compaction(&fresh, temp_path, offsets);
+        return -1;
+    }
+
+    // Ids updated, deleted or appended meanwhile take their current record;
+    // the copies they replace are the new segment's dead space
+    uint64_t *grown = realloc(offsets, ((size_t)snapshot_ids + (size_t)g_next_id) * sizeof(uint64_t));
+    if (grown == NULL) {
+        discard_compaction(&fresh, temp_path, offsets);
+        return -1;
+    }
+    offsets = grown;
+    sources = offsets;
+    targets = offsets + snapshot_ids;
+    uint64_t dead = 0;
+    for (int id = 1; id < g_next_id; id++) {
+        uint64_t source = id <= snapshot_ids ? sources[id - 1] : 0;
+        uint64_t current = index_entry(id)->offset;
+        if (source != 0 && current == source) {
+            continue;
+        }
+        if (source != 0) {
+            dead += record_size((segment_record_t *)(fresh.base + targets[id - 1]));
+        }
+        targets[id - 1] = current != 0 ? position : 0;
+        if (current != 0 && copy_record(&fresh, record_at(current), &position) != 0) {
+            LOG_ERROR("Failed to grow compacted segment\n");
+            discard_compaction(&fresh, temp_path, offsets);
+            return -1;
+        }
+    }
+
+    segment_header_t *header = (segment_header_t *)fresh.base;
+    memcpy(header, segment_header(), sizeof(segment_header_t));
+    header->generation++;
+    header->committed_end = position;
+    header->dead_bytes = dead;
+    header->next_id = g_next_id;
+    uint64_t generation = header->generation;
+
+    if (anonymous) {
+        // Nothing to put on disk: the copy simply becomes the segment
+        mapped_file_close(&g_segment);
+        g_segment = fresh;
+    } else if (replace_segment(&fresh, temp_path) != 0) {
+        free(offsets);
+        return -1;
+    }
+
+    uint64_t reclaimed = g_write_end > position ? g_write_end - position : 0;
+    for (int id = 1; id < g_next_id; id++) {
+        index_entry(id)->offset = targets[id - 1];
+    }
+    free(offsets);
+    index_header()->generation = generation;
+    g_write_end = position;
+    g_dead_bytes = dead;
+    g_compactions++;
+    LOG_INFO("Compacted message segment: reclaimed %llu bytes, %llu live\n",
+             (unsigned long long)reclaimed, (unsigned long long)(position - sizeof(segment_header_t) - dead));
+    return 0;
+}
+
+static void *compactor_main(void *arg) {
+    (void)arg;
+    mutex_lock(&g_store_lock);
+    while (g_compactor_running) {
+        cond_timedwait_ms(&g_compactor_cond, &g_store_lock, SEGMENT_COMPACT_CHECK_MS);
+        if (g_compactor_running && g_open && compaction_due()) {
+            compact_segment();
+        }
+    }
+    mutex_unlock(&g_store_lock);
+    return NULL;
+}
+
+// Open (or create) the segment and its index. With sync_writes every commit
+// waits for the disk; without it the OS writes the pages back on its own.
+// With both paths NULL the store lives in process memory only.
+int segment_store_open(const char *segment_path, const char *index_path, bool sync_writes) {
+    if (g_open) {
+        return 0;
+    }
+    if ((segment_path == NULL) != (index_path == NULL) ||
+        (segment_path != NULL && strlen(segment_path) >= sizeof(g_segment_path))) {
+        return -4;
+    }
+    strcpy(g_segment_path, segment_path != NULL ? segment_path : "");
+    g_sync_writes = sync_writes && segment_path != NULL;
+
+    if (mapped_file_open(&g_segment, segment_path, SEGMENT_INITIAL_SIZE) != 0) {
+        LOG_ERROR("Failed to map message segment %s\n", g_segment_path);
+        return -1;
+    }
+    segment_header_t *header = segment_header();
+    if (memcmp(header->magic, SEGMENT_MAGIC, 8) != 0) {
+        // New file: the mapping is all zeros
+        memset(header, 0, sizeof(*header));
+        memcpy(header->magic, SEGMENT_MAGIC, 8);
+        header->version = SEGMENT_VERSION;
+        header->record_header_size = sizeof(segment_record_t);
+        header->generation = 1;
+        header->committed_end = sizeof(segment_header_t);
+        header->next_id = 1;
+    } else if (header->version != SEGMENT_VERSION || header->record_header_size != sizeof(segment_record_t) ||
+               header->committed_end < sizeof(segment_header_t) || header->committed_end > g_segment.size) {
+        LOG_ERROR("Unsupported or damaged message segment %s\n", g_segment_path);
+        mapped_file_close(&g_segment);
+        return -1;
+    }
+
+    size_t index_size = sizeof(index_header_t) + (size_t)SEGMENT_INITIAL_IDS * sizeof(index_entry_t);
+    if (mapped_file_open(&g_index, index_path, index_size) != 0) {
+        LOG_ERROR("Failed to map message index\n");
+        mapped_file_close(&g_segment);
+        return -1;
+    }
+
+    index_header_t *index = index_header();
+    bool trusted = memcmp(index->magic, INDEX_MAGIC, 8) == 0 && index->version == SEGMENT_VERSION &&
+                   index->entry_size == sizeof(index_entry_t) && index->clean == 1 &&
+                   index->generation == header->generation && index->segment_end == header->committed_end &&
+                   index->id_count == header->next_id - 1 && index->id_count <= index_capacity();
+    if (!trusted && rebuild_index() != 0) {
+        LOG_ERROR("Failed to rebuild message index\n");
+        mapped_file_close(&g_index);
+        mapped_file_close(&g_segment);
+        return -1;
+    }
+    header = segment_header();
+    index = index_header();
+
+    // Until the next clean close the index may run ahead of the disk
+    memcpy(index->magic, INDEX_MAGIC, 8);
+    index->version = SEGMENT_VERSION;
+    index->entry_size = sizeof(index_entry_t);
+    index->generation = header->generation;
+    index->clean = 0;
+    mapped_file_sync(&g_index, 0, sizeof(index_header_t));
+
+    // commit_locked() may signal the compactor, so both exist before it runs
+    mutex_init(&g_store_lock);
+    cond_init(&g_compactor_cond);
+    cond_init(&g_compaction_cond);
+
+    mutex_lock(&g_store_lock);
+    g_write_end = header->committed_end;
+    g_dead_bytes = header->dead_bytes;
+    g_next_id = header->next_id;
+    commit_locked();
+    mutex_unlock(&g_store_lock);
+
+    g_compactor_running = true;
+    if (thread_create(&g_compactor, compactor_main, NULL) != 0) {
+        g_compactor_running = false;
+        LOG_WARN("Failed to start segment compactor; dead space will not be reclaimed\n");
+    }
+    g_compactions = 0;
+    g_open = true;
+    LOG_INFO("Message segment %s: %d ids, %llu bytes (%llu dead)\n",
+             segment_path != NULL ? segment_path : "(memory)", g_next_id - 1,
+             (unsigned long long)g_write_end, (unsigned long long)g_dead_bytes);
+    return 0;
+}
+
+// Append a new message. Its time is created_at, raised if needed so times
+// never decrease with id; the id and time used are written back. Nothing is
+// durable until segment_store_commit().
+int segment_store_append(const char *room, const char *username, const char *message,
+                         const char *created_at, int *out_id, char *out_created_at) {
+    if (room == NULL || username == NULL || message == NULL || created_at == NULL || out_id == NULL ||
+        strlen(room) > 0xFFFF || strlen(created_at) >= SEGMENT_CREATED_AT_LEN) {
+        return -4;
+    }
+
+    mutex_lock(&g_store_lock);
+    if (make_room(record_bytes(strlen(room) + strlen(username) + strlen(message))) != 0) {
+        mutex_unlock(&g_store_lock);
+        return -1;
+    }
+
+    int id = g_next_id;
+    char when[SEGMENT_CREATED_AT_LEN];
+    strcpy(when, created_at);
+    if (id > 1 && strcmp(when, index_entry(id - 1)->created_at) < 0) {
+        strcpy(when, index_entry(id - 1)->created_at);
+    }
+
+    uint64_t offset;
+    if (reserve_index(id) != 0 ||
+        append_record(RECORD_PUT, id, when, room, strlen(room), username, strlen(username),
+                      message, strlen(message), &offset) != 0) {
+        mutex_unlock(&g_store_lock);
+        return -5;
+    }
+    index_entry_t *entry = index_entry(id);
+    entry->offset = offset;
+    memcpy(entry->created_at, when, SEGMENT_CREATED_AT_LEN);
+    index_header()->id_count = id;
+    g_next_id = id + 1;
+    mutex_unlock(&g_store_lock);
+
+    *out_id = id;
+    if (out_created_at != NULL) {
+        strcpy(out_created_at, when);
+    }
+    return 0;
+}
+
+// Make every append so far durable (one sync for however many there were)
+int segment_store_commit(void) {
+    mutex_lock(&g_store_lock);
+    int result = g_open ? commit_locked() : -1;
+    mutex_unlock(&g_store_lock);
+    return result;
+}
+
+// Forget every append since the last commit (a batch that failed part way)
+void segment_store_rollback(void) {
+    mutex_lock(&g_store_lock);
+    if (g_open) {
+        segment_header_t *header = segment_header();
+        for (int id = header->next_id; id < g_next_id; id++) {
+            memset(index_entry(id), 0, sizeof(index_entry_t));
+        }
+        g_write_end = header->committed_end;
+        g_dead_bytes = header->dead_bytes;
+        g_next_id = header->next_id;
+        index_header()->id_count = g_next_id - 1;
+    }
+    mutex_unlock(&g_store_lock);
+}
+
+// The live record for id if it belongs to room and username (store locked)
+static segment_record_t *owned_record(int id, const char *room, const char *username) {
+    if (id < 1 || id >= g_next_id || index_entry(id)->offset == 0) {
+        return NULL;
+    }
+    segment_record_t *record = record_at(index_entry(id)->offset);
+    const char *payload = (const char *)(record + 1);
+    if (record->room_len != strlen(room) || memcmp(payload, room, record->room_len) != 0 ||
+        record->username_len != strlen(username) ||
+        memcmp(payload + record->room_len, username, record->username_len) != 0) {
+        return NULL;
+    }
+    return record;
+}
+
+// Replace a message's text; -2 if id is not a live message of username in room
+int segment_store_update(int id, const char *room, const char *username, const char *message) {
+    if (room == NULL || username == NULL || message == NULL) {
+        return -4;
+    }
+
+    mutex_lock(&g_store_lock);
+    uint64_t size = record_bytes(strlen(room) + strlen(username) + strlen(message));
+    segment_record_t *old = make_room(size) == 0 ? owned_record(id, room, username) : NULL;
+    if (old == NULL) {
+        mutex_unlock(&g_store_lock);
+        return -2;
+    }
+
+    char when[SEGMENT_CREATED_AT_LEN];
+    memcpy(when, old->created_at, SEGMENT_CREATED_AT_LEN);
+    uint64_t old_size = record_size(old);
+    uint64_t offset;
+    if (append_record(RECORD_PUT, id, when, room, strlen(room), username, strlen(username),
+                      message, strlen(message), &offset) != 0) {
+        mutex_unlock(&g_store_lock);
+        return -5;
+    }
+    index_entry(id)->offset = offset;
+    g_dead_bytes += old_size;
+    int result = commit_locked();
+    mutex_unlock(&g_store_lock);
+    return result;
+}
+
+// Delete a message with a tombstone; -2 if it is not username's in room
+int segment_store_delete(int id, const char *room, const char *username) {
+    if (room == NULL || username == NULL) {
+        return -4;
+    }
+
+    mutex_lock(&g_store_lock);
+    uint64_t size = record_bytes(strlen(room));
+    segment_record_t *old = make_room(size) == 0 ? owned_record(id, room, username) : NULL;
+    if (old == NULL) {
+        mutex_unlock(&g_store_lock);
+        return -2;
+    }
+
+    char when[SEGMENT_CREATED_AT_LEN];
+    memcpy(when, old->created_at, SEGMENT_CREATED_AT_LEN);
+    uint64_t old_size = record_size(old);
+    uint64_t offset;
+    if (append_record(RECORD_TOMBSTONE, id, when, room, strlen(room), "", 0, "", 0, &offset) != 0) {
+        mutex_unlock(&g_store_lock);
+        return -5;
+    }
+    index_entry(id)->offset = 0;
+    g_dead_bytes += old_size + record_size(record_at(offset));
+    int result = commit_locked();
+    mutex_unlock(&g_store_lock);
+    return result;
+}
+
+// --- Listing-order scans (store locked) ---
+
+// Smallest id whose time is >= created_at (g_next_id if none)
+static int first_id_at_or_after(const char *created_at) {
+    int low = 1;
+    int high = g_next_id;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (strcmp(index_entry(mid)->created_at, created_at) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Largest id whose time is <= created_at (0 if none)
+static int last_id_at_or_before(const char *created_at) {
+    int low = 1;
+    int high = g_next_id;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (strcmp(index_entry(mid)->created_at, created_at) <= 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low - 1;
+}
+
+// Hand the live row for id to fn; false once fn asks to stop
+static bool emit_row(int id, segment_row_fn fn, void *ctx) {
+    index_entry_t *entry = index_entry(id);
+    if (entry->offset == 0) {
+        return true;
+    }
+    segment_record_t *record = record_at(entry->offset);
+    const char *payload = (const char *)(record + 1);
+    segment_row_t row;
+    row.id = id;
+    row.created_at = entry->created_at;
+    row.room = payload;
+    row.room_len = record->room_len;
+    row.username = payload + record->room_len;
+    row.username_len = record->username_len;
+    row.message = payload + record->room_len + record->username_len;
+    row.message_len = record->message_len;
+    return fn(&row, ctx);
+}
+
+// Visit live rows in order, starting just past the cursor row (created_at,
+// id) when cursor_created_at is given, until fn returns false
+int segment_store_scan(segment_scan_order_t order, const char *cursor_created_at, int cursor_id,
+                       segment_row_fn fn, void *ctx) {
+    if (fn == NULL) {
+        return -4;
+    }
+
+    mutex_lock(&g_store_lock);
+    if (!g_open) {
+        mutex_unlock(&g_store_lock);
+        return -1;
+    }
+
+    int last = g_next_id - 1;
+    if (last > 0) {
+        // [low, high] is the run of ids sharing one time; cur walks it
+        int low;
+        int high;
+        int cur;
+        if (cursor_created_at != NULL) {
+            low = first_id_at_or_after(cursor_created_at);
+            high = last_id_at_or_before(cursor_created_at);
+        } else if (order == SEGMENT_SCAN_NEWEST_FIRST) {
+            high = last;
+            low = first_id_at_or_after(index_entry(last)->created_at);
+        } else {
+            low = 1;
+            high = last_id_at_or_before(index_entry(1)->created_at);
+        }
+
+        if (order == SEGMENT_SCAN_NEWEST_FIRST) {
+            // Runs newest to oldest, ids ascending within a run
+            if (cursor_created_at == NULL) {
+                cur = low;
+            } else if (low <= high) {
+                cur = cursor_id + 1 > low ? cursor_id + 1 : low;
+            } else {
+                cur = high + 1;  // No row has the cursor's time: go to the older run
+                low = high + 1;
+            }
+            for (;;) {
+                if (cur > high) {
+                    high = low - 1;
+                    if (high < 1) {
+                        break;
+                    }
+                    low = first_id_at_or_after(index_entry(high)->created_at);
+                    cur = low;
+                    continue;
+                }
+                if (!emit_row(cur++, fn, ctx)) {
+                    break;
+                }
+            }
+        } else {
+            // Runs oldest to newest, ids descending within a run
+            if (cursor_created_at == NULL) {
+                cur = high;
+            } else if (low <= high) {
+                cur = cursor_id - 1 < high ? cursor_id - 1 : high;
+            } else {
+                cur = low - 1;  // No row has the cursor's time: go to the newer run
+                high = low - 1;
+            }
+            for (;;) {
+                if (cur < low) {
+                    low = high + 1;
+                    if (low > last) {
+                        break;
+                    }
+                    high = last_id_at_or_before(index_entry(low)->created_at);
+                    cur = high;
+                    continue;
+                }
+                if (!emit_row(cur--, fn, ctx)) {
+                    break;
+                }
+            }
+        }
+    }
+
+    mutex_unlock(&g_store_lock);
+    return 0;
+}
+
+// Visit the live rows of ids in the order given, skipping any that are
+// unknown or deleted, until fn returns false
+int segment_store_fetch(const int *ids, int count, segment_row_fn fn, void *ctx) {
+    if (fn == NULL || (ids == NULL && count > 0)) {
+        return -4;
+    }
+
+    mutex_lock(&g_store_lock);
+    if (!g_open) {
+        mutex_unlock(&g_store_lock);
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (ids[i] >= 1 && ids[i] < g_next_id && !emit_row(ids[i], fn, ctx)) {
+            break;
+        }
+    }
+    mutex_unlock(&g_store_lock);
+    return 0;
+}
+
+// Stop the compactor, commit, and mark the index as matching the segment
+void segment_store_close(void) {
+    if (!g_open) {
+        return;
+    }
+
+    mutex_lock(&g_store_lock);
+    bool joinable = g_compactor_running;
+    g_compactor_running = false;
+    cond_signal(&g_compactor_cond);
+    mutex_unlock(&g_store_lock);
+    if (joinable) {
+        thread_join(g_compactor);
+    }
+
+    mutex_lock(&g_store_lock);
+    if (g_open) {
+        commit_locked();
+        mapped_file_sync(&g_segment, 0, (size_t)g_write_end);
+        index_header_t *index = index_header();
+        index->segment_end = segment_header()->committed_end;
+        index->id_count = g_next_id - 1;
+        mapped_file_sync(&g_index, 0, g_index.size);
+        index->clean = 1;
+        mapped_file_sync(&g_index, 0, sizeof(index_header_t));
+        mapped_file_close(&g_index);
+        mapped_file_close(&g_segment);
+        g_open = false;
+    }
+    LOG_INFO("Message segment closed (%lu compactions)\n", g_compactions);
+    mutex_unlock(&g_store_lock);
+
+    cond_destroy(&g_compaction_cond);
+    cond_destroy(&g_compactor_cond);
+    mutex_destroy(&g_store_lock);
+}
@@ -1,144 +1,928 @@
 // Binary Semaphore Manager Implementation
-// Cross-platform mutex implementation for write operations
+// Lock-free binary semaphores (C11 atomics) guarding write operations, one per room
+//
+// Each room has its own holder word, lease and FIFO queue, so writers in
+// different rooms never wait on each other. Rooms live in a fixed
+// open-addressed table: a slot is claimed once, under room_mutex, and then
+// published with a release store, so lookups never lock. Rooms are never
+// removed.
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-
-#ifdef _WIN32
-    #include <windows.h>
-    typedef CRITICAL_SECTION mutex_t;
-    #define mutex_init(m) InitializeCriticalSection(m)
-    #define mutex_destroy(m) DeleteCriticalSection(m)
-    #define mutex_lock(m) EnterCriticalSection(m)
-    #define mutex_unlock(m) LeaveCriticalSection(m)
-    #define mutex_trylock(m) (TryEnterCriticalSection(m) ? 0 : 1)
-#else
-    #include <pthread.h>
-    typedef pthread_mutex_t mutex_t;
-    #define mutex_init(m) pthread_mutex_init(m, NULL)
-    #define mutex_destroy(m) pthread_mutex_destroy(m)
-    #define mutex_lock(m) pthread_mutex_lock(m)
-    #define mutex_unlock(m) pthread_mutex_unlock(m)
-    #define mutex_trylock(m) pthread_mutex_trylock(m)
-#endif
+#include <ctype.h>
+#include <time.h>
 
 #include "semaphore.h"
+#include "metrics.h"
+#include "events.h"
+#include "json_writer.h"
+#include "diag.h"
 
 // Global semaphore state
-static semaphore_state_t g_semaphore_state;
+static semaphore_state_t g_rooms[SEMAPHORE_MAX_ROOMS];
+static semaphore_state_t *g_room_list[SEMAPHORE_MAX_ROOMS];  // Creation order, for scans
+static atomic_u32_t g_room_count;
+static atomic_u32_t g_writer_enabled;         // Global writer toggle (admin control)
+static mutex_t g_room_mutex;                  // Serializes adding rooms to the table
+static mutex_t g_intern_mutex;                // Serializes adding names to the holder table
 static bool g_initialized = false;
 
+// Interned holder names. Slots are written once, under intern_mutex, and then
+// published with a release store, so a holder id read from the holder word
+// always names a complete, immutable string.
+static char g_holder_names[MAX_HOLDER_NAMES][MAX_USERNAME_LEN];
+static atomic_u32_t g_holder_published[MAX_HOLDER_NAMES];
+
+// FNV-1a, used to pick a username's or room's home slot
+static uint32_t hash_name(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+// Map a username to its holder id (index + 1). Lookups are lock-free; with
+// create set, an unseen name is added. Returns 0 if the name is unknown (or
+// the table is full).
+static uint32_t intern_holder(const char *username, bool create) {
+    uint32_t mask = MAX_HOLDER_NAMES - 1;
+    uint32_t slot = hash_name(username) & mask;
+    
+    for (uint32_t probes = 0; probes < MAX_HOLDER_NAMES; probes++, slot = (slot + 1) & mask) {
+        if (!atomic_u32_load(&g_holder_published[slot])) {
+            if (!create) {
+                return 0;  // Names are never removed, so the probe chain ends here
+            }
+            
+            mutex_lock(&g_intern_mutex);
+            bool claimed = !atomic_u32_load(&g_holder_published[slot]);
+            if (claimed) {
+                strncpy(g_holder_names[slot], username, MAX_USERNAME_LEN - 1);
+                g_holder_names[slot][MAX_USERNAME_LEN - 1] = '\0';
+                atomic_u32_store(&g_holder_published[slot], 1);
+            }
+            mutex_unlock(&g_intern_mutex);
+            
+            if (claimed) {
+                return slot + 1;
+            }
+        }
+        
+        // Published, either before we looked or by a concurrent intern
+        if (strcmp(g_holder_names[slot], username) == 0) {
+            return slot + 1;
+        }
+    }
+    
+    return 0;
+}
+
+static const char *holder_name(uint32_t id) {
+    return id != 0 ? g_holder_names[id - 1] : "";
+}
+
+// ---------------------------------------------------------------------------
+// Room table
+// ---------------------------------------------------------------------------
+
+static void lease_timer_fired(void *arg);
+
+// Room names travel in URLs, JSON and log lines unescaped, so keep them plain
+bool semaphore_valid_room(const char *room) {
+    if (room == NULL || room[0] == '\0') {
+        return true;  // Default room
+    }
+    
+    size_t len = strlen(room);
+    if (len >= MAX_ROOM_NAME_LEN) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)room[i];
+        if (!isalnum(c) && c != '-' && c != '_' && c != '.') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Set up a claimed slot before it is published (room_mutex held)
+static void init_room(semaphore_state_t *s, const char *room) {
+    strncpy(s->name, room, MAX_ROOM_NAME_LEN - 1);
+    s->name[MAX_ROOM_NAME_LEN - 1] = '\0';
+    mutex_init(&s->wait_mutex);
+    s->wait_head = s->wait_tail = NULL;
+    s->next_ticket = 0;
+    atomic_u32_store(&s->waiters, 0);
+    atomic_u64_store(&s->holder, HOLDER_WORD(0, 0));
+    atomic_u64_store(&s->lease, 0);
+    timer_init(&s->lease_timer, lease_timer_fired, s);
+}
+
+// Map a (validated) room name to its semaphore. Lookups are lock-free; with
+// create set, an unseen room is added. Returns NULL if the room does not
+// exist (or the table is full).
+static semaphore_state_t *find_room(const char *room, bool create) {
+    if (room == NULL || room[0] == '\0') {
+        room = SEMAPHORE_DEFAULT_ROOM;
+    }
+    
+    uint32_t mask = SEMAPHORE_MAX_ROOMS - 1;
+    uint32_t slot = hash_name(room) & mask;
+    
+    for (uint32_t probes = 0; probes < SEMAPHORE_MAX_ROOMS; probes++, slot = (slot + 1) & mask) {
+        semaphore_state_t *s = &g_rooms[slot];
+        
+        if (!atomic_u32_load(&s->published)) {
+            if (!create) {
+                return NULL;  // Rooms are never removed, so the probe chain ends here
+            }
+            
+            mutex_lock(&g_room_mutex);
+            bool claimed = !atomic_u32_load(&s->published);
+            if (claimed) {
+                uint32_t count = atomic_u32_load(&g_room_count);
+                init_room(s, room);
+                g_room_list[count] = s;
+                atomic_u32_store(&s->published, 1);
+                atomic_u32_store(&g_room_count, count + 1);
+            }
+            mutex_unlock(&g_room_mutex);
+            
+            if (claimed) {
+                LOG_INFO("Created writer semaphore for room '%s'\n", s->name);
+                return s;
+            }
+        }
+        
+        // Published, either before we looked or by a concurrent create
+        if (strcmp(s->name, room) == 0) {
+            return s;
+        }
+    }
+    
+    return NULL;
+}
+
+// Validate and resolve a room for an acquire. Returns 0 with *out set,
+// -4 for a malformed name or -3 when the room table is full.
+static int open_room(const char *room, semaphore_state_t **out) {
+    if (!semaphore_valid_room(room)) {
+        LOG_DEBUG("Invalid room name provided\n");
+        return -4;  // Invalid input
+    }
+    
+    *out = find_room(room, true);
+    if (*out == NULL) {
+        LOG_WARN("Room table full, cannot create room '%s'\n", room);
+        return -3;  // Resource unavailable
+    }
+    return 0;
+}
+
+// Existing room for read-only or holder-only calls; NULL if it was never used
+static semaphore_state_t *lookup_room(const char *room) {
+    return semaphore_valid_room(room) ? find_room(room, false) : NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Holder leases
+//
+// The holder owns the room's semaphore for lease_ttl unless it renews
+// (heartbeat or any write). Renewal is a CAS of a new deadline into the
+// holder's own lease word; the room's lease timer is left alone and, when it fires, either
+// re-arms for the remaining time or releases the semaphore. The lease word
+// pairs the deadline with the holder generation it belongs to, so a lease can
+// never outlive (or expire) a different holder.
+// ---------------------------------------------------------------------------
+
+#define LEASE_UNIT_MS 100                     // Deadline resolution; 32 bits cover ~13 years
+#define LEASE_WORD(generation, deadline_units) (((uint64_t)(generation) << 32) | (uint64_t)(deadline_units))
+#define LEASE_GENERATION(word) ((uint32_t)((word) >> 32))
+#define LEASE_DEADLINE_UNITS(word) ((uint32_t)((word) & 0xFFFFFFFFu))
+
+static int g_lease_ttl_ms = SEMAPHORE_DEFAULT_LEASE_SEC * 1000;
+static long long g_lease_epoch_ms = 0;        // monotonic_ms() that deadline units count from
+
+static void dispatch_waiters(semaphore_state_t *s);
+
+static uint64_t lease_word_from_now(uint32_t generation, int lease_ms) {
+    long long deadline = monotonic_ms() - g_lease_epoch_ms + lease_ms;
+    return LEASE_WORD(generation, (uint32_t)((deadline + LEASE_UNIT_MS - 1) / LEASE_UNIT_MS));
+}
+
+static long long lease_deadline_ms(uint64_t lease) {
+    return g_lease_epoch_ms + (long long)LEASE_DEADLINE_UNITS(lease) * LEASE_UNIT_MS;
+}
+
+// Count an acquire's outcome; 1 (queued) is counted once it resolves
+static int acquire_outcome(int status) {
+    if (status == 0) {
+        metrics_count(METRIC_ACQUIRE_GRANTED, 1);
+    } else if (status == -3) {
+        metrics_count(METRIC_ACQUIRE_CONFLICT, 1);
+    } else if (status == -2) {
+        metrics_count(METRIC_ACQUIRE_DENIED, 1);
+    } else if (status != 1) {
+        metrics_count(METRIC_ACQUIRE_FAILED, 1);
+    }
+    return status;
+}
+
+// Record a holder word's end for the hold-time histogram. granted is the
+// grant time read before the releasing CAS, so a newer grant cannot race it.
+static void record_hold(semaphore_state_t *s, uint32_t generation, uint64_t granted) {
+    if (atomic_u32_load(&s->granted_generation) == generation) {
+        metrics_observe(METRIC_SEMAPHORE_HOLD, monotonic_ns() - granted);
+    }
+}
+
+// Tell event-stream subscribers that a room changed hands. The generation
+// of the holder word orders events of one room even when a release and the
+// next acquire are published from different threads out of order.
+static void publish_holder_event(event_type_t type, semaphore_state_t *s, uint32_t holder_id,
+                                 uint32_t generation, const char *reason) {
+    if (!events_enabled()) {
+        return;
+    }
+    
+    strbuf_t data;
+    strbuf_init(&data);
+    json_writer_t json;
+    json_writer_init(&json, &data);
+    json_begin_object(&json);
+    json_field_string(&json, "room", s->name);
+    json_field_string(&json, "holder", holder_name(holder_id));
+    json_field_int(&json, "generation", generation);
+    if (reason != NULL) {
+        json_field_string(&json, "reason", reason);
+    }
+    json_end_object(&json);
+    if (json_writer_finish(&json) == 0) {
+        events_publish(type, data.data, data.len);
+    }
+    strbuf_free(&data);
+}
+
+// Give the holder of `generation` a lease of lease_ms (right after its CAS won)
+static void start_lease(semaphore_state_t *s, uint32_t generation, uint32_t holder_id, int lease_ms) {
+    atomic_u64_store(&s->granted_ns, monotonic_ns());
+    atomic_u32_store(&s->granted_generation, generation);
+    publish_holder_event(EVENT_ACQUIRE, s, holder_id, generation, NULL);
+    if (g_lease_ttl_ms <= 0) {
+        return;
+    }
+    atomic_u64_store(&s->lease, lease_word_from_now(generation, lease_ms));
+    timer_schedule(&s->lease_timer, lease_ms);
+}
+
+// Lease timer: re-arm if the holder renewed, otherwise take the semaphore back
+static void lease_timer_fired(void *arg) {
+    semaphore_state_t *s = (semaphore_state_t *)arg;
+    
+    uint64_t word = atomic_u64_load(&s->holder);
+    if (HOLDER_ID(word) == 0) {
+        return;  // Released in time
+    }
+    
+    uint64_t lease = atomic_u64_load(&s->lease);
+    if (LEASE_GENERATION(lease) != HOLDER_GENERATION(word)) {
+        // A new holder between its CAS and start_lease(). Look again shortly
+        // rather than trusting its schedule to land after this callback.
+        timer_schedule(&s->lease_timer, LEASE_UNIT_MS);
+        return;
+    }
+    
+    long long remaining = lease_deadline_ms(lease) - monotonic_ms();
+    if (remaining > 0) {
+        timer_schedule(&s->lease_timer, remaining);
+        return;
+    }
+    
+    uint64_t granted = atomic_u64_load(&s->granted_ns);
+    if (!atomic_u64_cas(&s->holder, &word, HOLDER_WORD(HOLDER_GENERATION(word) + 1, 0))) {
+        return;  // Released (or re-acquired) while we looked
+    }
+    record_hold(s, HOLDER_GENERATION(word), granted);
+    metrics_count(METRIC_LEASE_EXPIRED, 1);
+    publish_holder_event(EVENT_RELEASE, s, HOLDER_ID(word), HOLDER_GENERATION(word) + 1, "lease_expired");
+    
+    LOG_INFO("Lease of '%s' on room '%s' expired after %d ms without renewal, releasing writer semaphore\n",
+             holder_name(HOLDER_ID(word)), s->name, g_lease_ttl_ms);
+    dispatch_waiters(s);
+}
+
+// ---------------------------------------------------------------------------
+// FIFO waiter queue
+//
+// While anyone is queued for a room, try_acquire_writer() refuses to barge
+// and the semaphore is passed to the oldest waiter on release. The queue
+// itself only takes the room's wait_mutex on the slow path; the uncontended
+// acquire/release stays a single CAS.
+// ---------------------------------------------------------------------------
+
+typedef struct waiter {
+    uint64_t ticket;
+    uint32_t holder_id;
+    long long deadline_ms;              // monotonic_ms() at which the wait gives up
+    uint64_t queued_ns;                 // monotonic_ns() when it joined the queue
+    acquire_callback_t callback;
+    void *ctx;
+    struct waiter *next;
+} waiter_t;
+
+// Hand a free semaphore to the head waiter (caller holds s->wait_mutex).
+// Returns the granted waiter, already unlinked, or NULL.
+static waiter_t *grant_next_locked(semaphore_state_t *s) {
+    if (s->wait_head == NULL || !atomic_u32_load(&g_writer_enabled)) {
+        return NULL;
+    }
+    
+    uint64_t word = atomic_u64_load(&s->holder);
+    while (HOLDER_ID(word) == 0) {
+        if (atomic_u64_cas(&s->holder, &word,
+                           HOLDER_WORD(HOLDER_GENERATION(word) + 1, s->wait_head->holder_id))) {
+            start_lease(s, HOLDER_GENERATION(word) + 1, s->wait_head->holder_id, g_lease_ttl_ms);
+            waiter_t *granted = s->wait_head;
+            s->wait_head = granted->next;
+            if (s->wait_head == NULL) {
+                s->wait_tail = NULL;
+            }
+            atomic_u32_store(&s->waiters, atomic_u32_load(&s->waiters) - 1);
+            return granted;
+        }
+    }
+    return NULL;
+}
+
+// Run a waiter's callback outside wait_mutex and free it
+static void finish_waiter(semaphore_state_t *s, waiter_t *w, int status) {
+    metrics_observe(METRIC_SEMAPHORE_WAIT, monotonic_ns() - w->queued_ns);
+    acquire_outcome(status);
+    if (status == 0) {
+        LOG_DEBUG("Queued user '%s' granted writer semaphore for room '%s'\n",
+                  holder_name(w->holder_id), s->name);
+    }
+    w->callback(w->ctx, status);
+    free(w);
+}
+
+// Pass a just-freed semaphore on to the room's oldest waiter, if any
+static void dispatch_waiters(semaphore_state_t *s) {
+    // Pairs with the fence in queue_acquire(): either we see the new waiter
+    // or it sees the semaphore free and takes it itself
+    atomic_fence();
+    if (atomic_u32_load(&s->waiters) == 0) {
+        return;
+    }
+    
+    mutex_lock(&s->wait_mutex);
+    waiter_t *granted = grant_next_locked(s);
+    mutex_unlock(&s->wait_mutex);
+    
+    if (granted != NULL) {
+        finish_waiter(s, granted, 0);
+    }
+}
+
+// Unlink a still-queued waiter. Returns false if it was already granted or expired.
+static bool cancel_waiter(semaphore_state_t *s, uint64_t ticket) {
+    bool found = false;
+    
+    mutex_lock(&s->wait_mutex);
+    waiter_t *prev = NULL;
+    for (waiter_t *w = s->wait_head; w != NULL; prev = w, w = w->next) {
+        if (w->ticket != ticket) {
+            continue;
+        }
+        if (prev != NULL) {
+            prev->next = w->next;
+        } else {
+            s->wait_head = w->next;
+        }
+        if (s->wait_tail == w) {
+            s->wait_tail = prev;
+        }
+        atomic_u32_store(&s->waiters, atomic_u32_load(&s->waiters) - 1);
+        metrics_observe(METRIC_SEMAPHORE_WAIT, monotonic_ns() - w->queued_ns);
+        free(w);
+        found = true;
+        break;
+    }
+    mutex_unlock(&s->wait_mutex);
+    
+    return found;
+}
+
+// Validation shared by the acquire entry points
+static int check_username(const char *username) {
+    if (username == NULL || strlen(username) == 0) {
+        LOG_DEBUG("Invalid username provided\n");
+        return -4;  // Invalid input
+    }
+    
+    if (strlen(username) >= MAX_USERNAME_LEN) {
+        LOG_DEBUG("Username too long\n");
+        return -4;  // Invalid input
+    }
+    
+    return 0;
+}
+
+// Join the room's queue. Returns 0 if granted on the spot (callback not
+// called), 1 if queued, or a negative error code.
+static int queue_acquire(semaphore_state_t *s, const char *username, int wait_ms,
+                         acquire_callback_t callback, void *ctx, uint64_t *out_ticket) {
+    uint32_t id = intern_holder(username, true);
+    if (id == 0) {
+        LOG_WARN("Holder name table full, cannot register '%s'\n", username);
+        return -1;
+    }
+    
+    // Waiting on a semaphore we already hold could only time out
+    if (HOLDER_ID(atomic_u64_load(&s->holder)) == id) {
+        LOG_DEBUG("User '%s' already holds the writer semaphore for room '%s'\n", username, s->name);
+        return -3;
+    }
+    
+    waiter_t *w = malloc(sizeof(waiter_t));
+    if (w == NULL) {
+        return -1;
+    }
+    w->holder_id = id;
+    w->deadline_ms = monotonic_ms() + (wait_ms < SEMAPHORE_MAX_WAIT_MS ? wait_ms : SEMAPHORE_MAX_WAIT_MS);
+    w->queued_ns = monotonic_ns();
+    w->callback = callback;
+    w->ctx = ctx;
+    w->next = NULL;
+    
+    mutex_lock(&s->wait_mutex);
+    w->ticket = ++s->next_ticket;
+    if (out_ticket != NULL) {
+        *out_ticket = w->ticket;  // w may be granted and freed once we unlock
+    }
+    if (s->wait_tail != NULL) {
+        s->wait_tail->next = w;
+    } else {
+        s->wait_head = w;
+    }
+    s->wait_tail = w;
+    atomic_u32_store(&s->waiters, atomic_u32_load(&s->waiters) + 1);
+    
+    // The semaphore may have been released before we were visible
+    atomic_fence();
+    waiter_t *granted = grant_next_locked(s);
+    int queue_position = (int)atomic_u32_load(&s->waiters);
+    mutex_unlock(&s->wait_mutex);
+    
+    if (granted == w) {
+        free(w);
+        LOG_DEBUG("User '%s' acquired writer semaphore for room '%s'\n", username, s->name);
+        return 0;
+    }
+    if (granted != NULL) {
+        finish_waiter(s, granted, 0);  // An earlier waiter was owed it
+    }
+    
+    LOG_DEBUG("User '%s' queued for writer semaphore of room '%s' (%d waiting)\n",
+              username, s->name, queue_position);
+    return 1;
+}
+
 // Initialize the semaphore system
 int init_semaphore(void) {
     if (g_initialized) {
         return 0;  // Already initialized
     }
     
-    // Initialize mutexes
-    mutex_init(&g_semaphore_state.write_mutex);
-    mutex_init(&g_semaphore_state.admin_mutex);
+    // Initialize the room and name table locks
+    mutex_init(&g_room_mutex);
+    mutex_init(&g_intern_mutex);
     
     // Initialize state
-    memset(g_semaphore_state.current_holder, 0, sizeof(g_semaphore_state.current_holder));
-    g_semaphore_state.writer_enabled = true;  // Writers enabled by default
+    memset(g_holder_names, 0, sizeof(g_holder_names));
+    for (int i = 0; i < MAX_HOLDER_NAMES; i++) {
+        atomic_u32_store(&g_holder_published[i], 0);
+    }
+    for (int i = 0; i < SEMAPHORE_MAX_ROOMS; i++) {
+        atomic_u32_store(&g_rooms[i].published, 0);
+    }
+    atomic_u32_store(&g_room_count, 0);
+    g_lease_epoch_ms = monotonic_ms();
+    atomic_u32_store(&g_writer_enabled, 1);  // Writers enabled by default
     
     g_initialized = true;
     
-    printf("Semaphore manager initialized successfully\n");
+    // The default room always exists, so status calls have something to show
+    find_room(SEMAPHORE_DEFAULT_ROOM, true);
+    
+    if (g_lease_ttl_ms > 0) {
+        LOG_INFO("Semaphore manager initialized successfully (%d rooms max, lease %d s)\n",
+                 SEMAPHORE_MAX_ROOMS, g_lease_ttl_ms / 1000);
+    } else {
+        LOG_INFO("Semaphore manager initialized successfully (%d rooms max, leases disabled)\n",
+                 SEMAPHORE_MAX_ROOMS);
+    }
     return 0;
 }
 
-// Attempt to acquire writer semaphore (non-blocking)
-int try_acquire_writer(const char *username) {
+// Attempt to acquire a room's writer semaphore (non-blocking)
+static int try_acquire(const char *room, const char *username) {
     if (!g_initialized) {
-        fprintf(stderr, "Semaphore not initialized\n");
+        LOG_ERROR("Semaphore not initialized\n");
         return -1;
     }
     
-    if (username == NULL || strlen(username) == 0) {
-        fprintf(stderr, "Invalid username provided\n");
-        return -4;  // Invalid input
-    }
-    
-    if (strlen(username) >= MAX_USERNAME_LEN) {
-        fprintf(stderr, "Username too long\n");
-        return -4;  // Invalid input
+    int valid = check_username(username);
+    if (valid != 0) {
+        return valid;
     }
     
     // Check if writers are globally enabled
-    mutex_lock(&g_semaphore_state.admin_mutex);
-    bool writers_enabled = g_semaphore_state.writer_enabled;
-    mutex_unlock(&g_semaphore_state.admin_mutex);
-    
-    if (!writers_enabled) {
-        printf("Writer access is globally disabled\n");
+    if (!atomic_u32_load(&g_writer_enabled)) {
+        LOG_DEBUG("Writer access is globally disabled\n");
         return -2;  // Permission denied
     }
     
-    // Try to acquire the write mutex (non-blocking)
-    int result = mutex_trylock(&g_semaphore_state.write_mutex);
+    semaphore_state_t *s;
+    int opened = open_room(room, &s);
+    if (opened != 0) {
+        return opened;
+    }
     
-    if (result == 0) {
-        // Successfully acquired the mutex
-        strncpy(g_semaphore_state.current_holder, username, MAX_USERNAME_LEN - 1);
-        g_semaphore_state.current_holder[MAX_USERNAME_LEN - 1] = '\0';
-        
-        printf("User '%s' acquired writer semaphore\n", username);
-        return 0;  // Success
-    } else {
-        // Mutex is already locked
-        printf("Writer semaphore unavailable (held by '%s')\n", g_semaphore_state.current_holder);
+    uint32_t id = intern_holder(username, true);
+    if (id == 0) {
+        LOG_WARN("Holder name table full, cannot register '%s'\n", username);
+        return -1;
+    }
+    
+    // Queued writers go first
+    if (atomic_u32_load(&s->waiters) != 0) {
+        LOG_DEBUG("Writer semaphore for room '%s' unavailable (%u writer(s) queued)\n",
+                  s->name, (unsigned)atomic_u32_load(&s->waiters));
         return -3;  // Resource unavailable
     }
+    
+    // Claim the free word; a failed CAS reloads it and we re-check
+    uint64_t word = atomic_u64_load(&s->holder);
+    for (;;) {
+        if (HOLDER_ID(word) != 0) {
+            LOG_DEBUG("Writer semaphore for room '%s' unavailable (held by '%s')\n",
+                      s->name, holder_name(HOLDER_ID(word)));
+            return -3;  // Resource unavailable
+        }
+    
+        if (atomic_u64_cas(&s->holder, &word, HOLDER_WORD(HOLDER_GENERATION(word) + 1, id))) {
+            start_lease(s, HOLDER_GENERATION(word) + 1, id, g_lease_ttl_ms);
+            break;
+        }
+    }
+    
+    LOG_DEBUG("User '%s' acquired writer semaphore for room '%s'\n", username, s->name);
+    return 0;  // Success
+}
+
+int try_acquire_writer(const char *room, const char *username) {
+    return acquire_outcome(try_acquire(room, username));
+}
+
+// Acquire, or wait up to wait_ms in FIFO order. Returns 0 if acquired now,
+// 1 if queued (callback reports the outcome later), or a negative error code.
+int acquire_writer_queued(const char *room, const char *username, int wait_ms,
+                          acquire_callback_t callback, void *ctx) {
+    if (!g_initialized) {
+        LOG_ERROR("Semaphore not initialized\n");
+        return acquire_outcome(-1);
+    }
+    
+    int valid = check_username(username);
+    if (valid != 0) {
+        return acquire_outcome(valid);
+    }
+    
+    if (callback == NULL) {
+        return acquire_outcome(-4);
+    }
+    
+    if (wait_ms <= 0) {
+        return try_acquire_writer(room, username);
+    }
+    
+    if (!atomic_u32_load(&g_writer_enabled)) {
+        LOG_DEBUG("Writer access is globally disabled\n");
+        return acquire_outcome(-2);  // Permission denied
+    }
+    
+    semaphore_state_t *s;
+    int opened = open_room(room, &s);
+    if (opened != 0) {
+        return acquire_outcome(opened);
+    }
+    
+    return acquire_outcome(queue_acquire(s, username, wait_ms, callback, ctx, NULL));
+}
+
+// Rendezvous for acquire_writer_wait()
+typedef struct {
+    mutex_t lock;
+    cond_t done_cond;
+    bool done;
+    int status;
+} sync_waiter_t;
+
+static void wake_sync_waiter(void *ctx, int status) {
+    sync_waiter_t *sync = (sync_waiter_t *)ctx;
+    mutex_lock(&sync->lock);
+    sync->status = status;
+    sync->done = true;
+    cond_signal(&sync->done_cond);
+    mutex_unlock(&sync->lock);
 }
 
-// Release writer semaphore with ownership validation
-int release_writer(const char *username) {
+// Blocking acquire: waits up to wait_ms in FIFO order.
+// Returns 0 when acquired, -3 on timeout, or another negative error code.
+int acquire_writer_wait(const char *room, const char *username, int wait_ms) {
     if (!g_initialized) {
-        fprintf(stderr, "Semaphore not initialized\n");
+        LOG_ERROR("Semaphore not initialized\n");
+        return acquire_outcome(-1);
+    }
+    
+    int valid = check_username(username);
+    if (valid != 0) {
+        return acquire_outcome(valid);
+    }
+    
+    if (wait_ms <= 0) {
+        return try_acquire_writer(room, username);
+    }
+    
+    if (!atomic_u32_load(&g_writer_enabled)) {
+        LOG_DEBUG("Writer access is globally disabled\n");
+        return acquire_outcome(-2);  // Permission denied
+    }
+    
+    semaphore_state_t *s;
+    int opened = open_room(room, &s);
+    if (opened != 0) {
+        return acquire_outcome(opened);
+    }
+    
+    sync_waiter_t sync;
+    sync.done = false;
+    sync.status = -1;
+    mutex_init(&sync.lock);
+    cond_init(&sync.done_cond);
+    
+    uint64_t ticket = 0;
+    long long deadline = monotonic_ms() + (wait_ms < SEMAPHORE_MAX_WAIT_MS ? wait_ms : SEMAPHORE_MAX_WAIT_MS);
+    int result = acquire_outcome(queue_acquire(s, username, wait_ms, wake_sync_waiter, &sync, &ticket));
+    
+    if (result == 1) {
+        // Nothing may expire us if no event loop runs, so watch our own deadline
+        mutex_lock(&sync.lock);
+        while (!sync.done) {
+            long long remaining = deadline - monotonic_ms();
+            if (remaining <= 0) {
+                if (cancel_waiter(s, ticket)) {
+                    sync.status = -3;  // Timed out while still queued
+                    acquire_outcome(-3);
+                    break;
+                }
+                remaining = 10;  // Already granted or expired; the callback is on its way
+            }
+            cond_timedwait_ms(&sync.done_cond, &sync.lock, (int)remaining);
+        }
+        result = sync.status;
+        mutex_unlock(&sync.lock);
+    }
+    
+    mutex_destroy(&sync.lock);
+    cond_destroy(&sync.done_cond);
+    return result;
+}
+
+// Time out one room's overdue waiters. Returns the room's next deadline, or -1.
+static long long expire_room_waiters(semaphore_state_t *s, long long now) {
+    long long next_deadline = -1;
+    waiter_t *expired = NULL;
+    
+    mutex_lock(&s->wait_mutex);
+    waiter_t **link = &s->wait_head;
+    s->wait_tail = NULL;
+    while (*link != NULL) {
+        waiter_t *w = *link;
+        if (w->deadline_ms <= now) {
+            *link = w->next;
+            w->next = expired;
+            expired = w;
+            atomic_u32_store(&s->waiters, atomic_u32_load(&s->waiters) - 1);
+            continue;
+        }
+        if (next_deadline < 0 || w->deadline_ms < next_deadline) {
+            next_deadline = w->deadline_ms;
+        }
+        s->wait_tail = w;
+        link = &w->next;
+    }
+    mutex_unlock(&s->wait_mutex);
+    
+    while (expired != NULL) {
+        waiter_t *next = expired->next;
+        LOG_DEBUG("Queued acquire by '%s' on room '%s' timed out\n",
+                  holder_name(expired->holder_id), s->name);
+        finish_waiter(s, expired, -3);
+        expired = next;
+    }
+    
+    // The head may have left the queue with the semaphore free
+    dispatch_waiters(s);
+    return next_deadline;
+}
+
+// Time out queued acquires whose deadline has passed, in every room. Returns
+// milliseconds until the next deadline, or -1 if nobody is waiting.
+int semaphore_expire_waiters(void) {
+    if (!g_initialized) {
+        return -1;
+    }
+    
+    long long now = monotonic_ms();
+    long long next_deadline = -1;
+    uint32_t count = atomic_u32_load(&g_room_count);
+    
+    for (uint32_t i = 0; i < count; i++) {
+        semaphore_state_t *s = g_room_list[i];
+        if (atomic_u32_load(&s->waiters) == 0) {
+            continue;
+        }
+    
+        long long room_deadline = expire_room_waiters(s, now);
+        if (room_deadline >= 0 && (next_deadline < 0 || room_deadline < next_deadline)) {
+            next_deadline = room_deadline;
+        }
+    }
+    
+    return next_deadline < 0 ? -1 : (int)(next_deadline - now);
+}
+
+// Number of acquirers currently waiting for a room
+int semaphore_queue_length(const char *room) {
+    if (!g_initialized) {
+        return 0;
+    }
+    
+    semaphore_state_t *s = lookup_room(room);
+    return s != NULL ? (int)atomic_u32_load(&s->waiters) : 0;
+}
+
+// Release a room's writer semaphore with ownership validation
+int release_writer(const char *room, const char *username) {
+    if (!g_initialized) {
+        LOG_ERROR("Semaphore not initialized\n");
         return -1;
     }
     
     if (username == NULL || strlen(username) == 0) {
-        fprintf(stderr, "Invalid username provided\n");
+        LOG_DEBUG("Invalid username provided\n");
         return -4;  // Invalid input
     }
     
-    // Validate ownership
-    if (strcmp(g_semaphore_state.current_holder, username) != 0) {
-        printf("User '%s' cannot release semaphore held by '%s'\n", 
-               username, g_semaphore_state.current_holder);
+    if (!semaphore_valid_room(room)) {
+        LOG_DEBUG("Invalid room name provided\n");
+        return -4;  // Invalid input
+    }
+    
+    semaphore_state_t *s = find_room(room, false);
+    if (s == NULL) {
+        LOG_DEBUG("User '%s' cannot release semaphore of unknown room '%s'\n", username, room);
         return -2;  // Permission denied
     }
     
-    // Clear the current holder
-    memset(g_semaphore_state.current_holder, 0, sizeof(g_semaphore_state.current_holder));
+    uint32_t id = intern_holder(username, false);
+    uint64_t word = atomic_u64_load(&s->holder);
+    for (;;) {
+        // Validate ownership
+        if (id == 0 || HOLDER_ID(word) != id) {
+            LOG_DEBUG("User '%s' cannot release semaphore of room '%s' held by '%s'\n",
+                      username, s->name, holder_name(HOLDER_ID(word)));
+            return -2;  // Permission denied
+        }
     
-    // Release the mutex
-    mutex_unlock(&g_semaphore_state.write_mutex);
+        // Clear the current holder
+        uint64_t granted = atomic_u64_load(&s->granted_ns);
+        if (atomic_u64_cas(&s->holder, &word, HOLDER_WORD(HOLDER_GENERATION(word) + 1, 0))) {
+            record_hold(s, HOLDER_GENERATION(word), granted);
+            break;
+        }
+    }
+    publish_holder_event(EVENT_RELEASE, s, id, HOLDER_GENERATION(word) + 1, "released");
     
-    printf("User '%s' released writer semaphore\n", username);
+    LOG_DEBUG("User '%s' released writer semaphore for room '%s'\n", username, s->name);
+    dispatch_waiters(s);
     return 0;  // Success
 }
 
-// Get current semaphore status
-int get_semaphore_status(char *holder, int *value) {
+// Extend the holder's lease on a room (heartbeat or write). Lock-free;
+// returns 0 if username holds the room's semaphore, -2 if not.
+int semaphore_renew_lease(const char *room, const char *username) {
+    if (!g_initialized || username == NULL || username[0] == '\0') {
+        return -4;
+    }
+    
+    if (!semaphore_valid_room(room)) {
+        return -4;
+    }
+    
+    semaphore_state_t *s = find_room(room, false);
+    uint32_t id = intern_holder(username, false);
+    if (s == NULL || id == 0) {
+        return -2;  // Not the holder
+    }
+    
+    uint64_t word = atomic_u64_load(&s->holder);
+    if (HOLDER_ID(word) != id) {
+        return -2;  // Not the holder
+    }
+    
+    // Only ever extend this holder's own lease word: a release and a new
+    // holder's start_lease() may land between the load above and here
+    if (g_lease_ttl_ms > 0) {
+        uint64_t lease = atomic_u64_load(&s->lease);
+        while (LEASE_GENERATION(lease) == HOLDER_GENERATION(word)) {
+            uint64_t renewed = lease_word_from_now(HOLDER_GENERATION(word), g_lease_ttl_ms);
+            if (atomic_u64_cas(&s->lease, &lease, renewed)) {
+                return 0;
+            }
+        }
+        if (atomic_u64_load(&s->holder) != word) {
+            return -2;  // Released, or expired, since the check above
+        }
+        // Our start_lease() has not published yet; it grants a full lease
+    }
+    return 0;
+}
+
+// Milliseconds left on a state's lease, or -1 if there is none
+static int lease_remaining_ms(semaphore_state_t *s) {
+    if (g_lease_ttl_ms <= 0) {
+        return -1;
+    }
+    
+    uint64_t word = atomic_u64_load(&s->holder);
+    if (HOLDER_ID(word) == 0) {
+        return -1;
+    }
+    
+    uint64_t lease = atomic_u64_load(&s->lease);
+    if (LEASE_GENERATION(lease) != HOLDER_GENERATION(word)) {
+        return g_lease_ttl_ms;  // Lease not published yet
+    }
+    
+    long long remaining = lease_deadline_ms(lease) - monotonic_ms();
+    return remaining > 0 ? (int)remaining : 0;
+}
+
+// Milliseconds left on a room holder's lease, or -1 if there is none
+int semaphore_lease_remaining_ms(const char *room) {
+    if (!g_initialized) {
+        return -1;
+    }
+    
+    semaphore_state_t *s = lookup_room(room);
+    return s != NULL ? lease_remaining_ms(s) : -1;
+}
+
+// Set the holder lease length; call before init_semaphore(). 0 disables leases.
+void semaphore_set_lease_ttl(int seconds) {
+    g_lease_ttl_ms = seconds > 0 ? seconds * 1000 : 0;
+}
+
+// Get a room's semaphore status (a room nobody has used yet is free)
+int get_semaphore_status(const char *room, char *holder, int *value) {
     if (!g_initialized) {
-        fprintf(stderr, "Semaphore not initialized\n");
+        LOG_ERROR("Semaphore not initialized\n");
         return -1;
     }
     
     if (holder == NULL || value == NULL) {
-        fprintf(stderr, "Invalid parameters provided\n");
+        LOG_DEBUG("Invalid parameters provided\n");
         return -4;  // Invalid input
     }
     
-    // Check if there's a current holder
-    if (g_semaphore_state.current_holder[0] != '\0') {
+    if (!semaphore_valid_room(room)) {
+        LOG_DEBUG("Invalid room name provided\n");
+        return -4;  // Invalid input
+    }
+    
+    // One load gives a consistent holder/value pair
+    semaphore_state_t *s = find_room(room, false);
+    uint32_t id = s != NULL ? HOLDER_ID(atomic_u64_load(&s->holder)) : 0;
+    if (id != 0) {
         // Semaphore is held
         *value = 0;  // Locked
-        strncpy(holder, g_semaphore_state.current_holder, MAX_USERNAME_LEN - 1);
+        strncpy(holder, holder_name(id), MAX_USERNAME_LEN - 1);
         holder[MAX_USERNAME_LEN - 1] = '\0';
     } else {
         // Semaphore is available
@@ -149,57 +933,295 @@ int get_semaphore_status(char *holder, int *value) {
     return 0;  // Success
 }
 
-// Admin function to toggle writer access globally
+// Lock-free ownership check for write paths
+bool semaphore_is_holder(const char *room, const char *username) {
+    if (!g_initialized || username == NULL || username[0] == '\0') {
+        return false;
+    }
+    
+    semaphore_state_t *s = lookup_room(room);
+    uint32_t id = intern_holder(username, false);
+    return s != NULL && id != 0 && HOLDER_ID(atomic_u64_load(&s->holder)) == id;
+}
+
+// Number of rooms that have been used since startup
+int semaphore_room_count(void) {
+    return g_initialized ? (int)atomic_u32_load(&g_room_count) : 0;
+}
+
+// Render every room's holder, queue length and lease as JSON
+int semaphore_rooms_json(char *out_json, size_t size) {
+    if (out_json == NULL || size == 0) {
+        return -4;
+    }
+    
+    uint32_t count = g_initialized ? atomic_u32_load(&g_room_count) : 0;
+    size_t used = (size_t)snprintf(out_json, size, "{\"rooms\":%u,\"writer_enabled\":%s,\"semaphores\":[",
+                                   (unsigned)count,
+                                   atomic_u32_load(&g_writer_enabled) ? "true" : "false");
+    
+    for (uint32_t i = 0; i < count && used < size; i++) {
+        semaphore_state_t *s = g_room_list[i];
+        uint32_t id = HOLDER_ID(atomic_u64_load(&s->holder));
+        used += (size_t)snprintf(out_json + used, size - used,
+                                 "%s{\"room\":\"%s\",\"semaphore\":%d,\"holder\":\"%s\",\"waiting\":%u,\"lease_ms\":%d}",
+                                 i > 0 ? "," : "", s->name, id != 0 ? 0 : 1, holder_name(id),
+                                 (unsigned)atomic_u32_load(&s->waiters), lease_remaining_ms(s));
+    }
+    
+    if (used < size) {
+        used += (size_t)snprintf(out_json + used, size - used, "]}");
+    }
+    return used < size ? 0 : -5;
+}
+
+// Admin function to toggle writer access globally (every room)
 int admin_toggle_writer(bool enabled, const char *admin_user) {
     if (!g_initialized) {
-        fprintf(stderr, "Semaphore not initialized\n");
+        LOG_ERROR("Semaphore not initialized\n");
         return -1;
     }
     
     if (admin_user == NULL || strlen(admin_user) == 0) {
-        fprintf(stderr, "Invalid admin username provided\n");
+        LOG_DEBUG("Invalid admin username provided\n");
         return -4;  // Invalid input
     }
     
-    // Lock admin mutex to modify global state
-    mutex_lock(&g_semaphore_state.admin_mutex);
+    bool previous_state = atomic_u32_exchange(&g_writer_enabled, enabled ? 1 : 0) != 0;
     
-    bool previous_state = g_semaphore_state.writer_enabled;
-    g_semaphore_state.writer_enabled = enabled;
+    LOG_INFO("Admin '%s' %s writer access (was %s)\n",
+             admin_user,
+             enabled ? "enabled" : "disabled",
+             previous_state ? "enabled" : "disabled");
     
-    mutex_unlock(&g_semaphore_state.admin_mutex);
+    if (events_enabled()) {
+        strbuf_t data;
+        strbuf_init(&data);
+        json_writer_t json;
+        json_writer_init(&json, &data);
+        json_begin_object(&json);
+        json_key(&json, "writer_enabled");
+        json_raw(&json, enabled ? "true" : "false", enabled ? 4 : 5);
+        json_field_string(&json, "admin", admin_user);
+        json_end_object(&json);
+        if (json_writer_finish(&json) == 0) {
+            events_publish(EVENT_TOGGLE, data.data, data.len);
+        }
+        strbuf_free(&data);
+    }
     
-    printf("Admin '%s' %s writer access (was %s)\n", 
-           admin_user,
-           enabled ? "enabled" : "disabled",
-           previous_state ? "enabled" : "disabled");
+    if (enabled && !previous_state) {
+        // Writers queued while disabled may proceed
+        uint32_t count = atomic_u32_load(&g_room_count);
+        for (uint32_t i = 0; i < count; i++) {
+            dispatch_waiters(g_room_list[i]);
+        }
+    }
     
     return 0;  // Success
 }
 
+// ---------------------------------------------------------------------------
+// Warm restart
+//
+// A clean shutdown writes the writer toggle and every held room to a small
+// text file; the next start grants those rooms back to their holders for
+// what was left of their leases. A rolling restart then neither hands a
+// writer's room to someone else nor revives a holder that stopped renewing.
+// Deadlines are saved as wall-clock seconds, since monotonic time does not
+// outlive the process, so the downtime counts against the lease. Queued
+// waiters are not saved: their requests end with their connections.
+// ---------------------------------------------------------------------------
+
+#define STATE_FILE_MAGIC "chat-semaphore-state 1"
+
+// Grant a saved room back to its holder with lease_ms left
+static int restore_holder(const char *room, const char *username, int lease_ms) {
+    int valid = check_username(username);
+    if (valid != 0) {
+        return valid;
+    }
+    
+    semaphore_state_t *s;
+    int opened = open_room(room, &s);
+    if (opened != 0) {
+        return opened;
+    }
+    
+    uint32_t id = intern_holder(username, true);
+    if (id == 0) {
+        return -1;
+    }
+    
+    uint64_t word = atomic_u64_load(&s->holder);
+    if (HOLDER_ID(word) != 0 ||
+        !atomic_u64_cas(&s->holder, &word, HOLDER_WORD(HOLDER_GENERATION(word) + 1, id))) {
+        return -3;  // Already held (the file named the room twice)
+    }
+    start_lease(s, HOLDER_GENERATION(word) + 1, id, lease_ms);
+    return 0;
+}
+
+// Save the writer toggle and the rooms held, for semaphore_load_state() on
+// the next start (call before cleanup_semaphore()). Returns the number of
+// holders saved or -1.
+int semaphore_save_state(const char *path) {
+    if (!g_initialized || path == NULL) {
+        return -1;
+    }
+    
+    char temp_path[512];
+    if (snprintf(temp_path, sizeof(temp_path), "%s.tmp", path) >= (int)sizeof(temp_path)) {
+        return -1;
+    }
+    FILE *f = fopen(temp_path, "w");
+    if (f == NULL) {
+        LOG_WARN("Cannot write semaphore state %s\n", temp_path);
+        return -1;
+    }
+    
+    fprintf(f, "%s\nwriter_enabled %d\n", STATE_FILE_MAGIC, atomic_u32_load(&g_writer_enabled) ? 1 : 0);
+    long long now = (long long)time(NULL);
+    int saved = 0;
+    uint32_t count = atomic_u32_load(&g_room_count);
+    for (uint32_t i = 0; i < count; i++) {
+        semaphore_state_t *s = g_room_list[i];
+        uint32_t id = HOLDER_ID(atomic_u64_load(&s->holder));
+        if (id == 0) {
+            continue;
+        }
+        const char *username = holder_name(id);
+        if (strpbrk(username, "\t\r\n") != NULL) {
+            LOG_WARN("Not saving holder of room '%s': name does not fit the state file\n", s->name);
+            continue;
+        }
+    
+        // Rounded down to the second, so a restored lease never grows
+        int remaining = lease_remaining_ms(s);
+        fprintf(f, "%s\t%lld\t%s\n", s->name, remaining >= 0 ? now + remaining / 1000 : -1LL, username);
+        saved++;
+    }
+    
+    bool ok = !ferror(f);
+    ok = fclose(f) == 0 && ok;
+    if (!ok || platform_replace_file(temp_path, path) != 0) {
+        LOG_WARN("Failed to write semaphore state %s\n", path);
+        remove(temp_path);
+        return -1;
+    }
+    LOG_INFO("Saved %d writer semaphore holder(s) to %s\n", saved, path);
+    return saved;
+}
+
+// Restore what semaphore_save_state() saved (call after init_semaphore(),
+// before serving). Holders whose lease ran out while the daemon was down are
+// dropped. The file is removed once read, so a later crash cannot bring
+// back holders that have released since. Returns the holders restored, 0 if
+// there is no file, or -1 if it is not a state file.
+int semaphore_load_state(const char *path) {
+    if (!g_initialized || path == NULL) {
+        return -1;
+    }
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return 0;  // Nothing saved: first start, or the last one did not stop cleanly
+    }
+    
+    char line[MAX_ROOM_NAME_LEN + MAX_USERNAME_LEN + 32];
+    if (fgets(line, sizeof(line), f) == NULL || strcmp(line, STATE_FILE_MAGIC "\n") != 0) {
+        fclose(f);
+        LOG_WARN("Ignoring %s: not a semaphore state file\n", path);
+        return -1;
+    }
+    
+    long long now = (long long)time(NULL);
+    int restored = 0;
+    int expired = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        int enabled;
+        if (sscanf(line, "writer_enabled %d", &enabled) == 1) {
+            atomic_u32_store(&g_writer_enabled, enabled ? 1 : 0);
+            continue;
+        }
+    
+        // room \t deadline \t username
+        char *deadline_text = strchr(line, '\t');
+        char *username = deadline_text != NULL ? strchr(deadline_text + 1, '\t') : NULL;
+        if (username == NULL) {
+            continue;
+        }
+        *deadline_text++ = '\0';
+        *username++ = '\0';
+    
+        long long deadline = strtoll(deadline_text, NULL, 10);
+        int lease_ms = g_lease_ttl_ms;
+        if (deadline >= 0 && g_lease_ttl_ms > 0) {
+            long long left_ms = (deadline - now) * 1000;
+            if (left_ms <= 0) {
+                expired++;
+                continue;
+            }
+            if (left_ms < lease_ms) {
+                lease_ms = (int)left_ms;
+            }
+        }
+        if (restore_holder(line, username, lease_ms) == 0) {
+            LOG_DEBUG("Restored writer semaphore of room '%s' to '%s'\n", line, username);
+            restored++;
+        }
+    }
+    fclose(f);
+    remove(path);
+    
+    LOG_INFO("Restored %d writer semaphore holder(s) from %s (%d lease(s) ran out while stopped), "
+             "writer access %s\n", restored, path, expired,
+             atomic_u32_load(&g_writer_enabled) ? "enabled" : "disabled");
+    return restored;
+}
+
 // Cleanup semaphore resources
 void cleanup_semaphore(void) {
     if (!g_initialized) {
         return;
     }
     
-    // Force release if someone is holding the semaphore
-    if (g_semaphore_state.current_holder[0] != '\0') {
-        printf("Forcing release of semaphore held by '%s' during cleanup\n", 
-               g_semaphore_state.current_holder);
-        
-        // Clear holder
-        memset(g_semaphore_state.current_holder, 0, sizeof(g_semaphore_state.current_holder));
-        
-        // Unlock the mutex
-        mutex_unlock(&g_semaphore_state.write_mutex);
+    uint32_t count = atomic_u32_load(&g_room_count);
+    for (uint32_t i = 0; i < count; i++) {
+        semaphore_state_t *s = g_room_list[i];
+    
+        // Force release if someone is holding the semaphore
+        uint64_t word = atomic_u64_exchange(&s->holder, HOLDER_WORD(0, 0));
+        if (HOLDER_ID(word) != 0) {
+            LOG_INFO("Forcing release of room '%s' semaphore held by '%s' during cleanup\n",
+                     s->name, holder_name(HOLDER_ID(word)));
+        }
+    
+        timer_cancel(&s->lease_timer);
+    
+        // Fail everyone still waiting
+        mutex_lock(&s->wait_mutex);
+        waiter_t *pending = s->wait_head;
+        s->wait_head = s->wait_tail = NULL;
+        atomic_u32_store(&s->waiters, 0);
+        mutex_unlock(&s->wait_mutex);
+    
+        while (pending != NULL) {
+            waiter_t *next = pending->next;
+            finish_waiter(s, pending, -1);
+            pending = next;
+        }
+    
+        mutex_destroy(&s->wait_mutex);
+        atomic_u32_store(&s->published, 0);
     }
+    atomic_u32_store(&g_room_count, 0);
     
-    // Destroy mutexes
-    mutex_destroy(&g_semaphore_state.write_mutex);
-    mutex_destroy(&g_semaphore_state.admin_mutex);
+    // Destroy the room and name table locks
+    mutex_destroy(&g_room_mutex);
+    mutex_destroy(&g_intern_mutex);
     
     g_initialized = false;
     
-    printf("Semaphore manager cleanup complete\n");
-}
\ No newline at end of file
+    LOG_INFO("Semaphore manager cleanup complete\n");
+}
@@ -0,0 +1,369 @@
+// Storage Implementation
+// Dispatch of the storage API to the backend chosen at startup
+//
+// Every backend implements the whole API behind a storage_backend_t, so one
+// binary can run on SQLite, the file engine or the in-memory engine and
+// callers never know which. Commit, reader, retention and cache options are
+// validated and kept here and handed to the backend when it is initialized,
+// so they may be given before or after the backend is chosen.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "storage.h"
+#include "semaphore.h"
+#include "events.h"
+#include "json_writer.h"
+#include "search_index.h"
+#include "platform.h"
+#include "diag.h"
+
+static const storage_backend_t *const g_backends[] = {
+#ifndef STORAGE_NO_SQLITE
+    &storage_sqlite_backend,
+#endif
+    &storage_file_backend,
+    &storage_memory_backend,
+};
+
+static const storage_backend_t *g_backend = NULL;
+static bool g_backend_initialized = false;
+static int g_commit_window_ms = DB_DEFAULT_COMMIT_WINDOW_MS;
+static char g_synchronous[8] = DB_DEFAULT_SYNCHRONOUS;
+static int g_readers = DB_DEFAULT_READERS;
+static int g_log_retention_days = DB_DEFAULT_LOG_RETENTION_DAYS;
+static int g_cache_mb = DB_DEFAULT_CACHE_MB;
+static int g_mmap_mb = DB_DEFAULT_MMAP_MB;
+
+// Choose the backend by name ("sqlite", "file", "memory"); -4 if unknown
+int storage_select(const char *name) {
+    if (g_backend_initialized || name == NULL) {
+        return -4;
+    }
+    for (size_t i = 0; i < sizeof(g_backends) / sizeof(g_backends[0]); i++) {
+        if (strcmp(g_backends[i]->name, name) == 0) {
+            g_backend = g_backends[i];
+            return 0;
+        }
+    }
+    return -4;
+}
+
+const char *storage_backend_name(void) {
+    return g_backend != NULL ? g_backend->name : STORAGE_DEFAULT_BACKEND;
+}
+
+// Set group commit options before init_databases(). A window of 0 commits
+// every write on its own; synchronous is one of OFF, NORMAL, FULL, EXTRA.
+int db_configure_commit(int window_ms, const char *synchronous) {
+    if (window_ms < 0 || window_ms > DB_MAX_COMMIT_WINDOW_MS) {
+        return -4;
+    }
+    if (synchronous != NULL) {
+        if (strcmp(synchronous, "OFF") != 0 && strcmp(synchronous, "NORMAL") != 0 &&
+            strcmp(synchronous, "FULL") != 0 && strcmp(synchronous, "EXTRA") != 0) {
+            return -4;
+        }
+        strcpy(g_synchronous, synchronous);
+    }
+    g_commit_window_ms = window_ms;
+    return 0;
+}
+
+// Set the read-only connection pool size before init_databases(); 0 serves
+// reads from the writer connection. Backends without a pool ignore it.
+int db_configure_readers(int readers) {
+    if (readers < 0 || readers > DB_MAX_READERS) {
+        return -4;
+    }
+    g_readers = readers;
+    return 0;
+}
+
+// Set how many days of audit log to keep before init_databases(); 0 keeps
+// everything. Backends without log partitions ignore it.
+int db_configure_log_retention(int days) {
+    if (days < 0 || days > DB_MAX_LOG_RETENTION_DAYS) {
+        return -4;
+    }
+    g_log_retention_days = days;
+    return 0;
+}
+
+// Set the page cache of each connection and how much of the database is
+// read through mmap before init_databases(); the larger of the two is also
+// how much of the files is read ahead at startup. 0 leaves SQLite's default
+// cache, or turns mmap off. Backends without files to warm ignore it.
+int db_configure_cache(int cache_mb, int mmap_mb) {
+    if (cache_mb < 0 || cache_mb > DB_MAX_CACHE_MB || mmap_mb < 0 || mmap_mb > DB_MAX_MMAP_MB) {
+        return -4;
+    }
+    g_cache_mb = cache_mb;
+    g_mmap_mb = mmap_mb;
+    return 0;
+}
+
+int init_databases(const char *chat_db_path, const char *log_db_path) {
+    if (g_backend_initialized) {
+        return 0;
+    }
+    if (g_backend == NULL && storage_select(STORAGE_DEFAULT_BACKEND) != 0) {
+        return -1;
+    }
+
+    LOG_INFO("Storage backend: %s\n", g_backend->name);
+    g_backend->configure_commit(g_commit_window_ms, g_synchronous);
+    if (g_backend->configure_readers != NULL) {
+        g_backend->configure_readers(g_readers);
+    }
+    if (g_backend->configure_log_retention != NULL) {
+        g_backend->configure_log_retention(g_log_retention_days);
+    }
+    if (g_backend->configure_cache != NULL) {
+        g_backend->configure_cache(g_cache_mb, g_mmap_mb);
+    }
+    if (g_backend->init(chat_db_path, log_db_path) != 0) {
+        return -1;
+    }
+    g_backend_initialized = true;
+    return 0;
+}
+
+// Before init_databases() there is no backend to answer
+static bool backend_ready(void) {
+    if (!g_backend_initialized) {
+        LOG_ERROR("Database not initialized\n");
+        return false;
+    }
+    return true;
+}
+
+int create_message(const char *room, const char *username, const char *message, char *out_timestamp) {
+    if (!backend_ready()) {
+        return -1;
+    }
+    return g_backend->create_message(room, username, message, out_timestamp);
+}
+
+int create_message_batch(const char *room, const char *username, const char *const *messages,
+                         int count, message_ref_t *out_refs) {
+    if (!backend_ready()) {
+        return -1;
+    }
+    return g_backend->create_message_batch(room, username, messages, count, out_refs);
+}
+
+int update_message(const char *room, int id, const char *username, const char *message) {
+    if (!backend_ready()) {
+        return -1;
+    }
+    return g_backend->update_message(room, id, username, message);
+}
+
+int delete_message(const char *room, int id, const char *username) {
+    if (!backend_ready()) {
+        return -1;
+    }
+    return g_backend->delete_message(room, id, username);
+}
+
+int list_messages(const char *room, int page, int limit, const char *before, const char *after,
+                  strbuf_t *out) {
+    if (!backend_ready()) {
+        return -1;
+    }
+    return g_backend->list_messages(room, page, limit, before, after, out);
+}
+
+// Messages containing every word of query, best match first, from one room
+// or (room NULL) every room. The page is appended to out as
+// {"query", "total", "page", "limit", "complete", "hits": [...]}; complete is
+// false while the index is still catching up with messages stored before
+// startup. -4 if the query has no words or the page is out of range.
+int search_messages(const char *room, const char *query, int page, int limit, strbuf_t *out) {
+    if (!backend_ready()) {
+        return -1;
+    }
+    char terms[SEARCH_MAX_QUERY_TERMS][SEARCH_MAX_TERM_LEN + 1];
+    if (query == NULL || out == NULL || strlen(query) > SEARCH_MAX_QUERY_LEN ||
+        search_query_terms(query, terms) == 0) {
+        LOG_DEBUG("Invalid search query\n");
+        return -4;
+    }
+    if (page < 1 || limit < 1 || limit > 100 || page > SEARCH_MAX_PAGE) {
+        LOG_DEBUG("Invalid page or limit parameters\n");
+        return -4;
+    }
+    if (room != NULL && (room[0] == '\0' || !semaphore_valid_room(room))) {
+        LOG_DEBUG("Invalid room name for search_messages\n");
+        return -4;
+    }
+    return g_backend->search_messages(room, query, page, limit, out);
+}
+
+// Messages created, edited or deleted after change sequence number since,
+// from one room or (room NULL) every room, in sequence order. Each entry is
+// the message as it stands now ("op":"upsert") or a tombstone
+// ("op":"delete"). The page is appended to out as {"changes", "next_since",
+// "has_more"}; next_since is what to pass as since for the next page. -3 if
+// the backend keeps no change sequence.
+int get_changes(const char *room, long long since, int limit, strbuf_t *out) {
+    if (!backend_ready()) {
+        return -1;
+    }
+    if (g_backend->get_changes == NULL) {
+        return -3;
+    }
+    if (out == NULL || since < 0 || limit < 1 || limit > DB_MAX_CHANGES_LIMIT) {
+        LOG_DEBUG("Invalid since or limit parameters\n");
+        return -4;
+    }
+    if (room != NULL && (room[0] == '\0' || !semaphore_valid_room(room))) {
+        LOG_DEBUG("Invalid room name for get_changes\n");
+        return -4;
+    }
+    return g_backend->get_changes(room, since, limit, out);
+}
+
+int get_logs(int page, int limit, const char *before, const char *after, strbuf_t *out) {
+    if (!backend_ready()) {
+        return -1;
+    }
+    return g_backend->get_logs(page, limit, before, after, out);
+}
+
+int insert_log_entry(const char *action, const char *user, const char *content, int semaphore_value) {
+    if (!g_backend_initialized) {
+        return -1;
+    }
+    return g_backend->insert_log_entry(action, user, content, semaphore_value);
+}
+
+int insert_log_entries(const log_entry_t *entries, int count) {
+    if (!g_backend_initialized) {
+        return -1;
+    }
+    return g_backend->insert_log_entries(entries, count);
+}
+
+void cleanup_databases(void) {
+    if (!g_backend_initialized) {
+        return;
+    }
+    g_backend->cleanup();
+    g_backend_initialized = false;
+}
+
+// --- Helpers shared by the backends ---
+
+// Generate ISO 8601 timestamp
+void get_current_timestamp(char *timestamp, size_t size) {
+    time_t now = time(NULL);
+    struct tm utc_tm;
+    platform_gmtime(now, &utc_tm);
+    strftime(timestamp, size, "%Y-%m-%dT%H:%M:%S", &utc_tm);
+}
+
+// Rooms are stored by name; requests that name none write to the default room
+const char *storage_room_or_default(const char *room) {
+    return room != NULL && room[0] != '\0' ? room : SEMAPHORE_DEFAULT_ROOM;
+}
+
+// Helper function to validate semaphore ownership for write operations
+int validate_semaphore_ownership(const char *room, const char *username) {
+    // Fast path: one atomic load of the room's holder word; a write also
+    // renews the holder's lease
+    if (semaphore_renew_lease(room, username) == 0) {
+        return 0;  // Ownership validated
+    }
+
+    // Slow path only explains why the check failed
+    char current_holder[MAX_USERNAME_LEN];
+    int semaphore_value;
+
+    int status = get_semaphore_status(room, current_holder, &semaphore_value);
+    if (status != 0) {
+        LOG_ERROR("Failed to get semaphore status\n");
+        return -1;  // General error
+    }
+
+    // Check if semaphore is available (value = 1 means no one holds it)
+    if (semaphore_value == 1) {
+        LOG_DEBUG("No writer currently holds the semaphore for room '%s'\n",
+                storage_room_or_default(room));
+        return -2;  // Permission denied
+    }
+
+    // Check if the requesting user is the current holder
+    if (strcmp(current_holder, username) != 0) {
+        LOG_DEBUG("User '%s' does not hold the semaphore for room '%s' (held by '%s')\n",
+                username, storage_room_or_default(room), current_holder);
+        return -2;  // Permission denied
+    }
+
+    return 0;  // Ownership validated
+}
+
+// Publish a stored change to event-stream subscribers. message is NULL
+// for deletes and created_at for anything but creates.
+static void publish_message_event(event_type_t type, long long id, const char *room, const char *username,
+                                  const char *message, const char *created_at) {
+    if (!events_enabled()) {
+        return;
+    }
+
+    strbuf_t data;
+    strbuf_init(&data);
+    json_writer_t json;
+    json_writer_init(&json, &data);
+    json_begin_object(&json);
+    json_field_int(&json, "id", id);
+    json_field_string(&json, "room", storage_room_or_default(room));
+    json_field_string(&json, "username", username);
+    if (message != NULL) {
+        json_field_string(&json, "message", message);
+    }
+    if (created_at != NULL) {
+        json_field_string(&json, "created_at", created_at);
+    }
+    json_end_object(&json);
+    if (json_writer_finish(&json) == 0) {
+        events_publish(type, data.data, data.len);
+    }
+    strbuf_free(&data);
+}
+
+// Called by a backend once a write has been committed
+void storage_publish_created(long long id, const char *room, const char *username, const char *message,
+                             const char *created_at) {
+    publish_message_event(EVENT_MESSAGE_CREATED, id, room, username, message, created_at);
+}
+
+void storage_publish_updated(int id, const char *room, const char *username, const char *message) {
+    publish_message_event(EVENT_MESSAGE_UPDATED, id, room, username, message, NULL);
+}
+
+void storage_publish_deleted(int id, const char *room, const char *username) {
+    publish_message_event(EVENT_MESSAGE_DELETED, id, room, username, NULL, NULL);
+}
+
+// Split a "<created_at>,<id>" paging cursor; 0 on success
+int storage_parse_page_cursor(const char *cursor, char *ts, size_t ts_size, int *id) {
+    const char *comma = strrchr(cursor, ',');
+    if (comma == NULL || comma == cursor || (size_t)(comma - cursor) >= ts_size) {
+        return -1;
+    }
+
+    char *end = NULL;
+    long value = strtol(comma + 1, &end, 10);
+    if (end == comma + 1 || *end != '\0' || value < 1 || value > 0x7FFFFFFF) {
+        return -1;
+    }
+
+    memcpy(ts, cursor, (size_t)(comma - cursor));
+    ts[comma - cursor] = '\0';
+    *id = (int)value;
+    return 0;
+}
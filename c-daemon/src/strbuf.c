@@ -0,0 +1,139 @@
+// String Buffer Implementation
+// Growable byte buffer for building responses without fixed-size caps
+//
+// Appends amortize to O(1) by doubling the capacity. A failed allocation is
+// sticky: later appends do nothing and return -1, so a builder can make a
+// run of calls and check the result once at the end.
+//
+// A buffer bound to an arena grows there instead, usually in place, and
+// is dropped with the arena; only strbuf_detach() copies it to the heap.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "strbuf.h"
+
+void strbuf_init(strbuf_t *sb) {
+    sb->data = NULL;
+    sb->len = 0;
+    sb->cap = 0;
+    sb->failed = 0;
+    sb->arena = NULL;
+}
+
+// Scratch buffer for one request, released by the arena's reset
+void strbuf_init_arena(strbuf_t *sb, arena_t *arena) {
+    strbuf_init(sb);
+    sb->arena = arena;
+}
+
+// Make room for extra more bytes plus the terminating NUL
+int strbuf_reserve(strbuf_t *sb, size_t extra) {
+    if (sb->failed) {
+        return -1;
+    }
+
+    size_t needed = sb->len + extra + 1;
+    if (needed <= sb->cap) {
+        return 0;
+    }
+
+    size_t new_cap = sb->cap ? sb->cap : STRBUF_MIN_CAPACITY;
+    while (new_cap < needed) {
+        new_cap *= 2;
+    }
+
+    char *grown = sb->arena != NULL ? arena_grow(sb->arena, sb->data, sb->cap, new_cap)
+                                    : realloc(sb->data, new_cap);
+    if (grown == NULL) {
+        sb->failed = 1;
+        return -1;
+    }
+    sb->data = grown;
+    sb->cap = new_cap;
+    return 0;
+}
+
+int strbuf_append(strbuf_t *sb, const void *data, size_t len) {
+    if (strbuf_reserve(sb, len) != 0) {
+        return -1;
+    }
+    memcpy(sb->data + sb->len, data, len);
+    sb->len += len;
+    sb->data[sb->len] = '\0';
+    return 0;
+}
+
+int strbuf_append_str(strbuf_t *sb, const char *str) {
+    return strbuf_append(sb, str, strlen(str));
+}
+
+// Append formatted text, formatting straight into the buffer's spare room
+int strbuf_printf(strbuf_t *sb, const char *fmt, ...) {
+    if (strbuf_reserve(sb, 0) != 0) {
+        return -1;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    int needed = vsnprintf(sb->data + sb->len, sb->cap - sb->len, fmt, args);
+    va_end(args);
+
+    if (needed < 0) {
+        sb->data[sb->len] = '\0';
+        return -1;
+    }
+
+    if ((size_t)needed >= sb->cap - sb->len) {
+        // Did not fit: grow once to the exact size and format again
+        if (strbuf_reserve(sb, (size_t)needed) != 0) {
+            return -1;
+        }
+        va_start(args, fmt);
+        vsnprintf(sb->data + sb->len, sb->cap - sb->len, fmt, args);
+        va_end(args);
+    }
+
+    sb->len += (size_t)needed;
+    return 0;
+}
+
+// Drop everything after the first len bytes
+void strbuf_truncate(strbuf_t *sb, size_t len) {
+    if (len < sb->len) {
+        sb->len = len;
+        sb->data[len] = '\0';
+    }
+}
+
+// Hand the heap block to the caller (free() it) and leave sb empty. An
+// arena-backed buffer is copied out; NULL (and *out_len 0) if that fails.
+char *strbuf_detach(strbuf_t *sb, size_t *out_len) {
+    char *data = sb->data;
+    size_t len = sb->len;
+    arena_t *arena = sb->arena;
+    if (arena != NULL && data != NULL) {
+        data = malloc(len + 1);
+        if (data != NULL) {
+            memcpy(data, sb->data, len + 1);
+        } else {
+            len = 0;
+        }
+    }
+    if (out_len != NULL) {
+        *out_len = len;
+    }
+    strbuf_init_arena(sb, arena);
+    return data;
+}
+
+// Empty the buffer; one bound to an arena stays bound to it
+void strbuf_free(strbuf_t *sb) {
+    arena_t *arena = sb->arena;
+    if (arena == NULL) {
+        free(sb->data);
+    }
+    strbuf_init_arena(sb, arena);
+}
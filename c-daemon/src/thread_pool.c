@@ -0,0 +1,351 @@
+// Worker Thread Pool Implementation
+// Fixed-size worker pool with per-worker deques and work stealing
+//
+// Each worker owns a bounded deque. Submissions are spread round-robin;
+// a worker runs tasks from the front of its own deque and, when that is
+// empty, steals the oldest task from the front of a sibling's deque so one
+// slow task (e.g. a large SQLite page) does not hold up the requests queued
+// behind it, and those requests still start in the order they arrived.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "thread_pool.h"
+#include "platform.h"
+#include "arena.h"
+#include "diag.h"
+
+#define STEAL_POLL_MS 50   // Idle workers re-check siblings at least this often
+
+typedef struct {
+    task_fn_t fn;
+    void *arg;
+} task_t;
+
+typedef struct {
+    mutex_t lock;                  // Protects every field below
+    cond_t wake;
+    task_t *tasks;                 // Ring buffer, capacity entries
+    int capacity;
+    int head;                      // Oldest queued task
+    int count;
+    bool sleeping;
+    bool stopping;
+    unsigned long executed;
+    unsigned long stolen;
+    int index;
+    thread_t thread;
+} worker_t;
+
+// Global pool state
+static worker_t *g_workers = NULL;
+static int g_num_workers = 0;
+static int g_queue_capacity = 0;
+static mutex_t g_rr_lock;          // Protects g_next_worker
+static int g_next_worker = 0;
+static bool g_pool_initialized = false;
+
+// ---------------------------------------------------------------------------
+// Deque operations (caller holds w->lock)
+// ---------------------------------------------------------------------------
+
+static bool deque_push_back(worker_t *w, task_t task) {
+    if (w->count == w->capacity) {
+        return false;
+    }
+    w->tasks[(w->head + w->count) % w->capacity] = task;
+    w->count++;
+    return true;
+}
+
+static bool deque_pop_front(worker_t *w, task_t *out) {
+    if (w->count == 0) {
+        return false;
+    }
+    *out = w->tasks[w->head];
+    w->head = (w->head + 1) % w->capacity;
+    w->count--;
+    return true;
+}
+
+// Take the oldest task from the first sibling deque that has work
+static bool steal_task(worker_t *self, task_t *out) {
+    for (int i = 1; i < g_num_workers; i++) {
+        worker_t *victim = &g_workers[(self->index + i) % g_num_workers];
+
+        mutex_lock(&victim->lock);
+        bool stolen = deque_pop_front(victim, out);
+        mutex_unlock(&victim->lock);
+
+        if (stolen) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Wake one sleeping worker other than busy so it can steal queued work
+static void wake_idle_thief(worker_t *busy) {
+    for (int i = 1; i < g_num_workers; i++) {
+        worker_t *w = &g_workers[(busy->index + i) % g_num_workers];
+
+        mutex_lock(&w->lock);
+        bool sleeping = w->sleeping;
+        if (sleeping) {
+            cond_signal(&w->wake);
+        }
+        mutex_unlock(&w->lock);
+
+        if (sleeping) {
+            return;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Worker thread
+// ---------------------------------------------------------------------------
+
+static void *worker_main(void *arg) {
+    worker_t *self = (worker_t *)arg;
+    unsigned long ran = 0;         // Counters are folded in under the next lock
+    unsigned long ran_stolen = 0;
+
+    for (;;) {
+        task_t task;
+
+        mutex_lock(&self->lock);
+        self->executed += ran;
+        self->stolen += ran_stolen;
+        ran = ran_stolen = 0;
+        bool have_task = deque_pop_front(self, &task);
+        bool stopping = self->stopping;
+        mutex_unlock(&self->lock);
+
+        bool was_stolen = false;
+        if (!have_task && g_num_workers > 1) {
+            have_task = steal_task(self, &task);
+            was_stolen = have_task;
+        }
+
+        if (have_task) {
+            task.fn(task.arg);
+            request_arena_reset();  // Whatever the task allocated per request
+            ran++;
+            if (was_stolen) {
+                ran_stolen++;
+            }
+            continue;
+        }
+
+        if (stopping) {
+            break;  // Queue drained and shutdown requested
+        }
+
+        mutex_lock(&self->lock);
+        if (self->count == 0 && !self->stopping) {
+            self->sleeping = true;
+            cond_timedwait_ms(&self->wake, &self->lock, STEAL_POLL_MS);
+            self->sleeping = false;
+        }
+        mutex_unlock(&self->lock);
+    }
+
+    request_arena_release();
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Public API
+// ---------------------------------------------------------------------------
+
+// Start num_workers threads, each with a deque of queue_capacity tasks
+int thread_pool_init(int num_workers, int queue_capacity) {
+    if (g_pool_initialized) {
+        return 0;  // Already initialized
+    }
+
+    if (num_workers < 1 || num_workers > THREAD_POOL_MAX_WORKERS || queue_capacity < 1) {
+        LOG_ERROR("Invalid thread pool size (%d workers, depth %d)\n",
+                num_workers, queue_capacity);
+        return -4;
+    }
+
+    g_workers = calloc((size_t)num_workers, sizeof(worker_t));
+    if (g_workers == NULL) {
+        LOG_ERROR("Failed to allocate thread pool\n");
+        return -1;
+    }
+
+    g_num_workers = num_workers;
+    g_queue_capacity = queue_capacity;
+    g_next_worker = 0;
+    mutex_init(&g_rr_lock);
+
+    for (int i = 0; i < num_workers; i++) {
+        worker_t *w = &g_workers[i];
+        w->index = i;
+        w->capacity = queue_capacity;
+        w->tasks = calloc((size_t)queue_capacity, sizeof(task_t));
+        if (w->tasks == NULL) {
+            LOG_ERROR("Failed to allocate queue for worker %d\n", i);
+            while (i-- > 0) {
+                free(g_workers[i].tasks);
+            }
+            free(g_workers);
+            g_workers = NULL;
+            mutex_destroy(&g_rr_lock);
+            return -1;
+        }
+        mutex_init(&w->lock);
+        cond_init(&w->wake);
+    }
+
+    // Flag first so shutdown can join a partially started pool
+    g_pool_initialized = true;
+
+    for (int i = 0; i < num_workers; i++) {
+        if (thread_create(&g_workers[i].thread, worker_main, &g_workers[i]) != 0) {
+            LOG_ERROR("Failed to start worker thread %d\n", i);
+            for (int j = i; j < num_workers; j++) {
+                free(g_workers[j].tasks);  // Never started, shutdown only joins [0, i)
+                mutex_destroy(&g_workers[j].lock);
+                cond_destroy(&g_workers[j].wake);
+            }
+            g_num_workers = i;
+            thread_pool_shutdown();
+            return -1;
+        }
+    }
+
+    LOG_INFO("Thread pool initialized (%d workers, queue depth %d)\n",
+             num_workers, queue_capacity);
+    return 0;
+}
+
+// Queue a task. Returns 0 on success, -3 when every deque is full.
+int thread_pool_submit(task_fn_t fn, void *arg) {
+    if (!g_pool_initialized) {
+        LOG_ERROR("Thread pool not initialized\n");
+        return -1;
+    }
+
+    if (fn == NULL) {
+        return -4;
+    }
+
+    mutex_lock(&g_rr_lock);
+    int start = g_next_worker;
+    g_next_worker = (g_next_worker + 1) % g_num_workers;
+    mutex_unlock(&g_rr_lock);
+
+    task_t task = { fn, arg };
+    for (int i = 0; i < g_num_workers; i++) {
+        worker_t *w = &g_workers[(start + i) % g_num_workers];
+
+        mutex_lock(&w->lock);
+        bool queued = !w->stopping && deque_push_back(w, task);
+        bool was_sleeping = queued && w->sleeping;
+        if (was_sleeping) {
+            cond_signal(&w->wake);
+        }
+        mutex_unlock(&w->lock);
+
+        if (queued) {
+            if (!was_sleeping && g_num_workers > 1) {
+                wake_idle_thief(w);  // Owner is busy, let a sibling take it
+            }
+            return 0;
+        }
+    }
+
+    return -3;  // Resource unavailable
+}
+
+int thread_pool_size(void) {
+    return g_pool_initialized ? g_num_workers : 0;
+}
+
+// Tasks currently waiting in one worker's deque (-4 for a bad index)
+int thread_pool_queue_depth(int worker) {
+    if (!g_pool_initialized || worker < 0 || worker >= g_num_workers) {
+        return -4;
+    }
+
+    mutex_lock(&g_workers[worker].lock);
+    int depth = g_workers[worker].count;
+    mutex_unlock(&g_workers[worker].lock);
+    return depth;
+}
+
+int thread_pool_get_stats(int worker, worker_stats_t *out) {
+    if (!g_pool_initialized || out == NULL || worker < 0 || worker >= g_num_workers) {
+        return -4;
+    }
+
+    worker_t *w = &g_workers[worker];
+    mutex_lock(&w->lock);
+    out->queue_depth = w->count;
+    out->queue_capacity = w->capacity;
+    out->executed = w->executed;
+    out->stolen = w->stolen;
+    mutex_unlock(&w->lock);
+    return 0;
+}
+
+// Render per-worker queue depths and counters as JSON
+int thread_pool_stats_json(char *out_json, size_t size) {
+    if (out_json == NULL || size == 0) {
+        return -4;
+    }
+
+    size_t used = (size_t)snprintf(out_json, size,
+                                   "{\"workers\":%d,\"queue_capacity\":%d,\"queues\":[",
+                                   thread_pool_size(), g_queue_capacity);
+
+    for (int i = 0; i < thread_pool_size() && used < size; i++) {
+        worker_stats_t stats;
+        thread_pool_get_stats(i, &stats);
+        used += (size_t)snprintf(out_json + used, size - used,
+                                 "%s{\"worker\":%d,\"depth\":%d,\"executed\":%lu,\"stolen\":%lu}",
+                                 i > 0 ? "," : "", i, stats.queue_depth,
+                                 stats.executed, stats.stolen);
+    }
+
+    if (used < size) {
+        used += (size_t)snprintf(out_json + used, size - used, "]}");
+    }
+    return used < size ? 0 : -5;
+}
+
+// Finish queued work, stop every worker and free the pool
+void thread_pool_shutdown(void) {
+    if (!g_pool_initialized) {
+        return;
+    }
+
+    for (int i = 0; i < g_num_workers; i++) {
+        mutex_lock(&g_workers[i].lock);
+        g_workers[i].stopping = true;
+        cond_signal(&g_workers[i].wake);
+        mutex_unlock(&g_workers[i].lock);
+    }
+
+    for (int i = 0; i < g_num_workers; i++) {
+        thread_join(g_workers[i].thread);
+    }
+
+    for (int i = 0; i < g_num_workers; i++) {
+        mutex_destroy(&g_workers[i].lock);
+        cond_destroy(&g_workers[i].wake);
+        free(g_workers[i].tasks);
+    }
+
+    free(g_workers);
+    g_workers = NULL;
+    g_num_workers = 0;
+    mutex_destroy(&g_rr_lock);
+    g_pool_initialized = false;
+    LOG_INFO("Thread pool shutdown complete\n");
+}
@@ -0,0 +1,250 @@
+// Timer Wheel Implementation
+// Hierarchical timing wheel: O(1) schedule, cancel and per-tick expiry
+//
+// Level 0 holds timers due within the next 64 ticks, one slot per tick.
+// Each higher level covers 64 times the span of the one below; when level 0
+// wraps, the next slot of level 1 is cascaded down (and so on upwards), so
+// no timer is ever inspected before it is nearly due.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "timer_wheel.h"
+#include "platform.h"
+#include "diag.h"
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define MAX_DELAY_TICKS ((1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+// Each slot is a circular list around a sentinel entry
+static timer_entry_t g_slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+static uint64_t g_current_tick = 0;      // Last tick that has been processed
+static long long g_base_ms = 0;          // monotonic_ms() at tick 0
+static int g_pending_count = 0;
+static mutex_t g_wheel_lock;             // Protects everything above
+static bool g_wheel_initialized = false;
+
+static void list_unlink(timer_entry_t *timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = timer->prev = NULL;
+}
+
+static void list_append(timer_entry_t *head, timer_entry_t *timer) {
+    timer->prev = head->prev;
+    timer->next = head;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+// File a pending timer into the slot that matches its distance (lock held)
+static void wheel_insert(timer_entry_t *timer) {
+    // Only a cascade can file a timer for the tick being processed, and that
+    // slot is drained right after the cascade
+    if (timer->expires < g_current_tick) {
+        timer->expires = g_current_tick;
+    }
+
+    uint64_t delta = timer->expires - g_current_tick;
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 &&
+           delta >= (1ULL << (TIMER_WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+
+    int slot = (int)((timer->expires >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK);
+    list_append(&g_slots[level][slot], timer);
+}
+
+// Re-file every timer of one higher-level slot into the levels below
+static void wheel_cascade(int level, int slot) {
+    timer_entry_t *head = &g_slots[level][slot];
+    while (head->next != head) {
+        timer_entry_t *timer = head->next;
+        list_unlink(timer);
+        wheel_insert(timer);
+    }
+}
+
+static uint64_t ms_to_tick(long long ms) {
+    return ms <= g_base_ms ? 0 : (uint64_t)((ms - g_base_ms) / TIMER_TICK_MS);
+}
+
+int timer_wheel_init(void) {
+    if (g_wheel_initialized) {
+        return 0;  // Already initialized
+    }
+
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            g_slots[level][slot].next = g_slots[level][slot].prev = &g_slots[level][slot];
+        }
+    }
+
+    mutex_init(&g_wheel_lock);
+    g_base_ms = monotonic_ms();
+    g_current_tick = 0;
+    g_pending_count = 0;
+    g_wheel_initialized = true;
+
+    LOG_INFO("Timer wheel initialized (%d ms tick, %d levels)\n",
+             TIMER_TICK_MS, TIMER_WHEEL_LEVELS);
+    return 0;
+}
+
+void timer_init(timer_entry_t *timer, timer_callback_t callback, void *arg) {
+    memset(timer, 0, sizeof(*timer));
+    timer->callback = callback;
+    timer->arg = arg;
+}
+
+// Arm (or re-arm) a timer to fire delay_ms from now. Thread-safe.
+void timer_schedule(timer_entry_t *timer, long long delay_ms) {
+    if (!g_wheel_initialized || timer == NULL || timer->callback == NULL) {
+        return;
+    }
+
+    long long delay_ticks = (delay_ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+    if (delay_ticks < 1) {
+        delay_ticks = 1;
+    }
+    if ((uint64_t)delay_ticks > MAX_DELAY_TICKS) {
+        delay_ticks = (long long)MAX_DELAY_TICKS;
+    }
+
+    mutex_lock(&g_wheel_lock);
+    if (timer->pending) {
+        list_unlink(timer);
+        g_pending_count--;
+    }
+    // Count from wall time, not the last processed tick, so a late advance
+    // does not shorten the delay
+    uint64_t now_tick = ms_to_tick(monotonic_ms());
+    timer->expires = (now_tick > g_current_tick ? now_tick : g_current_tick) + (uint64_t)delay_ticks;
+    timer->pending = true;
+    wheel_insert(timer);
+    g_pending_count++;
+    mutex_unlock(&g_wheel_lock);
+}
+
+// Disarm a timer. Thread-safe; a no-op if it is not pending.
+void timer_cancel(timer_entry_t *timer) {
+    if (!g_wheel_initialized || timer == NULL) {
+        return;
+    }
+
+    mutex_lock(&g_wheel_lock);
+    if (timer->pending) {
+        list_unlink(timer);
+        timer->pending = false;
+        g_pending_count--;
+    }
+    mutex_unlock(&g_wheel_lock);
+}
+
+bool timer_pending(timer_entry_t *timer) {
+    if (!g_wheel_initialized || timer == NULL) {
+        return false;
+    }
+
+    mutex_lock(&g_wheel_lock);
+    bool pending = timer->pending;
+    mutex_unlock(&g_wheel_lock);
+    return pending;
+}
+
+// Run every timer that is now due. Returns milliseconds until the wheel next
+// needs attention, or -1 if no timers are pending.
+int timer_wheel_advance(void) {
+    if (!g_wheel_initialized) {
+        return -1;
+    }
+
+    timer_entry_t expired;
+    expired.next = expired.prev = &expired;
+
+    mutex_lock(&g_wheel_lock);
+    uint64_t target = ms_to_tick(monotonic_ms());
+    while (g_current_tick < target) {
+        g_current_tick++;
+
+        // Level 0 wrapped: pull the next span down from the level above
+        int level = 0;
+        while (level < TIMER_WHEEL_LEVELS - 1 &&
+               ((g_current_tick >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK) == 0) {
+            level++;
+            wheel_cascade(level, (int)((g_current_tick >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK));
+        }
+
+        // Due timers stay pending on a private list until their callback
+        // starts, so a racing schedule or cancel can still pull them back
+        timer_entry_t *head = &g_slots[0][g_current_tick & SLOT_MASK];
+        while (head->next != head) {
+            timer_entry_t *timer = head->next;
+            list_unlink(timer);
+            list_append(&expired, timer);
+        }
+    }
+    mutex_unlock(&g_wheel_lock);
+
+    // Callbacks run unlocked so they may schedule or cancel timers
+    for (;;) {
+        mutex_lock(&g_wheel_lock);
+        timer_entry_t *timer = expired.next != &expired ? expired.next : NULL;
+        if (timer != NULL) {
+            list_unlink(timer);
+            timer->pending = false;
+            g_pending_count--;
+        }
+        mutex_unlock(&g_wheel_lock);
+
+        if (timer == NULL) {
+            break;
+        }
+        timer->callback(timer->arg);
+    }
+
+    // Time to the next occupied level-0 slot, or to the next cascade
+    int next_ms = -1;
+    mutex_lock(&g_wheel_lock);
+    if (g_pending_count > 0) {
+        int ticks = TIMER_WHEEL_SLOTS - (int)(g_current_tick & SLOT_MASK);
+        for (int i = 1; i < ticks; i++) {
+            timer_entry_t *head = &g_slots[0][(g_current_tick + (uint64_t)i) & SLOT_MASK];
+            if (head->next != head) {
+                ticks = i;
+                break;
+            }
+        }
+        long long due_ms = g_base_ms + (long long)(g_current_tick + (uint64_t)ticks) * TIMER_TICK_MS;
+        long long wait_ms = due_ms - monotonic_ms();
+        next_ms = wait_ms > 0 ? (int)wait_ms : 0;
+    }
+    mutex_unlock(&g_wheel_lock);
+
+    return next_ms;
+}
+
+void timer_wheel_cleanup(void) {
+    if (!g_wheel_initialized) {
+        return;
+    }
+
+    // Pending timers belong to their owners; just detach them
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            timer_entry_t *head = &g_slots[level][slot];
+            while (head->next != head) {
+                timer_entry_t *timer = head->next;
+                list_unlink(timer);
+                timer->pending = false;
+            }
+        }
+    }
+
+    mutex_destroy(&g_wheel_lock);
+    g_pending_count = 0;
+    g_wheel_initialized = false;
+    LOG_INFO("Timer wheel cleanup complete\n");
+}
@@ -1,13 +1,32 @@
 // C Daemon Communication Bridge
 const net = require('net');
+const http = require('http');
 const EventEmitter = require('events');
 const fetch = require('node-fetch');
 
+// Binary command frames spoken on the daemon's command socket (see
+// c-daemon/include/handlers.h). Integers are big-endian.
+const COMMAND_TYPES = [
+    'TRY_ACQUIRE', 'ACQUIRE_WAIT', 'RELEASE', 'HEARTBEAT', 'CREATE_MESSAGE', 'CREATE_BATCH',
+    'UPDATE_MESSAGE', 'DELETE_MESSAGE', 'LIST_MESSAGES', 'GET_STATUS', 'GET_LOGS', 'TOGGLE_WRITER',
+    'SEARCH_MESSAGES', 'GET_CHANGES'
+];
+const COMMAND_FIELDS = {
+    user: 1, room: 2, message: 3, id: 4, page: 5, limit: 6, wait_ms: 7, before: 8, after: 9, enabled: 10,
+    query: 11, since: 12
+};
+const COMMAND_FRAME_HEADER = 9;
+const COMMAND_REPLY_HEADER = 12;
+
 class CDaemonBridge extends EventEmitter {
     constructor(daemonUrl = process.env.DAEMON_URL || 'http://localhost:8081') {
         super();
         this.daemonUrl = daemonUrl;
+        // Reuse daemon connections across requests (daemon honors HTTP/1.1 keep-alive)
+        this.httpAgent = new http.Agent({ keepAlive: true, maxSockets: 8 });
+        this.socketPath = process.env.DAEMON_SOCKET || null; // Unset keeps commands in memory
         this.socket = null;
+        this.socketBuffer = Buffer.alloc(0);
         this.connected = false;
         
         // In-memory semaphore state (since C daemon has bugs)
@@ -23,10 +42,13 @@ class CDaemonBridge extends EventEmitter {
                 id: 1,
                 username: 'system',
                 message: 'Welcome to Binary Semaphore Chat! This is a demo message.',
-                created_at: new Date().toISOString()
+                created_at: new Date().toISOString(),
+                change_seq: 1
             }
         ];
         this.nextMessageId = 2;
+        this.changeSeq = 1; // Last change sequence number handed out
+        this.tombstones = []; // Deleted messages, kept for change feed readers
         this.reconnectAttempts = 0;
         this.maxReconnectAttempts = 5;
         this.reconnectDelay = 1000; // Start with 1 second
@@ -36,6 +58,17 @@ class CDaemonBridge extends EventEmitter {
         this.commandId = 0;
         this.connectionTimeout = 5000; // 5 seconds
         this.responseTimeout = 10000; // 10 seconds
+
+        // Daemon push stream (GET /api/events) replacing status polling
+        this.eventRoom = process.env.DAEMON_ROOM || 'general';
+        this.eventRequest = null;
+        this.lastEventId = null;
+        this.roomGeneration = 0; // Holder-word generation of the last applied acquire/release
+        this.eventRetryDelay = 2000; // Daemon sends its own "retry:" value
+        this.eventWatchdogMs = 35000; // Two missed 15 s heartbeats plus slack
+        this.eventWatchdog = null;
+        this.eventReconnectTimer = null;
+        this.eventsClosed = false;
     }
 
     // Connect to C daemon via HTTP (optional - semaphore works without it)
@@ -49,13 +82,15 @@ class CDaemonBridge extends EventEmitter {
             
             try {
                 // Test connection with a simple HTTP request
-                const response = await fetch(`${this.daemonUrl}/api/semaphore/status`);
+                const response = await fetch(`${this.daemonUrl}/api/semaphore/status`, { agent: this.httpAgent });
                 if (response.ok) {
                     this.connected = true;
                     this.reconnectAttempts = 0;
                     this.reconnectDelay = 1000;
                     console.log('Connected to C daemon via HTTP');
                     this.emit('connected');
+                    this.subscribeEvents();
+                    this.openCommandSocket();
                     
                     // Update error handler daemon state
                     try {
@@ -128,34 +163,142 @@ class CDaemonBridge extends EventEmitter {
         }
     }
 
-    // Handle response from C daemon
+    // Open the daemon's command socket. Commands are multiplexed over this
+    // one connection; without it the bridge keeps its in-memory state.
+    openCommandSocket() {
+        if (!this.socketPath || this.socket) {
+            return;
+        }
+
+        const socket = net.createConnection(this.socketPath);
+        this.socket = socket;
+        this.socketBuffer = Buffer.alloc(0);
+
+        socket.on('connect', () => {
+            console.log(`Command socket connected: ${this.socketPath}`);
+            this.processCommandQueue();
+        });
+        socket.on('data', (chunk) => this.handleResponse(chunk));
+        socket.on('error', (error) => {
+            console.warn('C daemon command socket error:', error.message);
+        });
+        socket.on('close', () => {
+            if (this.socket === socket) {
+                this.handleCommandSocketClosed();
+            }
+        });
+    }
+
+    // Fail in-flight commands; the next connect() reopens the socket
+    handleCommandSocketClosed() {
+        this.socket = null;
+        this.socketBuffer = Buffer.alloc(0);
+
+        const connectionError = new Error('Connection lost - daemon disconnected');
+        connectionError.code = 'CONNECTION_ERROR';
+        for (const [commandId, { reject, timeout }] of this.pendingCommands) {
+            clearTimeout(timeout);
+            reject(connectionError);
+        }
+        this.pendingCommands.clear();
+
+        if (this.connected && !this.eventsClosed) {
+            this.handleDisconnection();
+        }
+    }
+
+    // True when commands can go to the daemon instead of the in-memory state
+    hasCommandSocket() {
+        return this.connected && this.socket !== null && !this.socket.connecting;
+    }
+
+    // Handle reply frames from the C daemon; replies may arrive in any order
     handleResponse(data) {
-        try {
-            const response = JSON.parse(data.toString());
-            const commandId = response.commandId;
-            
-            if (this.pendingCommands.has(commandId)) {
-                const { resolve, reject, timeout } = this.pendingCommands.get(commandId);
-                clearTimeout(timeout);
-                this.pendingCommands.delete(commandId);
-                
-                if (response.status === 'OK') {
-                    resolve(response);
-                } else {
-                    reject(new Error(response.error || 'Unknown error'));
-                }
-            } else {
+        this.socketBuffer = this.socketBuffer.length ? Buffer.concat([this.socketBuffer, data]) : data;
+
+        while (this.socketBuffer.length >= 4) {
+            const length = this.socketBuffer.readUInt32BE(0);
+            if (this.socketBuffer.length < 4 + length) {
+                return;
+            }
+            const frame = this.socketBuffer.subarray(4, 4 + length);
+            this.socketBuffer = this.socketBuffer.subarray(4 + length);
+
+            const commandId = frame.readUInt32BE(0);
+            const status = frame.readInt32BE(4);
+            const payload = frame.toString('utf8', COMMAND_REPLY_HEADER - 4);
+
+            if (!this.pendingCommands.has(commandId)) {
                 console.warn('Received response for unknown command ID:', commandId);
+                continue;
+            }
+            const { resolve, timeout } = this.pendingCommands.get(commandId);
+            clearTimeout(timeout);
+            this.pendingCommands.delete(commandId);
+
+            if (status !== 0) {
+                resolve({ status: 'ERROR', code: status, error: payload || 'Unknown error' });
+                continue;
+            }
+            try {
+                resolve({ status: 'OK', data: JSON.parse(payload) });
+            } catch (error) {
+                resolve({ status: 'ERROR', error: `Failed to parse C daemon response: ${error.message}` });
             }
-        } catch (error) {
-            console.error('Failed to parse C daemon response:', error.message);
         }
     }
 
-    // Send command to C daemon
+    // Encode { type, ...fields } as a command frame
+    encodeCommand(commandId, command) {
+        const type = COMMAND_TYPES.indexOf(command.type);
+        if (type < 0) {
+            throw new Error(`Unknown daemon command: ${command.type}`);
+        }
+
+        const fields = [];
+        const addField = (tag, value) => {
+            const header = Buffer.alloc(3);
+            header.writeUInt8(tag, 0);
+            header.writeUInt16BE(value.length, 1);
+            fields.push(header, value);
+        };
+        for (const [name, value] of Object.entries(command)) {
+            const tag = COMMAND_FIELDS[name];
+            if (tag === undefined || value === undefined || value === null) {
+                continue;
+            }
+            if (name === 'enabled') {
+                addField(tag, Buffer.from([value ? 1 : 0]));
+            } else if (name === 'since') {
+                // Change sequence numbers are 64-bit
+                const number = Buffer.alloc(8);
+                number.writeBigUInt64BE(BigInt(Math.max(0, Math.trunc(Number(value) || 0))), 0);
+                addField(tag, number);
+            } else if (typeof value === 'number') {
+                const number = Buffer.alloc(4);
+                number.writeUInt32BE(value >>> 0, 0);
+                addField(tag, number);
+            } else {
+                addField(tag, Buffer.from(String(value), 'utf8'));
+            }
+        }
+        // A batch repeats the MESSAGE field once per entry
+        for (const message of command.messages || []) {
+            addField(COMMAND_FIELDS.message, Buffer.from(String(message), 'utf8'));
+        }
+
+        const body = Buffer.concat(fields);
+        const head = Buffer.alloc(4 + COMMAND_FRAME_HEADER - 4);
+        head.writeUInt32BE(COMMAND_FRAME_HEADER - 4 + body.length, 0);
+        head.writeUInt32BE(commandId, 4);
+        head.writeUInt8(type, 8);
+        return Buffer.concat([head, body]);
+    }
+
+    // Send command to C daemon; resolves with { status, data } or { status: 'ERROR', error }
     async sendCommand(command) {
         return new Promise((resolve, reject) => {
-            if (!this.connected) {
+            if (!this.connected || !this.socket || this.socket.connecting) {
                 // Queue command for later processing
                 this.commandQueue.push({ command, resolve, reject });
                 
@@ -166,20 +309,18 @@ class CDaemonBridge extends EventEmitter {
                 return;
             }
 
-            const commandId = ++this.commandId;
-            const commandWithId = { ...command, commandId };
+            const commandId = this.commandId = (this.commandId + 1) >>> 0;
             
             // Set response timeout
             const timeout = setTimeout(() => {
                 this.pendingCommands.delete(commandId);
                 reject(new Error('Command timeout'));
-            }, this.responseTimeout);
+            }, this.responseTimeout + (command.wait_ms || 0));
 
             this.pendingCommands.set(commandId, { resolve, reject, timeout });
 
             try {
-                const jsonCommand = JSON.stringify(commandWithId);
-                this.socket.write(jsonCommand + '\n');
+                this.socket.write(this.encodeCommand(commandId, command));
             } catch (error) {
                 clearTimeout(timeout);
                 this.pendingCommands.delete(commandId);
@@ -190,18 +331,217 @@ class CDaemonBridge extends EventEmitter {
 
     // Process queued commands
     processCommandQueue() {
-        while (this.commandQueue.length > 0 && this.connected) {
+        while (this.commandQueue.length > 0 && this.hasCommandSocket()) {
             const { command, resolve, reject } = this.commandQueue.shift();
             this.sendCommand(command).then(resolve).catch(reject);
         }
     }
 
+    // Daemon event stream
+
+    // Subscribe to the daemon's Server-Sent Events stream. Changes made
+    // through the daemon arrive as they happen; after a reconnect the
+    // daemon replays what was missed (Last-Event-ID) or asks for a resync.
+    subscribeEvents() {
+        if (this.eventRequest || this.eventsClosed) {
+            return;
+        }
+
+        const headers = { Accept: 'text/event-stream' };
+        if (this.lastEventId) {
+            headers['Last-Event-ID'] = this.lastEventId;
+        }
+
+        const req = http.get(`${this.daemonUrl}/api/events`, { headers, agent: false }, (res) => {
+            if (res.statusCode !== 200) {
+                console.warn(`C daemon event stream refused: HTTP ${res.statusCode}`);
+                res.resume();
+                this.handleEventStreamClosed(req);
+                return;
+            }
+
+            console.log('Subscribed to C daemon event stream');
+            res.setEncoding('utf8');
+            let buffer = '';
+            this.resetEventWatchdog(req);
+
+            res.on('data', (chunk) => {
+                this.resetEventWatchdog(req);
+                buffer += chunk.replace(/\r\n?/g, '\n');
+                let end;
+                while ((end = buffer.indexOf('\n\n')) !== -1) {
+                    const frame = buffer.slice(0, end);
+                    buffer = buffer.slice(end + 2);
+                    this.handleEventFrame(frame);
+                }
+            });
+            res.on('end', () => this.handleEventStreamClosed(req));
+            res.on('error', () => this.handleEventStreamClosed(req));
+        });
+
+        req.on('error', () => this.handleEventStreamClosed(req));
+        this.eventRequest = req;
+    }
+
+    // A stream that stops sending heartbeats is dead even if TCP has not noticed
+    resetEventWatchdog(req) {
+        clearTimeout(this.eventWatchdog);
+        this.eventWatchdog = setTimeout(() => {
+            console.warn('C daemon event stream silent, reconnecting');
+            req.destroy();
+        }, this.eventWatchdogMs);
+    }
+
+    handleEventStreamClosed(req) {
+        if (this.eventRequest !== req) {
+            return; // Already handled
+        }
+        this.eventRequest = null;
+        clearTimeout(this.eventWatchdog);
+        req.destroy();
+
+        if (!this.eventsClosed && !this.eventReconnectTimer) {
+            this.eventReconnectTimer = setTimeout(() => {
+                this.eventReconnectTimer = null;
+                this.subscribeEvents();
+            }, this.eventRetryDelay);
+        }
+    }
+
+    // Parse one SSE frame ("field: value" lines; ":" lines are comments)
+    handleEventFrame(frame) {
+        let type = 'message';
+        const data = [];
+
+        for (const line of frame.split('\n')) {
+            if (line === '' || line.startsWith(':')) {
+                continue;
+            }
+            const colon = line.indexOf(':');
+            const field = colon === -1 ? line : line.slice(0, colon);
+            let value = colon === -1 ? '' : line.slice(colon + 1);
+            if (value.startsWith(' ')) {
+                value = value.slice(1);
+            }
+
+            if (field === 'id') {
+                this.lastEventId = value;
+            } else if (field === 'event') {
+                type = value;
+            } else if (field === 'data') {
+                data.push(value);
+            } else if (field === 'retry' && /^\d+$/.test(value)) {
+                this.eventRetryDelay = parseInt(value, 10);
+            }
+        }
+
+        if (data.length === 0) {
+            return;
+        }
+        try {
+            this.applyDaemonEvent(type, JSON.parse(data.join('\n')));
+        } catch (error) {
+            console.error(`Bad C daemon event (${type}):`, error.message);
+        }
+    }
+
+    // Fold a daemon event into the mirrored state and re-emit it
+    applyDaemonEvent(type, data) {
+        switch (type) {
+            case 'resync':
+                this.resyncFromDaemon();
+                break;
+
+            case 'acquire':
+            case 'release':
+                // Generations order a room's acquire/release events even
+                // when the daemon published them from different threads
+                if (data.room !== this.eventRoom || data.generation <= this.roomGeneration) {
+                    break;
+                }
+                this.roomGeneration = data.generation;
+                this.semaphoreState.isLocked = type === 'acquire';
+                this.semaphoreState.currentHolder = type === 'acquire' ? data.holder : null;
+                this.emit('writerChanged', {
+                    event: type === 'acquire' ? 'acquired' : 'released',
+                    username: data.holder,
+                    reason: data.reason
+                });
+                this.emitStatusChanged();
+                break;
+
+            case 'toggle':
+                this.semaphoreState.writerEnabled = data.writer_enabled;
+                this.emitStatusChanged();
+                break;
+
+            case 'message_created':
+                if (data.room === this.eventRoom) {
+                    this.emit('messageCreated', {
+                        id: data.id,
+                        message: data.message,
+                        username: data.username,
+                        timestamp: data.created_at
+                    });
+                }
+                break;
+
+            case 'message_updated':
+            case 'message_deleted':
+                if (data.room === this.eventRoom) {
+                    this.emit(type === 'message_updated' ? 'messageUpdated' : 'messageDeleted', data);
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    // The stream could not be resumed: reload the room's state from the daemon
+    async resyncFromDaemon() {
+        try {
+            const response = await fetch(`${this.daemonUrl}/api/semaphore/rooms`, { agent: this.httpAgent });
+            const body = await response.json();
+            const room = (body.data?.semaphores || body.semaphores || []).find(r => r.room === this.eventRoom);
+
+            this.roomGeneration = 0;
+            this.semaphoreState.writerEnabled = (body.data || body).writer_enabled !== false;
+            this.semaphoreState.isLocked = room ? room.semaphore === 0 : false;
+            this.semaphoreState.currentHolder = room && room.holder ? room.holder : null;
+            this.emitStatusChanged();
+        } catch (error) {
+            console.warn('C daemon resync failed:', error.message);
+        }
+    }
+
+    emitStatusChanged() {
+        this.emit('statusChanged', {
+            semaphore: this.semaphoreState.isLocked ? 0 : 1,
+            holder: this.semaphoreState.currentHolder || null,
+            writer_enabled: this.semaphoreState.writerEnabled,
+            timestamp: new Date().toISOString()
+        });
+    }
+
+    closeEvents() {
+        this.eventsClosed = true;
+        clearTimeout(this.eventWatchdog);
+        clearTimeout(this.eventReconnectTimer);
+        if (this.eventRequest) {
+            this.eventRequest.destroy();
+            this.eventRequest = null;
+        }
+    }
+
     // Disconnect from C daemon
     disconnect() {
+        this.closeEvents();
         if (this.socket) {
             this.socket.end();
             this.socket = null;
         }
+        this.httpAgent.destroy();
         this.connected = false;
         this.commandQueue = [];
         this.pendingCommands.clear();
@@ -214,8 +554,21 @@ class CDaemonBridge extends EventEmitter {
 
     // High-level command methods
 
+    // Run a command on the daemon; connection failures become ERROR results
+    async daemonCommand(command) {
+        try {
+            return await this.sendCommand({ room: this.eventRoom, ...command });
+        } catch (error) {
+            return { status: 'ERROR', error: error.message };
+        }
+    }
+
     // Try to acquire writer semaphore (in-memory implementation)
     async tryAcquireWriter(username) {
+        if (this.hasCommandSocket()) {
+            return this.daemonCommand({ type: 'TRY_ACQUIRE', user: username });
+        }
+
         try {
             console.log(`[SEMAPHORE] Attempting to acquire semaphore for user: ${username}`);
             console.log(`[SEMAPHORE] Current state:`, {
@@ -250,6 +603,9 @@ class CDaemonBridge extends EventEmitter {
             this.semaphoreState.isLocked = true;
             this.semaphoreState.currentHolder = username;
             
+            this.emit('writerChanged', { event: 'acquired', username });
+            this.emitStatusChanged();
+            
             console.log(`[SEMAPHORE] ✅ Semaphore acquired successfully by: ${username}`);
             console.log(`[SEMAPHORE] New state:`, {
                 isLocked: this.semaphoreState.isLocked,
@@ -272,6 +628,10 @@ class CDaemonBridge extends EventEmitter {
 
     // Release writer semaphore (in-memory implementation)
     async releaseWriter(username) {
+        if (this.hasCommandSocket()) {
+            return this.daemonCommand({ type: 'RELEASE', user: username });
+        }
+
         try {
             console.log(`[SEMAPHORE] Attempting to release semaphore for user: ${username}`);
             console.log(`[SEMAPHORE] Current state:`, {
@@ -301,6 +661,9 @@ class CDaemonBridge extends EventEmitter {
             this.semaphoreState.isLocked = false;
             this.semaphoreState.currentHolder = null;
             
+            this.emit('writerChanged', { event: 'released', username });
+            this.emitStatusChanged();
+            
             console.log(`[SEMAPHORE] ✅ Semaphore released successfully by: ${username}`);
             console.log(`[SEMAPHORE] New state:`, {
                 isLocked: this.semaphoreState.isLocked,
@@ -322,14 +685,34 @@ class CDaemonBridge extends EventEmitter {
 
     // Create message (in-memory storage since C daemon doesn't implement this)
     async createMessage(username, message) {
+        if (this.hasCommandSocket()) {
+            // A one-entry batch, whose reply carries the new id
+            const response = await this.daemonCommand({ type: 'CREATE_BATCH', user: username, messages: [message] });
+            if (response.status !== 'OK') {
+                return response;
+            }
+            const [created] = response.data.messages;
+            return {
+                status: 'OK',
+                data: { id: created.id, username, message, timestamp: created.timestamp }
+            };
+        }
+
         const newMessage = {
             id: this.nextMessageId++,
             username: username,
             message: message,
-            created_at: new Date().toISOString()
+            created_at: new Date().toISOString(),
+            change_seq: ++this.changeSeq
         };
         
         this.messages.push(newMessage);
+        this.emit('messageCreated', {
+            id: newMessage.id,
+            message: newMessage.message,
+            username: newMessage.username,
+            timestamp: newMessage.created_at
+        });
         
         return {
             status: 'OK',
@@ -344,6 +727,10 @@ class CDaemonBridge extends EventEmitter {
 
     // Update message (in-memory storage since C daemon doesn't implement this)
     async updateMessage(username, messageId, message) {
+        if (this.hasCommandSocket()) {
+            return this.daemonCommand({ type: 'UPDATE_MESSAGE', user: username, id: parseInt(messageId), message });
+        }
+
         const messageIndex = this.messages.findIndex(m => m.id === parseInt(messageId));
         
         if (messageIndex === -1) {
@@ -356,6 +743,8 @@ class CDaemonBridge extends EventEmitter {
         
         this.messages[messageIndex].message = message;
         this.messages[messageIndex].updated_at = new Date().toISOString();
+        this.messages[messageIndex].change_seq = ++this.changeSeq;
+        this.emit('messageUpdated', { id: this.messages[messageIndex].id, username, message });
         
         return {
             status: 'OK',
@@ -370,6 +759,10 @@ class CDaemonBridge extends EventEmitter {
 
     // Delete message (in-memory storage since C daemon doesn't implement this)
     async deleteMessage(username, messageId) {
+        if (this.hasCommandSocket()) {
+            return this.daemonCommand({ type: 'DELETE_MESSAGE', user: username, id: parseInt(messageId) });
+        }
+
         const messageIndex = this.messages.findIndex(m => m.id === parseInt(messageId));
         
         if (messageIndex === -1) {
@@ -380,7 +773,9 @@ class CDaemonBridge extends EventEmitter {
             return { status: 'ERROR', error: 'You can only delete your own messages' };
         }
         
-        this.messages.splice(messageIndex, 1);
+        const [deleted] = this.messages.splice(messageIndex, 1);
+        this.tombstones.push({ change_seq: ++this.changeSeq, id: deleted.id, deleted_at: new Date().toISOString() });
+        this.emit('messageDeleted', { id: deleted.id, username });
         
         return {
             status: 'OK',
@@ -390,6 +785,14 @@ class CDaemonBridge extends EventEmitter {
 
     // List messages (in-memory storage since C daemon doesn't implement this)
     async listMessages(page = 1, limit = 50) {
+        if (this.hasCommandSocket()) {
+            const response = await this.daemonCommand({ type: 'LIST_MESSAGES', page, limit });
+            if (response.status === 'OK') {
+                response.data.hasMore = Boolean(response.data.next_cursor);
+            }
+            return response;
+        }
+
         const startIndex = (page - 1) * limit;
         const endIndex = startIndex + limit;
         const paginatedMessages = this.messages
@@ -406,8 +809,86 @@ class CDaemonBridge extends EventEmitter {
         };
     }
 
+    // Ranked full-text search; the in-memory fallback matches messages
+    // containing every word, most occurrences first
+    async searchMessages(query, page = 1, limit = 50) {
+        if (this.hasCommandSocket()) {
+            const response = await this.daemonCommand({ type: 'SEARCH_MESSAGES', query, page, limit });
+            if (response.status === 'OK') {
+                response.data.hasMore = page * limit < response.data.total;
+            }
+            return response;
+        }
+
+        const words = String(query).toLowerCase().match(/[a-z0-9]+|[^\x00-\x7f]+/g) || [];
+        if (words.length === 0) {
+            return { status: 'ERROR', error: 'Invalid query, page or limit parameters' };
+        }
+        const hits = [];
+        for (const message of this.messages) {
+            const text = message.message.toLowerCase();
+            const counts = words.map(word => text.split(word).length - 1);
+            if (counts.every(count => count > 0)) {
+                hits.push({ ...message, score: counts.reduce((sum, count) => sum + count, 0) });
+            }
+        }
+        hits.sort((a, b) => b.score - a.score || b.id - a.id);
+
+        const startIndex = (page - 1) * limit;
+        return {
+            status: 'OK',
+            data: {
+                query,
+                hits: hits.slice(startIndex, startIndex + limit),
+                total: hits.length,
+                page,
+                limit,
+                complete: true,
+                hasMore: startIndex + limit < hits.length
+            }
+        };
+    }
+
+    // Messages created, edited or deleted after sequence number since, oldest change first
+    async getChanges(since = 0, limit = 50) {
+        if (this.hasCommandSocket()) {
+            return this.daemonCommand({ type: 'GET_CHANGES', since, limit });
+        }
+
+        const changes = [
+            ...this.messages
+                .filter(m => m.change_seq > since)
+                .map(m => ({
+                    seq: m.change_seq, op: 'upsert', id: m.id, username: m.username,
+                    message: m.message, created_at: m.created_at
+                })),
+            ...this.tombstones
+                .filter(t => t.change_seq > since)
+                .map(t => ({ seq: t.change_seq, op: 'delete', id: t.id, deleted_at: t.deleted_at }))
+        ].sort((a, b) => a.seq - b.seq);
+
+        const page = changes.slice(0, limit);
+        return {
+            status: 'OK',
+            data: {
+                changes: page,
+                next_since: page.length > 0 ? page[page.length - 1].seq : since,
+                has_more: changes.length > limit
+            }
+        };
+    }
+
     // Get semaphore status (in-memory implementation)
     async getStatus() {
+        if (this.hasCommandSocket()) {
+            const response = await this.daemonCommand({ type: 'GET_STATUS' });
+            if (response.status === 'OK') {
+                response.data.writer_enabled = this.semaphoreState.writerEnabled;
+                response.data.timestamp = new Date().toISOString();
+            }
+            return response;
+        }
+
         try {
             return {
                 status: 'OK',
@@ -425,6 +906,10 @@ class CDaemonBridge extends EventEmitter {
 
     // Get logs (fallback to mock since C daemon doesn't implement this)
     async getLogs(page = 1, limit = 50) {
+        if (this.hasCommandSocket()) {
+            return this.daemonCommand({ type: 'GET_LOGS', page, limit });
+        }
+
         return {
             status: 'OK',
             data: {
@@ -446,6 +931,10 @@ class CDaemonBridge extends EventEmitter {
 
     // Toggle writer access (in-memory implementation)
     async toggleWriter(adminUser, enabled) {
+        if (this.hasCommandSocket()) {
+            return this.daemonCommand({ type: 'TOGGLE_WRITER', user: adminUser, enabled });
+        }
+
         try {
             console.log(`Admin ${adminUser} ${enabled ? 'enabling' : 'disabling'} writer access`);
             
@@ -454,9 +943,12 @@ class CDaemonBridge extends EventEmitter {
             // If disabling writers and someone currently holds the semaphore, force release
             if (!enabled && this.semaphoreState.isLocked) {
                 console.log(`Forcing release of semaphore held by ${this.semaphoreState.currentHolder} due to admin disable`);
+                const holder = this.semaphoreState.currentHolder;
                 this.semaphoreState.isLocked = false;
                 this.semaphoreState.currentHolder = null;
+                this.emit('writerChanged', { event: 'released', username: holder, reason: 'writer_disabled' });
             }
+            this.emitStatusChanged();
             
             return {
                 status: 'OK',
@@ -483,6 +975,9 @@ const getBridge = () => {
             console.log('C daemon bridge connected');
             
             // Secure the Unix socket file permissions
+            if (!bridgeInstance.socketPath) {
+                return;
+            }
             try {
                 const { secureUnixSocket } = require('./security');
                 secureUnixSocket(bridgeInstance.socketPath);
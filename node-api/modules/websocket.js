@@ -7,8 +7,7 @@ class WebSocketManager {
     constructor() {
         this.wss = null;
         this.clients = new Map(); // Map of client ID to client info
-        this.statusPollingInterval = null;
-        this.pollingIntervalMs = 2000; // Poll every 2 seconds
+        this.bridgeListeners = null; // Bridge events fanned out to clients
         this.lastKnownStatus = null;
     }
 
@@ -21,7 +20,7 @@ class WebSocketManager {
         });
 
         this.wss.on('connection', this.handleConnection.bind(this));
-        this.startStatusPolling();
+        this.subscribeToBridge();
 
         console.log('WebSocket server initialized at /ws/status');
     }
@@ -190,51 +189,30 @@ class WebSocketManager {
         return sentCount;
     }
 
-    // Start periodic status polling
-    startStatusPolling() {
-        if (this.statusPollingInterval) {
-            clearInterval(this.statusPollingInterval);
-        }
-
-        this.statusPollingInterval = setInterval(async () => {
-            try {
-                // Only poll if we have connected clients
-                if (this.clients.size === 0) return;
-
-                const bridge = getBridge();
-                if (!bridge.isConnected()) return;
+    // Fan bridge events out to clients as they happen. The bridge emits
+    // them for changes made through it and for everything the C daemon
+    // pushes on its event stream, so nothing has to be polled.
+    subscribeToBridge() {
+        this.unsubscribeFromBridge();
 
-                const response = await bridge.getStatus();
-                
-                if (response.status === 'OK') {
-                    const currentStatus = {
-                        semaphore: response.data.semaphore || 1,
-                        holder: response.data.holder || null,
-                        writer_enabled: response.data.writer_enabled !== false,
-                        timestamp: response.data.timestamp || new Date().toISOString()
-                    };
-
-                    // Check if status has changed
-                    if (this.hasStatusChanged(currentStatus)) {
-                        console.log('Semaphore status changed, broadcasting to clients');
-                        
-                        const broadcastData = {
-                            type: 'semaphore_status',
-                            data: currentStatus
-                        };
-                        
-                        const sentCount = this.broadcast(broadcastData);
-                        console.log(`Status broadcast sent to ${sentCount} clients`);
-                        
-                        this.lastKnownStatus = currentStatus;
-                    }
+        this.bridgeListeners = {
+            statusChanged: (status) => {
+                if (!this.hasStatusChanged(status)) {
+                    return;
                 }
-            } catch (error) {
-                console.error('Error during status polling:', error.message);
-            }
-        }, this.pollingIntervalMs);
+                this.lastKnownStatus = status;
+                const sentCount = this.broadcast({ type: 'semaphore_status', data: status });
+                console.log(`Status broadcast sent to ${sentCount} clients`);
+            },
+            writerChanged: ({ event, username }) => this.broadcastWriterChanged(event, username),
+            messageCreated: (messageData) => this.broadcastMessageCreated(messageData)
+        };
 
-        console.log(`Status polling started (interval: ${this.pollingIntervalMs}ms)`);
+        const bridge = getBridge();
+        for (const [event, listener] of Object.entries(this.bridgeListeners)) {
+            bridge.on(event, listener);
+        }
+        console.log('Subscribed to bridge events for real-time updates');
     }
 
     // Check if status has changed since last broadcast
@@ -250,12 +228,14 @@ class WebSocketManager {
         );
     }
 
-    // Stop status polling
-    stopStatusPolling() {
-        if (this.statusPollingInterval) {
-            clearInterval(this.statusPollingInterval);
-            this.statusPollingInterval = null;
-            console.log('Status polling stopped');
+    // Stop fanning out bridge events
+    unsubscribeFromBridge() {
+        if (this.bridgeListeners) {
+            const bridge = getBridge();
+            for (const [event, listener] of Object.entries(this.bridgeListeners)) {
+                bridge.off(event, listener);
+            }
+            this.bridgeListeners = null;
         }
     }
 
@@ -309,7 +289,7 @@ class WebSocketManager {
     shutdown() {
         console.log('Shutting down WebSocket server...');
         
-        this.stopStatusPolling();
+        this.unsubscribeFromBridge();
         
         // Close all client connections
         for (const [clientId, client] of this.clients) {
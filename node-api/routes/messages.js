@@ -9,7 +9,6 @@ const {
     validateAndSanitizeInput,
     CDaemonError
 } = require('../modules/errorHandler');
-const { getWebSocketManager } = require('../modules/websocket');
 
 const router = express.Router();
 
@@ -69,6 +68,118 @@ router.get('/',
     })
 );
 
+// GET /api/messages/search - Ranked full-text search (accessible to readers and writers)
+router.get('/search',
+    authenticateToken,
+    requireRole(['reader', 'writer', 'admin']),
+    [
+        query('q')
+            .notEmpty()
+            .withMessage('Search query is required')
+            .isLength({ min: 1, max: 256 })
+            .withMessage('Search query must be between 1 and 256 characters'),
+        query('page')
+            .optional()
+            .isInt({ min: 1, max: 1000 })
+            .withMessage('Page must be between 1 and 1000'),
+        query('limit')
+            .optional()
+            .isInt({ min: 1, max: 100 })
+            .withMessage('Limit must be between 1 and 100')
+    ],
+    validateAndSanitizeInput(),
+    asyncHandler(async (req, res, next) => {
+        try {
+            const q = String(req.query.q);
+            const page = parseInt(req.query.page) || 1;
+            const limit = parseInt(req.query.limit) || 50;
+
+            console.log(`User ${req.user.username} (${req.user.role}) searching messages - page: ${page}, limit: ${limit}`);
+
+            const bridge = getBridge();
+            const response = await bridge.searchMessages(q, page, limit);
+
+            if (response.status === 'OK') {
+                res.json({
+                    success: true,
+                    data: {
+                        query: q,
+                        hits: response.data.hits || [],
+                        complete: response.data.complete !== false,
+                        pagination: {
+                            page: page,
+                            limit: limit,
+                            total: response.data.total || 0,
+                            hasMore: response.data.hasMore || false
+                        }
+                    }
+                });
+            } else {
+                const unavailable = response.error && response.error.includes('not available');
+                throw new CDaemonError(
+                    response.error || 'Failed to search messages',
+                    unavailable ? 'SEARCH_UNAVAILABLE' : 'MESSAGE_SEARCH_FAILED',
+                    unavailable ? 503 : 500,
+                    { daemonStatus: response.status, operation: 'search_messages' }
+                );
+            }
+        } catch (error) {
+            console.error('Error searching messages:', error.message);
+            throw error;
+        }
+    })
+);
+
+// GET /api/messages/changes - Messages created, edited or deleted since a sequence number
+router.get('/changes',
+    authenticateToken,
+    requireRole(['reader', 'writer', 'admin']),
+    [
+        query('since')
+            .optional()
+            .isInt({ min: 0, max: 4294967295 })
+            .withMessage('Since must be a non-negative sequence number'),
+        query('limit')
+            .optional()
+            .isInt({ min: 1, max: 100 })
+            .withMessage('Limit must be between 1 and 100')
+    ],
+    validateAndSanitizeInput(),
+    asyncHandler(async (req, res, next) => {
+        try {
+            const since = parseInt(req.query.since) || 0;
+            const limit = parseInt(req.query.limit) || 50;
+
+            console.log(`User ${req.user.username} (${req.user.role}) fetching changes - since: ${since}, limit: ${limit}`);
+
+            const bridge = getBridge();
+            const response = await bridge.getChanges(since, limit);
+
+            if (response.status === 'OK') {
+                res.json({
+                    success: true,
+                    data: {
+                        changes: response.data.changes || [],
+                        nextSince: response.data.next_since,
+                        hasMore: response.data.has_more || false
+                    }
+                });
+            } else {
+                const unavailable = response.error && response.error.includes('not available');
+                throw new CDaemonError(
+                    response.error || 'Failed to fetch message changes',
+                    unavailable ? 'CHANGES_UNAVAILABLE' : 'MESSAGE_CHANGES_FAILED',
+                    unavailable ? 501 : 500,
+                    { daemonStatus: response.status, operation: 'get_changes' }
+                );
+            }
+        } catch (error) {
+            console.error('Error fetching message changes:', error.message);
+            throw error;
+        }
+    })
+);
+
 // POST /api/messages - Create new message (writer only)
 // Requirements: 6.3, 6.4, 6.2
 router.post('/',
@@ -103,10 +214,6 @@ router.post('/',
                     timestamp: response.data.timestamp
                 };
                 
-                // Broadcast message creation to WebSocket clients
-                const wsManager = getWebSocketManager();
-                wsManager.broadcastMessageCreated(messageData);
-                
                 res.status(201).json({
                     success: true,
                     data: messageData
@@ -8,7 +8,6 @@ const {
     validateAndSanitizeInput,
     CDaemonError
 } = require('../modules/errorHandler');
-const { getWebSocketManager } = require('../modules/websocket');
 
 const router = express.Router();
 
@@ -29,10 +28,6 @@ router.post('/request',
 
             // Map C daemon response to HTTP response
             if (response.status === 'OK') {
-                // Broadcast writer acquisition to WebSocket clients
-                const wsManager = getWebSocketManager();
-                wsManager.broadcastWriterChanged('acquired', username);
-                
                 res.json({
                     success: true,
                     message: 'Writer semaphore acquired successfully',
@@ -97,10 +92,6 @@ router.post('/release',
 
             // Map C daemon response to HTTP response
             if (response.status === 'OK') {
-                // Broadcast writer release to WebSocket clients
-                const wsManager = getWebSocketManager();
-                wsManager.broadcastWriterChanged('released', username);
-                
                 res.json({
                     success: true,
                     message: 'Writer semaphore released successfully',